@@ -31,11 +31,14 @@
 
 /** Maps classes **/
 #include <maps/LocalMap.hpp>
+#include <maps/geometric/SpatialIndex.hpp>
 
 /** Std vector **/
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <typeindex>
+#include <algorithm>
 
 /** Boost serialization **/
 #include <boost/serialization/access.hpp>
@@ -72,7 +75,8 @@ namespace maps { namespace geometric
 
         GeometricMap(const GeometricMap& other)
             : LocalMap(other),
-            elements (other.elements)
+            elements (other.elements),
+            spatial_index (other.spatial_index)
         {
         }
 
@@ -92,6 +96,7 @@ namespace maps { namespace geometric
         void resize(Ts&&... args)
         {
             this->elements.resize(std::forward<Ts>(args)...);
+            invalidateSpatialIndex();
         }
 
         size_t capacity()
@@ -106,6 +111,7 @@ namespace maps { namespace geometric
 
         void pop_back()
         {
+            invalidateSpatialIndex();
             return this->elements.pop_back();
         }
 
@@ -113,6 +119,7 @@ namespace maps { namespace geometric
         void insert(Ts&&... args)
         {
             this->elements.insert(std::forward<Ts>(args)...);
+            invalidateSpatialIndex();
         }
 
         size_t getNumElements() const
@@ -143,9 +150,179 @@ namespace maps { namespace geometric
         template <typename... Ts>
         iterator erase(Ts&&... args)
         {
+            invalidateSpatialIndex();
             return this->elements.erase(std::forward<Ts>(args)...);
         }
 
+        /**
+         * @brief Enables a bucket grid over the xy plane to accelerate the spatial queries.
+         * @details The index is built by the next query. Elements added by push_back
+         * are indexed incrementally, the other modifications of this class rebuild it.
+         * Elements which are modified in place by at(), operator[] or the iterators
+         * require a call of invalidateSpatialIndex(). Since queries update the index,
+         * they must not run concurrently with the first query after a modification.
+         * @param cell_size edge length of the buckets, in the order of the element size
+         */
+        void enableSpatialIndex(double cell_size)
+        {
+            if (cell_size <= 0.)
+                throw std::runtime_error("The cell size of the spatial index has to be positive");
+            spatial_index = SpatialIndex(cell_size);
+        }
+
+        void disableSpatialIndex()
+        {
+            spatial_index = SpatialIndex();
+        }
+
+        bool hasSpatialIndex() const
+        {
+            return spatial_index.getCellSize() > 0.;
+        }
+
+        void invalidateSpatialIndex()
+        {
+            spatial_index.clear();
+        }
+
+        /**
+         * @brief Returns the numbers of the @p k elements closest to @p position, ordered by distance.
+         * @details Without spatial index all elements are checked.
+         */
+        template <typename Derived>
+        std::vector<size_t> findNearest(const Eigen::MatrixBase<Derived>& position, size_t k) const
+        {
+            typedef std::pair<double, size_t> Candidate;
+            std::vector<Candidate> heap;
+            heap.reserve(k + 1);
+            auto consider = [&](size_t element)
+            {
+                const double distance = squaredDistance(this->elements[element], position);
+                if (heap.size() == k && !(distance < heap.front().first))
+                    return;
+                heap.push_back(Candidate(distance, element));
+                std::push_heap(heap.begin(), heap.end());
+                if (heap.size() > k)
+                {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.pop_back();
+                }
+            };
+
+            if (k > 0 && !hasSpatialIndex())
+            {
+                for (size_t i = 0; i < this->elements.size(); ++i)
+                    consider(i);
+            }
+            else if (k > 0 && !this->elements.empty())
+            {
+                updateSpatialIndex();
+                const SpatialIndex::BucketIndex center = spatial_index.toBucket(position.template head<2>().template cast<double>());
+                const Eigen::AlignedBox2i& extent = spatial_index.getExtent();
+                const int min_ring = std::max(0, std::max((extent.min() - center).maxCoeff(), (center - extent.max()).maxCoeff()));
+                const int max_ring = std::max((center - extent.min()).maxCoeff(), (extent.max() - center).maxCoeff());
+                std::unordered_set<uint32_t> visited;
+
+                // visit the rings of buckets around the bucket of the position until
+                // no closer element can be found in the remaining rings
+                for (int ring = min_ring; ring <= max_ring; ++ring)
+                {
+                    const double bound = std::max(ring - 1, 0) * spatial_index.getCellSize();
+                    if (heap.size() == k && heap.front().first <= bound * bound)
+                        break;
+
+                    const Eigen::AlignedBox2i ring_box(center.array() - ring, center.array() + ring);
+                    for (int y = std::max(ring_box.min().y(), extent.min().y()); y <= std::min(ring_box.max().y(), extent.max().y()); ++y)
+                    {
+                        const bool full_row = y == ring_box.min().y() || y == ring_box.max().y();
+                        const int step = full_row ? 1 : 2 * ring;
+                        for (int x = ring_box.min().x(); x <= ring_box.max().x(); x += step)
+                        {
+                            const std::vector<uint32_t>* bucket = spatial_index.getBucket(x, y);
+                            if (!bucket)
+                                continue;
+                            for (uint32_t element : *bucket)
+                            {
+                                if (visited.insert(element).second)
+                                    consider(element);
+                            }
+                        }
+                    }
+                }
+            }
+
+            std::sort_heap(heap.begin(), heap.end());
+            std::vector<size_t> result(heap.size());
+            for (size_t i = 0; i < heap.size(); ++i)
+                result[i] = heap[i].second;
+            return result;
+        }
+
+        /** @brief Returns the numbers of the elements within @p radius of @p position, in ascending order */
+        template <typename Derived>
+        std::vector<size_t> findInRadius(const Eigen::MatrixBase<Derived>& position, double radius) const
+        {
+            const Eigen::Vector2d center = position.template head<2>().template cast<double>();
+            std::vector<size_t> result;
+            for (size_t element : getCandidates(Eigen::AlignedBox2d(center.array() - radius, center.array() + radius)))
+            {
+                if (squaredDistance(this->elements[element], position) <= radius * radius)
+                    result.push_back(element);
+            }
+            return result;
+        }
+
+        /** @brief Returns the numbers of the elements intersecting @p box, in ascending order */
+        template <typename Scalar, int Dim>
+        std::vector<size_t> findInBox(const Eigen::AlignedBox<Scalar, Dim>& box) const
+        {
+            std::vector<size_t> result;
+            const Eigen::AlignedBox2d box_xy(box.min().template head<2>().template cast<double>(),
+                                             box.max().template head<2>().template cast<double>());
+            for (size_t element : getCandidates(box_xy))
+            {
+                if (intersects(this->elements[element], box))
+                    result.push_back(element);
+            }
+            return result;
+        }
+
+    private:
+        /** Bucket grid of the elements, built lazily by the queries */
+        mutable SpatialIndex spatial_index;
+
+        /** Adds the elements which are not indexed yet */
+        void updateSpatialIndex() const
+        {
+            for (size_t i = spatial_index.getNumElements(); i < this->elements.size(); ++i)
+            {
+                const auto box = boundingBox(this->elements[i]);
+                spatial_index.insert(i, Eigen::AlignedBox2d(box.min().template head<2>().template cast<double>(),
+                                                            box.max().template head<2>().template cast<double>()));
+            }
+        }
+
+        /** Elements whose bounding box may overlap @p box in the xy plane, in ascending order */
+        std::vector<size_t> getCandidates(const Eigen::AlignedBox2d& box) const
+        {
+            std::vector<size_t> candidates;
+            if (!hasSpatialIndex())
+            {
+                candidates.resize(this->elements.size());
+                for (size_t i = 0; i < candidates.size(); ++i)
+                    candidates[i] = i;
+                return candidates;
+            }
+
+            updateSpatialIndex();
+            std::vector<uint32_t> elements;
+            spatial_index.collect(box, elements);
+            std::sort(elements.begin(), elements.end());
+            elements.erase(std::unique(elements.begin(), elements.end()), elements.end());
+            candidates.assign(elements.begin(), elements.end());
+            return candidates;
+        }
+
     protected:
         /** Grants access to boost serialization */
         friend class boost::serialization::access;
@@ -156,6 +333,8 @@ namespace maps { namespace geometric
         {
              ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(::maps::LocalMap);
              ar & BOOST_SERIALIZATION_NVP(elements);
+             if (Archive::is_loading::value)
+                 invalidateSpatialIndex();
         }
     };
 }}
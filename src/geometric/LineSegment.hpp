@@ -41,6 +41,7 @@
 /** Std **/
 #include <math.h>
 #include <utility>
+#include <algorithm>
 
 namespace maps { namespace geometric
 {
@@ -151,6 +152,25 @@ namespace maps { namespace geometric
             return base::NaN<T>();
         }
 
+        /** Point of the line segment which is closest to @p point **/
+        VectorType closestPoint(const VectorType &point) const
+        {
+            const VectorType segment = this->_psi_b - this->origin();
+            const T length2 = segment.squaredNorm();
+            if (length2 == 0)
+                return this->origin();
+            T t = (point - this->origin()).dot(segment) / length2;
+            t = std::min(std::max(t, T(0)), T(1));
+            return this->origin() + t * segment;
+        }
+
+        /** Squared distance from @p point to the line segment, unlike
+         * distance() which is the distance to the infinite line. **/
+        T squaredSegmentDistance(const VectorType &point) const
+        {
+            return (closestPoint(point) - point).squaredNorm();
+        }
+
     protected:
         /** Grants access to boost serialization */
         friend class boost::serialization::access;
@@ -166,6 +186,48 @@ namespace maps { namespace geometric
 
     };
 
+    /** Bounding box of a line segment, used by the spatial queries of GeometricMap */
+    template <typename T, int D>
+    Eigen::AlignedBox<T, D> boundingBox(const LineSegment<T, D>& segment)
+    {
+        Eigen::AlignedBox<T, D> box(segment.psi_a());
+        box.extend(segment.psi_b());
+        return box;
+    }
+
+    template <typename T, int D, typename Derived>
+    T squaredDistance(const LineSegment<T, D>& segment, const Eigen::MatrixBase<Derived>& position)
+    {
+        return segment.squaredSegmentDistance(position);
+    }
+
+    /** True if a part of the line segment is inside of the box **/
+    template <typename T, int D>
+    bool intersects(const LineSegment<T, D>& segment, const Eigen::AlignedBox<T, D>& box)
+    {
+        // clip the segment at the slabs of the box
+        const typename LineSegment<T, D>::VectorType delta = segment.psi_b() - segment.psi_a();
+        T t_min = 0, t_max = 1;
+        for (int i = 0; i < D; ++i)
+        {
+            if (delta[i] == 0)
+            {
+                if (segment.psi_a()[i] < box.min()[i] || segment.psi_a()[i] > box.max()[i])
+                    return false;
+                continue;
+            }
+            T t0 = (box.min()[i] - segment.psi_a()[i]) / delta[i];
+            T t1 = (box.max()[i] - segment.psi_a()[i]) / delta[i];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            t_min = std::max(t_min, t0);
+            t_max = std::min(t_max, t1);
+            if (t_min > t_max)
+                return false;
+        }
+        return true;
+    }
+
     typedef LineSegment<double, 2> LineSegment2d;
     typedef LineSegment<double, 3> LineSegment3d;
     typedef LineSegment<float, 2> LineSegment2f;
@@ -54,6 +54,25 @@ namespace maps { namespace geometric
         }
     };
 
+    /** Bounding box of a point, used by the spatial queries of GeometricMap */
+    template <typename T, int D>
+    Eigen::AlignedBox<T, D> boundingBox(const Point<T, D>& point)
+    {
+        return Eigen::AlignedBox<T, D>(point, point);
+    }
+
+    template <typename T, int D, typename Derived>
+    T squaredDistance(const Point<T, D>& point, const Eigen::MatrixBase<Derived>& position)
+    {
+        return (point - position).squaredNorm();
+    }
+
+    template <typename T, int D>
+    bool intersects(const Point<T, D>& point, const Eigen::AlignedBox<T, D>& box)
+    {
+        return box.contains(point);
+    }
+
     typedef Point<double, 2> Point2d;
     typedef Point<double, 3> Point3d;
     typedef Point<float, 2> Point2f;
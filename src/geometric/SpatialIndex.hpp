@@ -0,0 +1,135 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <cmath>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace maps { namespace geometric
+{
+    /**
+     * @brief Uniform bucket grid over the xy plane storing element numbers.
+     * @details
+     * An element is stored in all buckets overlapped by its bounding box. Only
+     * occupied buckets are allocated, so the extent of the indexed area is not
+     * limited. Used by GeometricMap to accelerate its spatial queries.
+     */
+    class SpatialIndex
+    {
+    public:
+        typedef Eigen::Vector2i BucketIndex;
+
+        explicit SpatialIndex(double cell_size = 0.)
+            : cell_size(cell_size),
+              num_elements(0),
+              extent(BucketIndex::Zero(), BucketIndex::Zero())
+        {}
+
+        void clear()
+        {
+            buckets.clear();
+            num_elements = 0;
+            extent = Eigen::AlignedBox2i(BucketIndex::Zero(), BucketIndex::Zero());
+        }
+
+        double getCellSize() const
+        {
+            return cell_size;
+        }
+
+        /** Number of elements inserted since the last clear */
+        size_t getNumElements() const
+        {
+            return num_elements;
+        }
+
+        BucketIndex toBucket(const Eigen::Vector2d& position) const
+        {
+            return (position / cell_size).array().floor().cast<int>().matrix();
+        }
+
+        /** Occupied buckets are within this range */
+        const Eigen::AlignedBox2i& getExtent() const
+        {
+            return extent;
+        }
+
+        void insert(uint32_t element, const Eigen::AlignedBox2d& box)
+        {
+            const BucketIndex min = toBucket(box.min());
+            const BucketIndex max = toBucket(box.max());
+            if(num_elements == 0)
+                extent = Eigen::AlignedBox2i(min, max);
+            else
+                extent.extend(Eigen::AlignedBox2i(min, max));
+            num_elements++;
+
+            for(int y = min.y(); y <= max.y(); ++y)
+                for(int x = min.x(); x <= max.x(); ++x)
+                    buckets[toKey(x, y)].push_back(element);
+        }
+
+        /** Returns the elements of a bucket, or NULL if it is empty */
+        const std::vector<uint32_t>* getBucket(int x, int y) const
+        {
+            std::unordered_map<int64_t, std::vector<uint32_t> >::const_iterator it = buckets.find(toKey(x, y));
+            return it == buckets.end() ? NULL : &it->second;
+        }
+
+        /** Appends the elements of all buckets overlapped by @p box to @p elements, elements can be repeated */
+        void collect(const Eigen::AlignedBox2d& box, std::vector<uint32_t>& elements) const
+        {
+            const BucketIndex min = toBucket(box.min()).cwiseMax(extent.min());
+            const BucketIndex max = toBucket(box.max()).cwiseMin(extent.max());
+            for(int y = min.y(); y <= max.y(); ++y)
+            {
+                for(int x = min.x(); x <= max.x(); ++x)
+                {
+                    const std::vector<uint32_t>* bucket = getBucket(x, y);
+                    if(bucket)
+                        elements.insert(elements.end(), bucket->begin(), bucket->end());
+                }
+            }
+        }
+
+    private:
+        double cell_size;
+        size_t num_elements;
+        Eigen::AlignedBox2i extent;
+        std::unordered_map<int64_t, std::vector<uint32_t> > buckets;
+
+        static int64_t toKey(int x, int y)
+        {
+            return (int64_t(x) << 32) | uint32_t(y);
+        }
+    };
+}}
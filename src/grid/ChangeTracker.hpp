@@ -0,0 +1,161 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+
+#include <maps/grid/Index.hpp>
+
+namespace maps { namespace grid
+{
+    /**
+     * @brief Records which tiles of a grid were modified since a given version.
+     * @details
+     * The grid is divided into square tiles. Every modification increments the
+     * version of the tracker and stamps the tile of the modified cell with it,
+     * so the tiles changed since a version can be found without looking at the cells.
+     * Each start of the tracking begins a new history, copies of the tracker continue it.
+     */
+    class ChangeTracker
+    {
+    public:
+        ChangeTracker()
+            : tile_size(0),
+              num_cells(0, 0),
+              num_tiles(0, 0),
+              version(0),
+              history(0)
+        {}
+
+        /** Starts tracking a grid of @p num_cells, all tiles are marked as modified */
+        void init(const Vector2ui& num_cells, unsigned tile_size)
+        {
+            history = nextHistory();
+            this->tile_size = tile_size;
+            this->num_cells = num_cells;
+            num_tiles = Vector2ui((num_cells.x() + tile_size - 1) / tile_size, (num_cells.y() + tile_size - 1) / tile_size);
+            stamps.assign(num_tiles.prod(), 0);
+            markAllModified();
+        }
+
+        void clear()
+        {
+            tile_size = 0;
+            num_cells = Vector2ui(0, 0);
+            num_tiles = Vector2ui(0, 0);
+            stamps.clear();
+            history = 0;
+        }
+
+        bool isEmpty() const
+        {
+            return tile_size == 0;
+        }
+
+        unsigned getTileSize() const { return tile_size; }
+        const Vector2ui& getNumCells() const { return num_cells; }
+        const Vector2ui& getNumTiles() const { return num_tiles; }
+
+        /** Returns the version of the latest modification */
+        uint64_t getVersion() const
+        {
+            return version;
+        }
+
+        /** Stamps the tile of cell @p idx, cells outside of the tracked grid are ignored */
+        void markModified(const Index& idx)
+        {
+            if(tile_size && (unsigned)idx.x() < num_cells.x() && (unsigned)idx.y() < num_cells.y())
+                stamps[idx.x() / tile_size + (idx.y() / tile_size) * num_tiles.x()] = ++version;
+        }
+
+        void markAllModified()
+        {
+            ++version;
+            std::fill(stamps.begin(), stamps.end(), version);
+        }
+
+        /** Returns the version of the latest modification of @p tile */
+        uint64_t getStamp(const Index& tile) const
+        {
+            return stamps[tile.x() + tile.y() * num_tiles.x()];
+        }
+
+        /** Returns true if the tile was modified after @p since_version */
+        bool isModified(const Index& tile, uint64_t since_version) const
+        {
+            return stamps[tile.x() + tile.y() * num_tiles.x()] > since_version;
+        }
+
+        /**
+         * Returns true if both trackers record the same grid, i.e. one of them is a
+         * (possibly modified) copy of the other. Only then their stamps can be compared.
+         */
+        bool sharesHistory(const ChangeTracker& other) const
+        {
+            return !isEmpty() && history == other.history && tile_size == other.tile_size && num_cells == other.num_cells;
+        }
+
+        /**
+         * Returns true if a tile overlapping the cells [begin, end) was modified in only one
+         * of the trackers, which have to share their history.
+         */
+        bool differsFrom(const ChangeTracker& other, const Index& begin, const Index& end) const
+        {
+            for(int ty = begin.y() / tile_size; ty <= (end.y() - 1) / int(tile_size); ty++)
+                for(int tx = begin.x() / tile_size; tx <= (end.x() - 1) / int(tile_size); tx++)
+                    if(getStamp(Index(tx, ty)) != other.getStamp(Index(tx, ty)))
+                        return true;
+            return false;
+        }
+
+        /** Returns the cell range [begin, end) of a tile */
+        void getTileCells(const Index& tile, Index& begin, Index& end) const
+        {
+            begin = tile * int(tile_size);
+            end = (begin.array() + tile_size).matrix().cwiseMin(num_cells.cast<int>());
+        }
+
+    private:
+        unsigned tile_size;
+        Vector2ui num_cells;
+        Vector2ui num_tiles;
+        uint64_t version;
+        /** Identifies the grid, 0 while the tracking is disabled */
+        uint64_t history;
+        std::vector<uint64_t> stamps;
+
+        static uint64_t nextHistory()
+        {
+            static std::atomic<uint64_t> next_history(0);
+            return ++next_history;
+        }
+    };
+}}
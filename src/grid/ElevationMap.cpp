@@ -26,6 +26,8 @@
 //
 #include "ElevationMap.hpp"
 
+#include <Eigen/Core>
+
 namespace maps { namespace grid
 {
 
@@ -145,4 +147,54 @@ std::pair<float, float> ElevationMap::getElevationRange() const
     return std::pair<float, float>(min, max);
 }
 
+void ElevationMap::computeSurfaceProperties(SurfaceProperties &properties) const
+{
+    typedef Eigen::Array<float, Eigen::Dynamic, 1> ArrayXf;
+    typedef Eigen::Array<bool, Eigen::Dynamic, 1> ArrayXb;
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    GridMapF *layers[] = {&properties.normal_x, &properties.normal_y, &properties.normal_z, &properties.slope, &properties.curvature};
+    for (GridMapF *layer : layers)
+    {
+        *layer = GridMapF(getNumCells(), getResolution(), nan);
+        layer->getLocalFrame() = getLocalFrame();
+    }
+    properties.valid = GridMap<uint8_t>(getNumCells(), getResolution(), 0);
+    properties.valid.getLocalFrame() = getLocalFrame();
+
+    if (getNumCells().x() < 3 || getNumCells().y() < 3)
+        return;
+
+    const int width = getNumCells().x() - 2;
+    const float scale_x = 1.0 / (getResolution().x() * 2.0);
+    const float scale_y = 1.0 / (getResolution().y() * 2.0);
+    const float curvature_x = 1.0 / (getResolution().x() * getResolution().x());
+    const float curvature_y = 1.0 / (getResolution().y() * getResolution().y());
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 1; y < int(getNumCells().y()) - 1; ++y)
+    {
+        // the rows of the grid are contiguous
+        const Eigen::Map<const ArrayXf> left(&at(0, y), width);
+        const Eigen::Map<const ArrayXf> center(&at(1, y), width);
+        const Eigen::Map<const ArrayXf> right(&at(2, y), width);
+        const Eigen::Map<const ArrayXf> up(&at(1, y - 1), width);
+        const Eigen::Map<const ArrayXf> down(&at(1, y + 1), width);
+
+        const ArrayXb valid = (left != ELEVATION_DEFAULT) && (right != ELEVATION_DEFAULT)
+                              && (up != ELEVATION_DEFAULT) && (down != ELEVATION_DEFAULT);
+        const ArrayXf slope_x = (left - right) * scale_x;
+        const ArrayXf slope_y = (up - down) * scale_y;
+        const ArrayXf inv_norm = (slope_x.square() + slope_y.square() + 1.f).rsqrt();
+        const ArrayXf curvature = (left + right - 2.f * center) * curvature_x + (up + down - 2.f * center) * curvature_y;
+
+        Eigen::Map<ArrayXf>(&properties.normal_x.at(1, y), width) = valid.select(slope_x * inv_norm, nan);
+        Eigen::Map<ArrayXf>(&properties.normal_y.at(1, y), width) = valid.select(slope_y * inv_norm, nan);
+        Eigen::Map<ArrayXf>(&properties.normal_z.at(1, y), width) = valid.select(inv_norm, nan);
+        Eigen::Map<ArrayXf>(&properties.slope.at(1, y), width) = valid.select(inv_norm.acos(), nan);
+        Eigen::Map<ArrayXf>(&properties.curvature.at(1, y), width) = (valid && center != ELEVATION_DEFAULT).select(curvature, nan);
+        Eigen::Map<Eigen::Array<uint8_t, Eigen::Dynamic, 1> >(&properties.valid.at(1, y), width) = valid.cast<uint8_t>();
+    }
+}
+
 }}
@@ -32,6 +32,23 @@
 namespace maps { namespace grid
 {
 
+    /**@brief Per cell surface properties of an ElevationMap
+     * computed by ElevationMap::computeSurfaceProperties
+     */
+    struct SurfaceProperties
+    {
+        /** components of the normals, as returned by ElevationMap::getNormal */
+        GridMapF normal_x;
+        GridMapF normal_y;
+        GridMapF normal_z;
+        /** angle between the normal and the z-axis in radians */
+        GridMapF slope;
+        /** laplacian of the elevation, positive in hollows */
+        GridMapF curvature;
+        /** 1 for cells with normal, 0 for border cells and cells with missing neighbours */
+        GridMap<uint8_t> valid;
+    };
+
     /**@brief ElevationMap class
      * It extends the typedef GridMapF with some convinient methods
      */
@@ -65,6 +82,16 @@ namespace maps { namespace grid
         float getMeanElevation(const Vector3d& pos) const;
 
         std::pair<float, float> getElevationRange() const;   
+
+        /** @brief computes normals, slope and curvature for all cells at once
+        *
+        * The result equals getNormal for each cell, but border cells and
+        * cells with missing neighbours are marked in the valid mask instead
+        * of throwing. Invalid cells are set to NaN, the curvature also
+        * requires the elevation of the cell itself. The rows are processed
+        * in parallel.
+        */
+        void computeSurfaceProperties(SurfaceProperties &properties) const;
     };
 }}
 
@@ -40,6 +40,7 @@
 
 #include <maps/LocalMap.hpp>
 #include <maps/grid/VectorGrid.hpp>
+#include <maps/grid/ChangeTracker.hpp>
 
 namespace maps { namespace grid
 {
@@ -62,6 +63,9 @@ namespace maps { namespace grid
          */
         Vector2d resolution;
 
+        /** Optional record of the modified tiles, see enableChangeTracking */
+        ChangeTracker change_tracker;
+
     public:
         typedef CellT CellType;
         typedef boost::shared_ptr<GridMap<CellT, GridT> > Ptr;
@@ -77,7 +81,8 @@ namespace maps { namespace grid
         GridMap(const GridMap& other)
             : LocalMap(other), 
               GridT(other),
-              resolution(other.resolution)
+              resolution(other.resolution),
+              change_tracker(other.change_tracker)
         {
         }
 
@@ -133,6 +138,14 @@ namespace maps { namespace grid
               resolution(resolution)
         {}
 
+        /** @brief Constructs a grid map on an existing storage, e.g. a MappedGrid
+         */
+        GridMap(const GridT& storage, const Vector2d &resolution)
+            : LocalMap(maps::LocalMapType::GRID_MAP),
+              GridT(storage),
+              resolution(resolution)
+        {}
+
         /** @brief default destructor
          */
         ~GridMap()
@@ -355,6 +368,43 @@ namespace maps { namespace grid
 
         }
 
+        /** @brief bulk variant of toGrid(const Vector3d& pos, Index& idx, Vector3d &pos_in_cell)
+         *
+         * Converts the columns of @p points, given in a frame with the transformation @p frame2map,
+         * to grid indices and positions relative to the cell centers.
+         * All points are converted at once with vectorized Eigen expressions.
+         * Float points are processed in float precision as long as the grid is small enough to
+         * keep a sub-cell precision of 1/1000, otherwise they are processed in double precision.
+         * @param in_grid is set to 1 for each point which is inside of the grid
+         */
+        template<typename Scalar>
+        void toGridBulk(const Eigen::Matrix<Scalar, 3, Eigen::Dynamic>& points, const base::Transform3d& frame2map,
+                        Eigen::Matrix2Xi& indices, Eigen::Matrix<Scalar, 3, Eigen::Dynamic>& pos_in_cell, std::vector<uint8_t>& in_grid) const
+        {
+            const base::Transform3d trafo = Eigen::DiagonalMatrix<double,3>(1.0/resolution.x(), 1.0/resolution.y(), 1.0) * this->getLocalFrame() * frame2map;
+            if(std::is_same<Scalar, float>::value && getNumCells().maxCoeff() > MAX_FLOAT_GRID_CELLS)
+            {
+                Eigen::Matrix3Xd pos_in_cell_d;
+                toGridBulkImpl<double>(points.template cast<double>(), trafo, indices, pos_in_cell_d, in_grid);
+                pos_in_cell = pos_in_cell_d.cast<Scalar>();
+            }
+            else
+                toGridBulkImpl<Scalar>(points, trafo, indices, pos_in_cell, in_grid);
+        }
+
+        /** @brief bulk variant of fromGrid(const Index& idx, Vector3d& pos, const Vector3d& pos_in_cell, bool checkIndex)
+         * without index check, the points are returned in the map frame.
+         */
+        template<typename Scalar>
+        void fromGridBulk(const Eigen::Matrix2Xi& indices, const Eigen::Matrix<Scalar, 3, Eigen::Dynamic>& pos_in_cell,
+                          Eigen::Matrix<Scalar, 3, Eigen::Dynamic>& points) const
+        {
+            Eigen::Matrix<Scalar, 3, Eigen::Dynamic> pos_in_grid = pos_in_cell;
+            pos_in_grid.template topRows<2>() += ((indices.cast<Scalar>().array() + Scalar(0.5)).colwise() * resolution.cast<Scalar>().array()).matrix();
+            const Eigen::Transform<Scalar, 3, Eigen::Affine> grid2map = this->getLocalFrame().inverse(Eigen::Isometry).template cast<Scalar>();
+            points = (grid2map.linear() * pos_in_grid).colwise() + grid2map.translation();
+        }
+
         /** @brief optimized variant of toGrid(const Vector3d& pos, Index& idx, Vector3d &pos_in_cell)
          */
         bool toGridOptimized(const Vector3d& pos, Index& idx, Vector3d& pos_in_cell, const base::Transform3d& trafo)
@@ -522,6 +572,28 @@ namespace maps { namespace grid
             this->resize(newSize);
         }
 
+        /** Resizes the grid, an enabled change tracking is restarted for the new size */
+        void resize(const Vector2ui &new_number_cells)
+        {
+            GridT::resize(new_number_cells);
+            if(hasChangeTracking())
+                change_tracker.init(getNumCells(), change_tracker.getTileSize());
+        }
+
+        /** Moves the cells by @p idx, all tiles are marked as modified */
+        void moveBy(const Index &idx)
+        {
+            GridT::moveBy(idx);
+            change_tracker.markAllModified();
+        }
+
+        /** Resets all cells to the default value, all tiles are marked as modified */
+        void clear()
+        {
+            GridT::clear();
+            change_tracker.markAllModified();
+        }
+
         CellExtents calculateCellExtents() const
         {
             Vector2ui num_cells = getNumCells();
@@ -598,6 +670,66 @@ namespace maps { namespace grid
             return cell_extents;
         }
 
+        /** @brief Starts recording which tiles of @p tile_size x @p tile_size cells are modified.
+         *
+         * The changes are used to serialize only the modified parts of the grid, see saveDelta.
+         * Modifications are recorded by MLSMap::mergePatch, other modifications have to be
+         * reported with markModified. Resizing the grid restarts the tracking, moving it
+         * marks all tiles as modified.
+         */
+        void enableChangeTracking(unsigned tile_size = 32)
+        {
+            change_tracker.init(getNumCells(), tile_size);
+        }
+
+        void disableChangeTracking()
+        {
+            change_tracker.clear();
+        }
+
+        bool hasChangeTracking() const
+        {
+            return !change_tracker.isEmpty();
+        }
+
+        const ChangeTracker& getChangeTracker() const
+        {
+            return change_tracker;
+        }
+
+        /** Reports a modification of the cell @p idx to the change tracking */
+        void markModified(const Index& idx)
+        {
+            change_tracker.markModified(idx);
+        }
+
+        /** Reports a modification of the whole grid to the change tracking */
+        void markAllModified()
+        {
+            change_tracker.markAllModified();
+        }
+
+        /**
+         * @brief Returns true if a cell in [begin, end) differs from the same cell of @p other.
+         * @details
+         * If one map is a tracked copy of the other, only the stamps of the modified tiles
+         * are compared, so the result can include unchanged cells of modified tiles.
+         * Otherwise the cells are compared. Maps of different sizes always differ.
+         */
+        bool differsFrom(const GridMap& other, const Index& begin, const Index& end) const
+        {
+            if(getNumCells() != other.getNumCells())
+                return true;
+            if(change_tracker.sharesHistory(other.change_tracker))
+                return change_tracker.differsFrom(other.change_tracker, begin, end);
+
+            for(int y = begin.y(); y < end.y(); y++)
+                for(int x = begin.x(); x < end.x(); x++)
+                    if(!(this->at(x, y) == other.at(x, y)))
+                        return true;
+            return false;
+        }
+
     protected:
         /** Grants access to boost serialization */
         friend class boost::serialization::access;
@@ -609,9 +741,37 @@ namespace maps { namespace grid
             ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(::maps::LocalMap);
             ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(GridT);
             ar & BOOST_SERIALIZATION_NVP(resolution);
+
+            // the loaded grid can have a different size
+            if(Archive::is_loading::value && hasChangeTracking())
+                change_tracker.init(getNumCells(), change_tracker.getTileSize());
         }
 
     private:
+        /** up to this number of cells per axis grid coordinates are computed in float precision */
+        static const unsigned MAX_FLOAT_GRID_CELLS = 8192;
+
+        template<typename Scalar, typename Derived>
+        void toGridBulkImpl(const Eigen::MatrixBase<Derived>& points, const base::Transform3d& trafo,
+                            Eigen::Matrix2Xi& indices, Eigen::Matrix<Scalar, 3, Eigen::Dynamic>& pos_in_cell, std::vector<uint8_t>& in_grid) const
+        {
+            typedef Eigen::Array<Scalar, 2, Eigen::Dynamic> Array2X;
+            const Eigen::Transform<Scalar, 3, Eigen::Affine> trafo_s = trafo.template cast<Scalar>();
+
+            // position in grid coordinates, scaled to cells
+            pos_in_cell = (trafo_s.linear() * points.template cast<Scalar>()).colwise() + trafo_s.translation();
+            const Array2X cells = pos_in_cell.template topRows<2>().array().floor();
+            indices = cells.template cast<int>().matrix();
+            pos_in_cell.template topRows<2>() = ((pos_in_cell.template topRows<2>().array() - cells - Scalar(0.5)).colwise() * resolution.cast<Scalar>().array()).matrix();
+
+            const Array2X upper = getNumCells().template cast<Scalar>().array();
+            const Eigen::Array<bool, 1, Eigen::Dynamic> inside = (cells.row(0) >= Scalar(0)) && (cells.row(1) >= Scalar(0)) &&
+                                                                 (cells.row(0) < upper(0)) && (cells.row(1) < upper(1));
+            in_grid.resize(inside.size());
+            for(int i = 0; i < inside.size(); i++)
+                in_grid[i] = inside(i);
+        }
+
         bool addCellForX(CellExtents &cell_extents, unsigned int x, unsigned int y_start, unsigned int y_end) const
         {
             unsigned int y = y_start;
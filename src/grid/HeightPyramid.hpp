@@ -0,0 +1,211 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <cmath>
+
+#include <maps/grid/Index.hpp>
+
+namespace maps { namespace grid
+{
+
+/**
+ * Hierarchical minimum and maximum height of the patches of a multi-level grid.
+ *
+ * Level 0 stores the lowest patch bottom and the highest patch top of each cell,
+ * each following level combines 2x2 nodes of the previous level, like a quadtree mipmap.
+ * Empty nodes have an empty range (min = +inf, max = -inf) and never overlap any height band.
+ * The stored bounds are rounded outwards, so a rejection is always conservative.
+ */
+class HeightPyramid
+{
+public:
+    HeightPyramid() {}
+
+    bool isEmpty() const { return levels.empty(); }
+
+    void clear() { levels.clear(); }
+
+    unsigned getNumLevels() const { return levels.size(); }
+
+    const Vector2ui& getLevelSize(unsigned level) const { return levels[level].size; }
+
+    float getMin(unsigned level, int x, int y) const { return levels[level].min[levels[level].getOffset(x, y)]; }
+
+    float getMax(unsigned level, int x, int y) const { return levels[level].max[levels[level].getOffset(x, y)]; }
+
+    /** Computes all levels from the cells of the given grid */
+    template<class Grid>
+    void build(const Grid& grid)
+    {
+        levels.clear();
+        Vector2ui size = grid.getNumCells();
+        levels.push_back(Level(size));
+        for(unsigned y = 0; y < size.y(); y++)
+        {
+            for(unsigned x = 0; x < size.x(); x++)
+                setCell(x, y, grid.at(x, y));
+        }
+
+        while(size.x() > 1 || size.y() > 1)
+        {
+            size = (size.array() + 1) / 2;
+            levels.push_back(Level(size));
+            for(unsigned y = 0; y < size.y(); y++)
+            {
+                for(unsigned x = 0; x < size.x(); x++)
+                    updateNode(levels.size() - 1, x, y);
+            }
+        }
+    }
+
+    /** Updates the cell @p idx after its patches have changed, cells outside of the pyramid are ignored */
+    template<class Cell>
+    void update(const Index& idx, const Cell& cell)
+    {
+        if(!contains(idx.x(), idx.y()))
+            return;
+        setCell(idx.x(), idx.y(), cell);
+        int x = idx.x(), y = idx.y();
+        for(unsigned level = 1; level < levels.size(); level++)
+        {
+            x >>= 1;
+            y >>= 1;
+            updateNode(level, x, y);
+        }
+    }
+
+    /** Returns true if no patch within the node can overlap the closed height interval [min, max] */
+    bool rejects(unsigned level, int x, int y, double min, double max) const
+    {
+        const size_t offset = levels[level].getOffset(x, y);
+        return levels[level].max[offset] < min || levels[level].min[offset] > max;
+    }
+
+    /**
+     * Returns true if at least one patch within the node overlaps [min, max].
+     * This is the case if the lowest bottom or the highest top of the node is inside of the interval.
+     * Since the bounds are rounded the tests allow for one float step.
+     */
+    bool accepts(unsigned level, int x, int y, double min, double max) const
+    {
+        const size_t offset = levels[level].getOffset(x, y);
+        const float node_min = levels[level].min[offset];
+        const float node_max = levels[level].max[offset];
+        const float inf = std::numeric_limits<float>::infinity();
+        if(node_min > node_max)
+            return false;
+        return (node_min >= min && std::nextafter(node_min, inf) <= max) ||
+               (std::nextafter(node_max, -inf) >= min && node_max <= max);
+    }
+
+    /**
+     * Returns the highest level at which the node containing cell (x, y) rejects [min, max],
+     * or -1 if the cell itself can't be rejected.
+     */
+    int getRejectLevel(int x, int y, double min, double max) const
+    {
+        if(!contains(x, y) || !rejects(0, x, y, min, max))
+            return -1;
+        unsigned level = 0;
+        while(level + 1 < levels.size() && rejects(level + 1, x >> (level + 1), y >> (level + 1), min, max))
+            level++;
+        return level;
+    }
+
+    /** Returns true if cell (x, y) is part of level 0 */
+    bool contains(int x, int y) const
+    {
+        return !levels.empty() && x >= 0 && y >= 0 && (unsigned)x < levels[0].size.x() && (unsigned)y < levels[0].size.y();
+    }
+
+private:
+    struct Level
+    {
+        Vector2ui size;
+        std::vector<float> min;
+        std::vector<float> max;
+
+        Level(const Vector2ui& size) : size(size), min(size.prod(), std::numeric_limits<float>::infinity()),
+                                       max(size.prod(), -std::numeric_limits<float>::infinity()) {}
+
+        size_t getOffset(int x, int y) const { return x + (size_t)y * size.x(); }
+    };
+
+    template<class Cell>
+    void setCell(int x, int y, const Cell& cell)
+    {
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        for(typename Cell::const_iterator it = cell.begin(); it != cell.end(); it++)
+        {
+            min = std::min<double>(min, it->getMin());
+            max = std::max<double>(max, it->getMax());
+        }
+        Level& level = levels[0];
+        const size_t offset = level.getOffset(x, y);
+        level.min[offset] = roundDown(min);
+        level.max[offset] = roundUp(max);
+    }
+
+    void updateNode(unsigned level, int x, int y)
+    {
+        const Level& child = levels[level - 1];
+        float min = std::numeric_limits<float>::infinity();
+        float max = -std::numeric_limits<float>::infinity();
+        for(int cy = 2 * y; cy < std::min(2 * y + 2, (int)child.size.y()); cy++)
+        {
+            for(int cx = 2 * x; cx < std::min(2 * x + 2, (int)child.size.x()); cx++)
+            {
+                const size_t offset = child.getOffset(cx, cy);
+                min = std::min(min, child.min[offset]);
+                max = std::max(max, child.max[offset]);
+            }
+        }
+        Level& node = levels[level];
+        node.min[node.getOffset(x, y)] = min;
+        node.max[node.getOffset(x, y)] = max;
+    }
+
+    static float roundDown(double value)
+    {
+        float f = value;
+        return f > value ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static float roundUp(double value)
+    {
+        float f = value;
+        return f < value ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+    std::vector<Level> levels;
+};
+
+}}
@@ -29,6 +29,12 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <typeinfo>
+#include <type_traits>
 
 #include <boost/multi_array.hpp>
 #include <boost/shared_ptr.hpp>
@@ -37,13 +43,87 @@
 
 namespace maps { namespace grid
 {
+    /** Storage of a layer, chosen when the layer is created */
+    enum LayerStorage
+    {
+        /** the layer is a GridMap of its own */
+        SEPARATE,
+        /** the layer is a member of a per cell record shared by all interleaved layers */
+        INTERLEAVED
+    };
+
+    /**
+     * @brief Typed handle of a layer of a LayeredGridMap.
+     * @details
+     * The handle is resolved once by LayeredGridMap::getLayerHandle and afterwards
+     * gives direct access to the cells without looking up the layer key. It works
+     * for separate and interleaved layers alike. The handle becomes invalid
+     * when layers are added or removed.
+     */
+    template <typename T>
+    class LayerHandle
+    {
+    public:
+        LayerHandle()
+            : data(NULL),
+              stride(0),
+              num_cells(0, 0)
+        {}
+
+        LayerHandle(char *data, size_t stride, const Vector2ui &num_cells)
+            : data(data),
+              stride(stride),
+              num_cells(num_cells)
+        {}
+
+        /** Converts a handle to a handle of const cells */
+        template <typename U>
+        LayerHandle(const LayerHandle<U> &other)
+            : data(other.data),
+              stride(other.stride),
+              num_cells(other.num_cells)
+        {
+            static_assert(std::is_convertible<U*, T*>::value, "Invalid conversion of layer handle");
+        }
+
+        bool isValid() const
+        {
+            return data != NULL;
+        }
+
+        const Vector2ui &getNumCells() const
+        {
+            return num_cells;
+        }
+
+        T& at(size_t x, size_t y) const
+        {
+            if(x >= num_cells.x() || y >= num_cells.y())
+                throw std::runtime_error("Provided index is out of the grid");
+            return *reinterpret_cast<T*>(data + (x + y * num_cells.x()) * stride);
+        }
+
+        T& at(const Index &idx) const
+        {
+            return at(idx.x(), idx.y());
+        }
+
+    private:
+        template <typename U> friend class LayerHandle;
+
+        char *data;
+        size_t stride;
+        Vector2ui num_cells;
+    };
+
     class LayeredGridMap : public LocalMap
     {
     public:
         LayeredGridMap()
         : LocalMap(maps::LocalMapType::GRID_MAP),
           num_cells(0,0),
-          resolution(0.0,0.0)
+          resolution(0.0,0.0),
+          record_size(0)
         {}
         /**
          * @brief creat an empty grid of specific size and resolution
@@ -59,7 +139,8 @@ namespace maps { namespace grid
         LayeredGridMap(const Vector2ui &num_cells, const Vector2d &resolution)
             : LocalMap(maps::LocalMapType::GRID_MAP),
               num_cells(num_cells), 
-              resolution(resolution)
+              resolution(resolution),
+              record_size(0)
         {}
 
         virtual ~LayeredGridMap() 
@@ -78,6 +159,9 @@ namespace maps { namespace grid
          * @param key the unique identification key of the layer
          * @param default_value the default initialisation value for the layer
          * @return true if the layer could be created successfully, otherwise false
+         *
+         * Layers which are used together per cell can be created with
+         * addInterleavedLayer instead.
          */
         template <typename T>
         GridMap<T>& addLayer(const std::string &key, const T &default_value)
@@ -105,11 +189,60 @@ namespace maps { namespace grid
         { 
             typename LayerType::const_iterator it = layers.find(key);
             if (it == layers.end())
-                return false;
+                return interleaved_layers.count(key) != 0;
             else 
                 return true;
         }
 
+        /**
+         * @brief create a layer stored interleaved with the other interleaved layers
+         * @details All interleaved layers share one record per cell, so reading
+         * several of them for the same cell touches a single cache line instead
+         * of one array per layer. The cells are accessed with getLayerHandle.
+         * Adding or removing interleaved layers repacks the records.
+         *
+         * @param storage SEPARATE creates a GridMap layer like addLayer
+         * @throw std::out_of_range if a layer with the same key exists already
+         */
+        template <typename T>
+        void addLayer(const std::string &key, const T &default_value, LayerStorage storage)
+        {
+            if (storage == SEPARATE)
+                addLayer<T>(key, default_value);
+            else
+                addInterleavedLayer<T>(key, default_value);
+        }
+
+        /** @see addLayer(const std::string&, const T&, LayerStorage) */
+        template <typename T>
+        void addInterleavedLayer(const std::string &key, const T &default_value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Interleaved layers require trivially copyable cells");
+            static_assert(alignof(T) <= alignof(std::max_align_t), "Interleaved layers do not support over-aligned cells");
+
+            if (hasLayer(key) == true)
+            {
+                throw std::out_of_range("LayeredGridMap::addInterleavedLayer: The grid with the key '" + key + "' exists already.");
+            }
+
+            InterleavedLayerType new_layers(interleaved_layers);
+            InterleavedLayer &layer = new_layers[key];
+            layer.type = &typeid(T);
+            layer.size = sizeof(T);
+            layer.alignment = alignof(T);
+            repackRecords(new_layers);
+
+            // initialize the new member of all records
+            char *record = records.data() + interleaved_layers[key].offset;
+            for (size_t i = 0; i < num_cells.prod(); ++i, record += record_size)
+                std::memcpy(record, &default_value, sizeof(T));
+        }
+
+        bool isInterleaved(const std::string &key) const
+        {
+            return interleaved_layers.count(key) != 0;
+        }
+
         bool removeLayer(const std::string &key)
         {
             if(hasLayer(key) == false)
@@ -117,6 +250,14 @@ namespace maps { namespace grid
                 return false;
             }
 
+            if (isInterleaved(key))
+            {
+                InterleavedLayerType new_layers(interleaved_layers);
+                new_layers.erase(key);
+                repackRecords(new_layers);
+                return true;
+            }
+
             delete layers[key];
             layers.erase(key);
 
@@ -132,6 +273,10 @@ namespace maps { namespace grid
                 delete it->second;
             }
             layers.clear();
+
+            interleaved_layers.clear();
+            records.clear();
+            record_size = 0;
         }
 
         template <typename T>
@@ -154,9 +299,45 @@ namespace maps { namespace grid
             {
                 keys.push_back(it->first);
             }
+            typename InterleavedLayerType::const_iterator iit;
+            for (iit = interleaved_layers.begin(); iit != interleaved_layers.end(); ++iit)
+            {
+                keys.push_back(iit->first);
+            }
             return keys;
         }
 
+        /**
+         * @brief resolves the layer with the key once for direct cell access
+         * @details works for separate and interleaved layers
+         * @throw std::out_of_range if the layer does not exist
+         * @throw std::runtime_error if the layer is not of type T
+         */
+        template <typename T>
+        LayerHandle<T> getLayerHandle(const std::string &key)
+        {
+            typename InterleavedLayerType::const_iterator it = interleaved_layers.find(key);
+            if (it == interleaved_layers.end())
+            {
+                GridMap<T> *grid = getGridMapPtr<T>(key);
+                if (grid->begin() == grid->end())
+                    return LayerHandle<T>();
+                return LayerHandle<T>(reinterpret_cast<char*>(&*grid->begin()), sizeof(T), num_cells);
+            }
+
+            if (*it->second.type != typeid(T))
+                throw std::runtime_error("The grid with the key '" + key + "' is not of required type.");
+            if (records.empty())
+                return LayerHandle<T>();
+            return LayerHandle<T>(records.data() + it->second.offset, record_size, num_cells);
+        }
+
+        template <typename T>
+        LayerHandle<const T> getLayerHandle(const std::string &key) const
+        {
+            return const_cast<LayeredGridMap*>(this)->getLayerHandle<T>(key);
+        }
+
     private:
         Vector2ui num_cells;
         Vector2d resolution;
@@ -164,6 +345,51 @@ namespace maps { namespace grid
         typedef std::map<std::string, LocalMap*> LayerType;
         LayerType layers;
 
+        /** Member of the per cell record of the interleaved layers */
+        struct InterleavedLayer
+        {
+            const std::type_info *type;
+            size_t size;
+            size_t alignment;
+            size_t offset;
+        };
+
+        typedef std::map<std::string, InterleavedLayer> InterleavedLayerType;
+        InterleavedLayerType interleaved_layers;
+
+        /** Records of all interleaved layers, one per cell */
+        std::vector<char> records;
+        size_t record_size;
+
+        /** Computes the record layout of @p new_layers and moves the existing members to it */
+        void repackRecords(InterleavedLayerType &new_layers)
+        {
+            size_t new_record_size = 0;
+            size_t max_alignment = 1;
+            typename InterleavedLayerType::iterator it;
+            for (it = new_layers.begin(); it != new_layers.end(); ++it)
+            {
+                it->second.offset = (new_record_size + it->second.alignment - 1) / it->second.alignment * it->second.alignment;
+                new_record_size = it->second.offset + it->second.size;
+                max_alignment = std::max(max_alignment, it->second.alignment);
+            }
+            new_record_size = (new_record_size + max_alignment - 1) / max_alignment * max_alignment;
+
+            std::vector<char> new_records(new_record_size * num_cells.prod());
+            for (it = new_layers.begin(); it != new_layers.end(); ++it)
+            {
+                typename InterleavedLayerType::const_iterator old_layer = interleaved_layers.find(it->first);
+                if (old_layer == interleaved_layers.end())
+                    continue;
+                for (size_t i = 0; i < num_cells.prod(); ++i)
+                    std::memcpy(&new_records[i * new_record_size + it->second.offset], &records[i * record_size + old_layer->second.offset], it->second.size);
+            }
+
+            records.swap(new_records);
+            record_size = new_record_size;
+            interleaved_layers.swap(new_layers);
+        }
+
         template <typename T>
         GridMap<T>* getGridMapPtr(const std::string &key) const
         {
@@ -172,6 +398,9 @@ namespace maps { namespace grid
             if (hasLayer(key) == false)
                 throw std::out_of_range("The map does not contain the grid with the key '" + key + "'.");
 
+            if (isInterleaved(key))
+                throw std::runtime_error("The grid with the key '" + key + "' is interleaved, it is only accessible by getLayerHandle.");
+
             grid = dynamic_cast<GridMap<T>*>(layers.at(key));   
                 
             if (grid == NULL)
@@ -0,0 +1,504 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "MLSCompactCodec.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace maps::grid;
+
+namespace
+{
+    const char MAGIC[4] = {'M', 'L', 'S', 'Q'};
+    const uint8_t VERSION = 1;
+
+    /** 16 bit values of at least this size are followed by a varint holding the actual value */
+    const uint16_t ESCAPE = 0xFFFF;
+
+    /** largest supported tile size, which bounds the per tile buffers of the decoder */
+    const unsigned MAX_TILE_SIZE = 4096;
+
+    /** smallest number of bytes of an encoded patch: two 16 bit heights and the variance */
+    const size_t MIN_PATCH_BYTES = 5;
+
+    class Writer
+    {
+    public:
+        Writer(std::vector<uint8_t>& data) : data(data), bit_buffer(0), num_bits(0) {}
+
+        void u8(uint8_t value) { data.push_back(value); }
+
+        void u16(uint16_t value)
+        {
+            data.push_back(value & 0xFF);
+            data.push_back(value >> 8);
+        }
+
+        void u32(uint32_t value)
+        {
+            for(int i = 0; i < 4; ++i)
+                data.push_back((value >> (8 * i)) & 0xFF);
+        }
+
+        void f32(float value)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            u32(bits);
+        }
+
+        void f64(double value)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            u32(bits & 0xFFFFFFFF);
+            u32(bits >> 32);
+        }
+
+        void varint(uint64_t value)
+        {
+            while(value >= 0x80)
+            {
+                data.push_back((value & 0x7F) | 0x80);
+                value >>= 7;
+            }
+            data.push_back(value);
+        }
+
+        void svarint(int64_t value)
+        {
+            varint((uint64_t(value) << 1) ^ uint64_t(value >> 63));
+        }
+
+        /** writes a non negative value in 16 bits, larger values are escaped */
+        void quantized(int64_t value)
+        {
+            if(value < ESCAPE)
+                u16(value);
+            else
+            {
+                u16(ESCAPE);
+                varint(value - ESCAPE);
+            }
+        }
+
+        void string(const std::string& value)
+        {
+            varint(value.size());
+            data.insert(data.end(), value.begin(), value.end());
+        }
+
+        void bits(uint32_t value, unsigned count)
+        {
+            bit_buffer |= uint64_t(value) << num_bits;
+            num_bits += count;
+            while(num_bits >= 8)
+            {
+                data.push_back(bit_buffer & 0xFF);
+                bit_buffer >>= 8;
+                num_bits -= 8;
+            }
+        }
+
+        void flushBits()
+        {
+            if(num_bits > 0)
+                data.push_back(bit_buffer & 0xFF);
+            bit_buffer = 0;
+            num_bits = 0;
+        }
+
+    private:
+        std::vector<uint8_t>& data;
+        uint64_t bit_buffer;
+        unsigned num_bits;
+    };
+
+    class Reader
+    {
+    public:
+        Reader(const std::vector<uint8_t>& data) : data(data), pos(0), bit_buffer(0), num_bits(0) {}
+
+        uint8_t u8()
+        {
+            require(1);
+            return data[pos++];
+        }
+
+        uint16_t u16()
+        {
+            require(2);
+            uint16_t value = data[pos] | (uint16_t(data[pos + 1]) << 8);
+            pos += 2;
+            return value;
+        }
+
+        uint32_t u32()
+        {
+            require(4);
+            uint32_t value = 0;
+            for(int i = 0; i < 4; ++i)
+                value |= uint32_t(data[pos + i]) << (8 * i);
+            pos += 4;
+            return value;
+        }
+
+        float f32()
+        {
+            uint32_t bits = u32();
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        double f64()
+        {
+            uint64_t bits = u32();
+            bits |= uint64_t(u32()) << 32;
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        uint64_t varint()
+        {
+            uint64_t value = 0;
+            for(unsigned shift = 0; shift < 64; shift += 7)
+            {
+                uint8_t byte = u8();
+                value |= uint64_t(byte & 0x7F) << shift;
+                if(!(byte & 0x80))
+                    return value;
+            }
+            throw std::runtime_error("Malformed compact MLS data");
+        }
+
+        int64_t svarint()
+        {
+            uint64_t value = varint();
+            return int64_t(value >> 1) ^ -int64_t(value & 1);
+        }
+
+        int64_t quantized()
+        {
+            uint16_t value = u16();
+            if(value < ESCAPE)
+                return value;
+            return ESCAPE + varint();
+        }
+
+        std::string string()
+        {
+            uint64_t size = varint();
+            require(size);
+            std::string value(data.begin() + pos, data.begin() + pos + size);
+            pos += size;
+            return value;
+        }
+
+        uint32_t bits(unsigned count)
+        {
+            while(num_bits < count)
+            {
+                bit_buffer |= uint64_t(u8()) << num_bits;
+                num_bits += 8;
+            }
+            uint32_t value = bit_buffer & ((uint64_t(1) << count) - 1);
+            bit_buffer >>= count;
+            num_bits -= count;
+            return value;
+        }
+
+        void alignBits()
+        {
+            bit_buffer = 0;
+            num_bits = 0;
+        }
+
+        bool atEnd() const { return pos == data.size(); }
+
+        size_t remaining() const { return data.size() - pos; }
+
+    private:
+        void require(size_t size) const
+        {
+            if(pos + size > data.size())
+                throw std::runtime_error("Compact MLS data is truncated");
+        }
+
+        const std::vector<uint8_t>& data;
+        size_t pos;
+        uint64_t bit_buffer;
+        unsigned num_bits;
+    };
+
+    unsigned bitsFor(uint32_t value)
+    {
+        unsigned bits = 0;
+        while(value >> bits)
+            ++bits;
+        return bits;
+    }
+
+    struct TileRange
+    {
+        unsigned x_begin, x_end, y_begin, y_end;
+    };
+
+    /** Rounds @p value to a multiple of @p step, throws for values which cannot be represented */
+    int64_t quantize(double value, float step)
+    {
+        const double scaled = value / step;
+        // also rejects NaN
+        if(!(std::abs(scaled) < 1e18))
+            throw std::runtime_error("Cannot encode non-finite or out of range patch heights");
+        return std::llround(scaled);
+    }
+
+    TileRange getTile(unsigned tx, unsigned ty, unsigned tile_size, const Vector2ui& num_cells)
+    {
+        TileRange tile;
+        tile.x_begin = tx * tile_size;
+        tile.y_begin = ty * tile_size;
+        tile.x_end = tile.x_begin + std::min(tile_size, num_cells.x() - tile.x_begin);
+        tile.y_end = tile.y_begin + std::min(tile_size, num_cells.y() - tile.y_begin);
+        return tile;
+    }
+}
+
+MLSCompactCodec::MLSCompactCodec(const Config& config)
+    : config(config)
+{
+    if(!(config.max_height_error > 0.f) || config.tile_size == 0 || config.tile_size > MAX_TILE_SIZE || !(config.min_variance > 0.f) || !(config.max_variance > config.min_variance))
+        throw std::runtime_error("Invalid MLSCompactCodec configuration");
+}
+
+void MLSCompactCodec::encode(const MLSMapKalman& map, std::vector<uint8_t>& data) const
+{
+    typedef MLSMapKalman::CellType Cell;
+    typedef MLSMapKalman::Patch Patch;
+
+    data.clear();
+    Writer writer(data);
+
+    // rounding to the step size keeps the error below half a step
+    const float step = 2.f * config.max_height_error;
+    const float log_min = std::log(config.min_variance);
+    const float log_max = std::log(config.max_variance);
+    const float variance_scale = 254.f / (log_max - log_min);
+
+    writer.u8(MAGIC[0]); writer.u8(MAGIC[1]); writer.u8(MAGIC[2]); writer.u8(MAGIC[3]);
+    writer.u8(VERSION);
+    const Vector2ui num_cells = map.getNumCells();
+    writer.u32(num_cells.x());
+    writer.u32(num_cells.y());
+    writer.f64(map.getResolution().x());
+    writer.f64(map.getResolution().y());
+    const Eigen::Matrix4d frame = map.getLocalFrame().matrix();
+    for(int row = 0; row < 3; ++row)
+        for(int col = 0; col < 4; ++col)
+            writer.f64(frame(row, col));
+    writer.u8(map.getMapType() + 1);
+    writer.string(map.getId());
+    writer.string(map.getEPSGCode());
+    const MLSConfig& mls_config = map.getConfig();
+    writer.f32(mls_config.gapSize);
+    writer.f32(mls_config.thickness);
+    writer.u8((mls_config.useColor ? 1 : 0) | (mls_config.useNegativeInformation ? 2 : 0));
+    writer.u32(config.tile_size);
+    writer.f32(step);
+    writer.f32(log_min);
+    writer.f32(log_max);
+
+    const unsigned tiles_x = (num_cells.x() + config.tile_size - 1) / config.tile_size;
+    const unsigned tiles_y = (num_cells.y() + config.tile_size - 1) / config.tile_size;
+    int64_t last_base = 0;
+    for(unsigned ty = 0; ty < tiles_y; ++ty)
+    {
+        for(unsigned tx = 0; tx < tiles_x; ++tx)
+        {
+            const TileRange tile = getTile(tx, ty, config.tile_size, num_cells);
+
+            // the base of a tile is the lowest mean of all cells
+            uint32_t max_count = 0;
+            int64_t base = std::numeric_limits<int64_t>::max();
+            for(unsigned y = tile.y_begin; y < tile.y_end; ++y)
+            {
+                for(unsigned x = tile.x_begin; x < tile.x_end; ++x)
+                {
+                    const Cell& cell = map.at(x, y);
+                    max_count = std::max<uint32_t>(max_count, cell.size());
+                    if(!cell.empty())
+                        base = std::min<int64_t>(base, quantize(cell.begin()->getMean(), step));
+                }
+            }
+
+            const unsigned count_bits = bitsFor(max_count);
+            writer.u8(count_bits);
+            if(count_bits == 0)
+                continue;
+
+            for(unsigned y = tile.y_begin; y < tile.y_end; ++y)
+                for(unsigned x = tile.x_begin; x < tile.x_end; ++x)
+                    writer.bits(map.at(x, y).size(), count_bits);
+            writer.flushBits();
+
+            writer.svarint(base - last_base);
+            last_base = base;
+
+            for(unsigned y = tile.y_begin; y < tile.y_end; ++y)
+            {
+                for(unsigned x = tile.x_begin; x < tile.x_end; ++x)
+                {
+                    // patches are sorted by their mean, so all deltas are positive
+                    int64_t last_mean = base;
+                    const Cell& cell = map.at(x, y);
+                    for(Cell::const_iterator it = cell.begin(); it != cell.end(); ++it)
+                    {
+                        const Patch& patch = *it;
+                        const int64_t mean = quantize(patch.getMean(), step);
+                        const int64_t bottom = quantize(patch.getBottom(), step);
+                        writer.quantized(std::max<int64_t>(mean - last_mean, 0));
+                        writer.quantized(std::max<int64_t>(mean - bottom, 0));
+                        last_mean = std::max(mean, last_mean);
+
+                        const float variance = patch.getVariance();
+                        if(variance <= 0.f)
+                            writer.u8(0);
+                        else
+                        {
+                            const float code = (std::log(variance) - log_min) * variance_scale;
+                            writer.u8(1 + std::min(254.f, std::max(0.f, std::round(code))));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void MLSCompactCodec::decode(const std::vector<uint8_t>& data, MLSMapKalman& map)
+{
+    typedef MLSMapKalman::CellType Cell;
+    typedef MLSMapKalman::Patch Patch;
+
+    Reader reader(data);
+    for(int i = 0; i < 4; ++i)
+        if(reader.u8() != uint8_t(MAGIC[i]))
+            throw std::runtime_error("Data is not in the compact MLS format");
+    if(reader.u8() != VERSION)
+        throw std::runtime_error("Unsupported compact MLS format version");
+
+    Vector2ui num_cells;
+    num_cells.x() = reader.u32();
+    num_cells.y() = reader.u32();
+    Vector2d resolution;
+    resolution.x() = reader.f64();
+    resolution.y() = reader.f64();
+    Eigen::Matrix4d frame = Eigen::Matrix4d::Identity();
+    for(int row = 0; row < 3; ++row)
+        for(int col = 0; col < 4; ++col)
+            frame(row, col) = reader.f64();
+    const LocalMapType map_type = static_cast<LocalMapType>(int(reader.u8()) - 1);
+    const std::string id = reader.string();
+    const std::string epsg_code = reader.string();
+    MLSConfig mls_config;
+    mls_config.updateModel = MLSConfig::KALMAN;
+    mls_config.gapSize = reader.f32();
+    mls_config.thickness = reader.f32();
+    const uint8_t flags = reader.u8();
+    mls_config.useColor = flags & 1;
+    mls_config.useNegativeInformation = flags & 2;
+    const unsigned tile_size = reader.u32();
+    const float step = reader.f32();
+    const float log_min = reader.f32();
+    const float log_max = reader.f32();
+    if(tile_size == 0 || tile_size > MAX_TILE_SIZE || tile_size > std::max(num_cells.x(), num_cells.y()) || !(step > 0.f))
+        throw std::runtime_error("Malformed compact MLS data");
+    // each tile takes at least one byte
+    const size_t tiles_x = (size_t(num_cells.x()) + tile_size - 1) / tile_size;
+    const size_t tiles_y = (size_t(num_cells.y()) + tile_size - 1) / tile_size;
+    if(tiles_x * tiles_y > reader.remaining())
+        throw std::runtime_error("Compact MLS data is truncated");
+    const float variance_step = (log_max - log_min) / 254.f;
+
+    map = MLSMapKalman(num_cells, resolution, mls_config);
+    map.getLocalFrame().matrix() = frame;
+    map.getMapType() = map_type;
+    map.getId() = id;
+    map.getEPSGCode() = epsg_code;
+
+    std::vector<uint32_t> counts(size_t(tile_size) * tile_size);
+    int64_t base = 0;
+    for(size_t ty = 0; ty < tiles_y; ++ty)
+    {
+        for(size_t tx = 0; tx < tiles_x; ++tx)
+        {
+            const TileRange tile = getTile(tx, ty, tile_size, num_cells);
+            const unsigned count_bits = reader.u8();
+            if(count_bits == 0)
+                continue;
+            if(count_bits > 32)
+                throw std::runtime_error("Malformed compact MLS data");
+
+            const size_t num_tile_cells = size_t(tile.x_end - tile.x_begin) * (tile.y_end - tile.y_begin);
+            for(size_t i = 0; i < num_tile_cells; ++i)
+                counts[i] = reader.bits(count_bits);
+            reader.alignBits();
+
+            base += reader.svarint();
+
+            size_t i = 0;
+            for(unsigned y = tile.y_begin; y < tile.y_end; ++y)
+            {
+                for(unsigned x = tile.x_begin; x < tile.x_end; ++x, ++i)
+                {
+                    if(counts[i] == 0)
+                        continue;
+                    if(counts[i] > reader.remaining() / MIN_PATCH_BYTES)
+                        throw std::runtime_error("Compact MLS data is truncated");
+                    Cell& cell = map.at(x, y);
+                    cell.reserve(counts[i]);
+                    int64_t mean = base;
+                    for(uint32_t p = 0; p < counts[i]; ++p)
+                    {
+                        mean += reader.quantized();
+                        const int64_t height = reader.quantized();
+                        const uint8_t variance_code = reader.u8();
+                        const float variance = variance_code == 0 ? 0.f : std::exp(log_min + (variance_code - 1) * variance_step);
+                        const float mean_z = mean * step;
+                        cell.insert(cell.end(), Patch(mean_z, variance, mean_z - (mean - height) * step));
+                    }
+                }
+            }
+        }
+    }
+
+    if(!reader.atEnd())
+        throw std::runtime_error("Compact MLS data has trailing bytes");
+}
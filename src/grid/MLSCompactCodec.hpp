@@ -0,0 +1,89 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include <maps/grid/MLSMap.hpp>
+
+namespace maps { namespace grid
+{
+    /**
+     * @brief Compact, lossy wire format for MLSMapKalman.
+     * @details
+     * The map is encoded in square tiles. Per tile the patch counts of the cells
+     * are bit-packed with the minimal number of bits. The patch means are quantized
+     * to a fixed step, relative to a per-tile base for the first patch of a cell and
+     * relative to the previous patch for the others, and stored in 16 bits. The same
+     * holds for the bottom of each patch relative to its mean. Variances are
+     * encoded logarithmically in 8 bits.
+     *
+     * The mean, top and bottom of every decoded patch deviate at most by
+     * Config::max_height_error from the original, up to float precision.
+     * The variances are encoded in 255 logarithmic steps between
+     * Config::min_variance and Config::max_variance, which is a relative error
+     * below 4% for the default range. Variances outside of that range are clamped.
+     * Patches of a cell closer than the quantization step collapse to one patch,
+     * which does not happen for maps built by merging measurements as long as
+     * the gap size of the map is larger than the quantization step.
+     */
+    class MLSCompactCodec
+    {
+    public:
+        struct Config
+        {
+            Config()
+                : max_height_error(0.005f),
+                  tile_size(16),
+                  min_variance(1e-6f),
+                  max_variance(10.f)
+            {}
+
+            /** maximum absolute error of the decoded heights */
+            float max_height_error;
+            /** number of cells per tile in x and y, at most 4096 */
+            unsigned tile_size;
+            /** range of the logarithmic variance encoding */
+            float min_variance;
+            float max_variance;
+        };
+
+        MLSCompactCodec(const Config& config = Config());
+
+        const Config& getConfig() const { return config; }
+
+        /** Encodes the map and replaces the content of @p data */
+        void encode(const MLSMapKalman& map, std::vector<uint8_t>& data) const;
+
+        /** Decodes data created by encode(), throws std::runtime_error on malformed data */
+        static void decode(const std::vector<uint8_t>& data, MLSMapKalman& map);
+
+    private:
+        Config config;
+    };
+}}
@@ -30,6 +30,7 @@
 #include <vector>
 #include <set>
 #include <exception>
+#include <algorithm>
 
 #include <Eigen/Geometry>
 
@@ -116,27 +117,10 @@ namespace maps { namespace grid
             Vector3d pos_in_cell;
             if(Base::toGrid(point, idx, pos_in_cell))
             {
-                Vector3 pos_in_cell_f = pos_in_cell.cast<float>();
-                const CellType& cell = Base::at(idx);
-                float min_dist;
-                bool found_patch = false;
-                Vector3d contact_point_in_cell;
-                for(const Patch& patch : cell)
+                Vector3 contact_point_f; // in local cell-coordinate system
+                if(getClosestContactPointInCell(Base::at(idx), pos_in_cell.cast<float>(), contact_point_f))
                 {
-                    Vector3 contact_point_f; // in local cell-coordinate system
-                    float dist = std::abs(patch.getClosestContactPoint(pos_in_cell_f, contact_point_f));
-                    if(found_patch && dist > min_dist)
-                        break; // we already found a patch and the current patch is farer away. Since patches are sorted, we can't get closer
-                    else
-                    {
-                        found_patch = true;
-                        min_dist = dist;
-                        contact_point_in_cell = contact_point_f.cast<double>();
-                    }
-                }
-                if(found_patch && !base::isInfinity<float>(min_dist))
-                {
-                    Base::fromGrid(idx, contact_point, contact_point_in_cell, false);
+                    Base::fromGrid(idx, contact_point, contact_point_f.cast<double>(), false);
                     return true;
                 }
             }
@@ -149,23 +133,8 @@ namespace maps { namespace grid
             Vector3d pos_in_cell;
             if(Base::toGrid(point, idx, pos_in_cell))
             {
-                const CellType& cell = Base::at(idx);
-                Vector3 pos_in_cell_f = pos_in_cell.cast<float>();
-                float min_dist = base::infinity<float>();
-                float cell_surface_pos = base::NaN<float>();
-                for(const Patch& patch : cell)
-                {
-                    float surface_pos_f = patch.getSurfacePos(pos_in_cell_f);
-                    float dist = std::abs(surface_pos_f - pos_in_cell_f.z());
-                    if(dist > min_dist)
-                        break;
-                    else
-                    {
-                        min_dist = dist;
-                        cell_surface_pos = surface_pos_f;
-                    }
-                }
-                if(!base::isInfinity<float>(min_dist))
+                float cell_surface_pos;
+                if(getClosestSurfacePosInCell(Base::at(idx), pos_in_cell.cast<float>(), cell_surface_pos))
                 {
                     // transform from grid to map frame
                     pos_in_cell.z() = cell_surface_pos;
@@ -178,6 +147,37 @@ namespace maps { namespace grid
             return false;
         }
 
+        /**
+         * Batch variant of getClosestContactPoint for the columns of @p points.
+         * The queries are grouped by cell and processed in parallel, if OpenMP is available.
+         * @param valid is set to 1 for each point with a contact point, the other contact points are NaN
+         */
+        void getClosestContactPoints(const Eigen::Matrix3Xd& points, Eigen::Matrix3Xd& contact_points, std::vector<uint8_t>& valid) const
+        {
+            queryBatch(points, contact_points, valid,
+                       [](const CellType& cell, const Vector3& pos_in_cell, Vector3& result)
+                       {
+                           return getClosestContactPointInCell(cell, pos_in_cell, result);
+                       });
+        }
+
+        /**
+         * Batch variant of getClosestSurfacePos for the columns of @p points.
+         * The queries are grouped by cell and processed in parallel, if OpenMP is available.
+         * @param valid is set to 1 for each point with a surface, the other surface positions are NaN
+         */
+        void getClosestSurfacePos(const Eigen::Matrix3Xd& points, Eigen::VectorXd& surface_pos, std::vector<uint8_t>& valid) const
+        {
+            Eigen::Matrix3Xd surface_points;
+            queryBatch(points, surface_points, valid,
+                       [](const CellType& cell, const Vector3& pos_in_cell, Vector3& result)
+                       {
+                           result = pos_in_cell;
+                           return getClosestSurfacePosInCell(cell, pos_in_cell, result.z());
+                       });
+            surface_pos = surface_points.row(2).transpose();
+        }
+
         void mergeMLS(const MLSMap& other)
         {
             // TODO implement
@@ -186,22 +186,28 @@ namespace maps { namespace grid
 
         void mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2mls, double measurement_variance = 0.01)
         {
-            base::Transform3d pc2grid = Base::prepareToGridOptimized(pc2mls);
+            Eigen::Matrix3Xf points(3, pc.size());
+            for(size_t i = 0; i < pc.size(); ++i)
+                points.col(i) = pc[i].getArray3fMap();
+
+            Eigen::Matrix2Xi indices;
+            Eigen::Matrix3Xf pos_in_cell;
+            std::vector<uint8_t> in_grid;
+            Base::toGridBulk(points, pc2mls, indices, pos_in_cell, in_grid);
+
             if(hasFreeSpaceMap())
             {
                 Eigen::Vector3d sensor_origin = pc.sensor_origin_.block(0,0,3,1).cast<double>();
                 Eigen::Vector3d sensor_origin_in_mls = pc2mls * sensor_origin;
-                for(PointCloud::const_iterator it=pc.begin(); it != pc.end(); ++it)
+                const Eigen::Matrix3Xd points_in_mls = (pc2mls.linear() * points.cast<double>()).colwise() + pc2mls.translation();
+                for(int i = 0; i < points.cols(); ++i)
                 {
-                    Eigen::Vector3d measurement = it->getArray3fMap().cast<double>();
-                    Eigen::Vector3d measurement_in_map = pc2mls * measurement;
-
                     try
                     {
-                        if(!free_space_map->isFreeSpace(measurement_in_map))
-                            mergePoint(measurement, pc2grid, measurement_variance);
+                        if(!free_space_map->isFreeSpace(points_in_mls.col(i)))
+                            mergeBulkPoint(i, points, indices, pos_in_cell, in_grid, measurement_variance);
 
-                        free_space_map->mergePoint(sensor_origin_in_mls, measurement_in_map);
+                        free_space_map->mergePoint(sensor_origin_in_mls, points_in_mls.col(i));
                     }
                     catch(const std::runtime_error& e)
                     {
@@ -211,105 +217,30 @@ namespace maps { namespace grid
             }
             else
             {
-                for(PointCloud::const_iterator it=pc.begin(); it != pc.end(); ++it)
-                {
-                    try
-                    {
-                        mergePoint(it->getArray3fMap().cast<double>(), pc2grid, measurement_variance);
-                    }
-                    catch(const std::runtime_error& e)
-                    {
-                        LOG_ERROR_S << e.what();
-                    }
-                }
+                for(int i = 0; i < points.cols(); ++i)
+                    mergeBulkPoint(i, points, indices, pos_in_cell, in_grid, measurement_variance);
             }
         }
 
         void mergePointCloud(const PointCloud& pc, const base::TransformWithCovariance& pc2mls, double measurement_variance = 0.01)
         {
-            base::Transform3d pc2grid = Base::prepareToGridOptimized(pc2mls.getTransform());
-            if(hasFreeSpaceMap())
-            {
-                Eigen::Vector3d sensor_origin = pc.sensor_origin_.block(0,0,3,1).cast<double>();
-                Eigen::Vector3d sensor_origin_in_mls = pc2mls.getTransform() * sensor_origin;
-                for(PointCloud::const_iterator it=pc.begin(); it != pc.end(); ++it)
-                {
-                    Eigen::Vector3d measurement = it->getArray3fMap().cast<double>();
-                    std::pair<Eigen::Vector3d, Eigen::Matrix3d> measurement_in_map = pc2mls.composePointWithCovariance(measurement, Eigen::Matrix3d::Zero());
-
-                    try
-                    {
-                        if(!free_space_map->isFreeSpace(measurement_in_map.first))
-                            mergePoint(measurement, pc2grid, measurement_variance + measurement_in_map.second(2,2));
+            Eigen::Matrix3Xf points(3, pc.size());
+            for(size_t i = 0; i < pc.size(); ++i)
+                points.col(i) = pc[i].getArray3fMap();
 
-                        if(measurement_in_map.second(2,2) <= free_space_map->getConfig().uncertainty_threshold)
-                            free_space_map->mergePoint(sensor_origin_in_mls, measurement_in_map.first);
-                    }
-                    catch(const std::runtime_error& e)
-                    {
-                        LOG_ERROR_S << e.what();
-                    }
-                }
-            }
-            else
-            {
-                for(PointCloud::const_iterator it=pc.begin(); it != pc.end(); ++it)
-                {
-                    Eigen::Vector3d point = it->getArray3fMap().cast<double>();
-                    std::pair<Eigen::Vector3d, Eigen::Matrix3d> point_with_cov = pc2mls.composePointWithCovariance(point, Eigen::Matrix3d::Zero());
-                    try
-                    {
-                        mergePoint(point, pc2grid, measurement_variance + point_with_cov.second(2,2));
-                    }
-                    catch(const std::runtime_error& e)
-                    {
-                        LOG_ERROR_S << e.what();
-                    }
-                }
-            }
+            Eigen::Vector3d sensor_origin = pc.sensor_origin_.block(0,0,3,1).cast<double>();
+            mergePointsWithCovariance(points, pc2mls, sensor_origin, measurement_variance);
         }
 
         template<int _MatrixOptions>
         void mergePointCloud(const std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >& pc, const base::TransformWithCovariance& pc2mls,
                              const base::Vector3d& sensor_origin_in_pc = base::Vector3d::Zero(), double measurement_variance = 0.01)
         {
-            base::Transform3d pc2grid = Base::prepareToGridOptimized(pc2mls.getTransform());
-            if(hasFreeSpaceMap())
-            {
-                base::Vector3d sensor_origin_in_mls = pc2mls.getTransform() * sensor_origin_in_pc;
-                for(typename std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >::const_iterator it = pc.begin(); it != pc.end(); ++it)
-                {
-                    std::pair<Eigen::Vector3d, Eigen::Matrix3d> measurement_in_map = pc2mls.composePointWithCovariance(*it, Eigen::Matrix3d::Zero());
-
-                    try
-                    {
-                        if(!free_space_map->isFreeSpace(measurement_in_map.first))
-                            mergePoint(*it, pc2grid, measurement_variance + measurement_in_map.second(2,2));
+            Eigen::Matrix3Xd points(3, pc.size());
+            for(size_t i = 0; i < pc.size(); ++i)
+                points.col(i) = pc[i];
 
-                        if(measurement_in_map.second(2,2) <= free_space_map->getConfig().uncertainty_threshold)
-                            free_space_map->mergePoint(sensor_origin_in_mls, measurement_in_map.first);
-                    }
-                    catch(const std::runtime_error& e)
-                    {
-                        LOG_ERROR_S << e.what();
-                    }
-                }
-            }
-            else
-            {
-                for(typename std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >::const_iterator it = pc.begin(); it != pc.end(); ++it)
-                {
-                    std::pair<Eigen::Vector3d, Eigen::Matrix3d> point_with_cov = pc2mls.composePointWithCovariance(*it, Eigen::Matrix3d::Zero());
-                    try
-                    {
-                        mergePoint(*it, pc2grid, measurement_variance + point_with_cov.second(2,2));
-                    }
-                    catch(const std::runtime_error& e)
-                    {
-                        LOG_ERROR_S << e.what();
-                    }
-                }
-            }
+            mergePointsWithCovariance(points, pc2mls, sensor_origin_in_pc, measurement_variance);
         }
 
         void mergePatch(const Index &idx, const Patch& new_patch)
@@ -323,6 +254,7 @@ namespace maps { namespace grid
                 {
                     // since patch_it was changed test if it can be merged with any of the existing patches
                     mergePatchRecursive(list, patch_it);
+                    Base::markModified(idx);
                     return;
                 }
                 else if(new_patch < *patch_it)
@@ -330,6 +262,7 @@ namespace maps { namespace grid
             }
             // insert as new patch
             list.insert(new_patch);
+            Base::markModified(idx);
         }
 
         void mergePoint(const Eigen::Vector3d& point, double measurement_variance = 0.01)
@@ -363,6 +296,144 @@ namespace maps { namespace grid
         MLSConfig config;
         boost::shared_ptr<OccupancyGridMapBase> free_space_map;
 
+        /** Adds the i-th point of a bulk conversion done by \c toGridBulk */
+        template<typename Scalar>
+        void mergeBulkPoint(int i, const Eigen::Matrix<Scalar, 3, Eigen::Dynamic>& points, const Eigen::Matrix2Xi& indices,
+                            const Eigen::Matrix<Scalar, 3, Eigen::Dynamic>& pos_in_cell, const std::vector<uint8_t>& in_grid, double measurement_variance)
+        {
+            if(in_grid[i])
+                mergePatch(Index(indices.col(i)), Patch(pos_in_cell.col(i).template cast<float>(), measurement_variance));
+            else
+                LOG_ERROR_S << "Point " << points.col(i).transpose() << " is outside of the grid! Can't add to grid.";
+        }
+
+        /** Adds the points in bulk, the z-variance of each point is increased by the uncertainty of \c pc2mls */
+        template<typename Scalar>
+        void mergePointsWithCovariance(const Eigen::Matrix<Scalar, 3, Eigen::Dynamic>& points, const base::TransformWithCovariance& pc2mls,
+                                       const base::Vector3d& sensor_origin_in_pc, double measurement_variance)
+        {
+            Eigen::Matrix2Xi indices;
+            Eigen::Matrix<Scalar, 3, Eigen::Dynamic> pos_in_cell;
+            std::vector<uint8_t> in_grid;
+            Base::toGridBulk(points, pc2mls.getTransform(), indices, pos_in_cell, in_grid);
+
+            if(hasFreeSpaceMap())
+            {
+                base::Vector3d sensor_origin_in_mls = pc2mls.getTransform() * sensor_origin_in_pc;
+                for(int i = 0; i < points.cols(); ++i)
+                {
+                    std::pair<Eigen::Vector3d, Eigen::Matrix3d> measurement_in_map = pc2mls.composePointWithCovariance(points.col(i).template cast<double>(), Eigen::Matrix3d::Zero());
+
+                    try
+                    {
+                        if(!free_space_map->isFreeSpace(measurement_in_map.first))
+                            mergeBulkPoint(i, points, indices, pos_in_cell, in_grid, measurement_variance + measurement_in_map.second(2,2));
+
+                        if(measurement_in_map.second(2,2) <= free_space_map->getConfig().uncertainty_threshold)
+                            free_space_map->mergePoint(sensor_origin_in_mls, measurement_in_map.first);
+                    }
+                    catch(const std::runtime_error& e)
+                    {
+                        LOG_ERROR_S << e.what();
+                    }
+                }
+            }
+            else
+            {
+                for(int i = 0; i < points.cols(); ++i)
+                {
+                    std::pair<Eigen::Vector3d, Eigen::Matrix3d> point_with_cov = pc2mls.composePointWithCovariance(points.col(i).template cast<double>(), Eigen::Matrix3d::Zero());
+                    mergeBulkPoint(i, points, indices, pos_in_cell, in_grid, measurement_variance + point_with_cov.second(2,2));
+                }
+            }
+        }
+
+        static bool getClosestContactPointInCell(const CellType& cell, const Vector3& pos_in_cell, Vector3& contact_point)
+        {
+            float min_dist;
+            bool found_patch = false;
+            for(const Patch& patch : cell)
+            {
+                Vector3 contact_point_f; // in local cell-coordinate system
+                float dist = std::abs(patch.getClosestContactPoint(pos_in_cell, contact_point_f));
+                if(found_patch && dist > min_dist)
+                    break; // we already found a patch and the current patch is farer away. Since patches are sorted, we can't get closer
+                else
+                {
+                    found_patch = true;
+                    min_dist = dist;
+                    contact_point = contact_point_f;
+                }
+            }
+            return found_patch && !base::isInfinity<float>(min_dist);
+        }
+
+        static bool getClosestSurfacePosInCell(const CellType& cell, const Vector3& pos_in_cell, float& surface_pos)
+        {
+            float min_dist = base::infinity<float>();
+            for(const Patch& patch : cell)
+            {
+                float surface_pos_f = patch.getSurfacePos(pos_in_cell);
+                float dist = std::abs(surface_pos_f - pos_in_cell.z());
+                if(dist > min_dist)
+                    break;
+                else
+                {
+                    min_dist = dist;
+                    surface_pos = surface_pos_f;
+                }
+            }
+            return !base::isInfinity<float>(min_dist);
+        }
+
+        /**
+         * Transforms all points to the grid frame at once, sorts them by cell and
+         * calls @p query for each point within the grid.
+         * Prototype: bool query(const CellType& cell, const Vector3& pos_in_cell, Vector3& result_in_cell)
+         */
+        template<class Query>
+        void queryBatch(const Eigen::Matrix3Xd& points, Eigen::Matrix3Xd& results, std::vector<uint8_t>& valid, Query query) const
+        {
+            const Eigen::Matrix3Xd points_in_grid = Base::getLocalFrame() * points;
+            const Vector2d& res = Base::getResolution();
+            const Vector2ui& num_cells = Base::getNumCells();
+
+            // sort the queries by cell to access each cell only once and in memory order
+            std::vector< std::pair<size_t, size_t> > queries;
+            queries.reserve(points.cols());
+            for(int i = 0; i < points.cols(); i++)
+            {
+                double x = std::floor(points_in_grid(0, i) / res.x());
+                double y = std::floor(points_in_grid(1, i) / res.y());
+                if(x >= 0. && y >= 0. && x < num_cells.x() && y < num_cells.y())
+                    queries.push_back(std::make_pair((size_t)x + (size_t)y * num_cells.x(), (size_t)i));
+            }
+            std::sort(queries.begin(), queries.end());
+
+            Eigen::Matrix3Xd results_in_grid = Eigen::Matrix3Xd::Constant(3, points.cols(), base::NaN<double>());
+            valid.assign(points.cols(), 0);
+
+            #pragma omp parallel for schedule(static)
+            for(int k = 0; k < (int)queries.size(); k++)
+            {
+                const size_t i = queries[k].second;
+                const Index idx(queries[k].first % num_cells.x(), queries[k].first / num_cells.x());
+                const Vector2d cell_center = (idx.cast<double>() + Vector2d(0.5, 0.5)).cwiseProduct(res);
+                Vector3d pos_in_cell = points_in_grid.col(i);
+                pos_in_cell.head<2>() -= cell_center;
+
+                Vector3 result;
+                if(query(Base::at(idx), pos_in_cell.cast<float>(), result))
+                {
+                    results_in_grid.col(i) = result.cast<double>();
+                    results_in_grid.col(i).head<2>() += cell_center;
+                    valid[i] = 1;
+                }
+            }
+
+            results = Base::getLocalFrame().inverse(Eigen::Isometry) * results_in_grid;
+        }
+
         bool merge(Patch& a, const Patch& b)
         {
             return a.merge(b, config);
@@ -430,6 +501,8 @@ namespace maps { namespace grid
             ar & BOOST_SERIALIZATION_NVP(config);
             if(version >= 1)
                 ar & BOOST_SERIALIZATION_NVP(free_space_map);
+            if(this->hasHeightPyramid())
+                this->buildHeightPyramid();
         }
 
         BOOST_SERIALIZATION_SPLIT_MEMBER()
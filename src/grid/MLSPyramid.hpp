@@ -0,0 +1,218 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <stdint.h>
+
+#include <maps/grid/MLSMap.hpp>
+
+namespace maps { namespace grid
+{
+    /**
+     * @brief Coarser levels of an MLSMap for planning at lower resolutions.
+     * @details
+     * Each level has @p factor times the resolution of the previous one. A coarse
+     * cell contains the patches of the factor x factor block of cells below it,
+     * merged with the patch merge of the map configuration, so Kalman patches
+     * keep their fused mean and variance and overlapping patches are joined.
+     *
+     * Only patch types without in-cell positions (BASE and KALMAN) are supported.
+     * The coarse cells are computed in parallel.
+     */
+    template<enum MLSConfig::update_model SurfaceType>
+    class MLSPyramid
+    {
+        static_assert(SurfaceType == MLSConfig::KALMAN || SurfaceType == MLSConfig::BASE,
+                      "MLSPyramid only supports KALMAN and BASE patches");
+    public:
+        typedef MLSMap<SurfaceType> MapType;
+        typedef typename MapType::Patch Patch;
+        typedef typename MapType::CellType CellType;
+
+        explicit MLSPyramid(unsigned factor = 2)
+            : factor(factor),
+              version(0)
+        {
+            if(factor < 2)
+                throw std::runtime_error("The downsampling factor of a MLS pyramid has to be at least 2");
+        }
+
+        /** Computes @p num_levels coarser levels of @p map */
+        void build(const MapType& map, unsigned num_levels)
+        {
+            levels.clear();
+            levels.reserve(num_levels);
+            for(unsigned level = 0; level < num_levels; ++level)
+            {
+                const MapType& source = level == 0 ? map : levels[level - 1];
+                const Vector2ui num_cells((source.getNumCells().x() + factor - 1) / factor,
+                                          (source.getNumCells().y() + factor - 1) / factor);
+                // the capacity is reserved, so adding a level keeps the source valid
+                levels.push_back(MapType(num_cells, source.getResolution() * factor, map.getConfig()));
+                MapType& target = levels.back();
+                target.getLocalFrame() = map.getLocalFrame();
+
+                #pragma omp parallel for schedule(dynamic)
+                for(int y = 0; y < int(num_cells.y()); ++y)
+                {
+                    std::vector<Patch> patches;
+                    for(unsigned x = 0; x < num_cells.x(); ++x)
+                        computeCell(source, target, Index(x, y), patches);
+                }
+                target.buildHeightPyramid();
+            }
+            source_num_cells = map.getNumCells();
+            version = map.hasChangeTracking() ? map.getChangeTracker().getVersion() : 0;
+        }
+
+        /**
+         * Recomputes the coarse cells above the tiles of @p map which changed since the
+         * last build or update. The map has to track its changes, see
+         * GridMap::enableChangeTracking. The changes are reported to the change tracking
+         * and height pyramid of the levels with markModified.
+         */
+        void update(const MapType& map)
+        {
+            const ChangeTracker& tracker = map.getChangeTracker();
+            if(tracker.isEmpty())
+                throw std::runtime_error("Updating a MLS pyramid requires change tracking of the map");
+            if(levels.empty() || map.getNumCells() != source_num_cells)
+                throw std::runtime_error("The MLS pyramid has to be built for the map before it can be updated");
+
+            // cells of the first level above the modified tiles
+            std::vector<uint8_t> mask(levels[0].getNumCells().prod(), 0);
+            for(unsigned ty = 0; ty < tracker.getNumTiles().y(); ++ty)
+            {
+                for(unsigned tx = 0; tx < tracker.getNumTiles().x(); ++tx)
+                {
+                    if(!tracker.isModified(Index(tx, ty), version))
+                        continue;
+                    Index begin, end;
+                    tracker.getTileCells(Index(tx, ty), begin, end);
+                    for(int y = begin.y() / int(factor); y <= (end.y() - 1) / int(factor); ++y)
+                        for(int x = begin.x() / int(factor); x <= (end.x() - 1) / int(factor); ++x)
+                            mask[x + y * levels[0].getNumCells().x()] = 1;
+                }
+            }
+
+            for(size_t level = 0; level < levels.size(); ++level)
+            {
+                const MapType& source = level == 0 ? map : levels[level - 1];
+                MapType& target = levels[level];
+                std::vector<Index> cells;
+                for(size_t i = 0; i < mask.size(); ++i)
+                {
+                    if(mask[i])
+                        cells.push_back(Index(i % target.getNumCells().x(), i / target.getNumCells().x()));
+                }
+
+                #pragma omp parallel for schedule(dynamic, 16)
+                for(int i = 0; i < int(cells.size()); ++i)
+                {
+                    std::vector<Patch> patches;
+                    computeCell(source, target, cells[i], patches);
+                }
+
+                for(size_t i = 0; i < cells.size(); ++i)
+                    target.markModified(cells[i]);
+
+                if(level + 1 < levels.size())
+                {
+                    const Vector2ui& next_cells = levels[level + 1].getNumCells();
+                    mask.assign(next_cells.prod(), 0);
+                    for(size_t i = 0; i < cells.size(); ++i)
+                        mask[cells[i].x() / factor + (cells[i].y() / factor) * next_cells.x()] = 1;
+                }
+            }
+            version = tracker.getVersion();
+        }
+
+        size_t getNumLevels() const
+        {
+            return levels.size();
+        }
+
+        unsigned getFactor() const
+        {
+            return factor;
+        }
+
+        /** Returns the level with factor^(level+1) times the resolution of the map */
+        const MapType& getLevel(size_t level) const
+        {
+            return levels.at(level);
+        }
+
+    private:
+        unsigned factor;
+        uint64_t version;
+        Vector2ui source_num_cells;
+        std::vector<MapType> levels;
+
+        static bool bottomLess(const Patch& a, const Patch& b)
+        {
+            return a.getBottom() < b.getBottom();
+        }
+
+        /** Merges the patches of the block of source cells below @p idx into the cell of @p target */
+        void computeCell(const MapType& source, MapType& target, const Index& idx, std::vector<Patch>& patches) const
+        {
+            patches.clear();
+            const Index begin = idx * int(factor);
+            const Index end = (begin.array() + int(factor)).matrix().cwiseMin(source.getNumCells().template cast<int>());
+            for(int y = begin.y(); y < end.y(); ++y)
+            {
+                for(int x = begin.x(); x < end.x(); ++x)
+                {
+                    const CellType& cell = source.at(x, y);
+                    patches.insert(patches.end(), cell.begin(), cell.end());
+                }
+            }
+
+            CellType& cell = target.at(idx);
+            cell.clear();
+            if(patches.empty())
+                return;
+
+            // sweep over the patches ordered by their bottom, merging each into the current one if possible
+            std::sort(patches.begin(), patches.end(), bottomLess);
+            Patch current = patches.front();
+            for(size_t i = 1; i < patches.size(); ++i)
+            {
+                if(!current.merge(patches[i], target.getConfig()))
+                {
+                    cell.insert(current);
+                    current = patches[i];
+                }
+            }
+            cell.insert(current);
+        }
+    };
+}}
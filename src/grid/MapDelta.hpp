@@ -0,0 +1,162 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <stdint.h>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include <maps/grid/GridMap.hpp>
+
+namespace maps { namespace grid
+{
+    /** Identifies delta archives written by saveDelta */
+    const uint32_t MAP_DELTA_MAGIC = 0x544C444D;
+    const uint32_t MAP_DELTA_VERSION = 1;
+
+    /**
+     * @brief Serializes the tiles of @p map which changed after @p base_version.
+     * @details
+     * The map has to track its changes, see GridMap::enableChangeTracking. The delta
+     * consists of a header with a bitmap of the changed tiles, followed by the cells of
+     * these tiles as boost binary archive. Its size and the time to create it only
+     * depend on the changed area, besides one bit per tile for the bitmap.
+     * Passing 0 as @p base_version serializes all tiles.
+     * @return the version of the map after applying the delta, which is the base
+     * version of the next delta
+     */
+    template <class MapT>
+    uint64_t saveDelta(const MapT& map, uint64_t base_version, std::ostream& stream)
+    {
+        const ChangeTracker& tracker = map.getChangeTracker();
+        if(tracker.isEmpty())
+            throw std::runtime_error("Change tracking is required for delta serialization");
+        if(tracker.getNumCells() != map.getNumCells())
+            throw std::runtime_error("Change tracking is out of date, it has to be enabled again after resizing the map");
+
+        const Vector2ui& num_tiles = tracker.getNumTiles();
+        std::vector<uint8_t> bitmap((num_tiles.prod() + 7) / 8, 0);
+        std::vector<Index> tiles;
+        for(unsigned ty = 0; ty < num_tiles.y(); ++ty)
+        {
+            for(unsigned tx = 0; tx < num_tiles.x(); ++tx)
+            {
+                if(!tracker.isModified(Index(tx, ty), base_version))
+                    continue;
+                const size_t i = tx + ty * num_tiles.x();
+                bitmap[i / 8] |= 1 << (i % 8);
+                tiles.push_back(Index(tx, ty));
+            }
+        }
+
+        const uint64_t version = tracker.getVersion();
+        const Vector2ui num_cells = map.getNumCells();
+        const unsigned tile_size = tracker.getTileSize();
+        boost::archive::binary_oarchive oa(stream, boost::archive::no_header);
+        oa << MAP_DELTA_MAGIC << MAP_DELTA_VERSION;
+        oa << base_version << version;
+        oa << num_cells.derived() << tile_size;
+        oa << map.getResolution().derived();
+        oa << map.getLocalFrame().matrix();
+        oa.save_binary(bitmap.data(), bitmap.size());
+
+        for(std::vector<Index>::const_iterator tile = tiles.begin(); tile != tiles.end(); ++tile)
+        {
+            Index begin, end;
+            tracker.getTileCells(*tile, begin, end);
+            for(int y = begin.y(); y < end.y(); ++y)
+                for(int x = begin.x(); x < end.x(); ++x)
+                    oa << map.at(x, y);
+        }
+        return version;
+    }
+
+    /**
+     * @brief Applies a delta written by saveDelta to @p replica.
+     * @details
+     * The replica must have the same size and resolution as the original map and must
+     * contain the state of the original map at the base version of the delta. The changed
+     * cells are reported to the change tracking of the replica with markModified.
+     * @return the version of the original map the replica corresponds to afterwards
+     */
+    template <class MapT>
+    uint64_t applyDelta(std::istream& stream, MapT& replica)
+    {
+        boost::archive::binary_iarchive ia(stream, boost::archive::no_header);
+        uint32_t magic, format_version;
+        ia >> magic >> format_version;
+        if(magic != MAP_DELTA_MAGIC || format_version != MAP_DELTA_VERSION)
+            throw std::runtime_error("Stream does not contain a map delta");
+
+        uint64_t base_version, version;
+        Vector2ui num_cells;
+        unsigned tile_size;
+        Vector2d resolution;
+        Eigen::Matrix4d local_frame;
+        ia >> base_version >> version;
+        ia >> num_cells.derived() >> tile_size;
+        ia >> resolution.derived();
+        ia >> local_frame;
+        if(num_cells != replica.getNumCells() || !resolution.isApprox(replica.getResolution()) || tile_size == 0)
+            throw std::runtime_error("Map delta does not match the size of the replica");
+        replica.getLocalFrame().matrix() = local_frame;
+
+        const Vector2ui num_tiles((num_cells.x() + tile_size - 1) / tile_size, (num_cells.y() + tile_size - 1) / tile_size);
+        std::vector<uint8_t> bitmap((num_tiles.prod() + 7) / 8);
+        ia.load_binary(bitmap.data(), bitmap.size());
+
+        for(unsigned ty = 0; ty < num_tiles.y(); ++ty)
+        {
+            for(unsigned tx = 0; tx < num_tiles.x(); ++tx)
+            {
+                const size_t i = tx + ty * num_tiles.x();
+                if(!(bitmap[i / 8] & (1 << (i % 8))))
+                    continue;
+
+                const Index begin(tx * tile_size, ty * tile_size);
+                const Index end = (begin.array() + int(tile_size)).matrix().cwiseMin(num_cells.cast<int>());
+                for(int y = begin.y(); y < end.y(); ++y)
+                {
+                    for(int x = begin.x(); x < end.x(); ++x)
+                    {
+                        const Index idx(x, y);
+                        typename MapT::CellType cell;
+                        ia >> cell;
+                        std::swap(replica.at(idx), cell);
+                        replica.markModified(idx);
+                    }
+                }
+            }
+        }
+        return version;
+    }
+}}
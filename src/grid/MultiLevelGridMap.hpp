@@ -26,9 +26,13 @@
 //
 #pragma once
 
+#include <type_traits>
+
 #include "LevelList.hpp"
 #include "GridMap.hpp"
+#include "HeightPyramid.hpp"
 #include "../tools/Overlap.hpp"
+#include "../tools/Footprint.hpp"
 
 namespace maps { namespace grid
 {
@@ -77,6 +81,8 @@ namespace maps { namespace grid
         
         typedef std::vector<std::pair<Index, const P*>> PatchVector;
 
+        typedef std::vector<Eigen::Affine3d, Eigen::aligned_allocator<Eigen::Affine3d> > PoseVector;
+
         /** Intersects @p box with the mls map.
          * The box is in local grid coordinates (i.e., starting at (0,0))
          * @return A list of patches and their grid indices that intersect the @p box.
@@ -106,17 +112,21 @@ namespace maps { namespace grid
             double minHeight = box.min().z();
             double maxHeight = box.max().z();
 
-            Index minIdx = (box.min().head<2>().cwiseQuotient(this->getResolution())).template cast<int>();
-            Index maxIdx = (box.max().head<2>().cwiseQuotient(this->getResolution())).template cast<int>();
-            maxIdx.array() += 1;
-
-            minIdx = minIdx.cwiseMax(0);
-            maxIdx = maxIdx.cwiseMin(this->getNumCells().template cast<int>());
+            Index minIdx, maxIdx;
+            getFootprint(box, minIdx, maxIdx);
 
             for(int y = minIdx.y(); y < maxIdx.y(); y++)
             {
                 for(int x = minIdx.x();x < maxIdx.x(); x++)
                 {
+                    int level = height_pyramid.getRejectLevel(x, y, minHeight, maxHeight);
+                    if(level >= 0)
+                    {
+                        // skip the remaining cells of the rejected node in this row
+                        x = (((x >> level) + 1) << level) - 1;
+                        continue;
+                    }
+
                     const Index curIdx(x,y);
                     for(const P &p: this->at(curIdx))
                     {
@@ -129,9 +139,173 @@ namespace maps { namespace grid
                 }
             }
         }
-        
 
 
+        /** Returns true if any patch intersects @p box.
+         * The box is in local grid coordinates (i.e., starting at (0,0)).
+         * If the height pyramid is available, whole sub-regions are rejected or
+         * accepted without accessing their cells. */
+        bool intersectsAABB(const Eigen::AlignedBox3d& box) const
+        {
+            if(height_pyramid.isEmpty())
+            {
+                bool intersects = false;
+                intersectAABB_callback(box, [&intersects](const Index&, const P&)
+                                            {
+                                                intersects = true;
+                                                return true;
+                                            });
+                return intersects;
+            }
+
+            Index minIdx, maxIdx;
+            getFootprint(box, minIdx, maxIdx);
+            if((minIdx.array() >= maxIdx.array()).any())
+                return false;
+            return intersectsNode(height_pyramid.getNumLevels() - 1, 0, 0, minIdx, maxIdx, box.min().z(), box.max().z());
+        }
+
+        /** Tests the shapes @p footprints at each of the @p poses for intersections with the patches.
+         * The poses are in local grid coordinates, like the boxes of intersectAABB.
+         * The footprints are rasterized exactly, i.e. only cells overlapping the rotated polygon are tested.
+         * The poses are processed in parallel, if OpenMP is available.
+         * @param collisions is set to 1 for each pose at which any footprint intersects a patch, otherwise 0 */
+        void checkCollisions(const std::vector<tools::Footprint>& footprints, const PoseVector& poses,
+                             std::vector<uint8_t>& collisions) const
+        {
+            collisions.assign(poses.size(), 0);
+
+            #pragma omp parallel for schedule(dynamic)
+            for(int i = 0; i < (int)poses.size(); i++)
+            {
+                tools::Footprint::Polygon polygon;
+                double minHeight, maxHeight;
+                for(const tools::Footprint& footprint : footprints)
+                {
+                    footprint.transform(poses[i], polygon, minHeight, maxHeight);
+                    if(intersectsPolygon(polygon, minHeight, maxHeight))
+                    {
+                        collisions[i] = 1;
+                        break;
+                    }
+                }
+            }
+        }
+
+        void checkCollisions(const tools::Footprint& footprint, const PoseVector& poses, std::vector<uint8_t>& collisions) const
+        {
+            checkCollisions(std::vector<tools::Footprint>(1, footprint), poses, collisions);
+        }
+
+        /** Computes for each of the @p poses the smallest vertical distance between the shapes
+         * @p footprints and the patches below or above them.
+         * The clearance is 0 in case of a collision and infinity if no patch is within the footprints.
+         * @see checkCollisions */
+        void computeClearance(const std::vector<tools::Footprint>& footprints, const PoseVector& poses,
+                              std::vector<float>& clearance) const
+        {
+            clearance.assign(poses.size(), std::numeric_limits<float>::infinity());
+
+            #pragma omp parallel for schedule(dynamic)
+            for(int i = 0; i < (int)poses.size(); i++)
+            {
+                tools::Footprint::Polygon polygon;
+                double minHeight, maxHeight;
+                double minGap = std::numeric_limits<double>::infinity();
+                for(const tools::Footprint& footprint : footprints)
+                {
+                    footprint.transform(poses[i], polygon, minHeight, maxHeight);
+                    tools::Footprint::rasterize(polygon, this->getResolution(), this->getNumCells(),
+                        [&](int y, int x_begin, int x_end)
+                        {
+                            for(int x = x_begin; x < x_end; x++)
+                            {
+                                // the cell bounds are a lower bound of the gap of its patches
+                                if(!height_pyramid.isEmpty() && std::max(height_pyramid.getMin(0, x, y) - maxHeight, minHeight - height_pyramid.getMax(0, x, y)) >= minGap)
+                                    continue;
+                                for(const P &p: this->at(x, y))
+                                {
+                                    double gap = std::max(std::max((double)p.getMin() - maxHeight, minHeight - (double)p.getMax()), 0.);
+                                    minGap = std::min(minGap, gap);
+                                }
+                            }
+                            return minGap <= 0.;
+                        });
+                    if(minGap <= 0.)
+                        break;
+                }
+                clearance[i] = minGap;
+            }
+        }
+
+        void computeClearance(const tools::Footprint& footprint, const PoseVector& poses, std::vector<float>& clearance) const
+        {
+            computeClearance(std::vector<tools::Footprint>(1, footprint), poses, clearance);
+        }
+
+        /** Grows the grid to at least @p minSize, an existing height pyramid is rebuilt */
+        void extend(const Vector2ui &minSize)
+        {
+            resize(minSize.cwiseMax(this->getNumCells()));
+        }
+
+        /** Resizes the grid, an existing height pyramid is rebuilt */
+        void resize(const Vector2ui &new_number_cells)
+        {
+            GridMap<LevelList<P> >::resize(new_number_cells);
+            rebuildHeightPyramid();
+        }
+
+        /** Moves the cells by @p idx, an existing height pyramid is rebuilt */
+        void moveBy(const Index &idx)
+        {
+            GridMap<LevelList<P> >::moveBy(idx);
+            rebuildHeightPyramid();
+        }
+
+        /** Removes all patches, an existing height pyramid is rebuilt */
+        void clear()
+        {
+            GridMap<LevelList<P> >::clear();
+            rebuildHeightPyramid();
+        }
+
+        /** Computes the min/max height pyramid, which is used to speed up the intersection queries.
+         * The pyramid is updated by MLSMap::mergePatch, extend, resize, moveBy and clear. If the cells
+         * are modified otherwise updateHeightPyramid has to be called for each changed cell,
+         * or the pyramid has to be rebuilt. */
+        void buildHeightPyramid()
+        {
+            height_pyramid.build(*this);
+        }
+
+        void clearHeightPyramid()
+        {
+            height_pyramid.clear();
+        }
+
+        bool hasHeightPyramid() const
+        {
+            return !height_pyramid.isEmpty();
+        }
+
+        const HeightPyramid& getHeightPyramid() const
+        {
+            return height_pyramid;
+        }
+
+        /** Updates the height pyramid after the patches of cell @p idx have changed */
+        void updateHeightPyramid(const Index& idx)
+        {
+            height_pyramid.update(idx, this->at(idx));
+        }
+
+        /** Updates the height pyramid and the change tracking after the patches of cell @p idx have changed */
+        void markModified(const Index& idx)
+        {
+            GridMap<LevelList<P> >::markModified(idx);
+            updateHeightPyramid(idx);
+        }
 
         /** @param outNumIntersections contains the number of mls patches that
                                        intersected the @p box*/
@@ -162,6 +336,13 @@ namespace maps { namespace grid
             {
                 for(Index::Scalar x = minIdx.x();x <= maxIdx.x(); x++)
                 {
+                    int level = height_pyramid.getRejectLevel(x, y, minHeight, maxHeight);
+                    if(level >= 0)
+                    {
+                        x = (((x >> level) + 1) << level) - 1;
+                        continue;
+                    }
+
                     Index curIdx(x,y);
                     
                     LevelList<const P *> &retList(ret.at(Index(curIdx - minIdx)));
@@ -179,7 +360,93 @@ namespace maps { namespace grid
             
             return ret;
         }
-        
+
+    private:
+        /** Rebuilds an existing height pyramid. Grids of pointers (e.g. TraversabilityMap3d)
+         * cannot build a pyramid, so there is nothing to rebuild for them. */
+        template<class Q = P>
+        typename std::enable_if<!std::is_pointer<Q>::value>::type rebuildHeightPyramid()
+        {
+            if(hasHeightPyramid())
+                buildHeightPyramid();
+        }
+
+        template<class Q = P>
+        typename std::enable_if<std::is_pointer<Q>::value>::type rebuildHeightPyramid()
+        {
+        }
+
+        HeightPyramid height_pyramid;
+
+        /** Computes the cell range [minIdx, maxIdx) covered by a box in local grid coordinates */
+        void getFootprint(const Eigen::AlignedBox3d& box, Index& minIdx, Index& maxIdx) const
+        {
+            minIdx = (box.min().head<2>().cwiseQuotient(this->getResolution())).template cast<int>();
+            maxIdx = (box.max().head<2>().cwiseQuotient(this->getResolution())).template cast<int>();
+            maxIdx.array() += 1;
+
+            minIdx = minIdx.cwiseMax(0);
+            maxIdx = maxIdx.cwiseMin(this->getNumCells().template cast<int>());
+        }
+
+        /** Returns true if a patch intersects the prism given by a convex polygon in local grid coordinates and a height interval */
+        bool intersectsPolygon(const tools::Footprint::Polygon& polygon, double minHeight, double maxHeight) const
+        {
+            return tools::Footprint::rasterize(polygon, this->getResolution(), this->getNumCells(),
+                [&](int y, int x_begin, int x_end)
+                {
+                    for(int x = x_begin; x < x_end; x++)
+                    {
+                        int level = height_pyramid.getRejectLevel(x, y, minHeight, maxHeight);
+                        if(level >= 0)
+                        {
+                            x = (((x >> level) + 1) << level) - 1;
+                            continue;
+                        }
+                        for(const P &p: this->at(x, y))
+                        {
+                            if(::maps::tools::overlap(p, minHeight, maxHeight))
+                                return true;
+                        }
+                    }
+                    return false;
+                });
+        }
+
+        bool intersectsNode(unsigned level, int x, int y, const Index& minIdx, const Index& maxIdx, double minHeight, double maxHeight) const
+        {
+            // cells covered by the node
+            const Index nodeMin(x << level, y << level);
+            const Index nodeMax = Index((x + 1) << level, (y + 1) << level).cwiseMin(this->getNumCells().template cast<int>());
+            if((nodeMax.array() <= minIdx.array()).any() || (nodeMin.array() >= maxIdx.array()).any())
+                return false;
+            if(height_pyramid.rejects(level, x, y, minHeight, maxHeight))
+                return false;
+            if((nodeMin.array() >= minIdx.array()).all() && (nodeMax.array() <= maxIdx.array()).all() &&
+                height_pyramid.accepts(level, x, y, minHeight, maxHeight))
+                return true;
+
+            if(level == 0)
+            {
+                for(const P &p: this->at(x, y))
+                {
+                    if(::maps::tools::overlap(p, minHeight, maxHeight))
+                        return true;
+                }
+                return false;
+            }
+
+            const Vector2ui& childSize = height_pyramid.getLevelSize(level - 1);
+            for(int cy = 2 * y; cy < std::min(2 * y + 2, (int)childSize.y()); cy++)
+            {
+                for(int cx = 2 * x; cx < std::min(2 * x + 2, (int)childSize.x()); cx++)
+                {
+                    if(intersectsNode(level - 1, cx, cy, minIdx, maxIdx, minHeight, maxHeight))
+                        return true;
+                }
+            }
+            return false;
+        }
     };
 
 }}
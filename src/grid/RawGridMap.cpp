@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "RawGridMap.hpp"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace maps::grid;
+
+namespace
+{
+    const char RAW_GRID_MAGIC[8] = {'M', 'A', 'P', 'S', 'G', 'R', 'I', 'D'};
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+RawGridHeader maps::grid::createRawGridHeader(const LocalMap& map, const Vector2d& resolution, const Vector2ui& num_cells,
+                                              size_t cell_size, size_t cell_alignment)
+{
+    RawGridHeader header;
+    std::memset(&header, 0, sizeof(RawGridHeader));
+    std::memcpy(header.magic, RAW_GRID_MAGIC, sizeof(RAW_GRID_MAGIC));
+    header.version = RawGridHeader::VERSION;
+    header.byte_order = RawGridHeader::BYTE_ORDER_MARK;
+    header.header_size = sizeof(RawGridHeader);
+    header.cell_size = cell_size;
+    header.cell_alignment = cell_alignment;
+    header.num_cells[0] = num_cells.x();
+    header.num_cells[1] = num_cells.y();
+    header.map_type = map.getMapType();
+    header.resolution[0] = resolution.x();
+    header.resolution[1] = resolution.y();
+    Eigen::Map<Eigen::Matrix4d>(header.offset) = map.getLocalFrame().matrix();
+    header.id_length = map.getId().size();
+    header.epsg_code_length = map.getEPSGCode().size();
+    header.default_value_offset = alignUp(sizeof(RawGridHeader) + header.id_length + header.epsg_code_length, cell_alignment);
+    header.data_offset = alignUp(header.default_value_offset + cell_size, RAW_GRID_ALIGNMENT);
+    header.data_size = uint64_t(num_cells.prod()) * cell_size;
+    return header;
+}
+
+void maps::grid::checkRawGridHeader(const RawGridHeader& header, size_t file_size, size_t cell_size, size_t cell_alignment)
+{
+    if(std::memcmp(header.magic, RAW_GRID_MAGIC, sizeof(RAW_GRID_MAGIC)) != 0)
+        throw std::runtime_error("File is not a raw grid map");
+    if(header.byte_order != RawGridHeader::BYTE_ORDER_MARK)
+        throw std::runtime_error("Raw grid map was written on a platform with different byte order");
+    if(header.version != RawGridHeader::VERSION || header.header_size != sizeof(RawGridHeader))
+        throw std::runtime_error("Unsupported raw grid map version");
+    if(header.cell_size != cell_size || header.cell_alignment != cell_alignment)
+        throw std::runtime_error("Raw grid map was written with a different cell type");
+    // all checks are written to not overflow for arbitrary header values
+    const uint64_t num_cells = uint64_t(header.num_cells[0]) * header.num_cells[1];
+    if(header.data_size % cell_size != 0 || header.data_size / cell_size != num_cells
+        || header.default_value_offset < sizeof(RawGridHeader) + uint64_t(header.id_length) + header.epsg_code_length
+        || header.default_value_offset % cell_alignment != 0
+        || header.data_offset < header.default_value_offset
+        || header.data_offset - header.default_value_offset < cell_size
+        || header.data_offset % RAW_GRID_ALIGNMENT != 0
+        || header.data_offset > file_size
+        || header.data_size > file_size - header.data_offset)
+        throw std::runtime_error("Raw grid map is truncated or corrupted");
+}
+
+void maps::grid::writeRawGridHeader(std::ostream& stream, const RawGridHeader& header, const LocalMap& map, const void* default_value)
+{
+    std::vector<char> buffer(header.data_offset, 0);
+    writeRawGridHeader(buffer.data(), header, map, default_value);
+    stream.write(buffer.data(), buffer.size());
+}
+
+void maps::grid::writeRawGridHeader(char* buffer, const RawGridHeader& header, const LocalMap& map, const void* default_value)
+{
+    std::memset(buffer, 0, header.data_offset);
+    std::memcpy(buffer, &header, sizeof(RawGridHeader));
+    std::memcpy(buffer + sizeof(RawGridHeader), map.getId().data(), header.id_length);
+    std::memcpy(buffer + sizeof(RawGridHeader) + header.id_length, map.getEPSGCode().data(), header.epsg_code_length);
+    std::memcpy(buffer + header.default_value_offset, default_value, header.cell_size);
+}
+
+void maps::grid::applyRawGridHeader(const RawGridHeader& header, const char* strings, LocalMap& map)
+{
+    map.getId().assign(strings, header.id_length);
+    map.getEPSGCode().assign(strings + header.id_length, header.epsg_code_length);
+    map.getMapType() = static_cast<LocalMapType>(header.map_type);
+    map.getLocalFrame().matrix() = Eigen::Map<const Eigen::Matrix4d>(header.offset);
+}
+
+MappedFile::MappedFile(const std::string& filename)
+    : address(nullptr), length(0)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error("Could not open " + filename + " for reading");
+
+    struct stat file_stat;
+    if(::fstat(fd, &file_stat) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("Could not determine the size of " + filename);
+    }
+    length = file_stat.st_size;
+
+    if(length > 0)
+    {
+        void* mapped = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if(mapped == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("Could not map " + filename + " into memory");
+        }
+        address = static_cast<char*>(mapped);
+    }
+    // the mapping stays valid after closing the file descriptor
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if(address)
+        ::munmap(address, length);
+}
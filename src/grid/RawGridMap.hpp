@@ -0,0 +1,362 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <type_traits>
+#include <stdexcept>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <maps/grid/GridMap.hpp>
+
+namespace maps { namespace grid
+{
+    /**
+     * @brief Header of the raw grid map format.
+     * @details
+     * A raw grid map file consists of this header, the map id and EPSG code strings,
+     * the default value and the cells of the grid in row major order, starting at
+     * RawGridHeader::data_offset, which is aligned to RAW_GRID_ALIGNMENT bytes.
+     * All values are stored in the native byte order and are checked against
+     * the reading platform and cell type.
+     */
+    struct RawGridHeader
+    {
+        static const uint32_t VERSION = 1;
+        static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t header_size;
+        uint32_t cell_size;
+        uint32_t cell_alignment;
+        uint32_t num_cells[2];
+        int32_t map_type;
+        double resolution[2];
+        /** local frame as 4x4 matrix in column major order */
+        double offset[16];
+        uint32_t id_length;
+        uint32_t epsg_code_length;
+        uint64_t default_value_offset;
+        uint64_t data_offset;
+        uint64_t data_size;
+    };
+
+    /** Alignment of the cell data in a raw grid map file */
+    const size_t RAW_GRID_ALIGNMENT = 64;
+
+    /** Creates the header for a map, including the offsets of the default value and the cell data */
+    RawGridHeader createRawGridHeader(const LocalMap& map, const Vector2d& resolution, const Vector2ui& num_cells,
+                                      size_t cell_size, size_t cell_alignment);
+
+    /**
+     * Checks a raw grid header read from a file of @p file_size bytes.
+     * Throws std::runtime_error if the header is invalid or does not match the cell type.
+     */
+    void checkRawGridHeader(const RawGridHeader& header, size_t file_size, size_t cell_size, size_t cell_alignment);
+
+    /** Writes the header and everything up to the cell data */
+    void writeRawGridHeader(std::ostream& stream, const RawGridHeader& header, const LocalMap& map, const void* default_value);
+
+    /** Writes the header and everything up to the cell data to @p buffer, which must hold header.data_offset bytes */
+    void writeRawGridHeader(char* buffer, const RawGridHeader& header, const LocalMap& map, const void* default_value);
+
+    /** Applies the meta data of the raw grid header to a local map, @p strings points to the memory after the header */
+    void applyRawGridHeader(const RawGridHeader& header, const char* strings, LocalMap& map);
+
+    /**
+     * @brief Read-only memory mapping of a complete file.
+     * @details
+     * The file is mapped copy-on-write, so modifications of the mapped memory
+     * are private to the process and never written back to the file.
+     */
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string& filename);
+        ~MappedFile();
+
+        char* data() { return address; }
+        const char* data() const { return address; }
+        size_t size() const { return length; }
+
+    private:
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+
+        char* address;
+        size_t length;
+    };
+
+    /**
+     * @brief Grid storage on a memory mapped raw grid map file.
+     * @details
+     * Can be used as storage type of GridMap, see mapRawGridMap(). The storage
+     * can not be resized. Copies of a MappedGrid share the mapped memory.
+     * Any other memory holding a raw grid map can be used as well, see makeRawGridMapView().
+     */
+    template <typename CellT>
+    class MappedGrid
+    {
+        /** Keeps the memory of the cells alive, e.g. a MappedFile **/
+        boost::shared_ptr<void> memory;
+
+        /** The cells grid element **/
+        CellT* cells;
+
+        /** Number of cells in X-axis and Y-axis **/
+        Vector2ui num_cells;
+
+        /** Default value **/
+        CellT default_value;
+
+    public:
+
+        typedef CellT CellType;
+        typedef CellT* iterator;
+        typedef const CellT* const_iterator;
+
+        MappedGrid()
+            : cells(nullptr),
+              num_cells(0, 0),
+              default_value()
+        {
+        }
+
+        /**
+         * @param memory owner of the memory @p cells points to, it is released
+         * when the last copy of this grid is destroyed
+         */
+        MappedGrid(const boost::shared_ptr<void>& memory, CellT* cells, const Vector2ui& num_cells, const CellT& default_value)
+            : memory(memory),
+              cells(cells),
+              num_cells(num_cells),
+              default_value(default_value)
+        {
+        }
+
+        const CellT &getDefaultValue() const
+        {
+            return default_value;
+        }
+
+        iterator begin()
+        {
+            return cells;
+        }
+
+        iterator end()
+        {
+            return cells + num_cells.prod();
+        }
+
+        const_iterator begin() const
+        {
+            return cells;
+        }
+
+        const_iterator end() const
+        {
+            return cells + num_cells.prod();
+        }
+
+        void resize(const Vector2ui &new_number_cells)
+        {
+            if(new_number_cells != num_cells)
+                throw std::runtime_error("A memory mapped grid can not be resized");
+        }
+
+        void moveBy(const Index &idx)
+        {
+            if (abs(idx.x()) >= num_cells.x()
+                || abs(idx.y()) >= num_cells.y())
+            {
+                clear();
+                return;
+            }
+
+            std::vector<CellT> tmp(num_cells.prod(), default_value);
+            for (unsigned int y = 0; y < num_cells.y(); ++y)
+            {
+                for (unsigned int x = 0; x < num_cells.x(); ++x)
+                {
+                    int x_new = x + idx.x();
+                    int y_new = y + idx.y();
+
+                    if ((x_new >= 0 && unsigned(x_new) < num_cells.x())
+                        && (y_new >= 0 && unsigned(y_new) < num_cells.y()))
+                    {
+                        tmp[x_new + y_new * num_cells.x()] = cells[x + y * num_cells.x()];
+                    }
+                }
+            }
+            std::copy(tmp.begin(), tmp.end(), cells);
+        }
+
+        const CellT& at(const Index &idx) const
+        {
+            return this->at(idx.x(), idx.y());
+        }
+
+        CellT& at(const Index &idx)
+        {
+            return this->at(idx.x(), idx.y());
+        }
+
+        const CellT& at(size_t x, size_t y) const
+        {
+            if(x >= num_cells.x() || y >= num_cells.y())
+                throw std::runtime_error("Provided index is out of the grid");
+            return cells[x + y * num_cells.x()];
+        }
+
+        CellT& at(size_t x, size_t y)
+        {
+            if(x >= num_cells.x() || y >= num_cells.y())
+                throw std::runtime_error("Provided index is out of the grid");
+            return cells[x + y * num_cells.x()];
+        }
+
+        const Vector2ui &getNumCells() const
+        {
+            return num_cells;
+        };
+
+        void clear()
+        {
+            std::fill(begin(), end(), default_value);
+        };
+    };
+
+    /**
+     * @brief Saves a grid map of trivially copyable cells in the raw grid map format.
+     * @details
+     * Only the LocalMap data, the resolution and the cells are stored, additional
+     * members of derived maps are not part of the format.
+     */
+    template <typename CellT, typename GridT>
+    void saveRawGridMap(const GridMap<CellT, GridT>& map, const std::string& filename)
+    {
+        static_assert(std::is_trivially_copyable<CellT>::value, "The raw grid map format requires trivially copyable cells");
+
+        std::ofstream stream(filename.c_str(), std::ios::binary | std::ios::trunc);
+        if(!stream)
+            throw std::runtime_error("Could not open " + filename + " for writing");
+
+        RawGridHeader header = createRawGridHeader(map, map.getResolution(), map.getNumCells(), sizeof(CellT), alignof(CellT));
+        const CellT default_value = map.getDefaultValue();
+        writeRawGridHeader(stream, header, map, &default_value);
+        if(header.data_size > 0)
+            stream.write(reinterpret_cast<const char*>(&*map.begin()), header.data_size);
+
+        if(!stream)
+            throw std::runtime_error("Failed to write raw grid map to " + filename);
+    }
+
+    /**
+     * @brief Loads a raw grid map file with a single bulk read of the cells.
+     */
+    template <typename CellT>
+    void loadRawGridMap(const std::string& filename, GridMap<CellT>& map)
+    {
+        static_assert(std::is_trivially_copyable<CellT>::value, "The raw grid map format requires trivially copyable cells");
+
+        std::ifstream stream(filename.c_str(), std::ios::binary);
+        if(!stream)
+            throw std::runtime_error("Could not open " + filename + " for reading");
+        stream.seekg(0, std::ios::end);
+        const size_t file_size = stream.tellg();
+        stream.seekg(0, std::ios::beg);
+
+        RawGridHeader header;
+        if(!stream.read(reinterpret_cast<char*>(&header), sizeof(RawGridHeader)))
+            throw std::runtime_error("Failed to read raw grid map header from " + filename);
+        checkRawGridHeader(header, file_size, sizeof(CellT), alignof(CellT));
+
+        std::vector<char> meta_data(header.data_offset - sizeof(RawGridHeader));
+        if(!stream.read(meta_data.data(), meta_data.size()))
+            throw std::runtime_error("Failed to read raw grid map header from " + filename);
+
+        CellT default_value;
+        std::copy(meta_data.begin() + (header.default_value_offset - sizeof(RawGridHeader)),
+                  meta_data.begin() + (header.default_value_offset - sizeof(RawGridHeader) + sizeof(CellT)),
+                  reinterpret_cast<char*>(&default_value));
+
+        map = GridMap<CellT>(Vector2ui(header.num_cells[0], header.num_cells[1]),
+                             Vector2d(header.resolution[0], header.resolution[1]), default_value);
+        applyRawGridHeader(header, meta_data.data(), map);
+
+        if(header.data_size > 0 && !stream.read(reinterpret_cast<char*>(&*map.begin()), header.data_size))
+            throw std::runtime_error("Failed to read raw grid map cells from " + filename);
+    }
+
+    /**
+     * @brief Creates a grid map on a raw grid map image in memory, without copying the cells.
+     * @param memory owner of the memory, kept alive as long as the returned map or a copy of it exists
+     * @param data start of the raw grid map image, aligned to RAW_GRID_ALIGNMENT
+     * @param size size of the image in bytes
+     */
+    template <typename CellT>
+    GridMap<CellT, MappedGrid<CellT> > makeRawGridMapView(const boost::shared_ptr<void>& memory, char* data, size_t size)
+    {
+        static_assert(std::is_trivially_copyable<CellT>::value, "The raw grid map format requires trivially copyable cells");
+
+        if(size < sizeof(RawGridHeader))
+            throw std::runtime_error("Memory does not contain a raw grid map");
+
+        const RawGridHeader& header = *reinterpret_cast<const RawGridHeader*>(data);
+        checkRawGridHeader(header, size, sizeof(CellT), alignof(CellT));
+
+        const CellT& default_value = *reinterpret_cast<const CellT*>(data + header.default_value_offset);
+        const Vector2ui num_cells(header.num_cells[0], header.num_cells[1]);
+        GridMap<CellT, MappedGrid<CellT> > map(MappedGrid<CellT>(memory, reinterpret_cast<CellT*>(data + header.data_offset), num_cells, default_value),
+                                                Vector2d(header.resolution[0], header.resolution[1]));
+        applyRawGridHeader(header, data + sizeof(RawGridHeader), map);
+        return map;
+    }
+
+    /**
+     * @brief Maps a raw grid map file into memory without copying the cells.
+     * @details
+     * The cells are loaded lazily by the operating system on first access.
+     * Changes to the returned map are never written back to the file.
+     */
+    template <typename CellT>
+    GridMap<CellT, MappedGrid<CellT> > mapRawGridMap(const std::string& filename)
+    {
+        boost::shared_ptr<MappedFile> file(new MappedFile(filename));
+        if(file->size() < sizeof(RawGridHeader))
+            throw std::runtime_error(filename + " is not a raw grid map");
+        return makeRawGridMapView<CellT>(file, file->data(), file->size());
+    }
+}}
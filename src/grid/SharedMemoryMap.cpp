@@ -0,0 +1,276 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "SharedMemoryMap.hpp"
+
+#include <atomic>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace maps::grid;
+
+namespace
+{
+    const char SHARED_MAP_MAGIC[8] = {'M', 'A', 'P', 'S', 'S', 'H', 'M', '1'};
+    const uint32_t SHARED_MAP_VERSION = 1;
+    const int32_t WRITING = -1;
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    std::string shmName(const std::string& name)
+    {
+        return name.empty() || name[0] != '/' ? "/" + name : name;
+    }
+}
+
+struct SharedMapSegment::ControlHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_buffers;
+    uint64_t buffer_size;
+    uint64_t buffers_offset;
+    /** index of the latest published buffer, -1 if none */
+    std::atomic<int32_t> latest;
+    std::atomic<uint64_t> revision;
+};
+
+struct SharedMapSegment::BufferHeader
+{
+    /** number of readers or WRITING */
+    std::atomic<int32_t> state;
+    uint32_t format;
+    uint64_t size;
+    uint64_t revision;
+};
+
+// the atomics are shared between processes, which requires them to be lock-free
+// and to have the layout of the plain integers
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && sizeof(std::atomic<int32_t>) == sizeof(int32_t),
+              "Shared memory maps require lock-free 32 bit atomics");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+              "Shared memory maps require lock-free 64 bit atomics");
+
+SharedMapSegment::SharedMapSegment(const std::string& name, int fd, size_t size, bool owner)
+    : name(name), address(nullptr), length(size), owner(owner)
+{
+    void* mapped = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(mapped == MAP_FAILED)
+    {
+        if(owner)
+            ::shm_unlink(name.c_str());
+        throw std::runtime_error("Could not map shared memory segment " + name);
+    }
+    address = static_cast<char*>(mapped);
+}
+
+SharedMapSegment::~SharedMapSegment()
+{
+    ::munmap(address, length);
+    if(owner)
+        ::shm_unlink(name.c_str());
+}
+
+boost::shared_ptr<SharedMapSegment> SharedMapSegment::create(const std::string& name, size_t buffer_size, unsigned num_buffers)
+{
+    if(num_buffers < 2)
+        throw std::runtime_error("A shared map segment needs at least two buffers");
+
+    const std::string shm_name = shmName(name);
+    const size_t page_size = ::sysconf(_SC_PAGESIZE);
+    buffer_size = alignUp(std::max<size_t>(buffer_size, 1), page_size);
+    const size_t buffers_offset = alignUp(sizeof(ControlHeader) + num_buffers * sizeof(BufferHeader), page_size);
+    const size_t size = buffers_offset + num_buffers * buffer_size;
+
+    // replace a segment left behind by a previous publisher
+    ::shm_unlink(shm_name.c_str());
+    int fd = ::shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0)
+        throw std::runtime_error("Could not create shared memory segment " + shm_name);
+    if(::ftruncate(fd, size) != 0)
+    {
+        ::close(fd);
+        ::shm_unlink(shm_name.c_str());
+        throw std::runtime_error("Could not resize shared memory segment " + shm_name);
+    }
+
+    boost::shared_ptr<SharedMapSegment> segment(new SharedMapSegment(shm_name, fd, size, true));
+    ControlHeader* control = new (segment->address) ControlHeader;
+    control->version = SHARED_MAP_VERSION;
+    control->num_buffers = num_buffers;
+    control->buffer_size = buffer_size;
+    control->buffers_offset = buffers_offset;
+    control->latest.store(-1);
+    control->revision.store(0);
+    for(unsigned i = 0; i < num_buffers; ++i)
+    {
+        BufferHeader* buffer = new (&segment->bufferHeader(i)) BufferHeader;
+        buffer->state.store(0);
+        buffer->format = 0;
+        buffer->size = 0;
+        buffer->revision = 0;
+    }
+
+    // subscribers only accept the segment once the magic is set
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(control->magic, SHARED_MAP_MAGIC, sizeof(SHARED_MAP_MAGIC));
+    return segment;
+}
+
+boost::shared_ptr<SharedMapSegment> SharedMapSegment::open(const std::string& name)
+{
+    const std::string shm_name = shmName(name);
+    int fd = ::shm_open(shm_name.c_str(), O_RDWR, 0);
+    if(fd < 0)
+        throw std::runtime_error("Could not open shared memory segment " + shm_name);
+
+    struct stat segment_stat;
+    if(::fstat(fd, &segment_stat) != 0 || size_t(segment_stat.st_size) < sizeof(ControlHeader))
+    {
+        ::close(fd);
+        throw std::runtime_error("Shared memory segment " + shm_name + " is not initialized");
+    }
+
+    boost::shared_ptr<SharedMapSegment> segment(new SharedMapSegment(shm_name, fd, segment_stat.st_size, false));
+    const ControlHeader& control = segment->control();
+    if(std::memcmp(control.magic, SHARED_MAP_MAGIC, sizeof(SHARED_MAP_MAGIC)) != 0)
+        throw std::runtime_error("Shared memory segment " + shm_name + " is not initialized");
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(control.version != SHARED_MAP_VERSION
+        || control.buffers_offset + control.num_buffers * control.buffer_size > segment->length)
+        throw std::runtime_error("Shared memory segment " + shm_name + " has an unsupported layout");
+    return segment;
+}
+
+size_t SharedMapSegment::getBufferSize() const
+{
+    return control().buffer_size;
+}
+
+unsigned SharedMapSegment::getNumBuffers() const
+{
+    return control().num_buffers;
+}
+
+unsigned SharedMapSegment::beginWrite()
+{
+    const ControlHeader& header = control();
+    const int32_t latest = header.latest.load(std::memory_order_acquire);
+    // start after the latest buffer, so the buffers are used in turn
+    for(unsigned i = 1; i <= header.num_buffers; ++i)
+    {
+        const unsigned buffer = (latest + i) % header.num_buffers;
+        if(int32_t(buffer) == latest)
+            continue;
+        int32_t expected = 0;
+        if(bufferHeader(buffer).state.compare_exchange_strong(expected, WRITING, std::memory_order_acquire))
+            return buffer;
+    }
+    throw std::runtime_error("All shared map buffers are held by subscribers");
+}
+
+char* SharedMapSegment::getBuffer(unsigned buffer)
+{
+    const ControlHeader& header = control();
+    return address + header.buffers_offset + buffer * header.buffer_size;
+}
+
+void SharedMapSegment::commitWrite(unsigned buffer, Format format, size_t size)
+{
+    ControlHeader& header = control();
+    BufferHeader& buffer_header = bufferHeader(buffer);
+    const uint64_t revision = header.revision.load(std::memory_order_relaxed) + 1;
+    buffer_header.format = format;
+    buffer_header.size = size;
+    buffer_header.revision = revision;
+    buffer_header.state.store(0, std::memory_order_release);
+    header.latest.store(buffer, std::memory_order_release);
+    header.revision.store(revision, std::memory_order_release);
+}
+
+void SharedMapSegment::abortWrite(unsigned buffer)
+{
+    bufferHeader(buffer).state.store(0, std::memory_order_release);
+}
+
+uint64_t SharedMapSegment::getRevision() const
+{
+    return control().revision.load(std::memory_order_acquire);
+}
+
+bool SharedMapSegment::acquireLatest(unsigned& buffer, Format& format, size_t& size, uint64_t& revision)
+{
+    const ControlHeader& header = control();
+    while(true)
+    {
+        const int32_t latest = header.latest.load(std::memory_order_acquire);
+        if(latest < 0)
+            return false;
+
+        // the buffer is rewritten if a newer map was published meanwhile, retry in that case
+        BufferHeader& buffer_header = bufferHeader(latest);
+        int32_t state = buffer_header.state.load(std::memory_order_relaxed);
+        if(state == WRITING || !buffer_header.state.compare_exchange_weak(state, state + 1, std::memory_order_acquire))
+            continue;
+
+        // The buffer may have been rewritten and the write aborted before it was acquired,
+        // it only holds the map described by its header while it is still the latest one.
+        if(header.latest.load(std::memory_order_acquire) != latest)
+        {
+            release(latest);
+            continue;
+        }
+
+        buffer = latest;
+        format = static_cast<Format>(buffer_header.format);
+        size = buffer_header.size;
+        revision = buffer_header.revision;
+        return true;
+    }
+}
+
+void SharedMapSegment::release(unsigned buffer)
+{
+    bufferHeader(buffer).state.fetch_sub(1, std::memory_order_release);
+}
+
+SharedMapSegment::ControlHeader& SharedMapSegment::control() const
+{
+    return *reinterpret_cast<ControlHeader*>(address);
+}
+
+SharedMapSegment::BufferHeader& SharedMapSegment::bufferHeader(unsigned buffer) const
+{
+    return reinterpret_cast<BufferHeader*>(address + sizeof(ControlHeader))[buffer];
+}
@@ -0,0 +1,284 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include <maps/grid/RawGridMap.hpp>
+#include <maps/grid/MemoryStreamBuffer.hpp>
+
+namespace maps { namespace grid
+{
+    /**
+     * @brief POSIX shared memory segment holding a ring of map buffers.
+     * @details
+     * The segment contains a small control header followed by a fixed number of
+     * equally sized buffers. Each buffer has a state which is either the number
+     * of readers currently holding it or WRITING while the publisher fills it.
+     * The publisher only writes to buffers without readers which are not the
+     * latest published one, so readers can use the memory of a buffer without
+     * copying it for as long as they hold it.
+     *
+     * All synchronization is done with lock-free atomics inside of the segment,
+     * so it works across processes.
+     */
+    class SharedMapSegment
+    {
+    public:
+        /** Content types of a buffer */
+        enum Format
+        {
+            RAW_GRID_MAP = 1,
+            BINARY_ARCHIVE = 2
+        };
+
+        ~SharedMapSegment();
+
+        /**
+         * Creates a new segment, an existing segment with the same name is replaced.
+         * The segment is removed when the returned object is destroyed.
+         * @param buffer_size capacity of each buffer, rounded up to the page size
+         * @param num_buffers at least 2, more buffers allow readers to hold maps longer
+         */
+        static boost::shared_ptr<SharedMapSegment> create(const std::string& name, size_t buffer_size, unsigned num_buffers = 3);
+
+        /** Opens an existing segment, throws std::runtime_error if it doesn't exist */
+        static boost::shared_ptr<SharedMapSegment> open(const std::string& name);
+
+        size_t getBufferSize() const;
+        unsigned getNumBuffers() const;
+
+        /**
+         * Reserves a buffer for writing.
+         * Throws std::runtime_error if all buffers are held by readers.
+         */
+        unsigned beginWrite();
+
+        /** Returns the memory of a buffer, it is aligned to the page size */
+        char* getBuffer(unsigned buffer);
+
+        /** Publishes a buffer reserved by beginWrite() as the latest map */
+        void commitWrite(unsigned buffer, Format format, size_t size);
+
+        /** Releases a buffer reserved by beginWrite() without publishing it */
+        void abortWrite(unsigned buffer);
+
+        /** Returns the number of published maps */
+        uint64_t getRevision() const;
+
+        /**
+         * Acquires the latest published buffer for reading.
+         * Returns false if no map has been published yet.
+         */
+        bool acquireLatest(unsigned& buffer, Format& format, size_t& size, uint64_t& revision);
+
+        /** Releases a buffer acquired by acquireLatest() */
+        void release(unsigned buffer);
+
+    private:
+        struct ControlHeader;
+        struct BufferHeader;
+
+        SharedMapSegment(const std::string& name, int fd, size_t size, bool owner);
+        SharedMapSegment(const SharedMapSegment&);
+        SharedMapSegment& operator=(const SharedMapSegment&);
+
+        ControlHeader& control() const;
+        BufferHeader& bufferHeader(unsigned buffer) const;
+
+        std::string name;
+        char* address;
+        size_t length;
+        bool owner;
+    };
+
+    /**
+     * @brief Publishes maps to a shared memory segment.
+     * @details
+     * Grid maps of trivially copyable cells are written in the raw grid map format,
+     * subscribers can use them without copying. Other maps, e.g. MLSMap, are written
+     * as binary archive and are deserialized by the subscribers directly from the
+     * shared memory.
+     */
+    class SharedMapPublisher
+    {
+    public:
+        /** Creates the segment @p name, see SharedMapSegment::create() */
+        SharedMapPublisher(const std::string& name, size_t buffer_size, unsigned num_buffers = 3)
+            : segment(SharedMapSegment::create(name, buffer_size, num_buffers))
+        {
+        }
+
+        template <typename CellT, typename GridT>
+        void publish(const GridMap<CellT, GridT>& map)
+        {
+            static_assert(std::is_trivially_copyable<CellT>::value, "The raw grid map format requires trivially copyable cells");
+
+            const RawGridHeader header = createRawGridHeader(map, map.getResolution(), map.getNumCells(), sizeof(CellT), alignof(CellT));
+            if(header.data_offset + header.data_size > segment->getBufferSize())
+                throw std::runtime_error("Grid map does not fit into the shared memory buffer");
+
+            const unsigned buffer = segment->beginWrite();
+            char* data = segment->getBuffer(buffer);
+            const CellT default_value = map.getDefaultValue();
+            writeRawGridHeader(data, header, map, &default_value);
+            std::copy(map.begin(), map.end(), reinterpret_cast<CellT*>(data + header.data_offset));
+            segment->commitWrite(buffer, SharedMapSegment::RAW_GRID_MAP, header.data_offset + header.data_size);
+        }
+
+        template <typename MapT>
+        void publishSerialized(const MapT& map)
+        {
+            const unsigned buffer = segment->beginWrite();
+            MemoryStreamBuffer stream(segment->getBuffer(buffer), segment->getBufferSize());
+            try
+            {
+                boost::archive::binary_oarchive oa(stream);
+                oa << map;
+            }
+            catch(const boost::archive::archive_exception& e)
+            {
+                segment->abortWrite(buffer);
+                // the stream buffer fails on writes beyond its end
+                if(e.code == boost::archive::archive_exception::output_stream_error)
+                    throw std::runtime_error("Map does not fit into the shared memory buffer");
+                throw;
+            }
+            catch(...)
+            {
+                segment->abortWrite(buffer);
+                throw;
+            }
+            segment->commitWrite(buffer, SharedMapSegment::BINARY_ARCHIVE, stream.getWrittenSize());
+        }
+
+        uint64_t getRevision() const
+        {
+            return segment->getRevision();
+        }
+
+    private:
+        boost::shared_ptr<SharedMapSegment> segment;
+    };
+
+    /**
+     * @brief Reads maps published by a SharedMapPublisher, possibly in another process.
+     */
+    class SharedMapSubscriber
+    {
+    public:
+        /** Opens the segment @p name, throws std::runtime_error if it doesn't exist */
+        explicit SharedMapSubscriber(const std::string& name)
+            : segment(SharedMapSegment::open(name))
+        {
+        }
+
+        /** Returns the number of maps published so far, can be used to poll for updates */
+        uint64_t getRevision() const
+        {
+            return segment->getRevision();
+        }
+
+        /**
+         * @brief Returns a read-only view on the latest published grid map.
+         * @details
+         * The cells are not copied. The buffer is held until the returned map and all
+         * copies of it are destroyed, the publisher writes new maps to other buffers
+         * in the meantime. Returns an empty pointer if no map has been published yet.
+         */
+        template <typename CellT>
+        boost::shared_ptr<const GridMap<CellT, MappedGrid<CellT> > > getGridMap(uint64_t* revision = 0)
+        {
+            unsigned buffer;
+            SharedMapSegment::Format format;
+            size_t size;
+            uint64_t buffer_revision;
+            if(!segment->acquireLatest(buffer, format, size, buffer_revision))
+                return boost::shared_ptr<const GridMap<CellT, MappedGrid<CellT> > >();
+
+            // releases the buffer with the last copy of the map
+            boost::shared_ptr<void> hold(segment->getBuffer(buffer), BufferRelease(segment, buffer));
+            if(format != SharedMapSegment::RAW_GRID_MAP)
+                throw std::runtime_error("Latest shared map is not a raw grid map");
+            if(revision)
+                *revision = buffer_revision;
+            return boost::shared_ptr<const GridMap<CellT, MappedGrid<CellT> > >(
+                new GridMap<CellT, MappedGrid<CellT> >(makeRawGridMapView<CellT>(hold, segment->getBuffer(buffer), size)));
+        }
+
+        /**
+         * @brief Deserializes the latest map published with publishSerialized().
+         * Returns false if no map has been published yet.
+         */
+        template <typename MapT>
+        bool readSerialized(MapT& map, uint64_t* revision = 0)
+        {
+            unsigned buffer;
+            SharedMapSegment::Format format;
+            size_t size;
+            uint64_t buffer_revision;
+            if(!segment->acquireLatest(buffer, format, size, buffer_revision))
+                return false;
+
+            boost::shared_ptr<void> hold(segment->getBuffer(buffer), BufferRelease(segment, buffer));
+            if(format != SharedMapSegment::BINARY_ARCHIVE)
+                throw std::runtime_error("Latest shared map is not a binary archive");
+
+            MemoryStreamBuffer stream(segment->getBuffer(buffer), size);
+            boost::archive::binary_iarchive ia(stream);
+            ia >> map;
+            if(revision)
+                *revision = buffer_revision;
+            return true;
+        }
+
+    private:
+        struct BufferRelease
+        {
+            boost::shared_ptr<SharedMapSegment> segment;
+            unsigned buffer;
+
+            BufferRelease(const boost::shared_ptr<SharedMapSegment>& segment, unsigned buffer)
+                : segment(segment), buffer(buffer)
+            {
+            }
+
+            void operator()(void*)
+            {
+                segment->release(buffer);
+            }
+        };
+
+        boost::shared_ptr<SharedMapSegment> segment;
+    };
+}}
@@ -100,6 +100,7 @@ void TSDFVolumetricMap::mergePoint(const Eigen::Vector3d& sensor_origin, const E
                 Eigen::Vector3d cell_center;
                 if(GridMapBase::fromGrid(element.idx, cell_center))
                 {
+                    markModified(element.idx);
                     if(element.z_first == element.z_last)
                     {
                         cell_center.z() = tree.getCellCenter(element.z_first);
@@ -154,7 +155,25 @@ bool TSDFVolumetricMap::hasSameFrame(const base::Transform3d& local_frame, const
      return false;
 }
 
-float TSDFVolumetricMap::getTruncation()
+Vector2ui TSDFVolumetricMap::getNumBlocks() const
+{
+    return (getNumCells().array() + (BLOCK_SIZE - 1)) / BLOCK_SIZE;
+}
+
+uint64_t TSDFVolumetricMap::getBlockStamp(const Index& block) const
+{
+    // without tracking (e.g. if it was disabled) every block counts as modified
+    if(change_tracker.getTileSize() != BLOCK_SIZE || change_tracker.getNumCells() != getNumCells())
+        return change_tracker.getVersion() + 1;
+    return change_tracker.getStamp(block);
+}
+
+uint64_t TSDFVolumetricMap::getModificationStamp() const
+{
+    return change_tracker.getVersion();
+}
+
+float TSDFVolumetricMap::getTruncation() const
 {
     return truncation;
 }
@@ -164,7 +183,7 @@ void TSDFVolumetricMap::setTruncation(float truncation)
     this->truncation = truncation;
 }
 
-float TSDFVolumetricMap::getMinVariance()
+float TSDFVolumetricMap::getMinVariance() const
 {
     return min_variance;
 }
@@ -51,11 +51,21 @@ public:
     typedef VoxelGridMap<VoxelCellType> VoxelGridBase;
     typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
 
+    /** Number of cells along x and y which are grouped to one block to track modifications,
+     *  this is the tile size of the change tracking of the map */
+    static const unsigned BLOCK_SIZE = 16;
+
     TSDFVolumetricMap(): VoxelGridMap<VoxelCellType>(Vector2ui::Zero(), Vector3d::Ones()),
-                         truncation(1.f), min_variance(0.001f) {}
+                         truncation(1.f), min_variance(0.001f)
+    {
+        enableChangeTracking(BLOCK_SIZE);
+    }
 
     TSDFVolumetricMap(const Vector2ui &num_cells, const Vector3d &resolution, float truncation = 1.f, float min_varaince = 0.001f) :
-                    VoxelGridMap<VoxelCellType>(num_cells, resolution), truncation(truncation), min_variance(min_varaince) {}
+                    VoxelGridMap<VoxelCellType>(num_cells, resolution), truncation(truncation), min_variance(min_varaince)
+    {
+        enableChangeTracking(BLOCK_SIZE);
+    }
     virtual ~TSDFVolumetricMap() {}
 
     void mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2grid, double measurement_variance = 0.01);
@@ -77,11 +87,28 @@ public:
 
     void setTruncation(float truncation);
 
-    float getTruncation();
+    float getTruncation() const;
 
     void setMinVariance(float min_varaince);
 
-    float getMinVariance();
+    float getMinVariance() const;
+
+    /**
+     * Returns the number of blocks of the change tracking.
+     * All update methods of this class mark the modified blocks, cells which are changed
+     * directly have to be reported with GridMap::markModified.
+     */
+    Vector2ui getNumBlocks() const;
+
+    /**
+     * Returns the modification stamp of the given block.
+     * A block has been modified after a point in time if its stamp is greater than
+     * the value returned by getModificationStamp() at that time.
+     */
+    uint64_t getBlockStamp(const Index& block) const;
+
+    /** Returns the stamp of the latest modification */
+    uint64_t getModificationStamp() const;
 
 protected:
 
@@ -156,6 +183,7 @@ void TSDFVolumetricMap::projectMLSMap(const maps::grid::MLSMap<SurfaceType>& mls
                         float distance = diff.norm();
                         if(distance < truncation)
                         {
+                            markModified(idx.head<2>());
                             VoxelCellType& cell = getVoxelCell(idx);
                             cell.update(std::copysign(distance, diff.z()), variance, truncation, min_variance);
                         }
@@ -0,0 +1,576 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <string>
+#include <list>
+#include <deque>
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include <base-logging/Logging.hpp>
+
+#include <maps/grid/VectorGrid.hpp>
+
+namespace maps { namespace grid
+{
+    struct TiledGridConfig
+    {
+        TiledGridConfig()
+            : tile_size(256),
+              memory_budget(256 << 20)
+        {}
+
+        /** number of cells per tile in x and y */
+        unsigned tile_size;
+
+        /**
+         * maximum memory used by the cached tiles in bytes, estimated with
+         * sizeof(CellT) per cell. At least two tiles are always kept in memory.
+         */
+        size_t memory_budget;
+    };
+
+    /**
+     * @brief Disk backed grid storage, which keeps only a part of the grid in memory.
+     * @details
+     * The grid is split into square tiles, which are stored as boost binary archives
+     * in a directory. Tiles are loaded on access and kept in an LRU cache limited by
+     * TiledGridConfig::memory_budget. Evicted tiles that were accessed non-const are
+     * written back by a background thread.
+     *
+     * setWindow() prefetches the tiles around a robot in the background and evicts
+     * the tiles outside of the window.
+     *
+     * Can be used as storage type of GridMap, i.e. GridMap<CellT, TiledGrid<CellT> >.
+     * Copies of a TiledGrid share the same tiles.
+     *
+     * @note References returned by at() are only valid until the next call of at()
+     * with an index in a different tile. Access is not thread-safe.
+     */
+    template <typename CellT>
+    class TiledGrid
+    {
+        class Store;
+
+        boost::shared_ptr<Store> store;
+
+        /** Number of cells in X-axis and Y-axis **/
+        Vector2ui num_cells;
+
+    public:
+        typedef CellT CellType;
+
+        TiledGrid()
+            : num_cells(0, 0)
+        {
+        }
+
+        /**
+         * @brief Creates a new tiled grid in @p directory.
+         * Existing tiles in the directory are removed.
+         */
+        TiledGrid(const std::string& directory, const Vector2ui& num_cells, const CellT& default_value,
+                  const TiledGridConfig& config = TiledGridConfig())
+            : store(new Store(directory, num_cells, default_value, config)),
+              num_cells(num_cells)
+        {
+            store->clear();
+            store->writeInfo();
+        }
+
+        /**
+         * @brief Opens a tiled grid which was created in @p directory before.
+         * The tile size is read from the directory, only the memory budget of
+         * @p config is used.
+         */
+        explicit TiledGrid(const std::string& directory, const TiledGridConfig& config = TiledGridConfig())
+            : store(Store::open(directory, config))
+        {
+            num_cells = store->getNumCells();
+        }
+
+        const CellT &getDefaultValue() const
+        {
+            return store->getDefaultValue();
+        }
+
+        const Vector2ui &getNumCells() const
+        {
+            return num_cells;
+        }
+
+        const CellT& at(const Index &idx) const
+        {
+            return this->at(idx.x(), idx.y());
+        }
+
+        CellT& at(const Index &idx)
+        {
+            return this->at(idx.x(), idx.y());
+        }
+
+        const CellT& at(size_t x, size_t y) const
+        {
+            if(x >= num_cells.x() || y >= num_cells.y())
+                throw std::runtime_error("Provided index is out of the grid");
+            return store->at(x, y, false);
+        }
+
+        CellT& at(size_t x, size_t y)
+        {
+            if(x >= num_cells.x() || y >= num_cells.y())
+                throw std::runtime_error("Provided index is out of the grid");
+            return store->at(x, y, true);
+        }
+
+        void resize(const Vector2ui &new_number_cells)
+        {
+            if(new_number_cells != num_cells)
+                throw std::runtime_error("A tiled grid can not be resized");
+        }
+
+        void moveBy(const Index &idx)
+        {
+            throw std::runtime_error("A tiled grid can not be moved");
+        }
+
+        /** Resets all cells to the default value and removes all tiles from the disk */
+        void clear()
+        {
+            store->clear();
+        }
+
+        /** Writes all modified tiles to the disk and waits until they are written */
+        void flush()
+        {
+            store->flush();
+        }
+
+        /**
+         * @brief Sets the region of the grid which is currently in use.
+         * @details
+         * All tiles within @p radius cells around @p center, and around
+         * center + lookahead, are prefetched in the background. Cached tiles
+         * outside of this region are evicted.
+         */
+        void setWindow(const Index& center, unsigned radius, const Index& lookahead = Index(0, 0))
+        {
+            Index lower = center.cwiseMin(center + lookahead);
+            Index upper = center.cwiseMax(center + lookahead);
+            lower.array() -= radius;
+            upper.array() += radius;
+            store->setWindow(lower, upper);
+        }
+
+        unsigned getTileSize() const
+        {
+            return store->getTileSize();
+        }
+
+        /** Returns the number of tiles currently held in the cache */
+        size_t getNumCachedTiles() const
+        {
+            return store->getNumCachedTiles();
+        }
+
+    private:
+        /** Tile cache and background writer shared by all copies of a TiledGrid */
+        class Store
+        {
+            typedef VectorGrid<CellT> Tile;
+            typedef boost::shared_ptr<Tile> TilePtr;
+            typedef uint64_t TileKey;
+
+            struct CachedTile
+            {
+                TilePtr cells;
+                bool dirty;
+                typename std::list<TileKey>::iterator lru_position;
+            };
+
+            enum TaskType { WRITE, PREFETCH };
+
+            struct Task
+            {
+                TaskType type;
+                TileKey key;
+            };
+
+        public:
+            Store(const std::string& directory, const Vector2ui& num_cells, const CellT& default_value, const TiledGridConfig& config)
+                : directory(directory),
+                  num_cells(num_cells),
+                  default_value(default_value),
+                  tile_size(config.tile_size),
+                  last_tile(nullptr),
+                  stop(false),
+                  busy(false)
+            {
+                if(tile_size == 0)
+                    throw std::runtime_error("The tile size of a tiled grid must be positive");
+                max_tiles = std::max<size_t>(2, config.memory_budget / (size_t(tile_size) * tile_size * sizeof(CellT)));
+                boost::filesystem::create_directories(directory);
+                worker = std::thread(&Store::run, this);
+            }
+
+            ~Store()
+            {
+                try
+                {
+                    flush();
+                }
+                catch(const std::exception& e)
+                {
+                    LOG_ERROR_S << "Failed to write tiles: " << e.what();
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stop = true;
+                }
+                task_condition.notify_all();
+                worker.join();
+            }
+
+            static Store* open(const std::string& directory, const TiledGridConfig& config)
+            {
+                std::ifstream stream(infoFile(directory).c_str(), std::ios::binary);
+                if(!stream)
+                    throw std::runtime_error("No tiled grid found in " + directory);
+                boost::archive::binary_iarchive ia(stream);
+                Vector2ui num_cells;
+                CellT default_value;
+                TiledGridConfig stored_config = config;
+                ia >> num_cells.derived();
+                ia >> stored_config.tile_size;
+                ia >> default_value;
+                return new Store(directory, num_cells, default_value, stored_config);
+            }
+
+            void writeInfo() const
+            {
+                std::ofstream stream(infoFile(directory).c_str(), std::ios::binary | std::ios::trunc);
+                boost::archive::binary_oarchive oa(stream);
+                oa << num_cells.derived();
+                oa << tile_size;
+                oa << default_value;
+            }
+
+            const Vector2ui& getNumCells() const { return num_cells; }
+            const CellT& getDefaultValue() const { return default_value; }
+            unsigned getTileSize() const { return tile_size; }
+            size_t getNumCachedTiles() const { return cache.size(); }
+
+            CellT& at(size_t x, size_t y, bool modify)
+            {
+                const TileKey key = toKey(x / tile_size, y / tile_size);
+                CachedTile* tile = (last_tile && key == last_key) ? last_tile : fetch(key);
+                tile->dirty |= modify;
+                return tile->cells->at(x % tile_size, y % tile_size);
+            }
+
+            void flush()
+            {
+                for(typename std::unordered_map<TileKey, CachedTile>::iterator it = cache.begin(); it != cache.end(); ++it)
+                {
+                    if(!it->second.dirty)
+                        continue;
+                    // the cached tile may be modified while it is written, so write a copy
+                    queueWrite(it->first, TilePtr(new Tile(*it->second.cells)));
+                    it->second.dirty = false;
+                }
+                waitIdle();
+            }
+
+            void clear()
+            {
+                waitIdle();
+                cache.clear();
+                lru.clear();
+                last_tile = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    prefetched.clear();
+                    prefetch_requested.clear();
+                }
+                boost::filesystem::directory_iterator end;
+                for(boost::filesystem::directory_iterator it(directory); it != end; ++it)
+                {
+                    if(it->path().filename().string().compare(0, 5, "tile_") == 0)
+                        boost::filesystem::remove(it->path());
+                }
+            }
+
+            void setWindow(const Index& lower, const Index& upper)
+            {
+                const int tiles_x = (num_cells.x() + tile_size - 1) / tile_size;
+                const int tiles_y = (num_cells.y() + tile_size - 1) / tile_size;
+                const Index tile_min = Index(floorDiv(lower.x()), floorDiv(lower.y())).cwiseMax(Index(0, 0));
+                const Index tile_max = Index(floorDiv(upper.x()), floorDiv(upper.y())).cwiseMin(Index(tiles_x - 1, tiles_y - 1));
+
+                std::set<TileKey> window;
+                for(int ty = tile_min.y(); ty <= tile_max.y(); ++ty)
+                    for(int tx = tile_min.x(); tx <= tile_max.x(); ++tx)
+                        window.insert(toKey(tx, ty));
+
+                // evict everything behind the window
+                for(typename std::list<TileKey>::iterator it = lru.begin(); it != lru.end();)
+                {
+                    const TileKey key = *it++;
+                    if(!window.count(key))
+                        evict(key);
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                for(typename std::map<TileKey, TilePtr>::iterator it = prefetched.begin(); it != prefetched.end();)
+                {
+                    if(window.count(it->first))
+                        ++it;
+                    else
+                        prefetched.erase(it++);
+                }
+                for(std::set<TileKey>::const_iterator it = window.begin(); it != window.end(); ++it)
+                {
+                    if(cache.count(*it) || prefetched.count(*it) || prefetch_requested.count(*it))
+                        continue;
+                    prefetch_requested.insert(*it);
+                    tasks.push_back(Task{PREFETCH, *it});
+                }
+                task_condition.notify_all();
+            }
+
+        private:
+            static std::string infoFile(const std::string& directory)
+            {
+                return (boost::filesystem::path(directory) / "tiled_grid.info").string();
+            }
+
+            std::string tileFile(TileKey key) const
+            {
+                std::stringstream name;
+                name << "tile_" << (key >> 32) << "_" << (key & 0xFFFFFFFF) << ".bin";
+                return (boost::filesystem::path(directory) / name.str()).string();
+            }
+
+            static TileKey toKey(uint64_t tx, uint64_t ty)
+            {
+                return (tx << 32) | ty;
+            }
+
+            int floorDiv(int value) const
+            {
+                return value >= 0 ? value / int(tile_size) : -((-value + int(tile_size) - 1) / int(tile_size));
+            }
+
+            CachedTile* fetch(TileKey key)
+            {
+                typename std::unordered_map<TileKey, CachedTile>::iterator it = cache.find(key);
+                if(it != cache.end())
+                    lru.splice(lru.begin(), lru, it->second.lru_position);
+                else
+                {
+                    TilePtr cells = load(key);
+                    lru.push_front(key);
+                    CachedTile tile = {cells, false, lru.begin()};
+                    it = cache.insert(std::make_pair(key, tile)).first;
+                    while(cache.size() > max_tiles)
+                        evict(lru.back());
+                }
+                last_key = key;
+                last_tile = &it->second;
+                return last_tile;
+            }
+
+            void evict(TileKey key)
+            {
+                typename std::unordered_map<TileKey, CachedTile>::iterator it = cache.find(key);
+                if(it->second.dirty)
+                    queueWrite(key, it->second.cells);
+                lru.erase(it->second.lru_position);
+                cache.erase(it);
+                if(key == last_key)
+                    last_tile = nullptr;
+            }
+
+            TilePtr load(TileKey key)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    // a pending prefetch might read an outdated version of the tile later on
+                    prefetch_requested.erase(key);
+                    typename std::map<TileKey, TilePtr>::iterator prefetched_it = prefetched.find(key);
+                    if(prefetched_it != prefetched.end())
+                    {
+                        TilePtr cells = prefetched_it->second;
+                        prefetched.erase(prefetched_it);
+                        return cells;
+                    }
+                    typename std::map<TileKey, TilePtr>::iterator pending_it = pending_writes.find(key);
+                    if(pending_it != pending_writes.end())
+                        return TilePtr(new Tile(*pending_it->second));
+                }
+                return readTile(key);
+            }
+
+            TilePtr readTile(TileKey key) const
+            {
+                TilePtr cells(new Tile(Vector2ui(tile_size, tile_size), default_value));
+                std::ifstream stream(tileFile(key).c_str(), std::ios::binary);
+                if(stream)
+                {
+                    boost::archive::binary_iarchive ia(stream);
+                    ia >> *cells;
+                }
+                return cells;
+            }
+
+            void writeTile(TileKey key, const Tile& cells) const
+            {
+                // write to a temporary file first, so readers never see a partial tile
+                const std::string filename = tileFile(key);
+                {
+                    std::ofstream stream((filename + ".tmp").c_str(), std::ios::binary | std::ios::trunc);
+                    boost::archive::binary_oarchive oa(stream);
+                    oa << cells;
+                }
+                boost::filesystem::rename(filename + ".tmp", filename);
+            }
+
+            void queueWrite(TileKey key, const TilePtr& cells)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    pending_writes[key] = cells;
+                    tasks.push_back(Task{WRITE, key});
+                }
+                task_condition.notify_all();
+            }
+
+            void waitIdle()
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                idle_condition.wait(lock, [this]{ return tasks.empty() && !busy; });
+            }
+
+            /** background thread writing and prefetching tiles */
+            void run()
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while(true)
+                {
+                    task_condition.wait(lock, [this]{ return stop || !tasks.empty(); });
+                    if(tasks.empty())
+                        return;
+
+                    const Task task = tasks.front();
+                    tasks.pop_front();
+                    busy = true;
+                    try
+                    {
+                        if(task.type == WRITE)
+                            runWrite(task.key, lock);
+                        else
+                            runPrefetch(task.key, lock);
+                    }
+                    catch(const std::exception& e)
+                    {
+                        LOG_ERROR_S << "Tiled grid: " << e.what();
+                    }
+                    busy = false;
+                    if(tasks.empty())
+                        idle_condition.notify_all();
+                }
+            }
+
+            void runWrite(TileKey key, std::unique_lock<std::mutex>& lock)
+            {
+                typename std::map<TileKey, TilePtr>::iterator it = pending_writes.find(key);
+                if(it == pending_writes.end())
+                    return;
+                // a later write of the same tile may replace the pending data meanwhile
+                TilePtr cells = it->second;
+                lock.unlock();
+                writeTile(key, *cells);
+                lock.lock();
+                it = pending_writes.find(key);
+                if(it != pending_writes.end() && it->second == cells)
+                    pending_writes.erase(it);
+            }
+
+            void runPrefetch(TileKey key, std::unique_lock<std::mutex>& lock)
+            {
+                if(!prefetch_requested.count(key) || pending_writes.count(key))
+                {
+                    prefetch_requested.erase(key);
+                    return;
+                }
+                lock.unlock();
+                TilePtr cells = readTile(key);
+                lock.lock();
+                // the tile was loaded directly in the meantime
+                if(prefetch_requested.erase(key))
+                    prefetched[key] = cells;
+            }
+
+            std::string directory;
+            Vector2ui num_cells;
+            CellT default_value;
+            unsigned tile_size;
+            size_t max_tiles;
+
+            /** cache, only accessed by the user of the grid */
+            std::unordered_map<TileKey, CachedTile> cache;
+            std::list<TileKey> lru;
+            TileKey last_key;
+            CachedTile* last_tile;
+
+            /** state shared with the background thread, protected by mutex */
+            std::mutex mutex;
+            std::condition_variable task_condition;
+            std::condition_variable idle_condition;
+            std::deque<Task> tasks;
+            std::map<TileKey, TilePtr> pending_writes;
+            std::map<TileKey, TilePtr> prefetched;
+            std::set<TileKey> prefetch_requested;
+            bool stop;
+            bool busy;
+            std::thread worker;
+        };
+    };
+}}
@@ -0,0 +1,313 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <stdint.h>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/impl/archive_serializer_map.ipp>
+#include <boost/archive/impl/basic_binary_oarchive.ipp>
+#include <boost/archive/impl/basic_binary_oprimitive.ipp>
+#include <boost/serialization/vector.hpp>
+#include <boost_serialization/DynamicSizeSerialization.hpp>
+
+#include <maps/grid/VectorGrid.hpp>
+#include <maps/grid/MemoryStreamBuffer.hpp>
+
+namespace maps { namespace grid
+{
+    /** Identifies streams written by saveTiled */
+    const uint32_t TILED_MAP_MAGIC = 0x4C54504D;
+    const uint32_t TILED_MAP_VERSION = 1;
+
+    namespace detail
+    {
+        /**
+         * Binary archive which saves the map without the cells of its VectorGrid.
+         * The output can be read with a boost::archive::binary_iarchive.
+         */
+        class MapHeaderOArchive
+            : public boost::archive::binary_oarchive_impl<MapHeaderOArchive, std::ostream::char_type, std::ostream::traits_type>
+            , public SkipGridCells
+        {
+        public:
+            explicit MapHeaderOArchive(std::ostream& stream)
+                : boost::archive::binary_oarchive_impl<MapHeaderOArchive, std::ostream::char_type, std::ostream::traits_type>(stream, 0)
+            {
+                init(0);
+            }
+        };
+
+        /** Number of tiles needed to cover @p num_cells */
+        inline Vector2ui getNumTiles(const Vector2ui& num_cells, unsigned tile_size)
+        {
+            return Vector2ui((num_cells.x() + tile_size - 1) / tile_size, (num_cells.y() + tile_size - 1) / tile_size);
+        }
+
+        /** Cell range [begin, end) of tile number @p tile */
+        inline void getTileRange(size_t tile, const Vector2ui& num_cells, unsigned tile_size, Index& begin, Index& end)
+        {
+            const Vector2ui num_tiles = getNumTiles(num_cells, tile_size);
+            begin = Index((tile % num_tiles.x()) * tile_size, (tile / num_tiles.x()) * tile_size);
+            end = (begin.array() + int(tile_size)).matrix().cwiseMin(num_cells.cast<int>());
+        }
+
+        /**
+         * Serializes the cells of a tile to an independent archive. Blocks of default
+         * and non-default cells are run length encoded like in VectorGrid::save.
+         */
+        template <class CellT>
+        std::string saveTile(const VectorGrid<CellT>& grid, const Index& begin, const Index& end)
+        {
+            std::ostringstream stream;
+            boost::archive::binary_oarchive oa(stream, boost::archive::no_header);
+            const CellT& default_value = grid.getDefaultValue();
+            const size_t width = end.x() - begin.x();
+            const size_t size = width * (end.y() - begin.y());
+            size_t i = 0;
+            while(i < size)
+            {
+                const bool occupied = grid.at(begin.x() + i % width, begin.y() + i / width) != default_value;
+                size_t block_end = i + 1;
+                while(block_end < size && (grid.at(begin.x() + block_end % width, begin.y() + block_end / width) != default_value) == occupied)
+                    ++block_end;
+
+                oa << occupied;
+                saveSizeValue(oa, uint64_t(block_end - i));
+                if(occupied)
+                {
+                    for(; i < block_end; ++i)
+                        oa << grid.at(begin.x() + i % width, begin.y() + i / width);
+                }
+                i = block_end;
+            }
+            return stream.str();
+        }
+
+        /** Restarts an enabled change tracking for the cells swapped into @p map by loadTiled */
+        template <class MapT>
+        auto restartChangeTracking(MapT& map, int) -> decltype(map.enableChangeTracking(0u), void())
+        {
+            if(map.hasChangeTracking())
+                map.enableChangeTracking(map.getChangeTracker().getTileSize());
+        }
+
+        template <class MapT>
+        void restartChangeTracking(MapT&, long)
+        {
+        }
+
+        /** Rebuilds an existing height pyramid of @p map after loadTiled decoded the cells */
+        template <class MapT>
+        auto rebuildHeightPyramid(MapT& map, int) -> decltype(map.buildHeightPyramid(), void())
+        {
+            if(map.hasHeightPyramid())
+                map.buildHeightPyramid();
+        }
+
+        template <class MapT>
+        void rebuildHeightPyramid(MapT&, long)
+        {
+        }
+
+        /** Deserializes a tile written by saveTile into the cells of @p grid */
+        template <class CellT>
+        void loadTile(char* data, size_t data_size, VectorGrid<CellT>& grid, const Index& begin, const Index& end)
+        {
+            MemoryStreamBuffer buffer(data, data_size);
+            boost::archive::binary_iarchive ia(buffer, boost::archive::no_header);
+            const size_t width = end.x() - begin.x();
+            const size_t size = width * (end.y() - begin.y());
+            size_t i = 0;
+            while(i < size)
+            {
+                bool occupied;
+                uint64_t block_size;
+                ia >> occupied;
+                loadSizeValue(ia, block_size);
+                if(block_size == 0 || i + block_size > size)
+                    throw std::runtime_error("Corrupted tile in tiled map stream");
+
+                const size_t block_end = i + block_size;
+                if(occupied)
+                {
+                    for(; i < block_end; ++i)
+                        ia >> grid.at(begin.x() + i % width, begin.y() + i / width);
+                }
+                i = block_end;
+            }
+        }
+    }
+
+    /**
+     * @brief Serializes @p map in independently encoded tiles of @p tile_size x @p tile_size cells.
+     * @details
+     * The stream starts with a seek table of the tile sizes, followed by the map without its cells
+     * as boost binary archive and the tiles. The tiles are encoded in parallel using OpenMP,
+     * which makes saving large maps scale with the number of cores. Any map with a VectorGrid
+     * storage can be saved, e.g. MLSMap, OccupancyGridMap or TraversabilityGrid.
+     */
+    template <class MapT>
+    void saveTiled(const MapT& map, std::ostream& stream, unsigned tile_size = 128)
+    {
+        typedef VectorGrid<typename MapT::CellType> GridType;
+        if(tile_size == 0)
+            throw std::runtime_error("The tile size has to be positive");
+
+        const Vector2ui num_cells = map.getNumCells();
+        const Vector2ui num_tiles = detail::getNumTiles(num_cells, tile_size);
+        std::vector<std::string> tiles(num_tiles.prod());
+        const GridType& grid = map;
+        std::string error;
+
+        #pragma omp parallel for schedule(dynamic)
+        for(int i = 0; i < int(tiles.size()); ++i)
+        {
+            try
+            {
+                Index begin, end;
+                detail::getTileRange(i, num_cells, tile_size, begin, end);
+                tiles[i] = detail::saveTile(grid, begin, end);
+            }
+            catch(const std::exception& e)
+            {
+                #pragma omp critical
+                error = e.what();
+            }
+        }
+        if(!error.empty())
+            throw std::runtime_error(error);
+
+        // serialize the map without its cells
+        std::ostringstream map_stream;
+        {
+            detail::MapHeaderOArchive oa(map_stream);
+            oa << map;
+        }
+        const std::string map_data = map_stream.str();
+
+        std::vector<uint64_t> tile_sizes(tiles.size());
+        for(size_t i = 0; i < tiles.size(); ++i)
+            tile_sizes[i] = tiles[i].size();
+
+        {
+            boost::archive::binary_oarchive oa(stream, boost::archive::no_header);
+            oa << TILED_MAP_MAGIC << TILED_MAP_VERSION;
+            oa << num_cells.derived() << tile_size;
+            oa << uint64_t(map_data.size()) << tile_sizes;
+        }
+        stream.write(map_data.data(), map_data.size());
+        for(size_t i = 0; i < tiles.size(); ++i)
+            stream.write(tiles[i].data(), tiles[i].size());
+        if(!stream)
+            throw std::runtime_error("Failed to write tiled map");
+    }
+
+    /**
+     * @brief Deserializes a map written by saveTiled.
+     * @details
+     * The stream content is read at once, afterwards the tiles are decoded in parallel.
+     * As for the boost serialization of the map, an enabled change tracking is restarted
+     * and an existing height pyramid of a MultiLevelGridMap is rebuilt for the loaded cells.
+     */
+    template <class MapT>
+    void loadTiled(std::istream& stream, MapT& map)
+    {
+        typedef VectorGrid<typename MapT::CellType> GridType;
+
+        uint32_t magic, format_version;
+        Vector2ui num_cells;
+        unsigned tile_size;
+        uint64_t map_size;
+        std::vector<uint64_t> tile_sizes;
+        {
+            boost::archive::binary_iarchive ia(stream, boost::archive::no_header);
+            ia >> magic >> format_version;
+            if(magic != TILED_MAP_MAGIC || format_version != TILED_MAP_VERSION)
+                throw std::runtime_error("Stream does not contain a tiled map");
+            ia >> num_cells.derived() >> tile_size;
+            ia >> map_size >> tile_sizes;
+        }
+        if(tile_size == 0 || tile_sizes.size() != size_t(detail::getNumTiles(num_cells, tile_size).prod()))
+            throw std::runtime_error("Invalid seek table in tiled map stream");
+
+        // offsets of the tiles in the data
+        std::vector<uint64_t> tile_offsets(tile_sizes.size());
+        uint64_t data_size = map_size;
+        for(size_t i = 0; i < tile_sizes.size(); ++i)
+        {
+            tile_offsets[i] = data_size;
+            data_size += tile_sizes[i];
+        }
+        std::vector<char> data(data_size);
+        stream.read(data.data(), data.size());
+        if(stream.gcount() != std::streamsize(data.size()))
+            throw std::runtime_error("Unexpected end of tiled map stream");
+
+        {
+            MemoryStreamBuffer buffer(data.data(), map_size);
+            boost::archive::binary_iarchive ia(buffer);
+            ia >> map;
+        }
+        // the map was loaded without cells, so its change tracking is restarted for the real size
+        GridType cells(num_cells, map.getDefaultValue());
+        static_cast<GridType&>(map).swap(cells);
+        detail::restartChangeTracking(map, 0);
+
+        GridType& grid = map;
+        std::string error;
+        #pragma omp parallel for schedule(dynamic)
+        for(int i = 0; i < int(tile_sizes.size()); ++i)
+        {
+            try
+            {
+                Index begin, end;
+                detail::getTileRange(i, num_cells, tile_size, begin, end);
+                detail::loadTile(data.data() + tile_offsets[i], tile_sizes[i], grid, begin, end);
+            }
+            catch(const std::exception& e)
+            {
+                #pragma omp critical
+                error = e.what();
+            }
+        }
+        if(!error.empty())
+            throw std::runtime_error(error);
+
+        detail::rebuildHeightPyramid(map, 0);
+    }
+}}
+
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(maps::grid::detail::MapHeaderOArchive)
+BOOST_SERIALIZATION_USE_ARRAY_OPTIMIZATION(maps::grid::detail::MapHeaderOArchive)
@@ -37,10 +37,6 @@ TraversabilityCell::TraversabilityCell(uint8_t traversabilityClass, uint8_t prob
 {
 }
 
-TraversabilityCell::~TraversabilityCell()
-{
-}
-
 void TraversabilityCell::setTraversabilityClassId(uint8_t traversabilityClassId)
 {
     this->traversabilityClassId = traversabilityClassId;
@@ -53,7 +53,7 @@ namespace maps { namespace grid
         // Initializes the TraversabilityCell with the given values for traversabilityClassId and probability.
         TraversabilityCell(uint8_t traversabilityClassId, uint8_t probability);
 
-        ~TraversabilityCell();
+        ~TraversabilityCell() = default;
 
         void setTraversabilityClassId(uint8_t traversabilityClassId);
         uint8_t getTraversabilityClassId() const;
@@ -27,7 +27,9 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <stdexcept>
+#include <type_traits>
 
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/nvp.hpp>
@@ -39,6 +41,13 @@
 
 namespace maps { namespace grid
 {
+    namespace detail
+    {
+        /** Archive types derived from this tag save VectorGrids without their cells, see saveTiled */
+        class SkipGridCells
+        {
+        };
+    }
 
     template <typename CellT>
     class VectorGrid
@@ -121,43 +130,54 @@ namespace maps { namespace grid
             cells.resize(new_number_cells.prod(), default_value);
         };
 
+        /** Exchanges the cells, the size and the default value with @p other without copying the cells */
+        void swap(VectorGrid& other)
+        {
+            cells.swap(other.cells);
+            std::swap(num_cells, other.num_cells);
+            std::swap(default_value, other.default_value);
+        }
+
         /**
          * @brief Move the content of the grid cells
-         * @details by the offset described in the argument
+         * @details by the offset described in the argument. The cells are moved in place,
+         * only the cells which are uncovered by the move are reset to the default value.
          * @return void
          */
         void moveBy(const Index &idx)
         {
-            const Vector2ui num_cells(this->num_cells);
+            const int nx = num_cells.x(), ny = num_cells.y();
+            const int dx = idx.x(), dy = idx.y();
 
             // if all grid values should be moved outside
-            if (abs(idx.x()) >= num_cells.x()
-                || abs(idx.y()) >= num_cells.y())
+            if (abs(dx) >= nx || abs(dy) >= ny)
             {
                 clear();
                 return;
             }
+            if (dx == 0 && dy == 0)
+                return;
 
-            std::vector<CellT> tmp;
-            tmp.resize(num_cells.prod(), default_value);
-
-            //copy pointers to new grid at new position
-            for (unsigned int y = 0; y < num_cells.y(); ++y)
+            // iterate from the side the cells are moved to, so every target
+            // has already been moved away before it is overwritten
+            for (int j = 0; j < ny - abs(dy); ++j)
             {
-                for (unsigned int x = 0; x < num_cells.x(); ++x)
+                const int y_new = dy >= 0 ? ny - 1 - j : j;
+                for (int i = 0; i < nx - abs(dx); ++i)
                 {
-                    int x_new = x + idx.x();
-                    int y_new = y + idx.y();
-
-                    if ((x_new >= 0 && unsigned(x_new) < num_cells.x())
-                        && (y_new >= 0 && unsigned(y_new) < num_cells.y()))
-                    {
-                        std::swap(cells[toIdx(x, y)], tmp[toIdx(x_new, y_new)]);
-                    }
+                    const int x_new = dx >= 0 ? nx - 1 - i : i;
+                    std::swap(cells[toIdx(x_new, y_new)], cells[toIdx(x_new - dx, y_new - dy)]);
                 }
             }
 
-            cells.swap(tmp);
+            // reset the uncovered rows and columns
+            const int y_begin = dy >= 0 ? 0 : ny + dy, y_end = dy >= 0 ? dy : ny;
+            for (int y = y_begin; y < y_end; ++y)
+                std::fill(cells.begin() + toIdx(0, y), cells.begin() + toIdx(0, y + 1), default_value);
+
+            const int x_begin = dx >= 0 ? 0 : nx + dx, x_end = dx >= 0 ? dx : nx;
+            for (int y = 0; y < ny; ++y)
+                std::fill(cells.begin() + toIdx(x_begin, y), cells.begin() + toIdx(x_end, y), default_value);
         }
 
         const CellT& at(const Index &idx) const
@@ -233,6 +253,15 @@ namespace maps { namespace grid
         template<class Archive>
         void save(Archive & ar, const unsigned int version) const
         {
+            if(std::is_base_of<detail::SkipGridCells, Archive>::value)
+            {
+                // the cells are saved separately
+                const Vector2ui no_cells(0, 0);
+                ar << BOOST_SERIALIZATION_NVP(no_cells.derived());
+                ar << BOOST_SERIALIZATION_NVP(default_value);
+                return;
+            }
+
             ar << BOOST_SERIALIZATION_NVP(num_cells.derived());
             ar << BOOST_SERIALIZATION_NVP(default_value);
 
@@ -0,0 +1,240 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include <maps/grid/GridMap.hpp>
+#include <maps/geometric/GeometricMap.hpp>
+#include <maps/geometric/LineSegment.hpp>
+
+namespace maps { namespace operations
+{
+    /**
+     * @brief Rasterizes line segments, e.g. the walls of a ContourMap, into grids.
+     * @details
+     * The segments are given in the local frame of the grid and are projected to
+     * its xy plane. The grid is divided into tiles, the segments are binned per
+     * tile and the tiles are processed in parallel.
+     */
+    class ContourRasterization
+    {
+    public:
+        enum Mode
+        {
+            /** every cell touched by a segment */
+            SUPERCOVER,
+            /** cells within one cell of a segment, weighted by their distance */
+            ANTI_ALIASED
+        };
+
+        /**
+         * Sets the cells covered by the segments to @p value. In ANTI_ALIASED mode
+         * a cell is set to the maximum of its value and @p value scaled by
+         * one minus the distance of its center to the segment in cells.
+         */
+        template <typename T, int D, typename CellT, typename GridT>
+        static void rasterize(const geometric::GeometricMap<geometric::LineSegment<T, D> >& segments,
+                              grid::GridMap<CellT, GridT>& grid, Mode mode, const CellT& value, unsigned tile_size = 64)
+        {
+            std::vector<Segment> projected;
+            project(segments, grid, projected);
+            const double margin = mode == SUPERCOVER ? 0. : grid.getResolution().maxCoeff();
+
+            process(projected, grid.getNumCells(), grid.getResolution(), margin, tile_size,
+                    [&](const std::vector<size_t>& bin, const grid::Index& begin, const grid::Index& end)
+            {
+                for (size_t s : bin)
+                {
+                    if (mode == SUPERCOVER)
+                        coverCells(projected[s], grid, begin, end, value);
+                    else
+                        blendCells(projected[s], grid, begin, end, value);
+                }
+            });
+        }
+
+        /**
+         * Sets each cell of @p distance to the distance of its center to the closest
+         * segment, cells further away than @p max_range are set to @p max_range.
+         */
+        template <typename T, int D, typename CellT, typename GridT>
+        static void computeDistance(const geometric::GeometricMap<geometric::LineSegment<T, D> >& segments,
+                                    grid::GridMap<CellT, GridT>& distance, double max_range, unsigned tile_size = 64)
+        {
+            std::vector<Segment> projected;
+            project(segments, distance, projected);
+
+            process(projected, distance.getNumCells(), distance.getResolution(), max_range, tile_size,
+                    [&](const std::vector<size_t>& bin, const grid::Index& begin, const grid::Index& end)
+            {
+                for (int y = begin.y(); y < end.y(); ++y)
+                    for (int x = begin.x(); x < end.x(); ++x)
+                        distance.at(x, y) = max_range;
+
+                for (size_t s : bin)
+                {
+                    grid::Index min, max;
+                    if (!getCellRange(projected[s], distance.getResolution(), max_range, begin, end, min, max))
+                        continue;
+                    for (int y = min.y(); y <= max.y(); ++y)
+                    {
+                        for (int x = min.x(); x <= max.x(); ++x)
+                        {
+                            const Eigen::Vector2d center = (Eigen::Vector2d(x, y).array() + 0.5) * distance.getResolution().array();
+                            const CellT d = std::sqrt(projected[s].squaredSegmentDistance(center));
+                            CellT& cell = distance.at(x, y);
+                            if (d < cell)
+                                cell = d;
+                        }
+                    }
+                }
+            });
+        }
+
+    private:
+        /** segment in the xy plane of the grid, in meters */
+        typedef geometric::LineSegment2d Segment;
+
+        template <typename T, int D, typename CellT, typename GridT>
+        static void project(const geometric::GeometricMap<geometric::LineSegment<T, D> >& segments,
+                            const grid::GridMap<CellT, GridT>& grid, std::vector<Segment>& projected)
+        {
+            static_assert(D == 2 || D == 3, "Only 2D and 3D line segments can be rasterized");
+            projected.clear();
+            projected.reserve(segments.getNumElements());
+            for (size_t i = 0; i < segments.getNumElements(); ++i)
+            {
+                Eigen::Vector3d a = Eigen::Vector3d::Zero(), b = Eigen::Vector3d::Zero();
+                a.template head<D>() = segments[i].psi_a().template cast<double>();
+                b.template head<D>() = segments[i].psi_b().template cast<double>();
+                const Eigen::Vector3d a_grid = grid.getLocalFrame() * a;
+                const Eigen::Vector3d b_grid = grid.getLocalFrame() * b;
+                projected.push_back(Segment(a_grid.head<2>(), b_grid.head<2>()));
+            }
+        }
+
+        /**
+         * Range of cells [min, max] within [begin, end) overlapped by the bounding box of
+         * the segment extended by @p margin. Returns false if it is empty.
+         */
+        static bool getCellRange(const Segment& segment, const Eigen::Vector2d& resolution, double margin,
+                                 const grid::Index& begin, const grid::Index& end, grid::Index& min, grid::Index& max)
+        {
+            const Eigen::Array2d lower = segment.psi_a().cwiseMin(segment.psi_b()).array() - margin;
+            const Eigen::Array2d upper = segment.psi_a().cwiseMax(segment.psi_b()).array() + margin;
+            min = (lower / resolution.array()).floor().max(begin.cast<double>().array()).cast<int>().matrix();
+            max = (upper / resolution.array()).floor().min((end.array() - 1).cast<double>()).cast<int>().matrix();
+            return (min.array() <= max.array()).all();
+        }
+
+        /** Bins the segments to the tiles and calls @p process_tile for the tiles in parallel */
+        template <typename F>
+        static void process(const std::vector<Segment>& segments, const grid::Vector2ui& num_cells, const Eigen::Vector2d& resolution,
+                            double margin, unsigned tile_size, F process_tile)
+        {
+            if (tile_size == 0)
+                throw std::runtime_error("The tile size has to be positive");
+            const grid::Vector2ui num_tiles((num_cells.x() + tile_size - 1) / tile_size, (num_cells.y() + tile_size - 1) / tile_size);
+            std::vector<std::vector<size_t> > bins(num_tiles.prod());
+            const grid::Index grid_end = num_cells.cast<int>();
+            for (size_t s = 0; s < segments.size(); ++s)
+            {
+                grid::Index min, max;
+                if (!getCellRange(segments[s], resolution, margin, grid::Index(0, 0), grid_end, min, max))
+                    continue;
+                for (unsigned ty = min.y() / tile_size; ty <= max.y() / tile_size; ++ty)
+                    for (unsigned tx = min.x() / tile_size; tx <= max.x() / tile_size; ++tx)
+                        bins[tx + ty * num_tiles.x()].push_back(s);
+            }
+
+            #pragma omp parallel for schedule(dynamic)
+            for (int i = 0; i < int(bins.size()); ++i)
+            {
+                const grid::Index begin((i % num_tiles.x()) * tile_size, (i / num_tiles.x()) * tile_size);
+                const grid::Index end = (begin.array() + int(tile_size)).matrix().cwiseMin(grid_end);
+                process_tile(bins[i], begin, end);
+            }
+        }
+
+        /** Sets all cells of the tile touched by the segment, row by row */
+        template <typename CellT, typename GridT>
+        static void coverCells(const Segment& segment, grid::GridMap<CellT, GridT>& grid,
+                               const grid::Index& begin, const grid::Index& end, const CellT& value)
+        {
+            // segment in cell units
+            const Eigen::Vector2d a = segment.psi_a().cwiseQuotient(grid.getResolution());
+            const Eigen::Vector2d b = segment.psi_b().cwiseQuotient(grid.getResolution());
+            const int min_y = std::max<int>(std::floor(std::min(a.y(), b.y())), begin.y());
+            const int max_y = std::min<int>(std::floor(std::max(a.y(), b.y())), end.y() - 1);
+            for (int y = min_y; y <= max_y; ++y)
+            {
+                // part of the segment within the row [y, y + 1]
+                double x0 = a.x(), x1 = b.x();
+                if (a.y() != b.y())
+                {
+                    const double t0 = std::max(0., std::min(1., (y - a.y()) / (b.y() - a.y())));
+                    const double t1 = std::max(0., std::min(1., (y + 1 - a.y()) / (b.y() - a.y())));
+                    x0 = a.x() + t0 * (b.x() - a.x());
+                    x1 = a.x() + t1 * (b.x() - a.x());
+                }
+                const int min_x = std::max<int>(std::floor(std::min(x0, x1)), begin.x());
+                const int max_x = std::min<int>(std::floor(std::max(x0, x1)), end.x() - 1);
+                for (int x = min_x; x <= max_x; ++x)
+                    grid.at(x, y) = value;
+            }
+        }
+
+        /** Blends the value into the cells of the tile within one cell of the segment */
+        template <typename CellT, typename GridT>
+        static void blendCells(const Segment& segment, grid::GridMap<CellT, GridT>& grid,
+                               const grid::Index& begin, const grid::Index& end, const CellT& value)
+        {
+            // distances in cell units
+            const Segment scaled(segment.psi_a().cwiseQuotient(grid.getResolution()), segment.psi_b().cwiseQuotient(grid.getResolution()));
+            grid::Index min, max;
+            if (!getCellRange(scaled, Eigen::Vector2d(1., 1.), 1., begin, end, min, max))
+                return;
+            for (int y = min.y(); y <= max.y(); ++y)
+            {
+                for (int x = min.x(); x <= max.x(); ++x)
+                {
+                    const double coverage = 1. - std::sqrt(scaled.squaredSegmentDistance(Eigen::Vector2d(x + 0.5, y + 0.5)));
+                    if (coverage <= 0.)
+                        continue;
+                    const CellT weighted = static_cast<CellT>(value * coverage);
+                    CellT& cell = grid.at(x, y);
+                    if (cell < weighted)
+                        cell = weighted;
+                }
+            }
+        }
+    };
+}}
@@ -1,5 +1,9 @@
 #include "CoverageMapGeneration.hpp"
 
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
 namespace maps {
 
 namespace operations {
@@ -14,50 +18,222 @@ bool CoverageTracker::frameChanged(const grid::MLSMapKalman& mls_) const
 
 void CoverageTracker::updateMLS(const grid::MLSMapKalman& mls_) {
     mls = &mls_;
-    return; // FIXME shift local frame?
-    if(frameChanged(*mls))
+    if(!frameChanged(*mls))
+        return;
+
+    const Eigen::Affine3d coverage_to_mls = mls->getLocalFrame() * coverage.getLocalFrame().inverse();
+    if(coverage.getNumCells() == mls->getNumCells() && coverage.getResolution().isApprox(mls->getResolution())
+        && coverage_to_mls.linear().isIdentity(1e-9) && std::abs(coverage_to_mls.translation().z()) < 1e-6)
+    {
+        // pure translation by whole cells: scroll the contents with the MLS
+        const Eigen::Array2d shift = coverage_to_mls.translation().head<2>().array() / coverage.getResolution().array();
+        const Eigen::Array2d rounded = shift.round();
+        if(((shift - rounded).abs() < 1e-6).all())
+        {
+            coverage.moveBy(grid::Index(rounded.cast<int>().matrix()));
+            coverage.getLocalFrame() = mls->getLocalFrame();
+            return;
+        }
+    }
+
+    resample(*mls, coverage_to_mls);
+}
+
+void CoverageTracker::resample(const grid::MLSMapKalman& mls_, const Eigen::Affine3d& coverage_to_mls)
+{
+    CoverageMap3d resampled(mls_.getNumCells(), mls_.getResolution(), coverage.getConfig());
+    resampled.getLocalFrame() = mls_.getLocalFrame();
+
+    // nearest neighbor lookup of the old cell for every new cell, heights are transformed at the cell center
+    const Eigen::Affine3d mls_to_coverage = coverage_to_mls.inverse();
+    const Eigen::Array2d res = resampled.getResolution();
+    const Eigen::Array2d old_res = coverage.getResolution();
+    const Eigen::Array2d old_num_cells = coverage.getNumCells().array().cast<double>();
+    for(unsigned y = 0; y < resampled.getNumCells().y(); ++y)
     {
-        std::cout << "Frame changed. Resetting coverage. New Frame\n" << mls->getLocalFrame().matrix().topRows<3>() << "\nResolution: " << mls->getResolution().transpose() << ", NumCells: " << mls->getNumCells() << "\n";
-        grid::MLSConfig cfg = mls->getConfig();
-        cfg.updateModel = grid::MLSConfig::BASE;
-
-        // Just reset the coverage map for now
-        // TODO FIXME properly move the current contents of the coverage map
-        coverage = CoverageMap3d(mls->getNumCells(), mls->getResolution(), cfg);
-        coverage.getLocalFrame() = mls->getLocalFrame();
+        for(unsigned x = 0; x < resampled.getNumCells().x(); ++x)
+        {
+            const Eigen::Vector3d center_in_old = mls_to_coverage * Eigen::Vector3d((x + 0.5) * res.x(), (y + 0.5) * res.y(), 0.0);
+            const Eigen::Array2d old_idx = (center_in_old.head<2>().array() / old_res).floor();
+            if((old_idx < 0.0).any() || (old_idx >= old_num_cells).any())
+                continue;
+
+            for(const CoverageMap3d::Patch& p : coverage.at(old_idx.x(), old_idx.y()))
+            {
+                const double top = (coverage_to_mls * Eigen::Vector3d(center_in_old.x(), center_in_old.y(), p.getTop())).z();
+                const double bottom = (coverage_to_mls * Eigen::Vector3d(center_in_old.x(), center_in_old.y(), p.getBottom())).z();
+                resampled.mergePatch(grid::Index(x, y), CoverageMap3d::Patch(std::max(top, bottom), std::abs(top - bottom)));
+            }
+        }
     }
+
+    coverage = std::move(resampled);
 }
 
-void CoverageTracker::addCoverage(const double &radius, const base::AngleSegment& range /* ignored */, const base::Pose& pose_in_map)
+float CoverageTracker::surfaceHeight(const Eigen::Affine3d& coverage_to_mls, int x, int y, float z) const
 {
-    if(false && frameChanged(*mls) ) // FIXME temporarily disabled (MLS frame is irrelevant at the moment)
+    const Eigen::Array2d &res = coverage.getResolution();
+    const Eigen::Vector3d center_in_mls = coverage_to_mls * Eigen::Vector3d((x + 0.5) * res.x(), (y + 0.5) * res.y(), z);
+    const Eigen::Array2d idx = (center_in_mls.head<2>().array() / mls->getResolution().array()).floor();
+    if((idx < 0.0).any() || (idx >= mls->getNumCells().array().cast<double>()).any())
+        return std::numeric_limits<float>::quiet_NaN();
+
+    // patches above the sensor are ceilings and do not occlude the ground
+    float height = std::numeric_limits<float>::quiet_NaN();
+    for(const grid::MLSMapKalman::Patch& p : mls->at(idx.x(), idx.y()))
     {
-        std::cerr << "Local Frames and resolution of coverage map and MLS map must be the same.\n";
-        updateMLS(*mls); // HACK should not be necessary
-//            throw std::runtime_error( "Local Frames and resolution of coverage map and MLS map must be the same.");
+        if(p.getBottom() <= center_in_mls.z() && !(p.getTop() <= height))
+            height = p.getTop();
     }
+    // heights are given relative to the coverage grid (exact as long as the frames are not rotated against each other)
+    return height - (center_in_mls.z() - z);
+}
+
+void CoverageTracker::addCoverage(const double &radius, const base::AngleSegment& range, const base::Pose& pose_in_map)
+{
+    if(radius <= 0.0)
+        return;
 
     const Eigen::Array2d &res = coverage.getResolution();
+    const Eigen::Array2i num_cells = coverage.getNumCells().array().cast<int>();
     const Eigen::Affine3d pose_in_grid = coverage.getLocalFrame() * pose_in_map.toTransform();
     const Eigen::Array2d pos2d = pose_in_grid.translation().head<2>().array();
     const double z = pose_in_grid.translation().z();
+    const double yaw = std::atan2(pose_in_grid.linear()(1, 0), pose_in_grid.linear()(0, 0));
+
+    Eigen::Affine3d coverage_to_mls = Eigen::Affine3d::Identity();
+    if(mls)
+        coverage_to_mls = mls->getLocalFrame() * coverage.getLocalFrame().inverse();
+
+    // an empty (e.g. default constructed) segment means all around
+    double start_angle = yaw - M_PI, width = 2 * M_PI;
+    if(range.getWidth() > 0.0 && range.getWidth() < 2 * M_PI)
+    {
+        start_angle = yaw + range.getStart().getRad();
+        width = range.getWidth();
+    }
+
+    // two rays per cell at the maximum range, so every cell within the radius is hit
+    const int num_rays = std::max(1, int(std::ceil(2.0 * width * radius / res.minCoeff())));
+    const Eigen::Array2i window_radius = (radius / res).ceil().cast<int>() + 1;
+    const int max_steps = window_radius.sum() + 2;
+    const Eigen::Array2i window_size = 2 * window_radius + 1;
+    const Eigen::Array2i sensor_idx = (pos2d / res).floor().cast<int>();
+    const Eigen::Array2i window_origin = sensor_idx - window_radius;
 
-    const Eigen::Array2i minIdx = ((pos2d - radius) / res).cast<int>().max(0);
-    const Eigen::Array2i maxIdx = ((pos2d + radius) / res).cast<int>().min(coverage.getNumCells().array().cast<int>());
+    ray_hits.resize(size_t(num_rays) * max_steps);
+    ray_lengths.assign(num_rays, 0);
 
-    for(int x=minIdx.x(); x < maxIdx.x(); ++x)
+#pragma omp parallel for schedule(dynamic, 16)
+    for(int ray = 0; ray < num_rays; ++ray)
     {
-        for(int y=minIdx.y(); y< maxIdx.y(); ++y)
+        const double angle = start_angle + (ray + 0.5) * width / num_rays;
+        const Eigen::Array2d dir(std::cos(angle), std::sin(angle));
+
+        // voxel traversal (Amanatides & Woo) in the xy-plane of the grid
+        Eigen::Array2i idx = sensor_idx;
+        Eigen::Array2i step;
+        Eigen::Array2d t_max, t_delta;
+        // the ray is within the grid for t in [t_grid_enter, t_grid_exit]
+        double t_grid_enter = 0.0, t_grid_exit = radius;
+        for(int i = 0; i < 2; ++i)
         {
-            // TODO here we need to ray-trace through the MLS and consider the angle-range
+            step[i] = dir[i] >= 0.0 ? 1 : -1;
+            const double border = (idx[i] + (step[i] > 0 ? 1 : 0)) * res[i];
+            t_delta[i] = dir[i] != 0.0 ? res[i] / std::abs(dir[i]) : std::numeric_limits<double>::infinity();
+            t_max[i] = dir[i] != 0.0 ? (border - pos2d[i]) / dir[i] : std::numeric_limits<double>::infinity();
+
+            if(dir[i] != 0.0)
+            {
+                const double t0 = -pos2d[i] / dir[i];
+                const double t1 = (num_cells[i] * res[i] - pos2d[i]) / dir[i];
+                t_grid_enter = std::max(t_grid_enter, std::min(t0, t1));
+                t_grid_exit = std::min(t_grid_exit, std::max(t0, t1));
+            }
+            else if(pos2d[i] < 0.0 || pos2d[i] >= num_cells[i] * res[i])
+                t_grid_exit = -1.0;
+        }
 
-            Eigen::Array2i idx(x,y);
+        RayHit* hits = &ray_hits[size_t(ray) * max_steps];
+        int num_hits = 0;
+        double max_slope = -std::numeric_limits<double>::infinity();
+        double t_enter = 0.0;
+        while(t_enter <= t_grid_exit && num_hits < max_steps)
+        {
+            if(!((idx >= 0).all() && (idx < num_cells).all()))
+            {
+                // a sensor outside of the grid, advance to the first cell inside of it
+                if(t_enter >= t_grid_enter)
+                    break;
+                const int axis = t_max.x() < t_max.y() ? 0 : 1;
+                t_enter = t_max[axis];
+                t_max[axis] += t_delta[axis];
+                idx[axis] += step[axis];
+                continue;
+            }
+
+            const double dist = (((idx.cast<double>() + 0.5) * res) - pos2d).matrix().norm();
+            const double z_diff_2 = radius * radius - dist * dist;
+            if(z_diff_2 > 0.0)
+            {
+                const double z_diff = std::sqrt(z_diff_2);
+                const double top = z + z_diff;
+                const double horizon = dist > 0.0 ? z + max_slope * dist : -std::numeric_limits<double>::infinity();
+                // once the horizon is above the sphere, it stays there for the rest of the ray
+                if(horizon >= top)
+                    break;
+
+                double bottom = std::max(horizon, z - z_diff);
+                const float height = mls ? surfaceHeight(coverage_to_mls, idx.x(), idx.y(), z) : std::numeric_limits<float>::quiet_NaN();
+                if(!std::isnan(height))
+                {
+                    if(height >= horizon)
+                        bottom = std::max<double>(height, z - z_diff);
+                    if(dist >= 0.5 * res.minCoeff())
+                        max_slope = std::max(max_slope, (height - z) / dist);
+                }
+
+                if(bottom < top)
+                {
+                    RayHit& hit = hits[num_hits++];
+                    hit.x = idx.x();
+                    hit.y = idx.y();
+                    hit.bottom = bottom;
+                    hit.top = top;
+                }
+            }
+
+            const int axis = t_max.x() < t_max.y() ? 0 : 1;
+            t_enter = t_max[axis];
+            t_max[axis] += t_delta[axis];
+            idx[axis] += step[axis];
+        }
+        ray_lengths[ray] = num_hits;
+    }
 
-            const double z_diff_2 = radius*radius - (idx.cast<double>() * res - pos2d).matrix().squaredNorm();
-            if(z_diff_2 <= 0) continue;
+    // rays overlap close to the sensor, merge their intervals before touching the map
+    window_bottom.assign(window_size.prod(), std::numeric_limits<float>::infinity());
+    window_top.assign(window_size.prod(), -std::numeric_limits<float>::infinity());
+    for(int ray = 0; ray < num_rays; ++ray)
+    {
+        const RayHit* hits = &ray_hits[size_t(ray) * max_steps];
+        for(int i = 0; i < ray_lengths[ray]; ++i)
+        {
+            const size_t w = (hits[i].x - window_origin.x()) + size_t(hits[i].y - window_origin.y()) * window_size.x();
+            window_bottom[w] = std::min(window_bottom[w], hits[i].bottom);
+            window_top[w] = std::max(window_top[w], hits[i].top);
+        }
+    }
 
-            const double z_diff = std::sqrt(z_diff_2);
-            coverage.mergePatch(grid::Index(idx.matrix()), CoverageMap3d::Patch(z+z_diff, 2*z_diff));
+    for(int y = 0; y < window_size.y(); ++y)
+    {
+        for(int x = 0; x < window_size.x(); ++x)
+        {
+            const size_t w = x + size_t(y) * window_size.x();
+            if(!(window_bottom[w] < window_top[w]))
+                continue;
+            const grid::Index idx(window_origin.x() + x, window_origin.y() + y);
+            coverage.mergePatch(idx, CoverageMap3d::Patch(window_top[w], window_top[w] - window_bottom[w]));
         }
     }
 }
@@ -1,9 +1,10 @@
 #pragma once
 
+#include <vector>
+
 #include <maps/grid/MLSMap.hpp>
 
 // TODO make configurable?
-// TODO MLSMap is currently ignored
 
 namespace maps {
 
@@ -13,11 +14,30 @@ typedef grid::MLSMapBase CoverageMap3d;
 namespace operations {
 
 class CoverageTracker {
+    /** A vertical interval of a cell which was seen by one ray */
+    struct RayHit
+    {
+        int32_t x, y;
+        float bottom, top;
+    };
+
     CoverageMap3d coverage;
     const grid::MLSMapKalman* mls;
 
+    /** Per ray result slots (num_rays * max_steps), reused between calls */
+    std::vector<RayHit> ray_hits;
+    std::vector<int32_t> ray_lengths;
+    /** Visible interval per cell of the window around the sensor, reused between calls */
+    std::vector<float> window_bottom, window_top;
+
     bool frameChanged(const grid::MLSMapKalman& mls_) const;
 
+    /** Moves the coverage into the grid of @p mls_, used if the grids are not shifted by whole cells */
+    void resample(const grid::MLSMapKalman& mls_, const Eigen::Affine3d& coverage_to_mls);
+
+    /** Height of the topmost MLS patch starting below @p z at a coverage cell, NaN if unknown */
+    float surfaceHeight(const Eigen::Affine3d& coverage_to_mls, int x, int y, float z) const;
+
 
 public:
     CoverageTracker() : mls(nullptr)
@@ -25,6 +45,13 @@ public:
 
     }
 
+    /**
+     * Sets the MLS used for occlusion checks and makes the coverage follow its frame.
+     *
+     * If the local frame of the MLS was translated by whole cells, the coverage is
+     * scrolled in place. Only if the resolution, size or rotation changed, the
+     * coverage is resampled into the grid of the MLS.
+     */
     void updateMLS(const grid::MLSMapKalman& mls_);
 
     template <typename CellT, typename GridT>
@@ -35,7 +62,18 @@ public:
         coverage.getLocalFrame() = map.getLocalFrame();
     }
 
-    void addCoverage(const double &radius, const base::AngleSegment& range /* ignored */, const base::Pose& pose_in_map);
+    /**
+     * Marks the space seen by a sensor at @p pose_in_map as covered.
+     *
+     * Rays are cast in the xy-plane of the coverage grid over the angular
+     * @p range (relative to the heading of the sensor, an empty segment
+     * means all around) up to @p radius. Each ray is traversed cell by cell
+     * over the top surface of the MLS set by updateMLS(), keeping track of the
+     * steepest elevation seen so far: cells whose surface lies below that
+     * horizon are occluded and only the space above the horizon is covered.
+     * Without an MLS, the whole sphere of @p radius is covered.
+     */
+    void addCoverage(const double &radius, const base::AngleSegment& range, const base::Pose& pose_in_map);
     const CoverageMap3d& getCoverage() const { return coverage; }
 };
 
@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <maps/grid/GridMap.hpp>
+
+#include <vector>
+#include <algorithm>
+
+namespace maps { namespace operations
+{
+    class GridHoleFilling
+    {
+    public:
+        /**
+         * @brief Fills the cells with default value by push-pull interpolation.
+         * @details Much cheaper than GridInterpolation::interpolate and does not
+         * need CGAL, but the holes are filled smoothly instead of with exact planes.
+         * The known cells are averaged into a pyramid of halved resolutions (push),
+         * afterwards the holes are filled from the coarser levels (pull). All cells
+         * are filled, also the ones outside of the convex hull of the known cells.
+         * Grids without known cells are not changed.
+         * For integral types the interpolated values are truncated.
+         */
+        template <class T, 
+                class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+        static void fillHoles(grid::GridMap<T> &grid)
+        {
+            if(grid.getNumCells().prod() == 0)
+                return;
+
+            const T default_value = grid.getDefaultValue();
+
+            std::vector<Eigen::ArrayXXd> values(1);
+            std::vector<Eigen::ArrayXXf> weights(1);
+            values[0].setZero(grid.getNumCells().x(), grid.getNumCells().y());
+            weights[0].setZero(grid.getNumCells().x(), grid.getNumCells().y());
+            for(size_t y = 0; y < grid.getNumCells().y(); ++y)
+            {
+                for(size_t x = 0; x < grid.getNumCells().x(); ++x)
+                {
+                    if(grid.at(x, y) != default_value)
+                    {
+                        values[0](x, y) = grid.at(x, y);
+                        weights[0](x, y) = 1.f;
+                    }
+                }
+            }
+
+            // push: weighted mean of the 2x2 child cells, the weight saturates at one
+            while(values.back().rows() > 1 || values.back().cols() > 1)
+            {
+                const Eigen::ArrayXXd &value = values.back();
+                const Eigen::ArrayXXf &weight = weights.back();
+                Eigen::ArrayXXd coarse_value = Eigen::ArrayXXd::Zero((value.rows() + 1) / 2, (value.cols() + 1) / 2);
+                Eigen::ArrayXXf coarse_weight = Eigen::ArrayXXf::Zero(coarse_value.rows(), coarse_value.cols());
+                #pragma omp parallel for schedule(static)
+                for(int y = 0; y < int(coarse_value.cols()); ++y)
+                {
+                    for(int x = 0; x < coarse_value.rows(); ++x)
+                    {
+                        double sum = 0.;
+                        float weight_sum = 0.f;
+                        for(int cy = 2 * y; cy < std::min<int>(2 * y + 2, value.cols()); ++cy)
+                        {
+                            for(int cx = 2 * x; cx < std::min<int>(2 * x + 2, value.rows()); ++cx)
+                            {
+                                sum += weight(cx, cy) * value(cx, cy);
+                                weight_sum += weight(cx, cy);
+                            }
+                        }
+                        if(weight_sum > 0.f)
+                            coarse_value(x, y) = sum / weight_sum;
+                        coarse_weight(x, y) = std::min(weight_sum, 1.f);
+                    }
+                }
+                values.push_back(coarse_value);
+                weights.push_back(coarse_weight);
+            }
+            if(weights.back()(0, 0) == 0.f)
+                return;
+
+            // pull: blend the missing weight with the bilinear interpolation of the coarser level
+            for(int level = int(values.size()) - 2; level >= 0; --level)
+            {
+                Eigen::ArrayXXd &value = values[level];
+                const Eigen::ArrayXXf &weight = weights[level];
+                const Eigen::ArrayXXd &coarse = values[level + 1];
+                #pragma omp parallel for schedule(static)
+                for(int y = 0; y < int(value.cols()); ++y)
+                {
+                    const double cy = std::max(0.5 * y - 0.25, 0.);
+                    const int y0 = std::min<int>(cy, coarse.cols() - 1);
+                    const int y1 = std::min<int>(y0 + 1, coarse.cols() - 1);
+                    const double fy = std::min(cy - y0, 1.);
+                    for(int x = 0; x < value.rows(); ++x)
+                    {
+                        if(weight(x, y) >= 1.f)
+                            continue;
+                        const double cx = std::max(0.5 * x - 0.25, 0.);
+                        const int x0 = std::min<int>(cx, coarse.rows() - 1);
+                        const int x1 = std::min<int>(x0 + 1, coarse.rows() - 1);
+                        const double fx = std::min(cx - x0, 1.);
+                        const double interpolated = (1. - fy) * ((1. - fx) * coarse(x0, y0) + fx * coarse(x1, y0))
+                                                  + fy * ((1. - fx) * coarse(x0, y1) + fx * coarse(x1, y1));
+                        value(x, y) = weight(x, y) * value(x, y) + (1. - weight(x, y)) * interpolated;
+                    }
+                }
+            }
+
+            for(size_t y = 0; y < grid.getNumCells().y(); ++y)
+            {
+                for(size_t x = 0; x < grid.getNumCells().x(); ++x)
+                {
+                    T &cell_value = grid.at(x, y);
+                    if(cell_value == default_value)
+                        cell_value = static_cast<T>(values[0](x, y));
+                }
+            }
+        }
+    };
+}}
@@ -27,7 +27,11 @@
 #ifndef __MAPS_GRIDINTERPOLATION_HPP__
 #define __MAPS_GRIDINTERPOLATION_HPP__
 
-#include "../GridMap.hpp"
+#include <maps/grid/GridMap.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
 
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
 #include <CGAL/Projection_traits_xy_3.h>
@@ -42,84 +46,139 @@ namespace maps { namespace operations
         ~GridInterpolation() {};
 
         /**
-         * @brief [brief description]
-         * @details nore only for doubles
-         * (cell_value = Vector3d(x,y,1).dot( A.inverse() * b );)
-         * uncertanty for integral types
-         * 
+         * @brief Interpolates the cells with default value from the Delaunay
+         * triangulation of the other cells.
+         * @details Each triangle is scan converted into the grid, the cells inside
+         * of it are set to the plane through its corners. Cells outside of the
+         * convex hull of the known cells keep the default value. The triangles
+         * are rasterized in parallel.
+         * For integral types the interpolated values are truncated.
+         * GridHoleFilling::fillHoles is a cheaper alternative if the holes
+         * do not have to be filled with exact planes.
+         *
          * @param grid [description]
          */
         template <class T, 
                 class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
-        static void interpolate(GridMap<T> &grid)
+        static void interpolate(grid::GridMap<T> &grid)
         {
             typedef CGAL::Exact_predicates_inexact_constructions_kernel K;
             typedef CGAL::Projection_traits_xy_3<K>  Gt;
             typedef CGAL::Delaunay_triangulation_2<Gt> Delaunay;                
             typedef K::Point_3 Point;
 
-            Delaunay dt;
-
-            size_t min_width = grid.getNumCells().x() - 1;
-            size_t max_width = 0;
-            size_t min_height = grid.getNumCells().y() - 1;
-            size_t max_height = 0;   
-
             T default_value = grid.getDefaultValue();
 
+            std::vector<Point> points;
             for(size_t y = 0; y < grid.getNumCells().y(); ++y)
             {
                 for(size_t x = 0; x < grid.getNumCells().x(); ++x)
                 {
                     T const &cell_value = grid.at(x, y);
                     if(cell_value != default_value )
-                    {
-                        Point p(x, y, cell_value);
-                        dt.insert( p );
-                            
-                        min_width = std::min(min_width, x);
-                        max_width = std::max(max_width, x);
-                        min_height = std::min(min_height, y);
-                        max_height = std::max(max_height, y);
-                    }
+                        points.push_back(Point(x, y, cell_value));
                 }
             }
 
-            for(size_t x = min_width; x < max_width; x++)
+            // bulk insertion sorts the points spatially
+            Delaunay dt(points.begin(), points.end());
+
+            std::vector<typename Delaunay::Face_handle> faces;
+            for(typename Delaunay::Finite_faces_iterator it = dt.finite_faces_begin(); it != dt.finite_faces_end(); ++it)
+                faces.push_back(it);
+
+            // each cell is covered by exactly one triangle, so they can be rasterized concurrently
+            #pragma omp parallel for schedule(dynamic, 64)
+            for(int i = 0; i < int(faces.size()); ++i)
             {
-                for(size_t y = min_height; y < max_height; y++)
+                Eigen::Vector3d corners[3];
+                bool hull_edges[3];
+                for(int j = 0; j < 3; j++)
                 {
-                    T &cell_value = grid.at(x, y);
-                    if(cell_value == default_value)
-                    {
-                        // no data point in grid, so value needs to be interpolated
-
-                        // Solve linear equation system to find plane that is spanned by
-                        // the three points
-                        Eigen::Matrix3d A;
-                        Eigen::Vector3d b;
-
-                        Delaunay::Face_handle face = dt.locate(Point(x, y, 0));
-                        if( face == NULL || face->vertex(0) == NULL 
-                            || face->vertex(1) == NULL || face->vertex(2) == NULL)
-                            continue;
-
-                        for(int i = 0; i < 3; i++)
-                        {
-                            Point &p(face->vertex(i)->point());
-                            A.block<1,3>(i,0) = Vector3d(p.x(), p.y(), 1);
-                            b(i) = p.z();
-                        }
-
-                        // evaluate the point at x, y
-                        cell_value = Vector3d(x,y,1).dot( A.inverse() * b );
-                    }
+                    const Point &p(faces[i]->vertex(j)->point());
+                    corners[j] = Eigen::Vector3d(p.x(), p.y(), p.z());
+                    hull_edges[j] = dt.is_infinite(faces[i]->neighbor(j));
                 }
-            }       
+                rasterizeTriangle(grid.getNumCells(), corners, hull_edges,
+                                  [&grid, default_value](int64_t x, int64_t y, double z)
+                                  {
+                                      T &cell_value = grid.at(x, y);
+                                      if(cell_value == default_value)
+                                          cell_value = static_cast<T>(z);
+                                  });
+            }
         }
 
-    private:
+        /**
+         * Calls @p callback with (x, y, z) for each cell of a grid with @p num_cells inside
+         * of the triangle, z is the plane through its corners, which are at integer cell
+         * coordinates. The edge functions are evaluated incrementally in integers. Cells on
+         * an inner edge belong to only one of the two adjacent triangles (top-left rule),
+         * cells on the edges of the convex hull (@p hull_edges, edge i is opposite of
+         * corner i) are always included.
+         */
+        template <class CallBack>
+        static void rasterizeTriangle(const grid::Vector2ui &num_cells, Eigen::Vector3d corners[3], bool hull_edges[3], CallBack &&callback)
+        {
+            Eigen::Matrix<int64_t, 2, 1> p[3];
+            for(int i = 0; i < 3; i++)
+                p[i] = corners[i].head<2>().array().round().cast<int64_t>().matrix();
+
+            // counter clockwise orientation
+            int64_t area = (p[1].x() - p[0].x()) * (p[2].y() - p[0].y()) - (p[1].y() - p[0].y()) * (p[2].x() - p[0].x());
+            if(area == 0)
+                return;
+            if(area < 0)
+            {
+                std::swap(p[1], p[2]);
+                std::swap(corners[1], corners[2]);
+                std::swap(hull_edges[1], hull_edges[2]);
+                area = -area;
+            }
 
+            // edge i is opposite of corner i, its function is positive inside of the triangle
+            int64_t step_x[3], step_y[3], bias[3];
+            for(int i = 0; i < 3; i++)
+            {
+                const Eigen::Matrix<int64_t, 2, 1> &a = p[(i + 1) % 3];
+                const Eigen::Matrix<int64_t, 2, 1> &b = p[(i + 2) % 3];
+                step_x[i] = a.y() - b.y();
+                step_y[i] = b.x() - a.x();
+                const bool top_left = (b.y() < a.y()) || (b.y() == a.y() && b.x() > a.x());
+                bias[i] = (top_left || hull_edges[i]) ? 0 : -1;
+            }
+
+            // plane z = z0 + dz_dx * (x - x0) + dz_dy * (y - y0)
+            const double dz1 = corners[1].z() - corners[0].z();
+            const double dz2 = corners[2].z() - corners[0].z();
+            const double dz_dx = (dz1 * (p[2].y() - p[0].y()) - dz2 * (p[1].y() - p[0].y())) / area;
+            const double dz_dy = (dz2 * (p[1].x() - p[0].x()) - dz1 * (p[2].x() - p[0].x())) / area;
+
+            const int64_t min_x = std::max<int64_t>(std::min(p[0].x(), std::min(p[1].x(), p[2].x())), 0);
+            const int64_t min_y = std::max<int64_t>(std::min(p[0].y(), std::min(p[1].y(), p[2].y())), 0);
+            const int64_t max_x = std::min<int64_t>(std::max(p[0].x(), std::max(p[1].x(), p[2].x())), int64_t(num_cells.x()) - 1);
+            const int64_t max_y = std::min<int64_t>(std::max(p[0].y(), std::max(p[1].y(), p[2].y())), int64_t(num_cells.y()) - 1);
+
+            for(int64_t y = min_y; y <= max_y; ++y)
+            {
+                int64_t w[3];
+                for(int i = 0; i < 3; i++)
+                {
+                    const Eigen::Matrix<int64_t, 2, 1> &a = p[(i + 1) % 3];
+                    w[i] = step_x[i] * (min_x - a.x()) + step_y[i] * (y - a.y()) + bias[i];
+                }
+                double z = corners[0].z() + dz_dx * (min_x - p[0].x()) + dz_dy * (y - p[0].y());
+                for(int64_t x = min_x; x <= max_x; ++x)
+                {
+                    if(w[0] >= 0 && w[1] >= 0 && w[2] >= 0)
+                        callback(x, y, z);
+                    w[0] += step_x[0];
+                    w[1] += step_x[1];
+                    w[2] += step_x[2];
+                    z += dz_dx;
+                }
+            }
+        }
     };
 }}
 
@@ -0,0 +1,199 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include <maps/grid/Index.hpp>
+
+namespace maps { namespace tools
+{
+
+/**
+ * Convex 2D polygon extruded along the z axis, e.g. the collision shape of a robot.
+ * The shape is given in the robot frame.
+ */
+class Footprint
+{
+public:
+    typedef std::vector< Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > Polygon;
+
+    Footprint() : min_z(0.), max_z(0.) {}
+
+    /** @param polygon corners of a convex polygon, in any order */
+    Footprint(const Polygon& polygon, double min_z, double max_z) : polygon(polygon), min_z(min_z), max_z(max_z) {}
+
+    static Footprint fromBox(const Eigen::AlignedBox3d& box)
+    {
+        Polygon polygon;
+        polygon.push_back(Eigen::Vector2d(box.min().x(), box.min().y()));
+        polygon.push_back(Eigen::Vector2d(box.max().x(), box.min().y()));
+        polygon.push_back(Eigen::Vector2d(box.max().x(), box.max().y()));
+        polygon.push_back(Eigen::Vector2d(box.min().x(), box.max().y()));
+        return Footprint(polygon, box.min().z(), box.max().z());
+    }
+
+    const Polygon& getPolygon() const { return polygon; }
+    double getMinZ() const { return min_z; }
+    double getMaxZ() const { return max_z; }
+
+    /**
+     * Transforms the shape by @p pose and returns the convex hull of its projection
+     * to the xy plane and its z interval.
+     * For poses with roll or pitch the z interval covers the whole transformed shape.
+     */
+    void transform(const Eigen::Affine3d& pose, Polygon& projection, double& projection_min_z, double& projection_max_z) const
+    {
+        Polygon corners;
+        corners.reserve(2 * polygon.size());
+        projection_min_z = std::numeric_limits<double>::infinity();
+        projection_max_z = -std::numeric_limits<double>::infinity();
+        for(const Eigen::Vector2d& corner : polygon)
+        {
+            for(double z : {min_z, max_z})
+            {
+                Eigen::Vector3d p = pose * Eigen::Vector3d(corner.x(), corner.y(), z);
+                corners.push_back(p.head<2>());
+                projection_min_z = std::min(projection_min_z, p.z());
+                projection_max_z = std::max(projection_max_z, p.z());
+            }
+        }
+        computeConvexHull(corners, projection);
+    }
+
+    /**
+     * Computes for each grid row intersected by the convex @p polygon the exact range of cells
+     * [x_begin, x_end) which overlap it. Cells touching the polygon count as overlapping.
+     * @param cb Prototype: bool f(int y, int x_begin, int x_end), returning true aborts the rasterization.
+     * @return true if the rasterization was aborted by the callback
+     */
+    template<class CallBack>
+    static bool rasterize(const Polygon& polygon, const Eigen::Vector2d& resolution, const maps::grid::Vector2ui& num_cells, CallBack&& cb)
+    {
+        if(polygon.empty())
+            return false;
+
+        double y_min = std::numeric_limits<double>::infinity(), y_max = -y_min;
+        for(const Eigen::Vector2d& p : polygon)
+        {
+            y_min = std::min(y_min, p.y());
+            y_max = std::max(y_max, p.y());
+        }
+
+        const int row_begin = std::max((int)std::floor(y_min / resolution.y()), 0);
+        const int row_end = std::min((int)std::floor(y_max / resolution.y()) + 1, (int)num_cells.y());
+        for(int y = row_begin; y < row_end; y++)
+        {
+            // x extent of the polygon within the strip of the current row
+            const double strip_min = y * resolution.y();
+            const double strip_max = strip_min + resolution.y();
+            double x_min = std::numeric_limits<double>::infinity(), x_max = -x_min;
+            for(size_t i = 0; i < polygon.size(); i++)
+            {
+                const Eigen::Vector2d& a = polygon[i];
+                const Eigen::Vector2d& b = polygon[(i + 1) % polygon.size()];
+                double t0 = 0., t1 = 1.;
+                const double dy = b.y() - a.y();
+                if(dy == 0.)
+                {
+                    if(a.y() < strip_min || a.y() > strip_max)
+                        continue;
+                }
+                else
+                {
+                    double ta = (strip_min - a.y()) / dy;
+                    double tb = (strip_max - a.y()) / dy;
+                    if(ta > tb)
+                        std::swap(ta, tb);
+                    t0 = std::max(t0, ta);
+                    t1 = std::min(t1, tb);
+                    if(t0 > t1)
+                        continue;
+                }
+                const double xa = a.x() + t0 * (b.x() - a.x());
+                const double xb = a.x() + t1 * (b.x() - a.x());
+                x_min = std::min(x_min, std::min(xa, xb));
+                x_max = std::max(x_max, std::max(xa, xb));
+            }
+            if(x_min > x_max)
+                continue;
+
+            const int x_begin = std::max((int)std::floor(x_min / resolution.x()), 0);
+            const int x_end = std::min((int)std::floor(x_max / resolution.x()) + 1, (int)num_cells.x());
+            if(x_begin < x_end && cb(y, x_begin, x_end))
+                return true;
+        }
+        return false;
+    }
+
+    /** Andrew's monotone chain algorithm, the hull is in counter-clockwise order */
+    static void computeConvexHull(Polygon points, Polygon& hull)
+    {
+        std::sort(points.begin(), points.end(), [](const Eigen::Vector2d& a, const Eigen::Vector2d& b)
+                                                { return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y()); });
+        hull.clear();
+        if(points.size() < 3)
+        {
+            hull = points;
+            return;
+        }
+
+        hull.resize(2 * points.size());
+        size_t k = 0;
+        for(size_t i = 0; i < points.size(); i++)
+        {
+            while(k >= 2 && cross(hull[k-2], hull[k-1], points[i]) <= 0.)
+                k--;
+            hull[k++] = points[i];
+        }
+        for(size_t i = points.size() - 1, t = k + 1; i > 0; i--)
+        {
+            while(k >= t && cross(hull[k-2], hull[k-1], points[i-1]) <= 0.)
+                k--;
+            hull[k++] = points[i-1];
+        }
+        hull.resize(k - 1);
+    }
+
+private:
+    static double cross(const Eigen::Vector2d& o, const Eigen::Vector2d& a, const Eigen::Vector2d& b)
+    {
+        return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+    }
+
+    Polygon polygon;
+    double min_z;
+    double max_z;
+};
+
+}}
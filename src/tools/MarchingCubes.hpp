@@ -339,9 +339,34 @@ namespace maps { namespace tools
     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}
   };
 
+  /*
+   * Cube vertex indices connected by each of the 12 edges, in the order
+   * used by edgeTable and triTable.
+   */
+  const int edgeCorners[12][2] = {
+    {0, 1}, {1, 2}, {2, 3}, {3, 0},
+    {4, 5}, {5, 6}, {6, 7}, {7, 4},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}
+  };
+
 class MarchingCubes
 {
 public:
+    /**
+     * Returns the index into edgeTable and triTable for the given signed distances
+     * of the eight cube vertices.
+     */
+    static inline int computeCubeIndex(const float *signed_distances, float iso_level = 0.f)
+    {
+        int cubeindex = 0;
+        for(int i = 0; i < 8; i++)
+        {
+            if (signed_distances[i] < iso_level)
+                cubeindex |= (1 << i);
+        }
+        return cubeindex;
+    }
+
     template<class VectorType, class Allocator = std::allocator<VectorType> >
     static void computeSurfaces(const std::vector< VectorType, Allocator >& vertices,
                                 const std::vector<float> &signed_distances,
@@ -26,6 +26,7 @@
 //
 #include "TSDFPolygonMeshReconstruction.hpp"
 
+#include <pcl/point_types.h>
 #include <pcl/common/transforms.h>
 #include <pcl/common/io.h>
 
@@ -34,29 +35,24 @@ using namespace maps::grid;
 
 void TSDFPolygonMeshReconstruction::reconstruct(pcl::PolygonMesh& output)
 {
-    std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > surfaces;
-    std::vector<float> intensities;
-    reconstructSurfaces(surfaces, intensities);
+    IndexedSurfaceMesh mesh;
+    reconstructMesh(mesh);
 
-    pcl::PointCloud<pcl::PointXYZI> cloud_with_intensity;
-    cloud_with_intensity.resize(surfaces.size());
-    for(unsigned i = 0; i < surfaces.size(); i++)
+    pcl::PointCloud<pcl::PointXYZINormal> cloud;
+    cloud.resize(mesh.vertices.size());
+    for(unsigned i = 0; i < mesh.vertices.size(); i++)
     {
-        cloud_with_intensity[i].getVector3fMap() = surfaces[i];
-        cloud_with_intensity[i].intensity = intensities[i];
+        cloud[i].getVector3fMap() = mesh.vertices[i];
+        cloud[i].getNormalVector3fMap() = mesh.normals[i];
+        cloud[i].intensity = mesh.intensities[i];
     }
 
-    pcl::toPCLPointCloud2(cloud_with_intensity, output.cloud);
+    pcl::toPCLPointCloud2(cloud, output.cloud);
 
-    output.polygons.resize (cloud_with_intensity.size() / 3);
+    output.polygons.resize(mesh.getNumTriangles());
     for(size_t i = 0; i < output.polygons.size(); ++i)
     {
-        pcl::Vertices v;
-        v.vertices.resize (3);
-        for(int j = 0; j < 3; ++j)
-        {
-            v.vertices[j] = static_cast<int> (i) * 3 + j;
-        }
-        output.polygons[i] = v;
+        pcl::Vertices& v = output.polygons[i];
+        v.vertices.assign(mesh.indices.begin() + 3 * i, mesh.indices.begin() + 3 * i + 3);
     }
 }
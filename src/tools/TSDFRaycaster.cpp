@@ -0,0 +1,290 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "TSDFRaycaster.hpp"
+
+#include <base/Float.hpp>
+#include <cmath>
+
+using namespace maps::tools;
+using namespace maps::grid;
+
+RayPattern RayPattern::createPinhole(unsigned width, unsigned height, float fx, float fy, float cx, float cy)
+{
+    RayPattern pattern;
+    pattern.width = width;
+    pattern.height = height;
+    pattern.directions.reserve(width * height);
+    pattern.depth_factors.reserve(width * height);
+    for(unsigned v = 0; v < height; v++)
+    {
+        for(unsigned u = 0; u < width; u++)
+        {
+            Eigen::Vector3f direction((u - cx) / fx, (v - cy) / fy, 1.f);
+            direction.normalize();
+            pattern.directions.push_back(direction);
+            pattern.depth_factors.push_back(direction.z());
+        }
+    }
+    return pattern;
+}
+
+RayPattern RayPattern::createLidar(unsigned horizontal_beams, float min_azimuth, float max_azimuth, const std::vector<float>& elevations)
+{
+    RayPattern pattern;
+    pattern.width = horizontal_beams;
+    pattern.height = elevations.size();
+    pattern.directions.reserve(pattern.width * pattern.height);
+    pattern.depth_factors.assign(pattern.width * pattern.height, 1.f);
+    const float azimuth_step = horizontal_beams > 1 ? (max_azimuth - min_azimuth) / (horizontal_beams - 1) : 0.f;
+    for(float elevation : elevations)
+    {
+        for(unsigned i = 0; i < horizontal_beams; i++)
+        {
+            const float azimuth = min_azimuth + i * azimuth_step;
+            pattern.directions.push_back(Eigen::Vector3f(std::cos(elevation) * std::cos(azimuth),
+                                                         std::cos(elevation) * std::sin(azimuth),
+                                                         std::sin(elevation)));
+        }
+    }
+    return pattern;
+}
+
+void RaycastResult::resize(unsigned width, unsigned height)
+{
+    this->width = width;
+    this->height = height;
+    depth.assign(width * height, base::NaN<float>());
+    normals.assign(width * height, Eigen::Vector3f::Constant(base::NaN<float>()));
+    variance.assign(width * height, base::NaN<float>());
+}
+
+void TSDFRaycaster::raycast(const RayPattern& rays, const base::Transform3d& sensor2map, RaycastResult& result) const
+{
+    if(!tsdf_map)
+        throw std::runtime_error("TSDF map is not set!");
+    if(rays.directions.size() != rays.width * rays.height || rays.depth_factors.size() != rays.directions.size())
+        throw std::runtime_error("Ray pattern is inconsistent!");
+
+    result.resize(rays.width, rays.height);
+
+    const Eigen::Affine3f sensor2grid = (tsdf_map->getLocalFrame() * sensor2map).cast<float>();
+    const Eigen::Matrix3f grid2map = tsdf_map->getLocalFrame().inverse().linear().cast<float>();
+    const Eigen::Vector3f origin = sensor2grid.translation();
+    const Eigen::Vector2f grid_size = (tsdf_map->getNumCells().cast<double>().cwiseProduct(tsdf_map->getResolution())).cast<float>();
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for(int i = 0; i < (int)rays.size(); i++)
+    {
+        const Eigen::Vector3f direction = sensor2grid.linear() * rays.directions[i];
+
+        // clip the ray to the extents of the grid
+        float t_min = min_range;
+        float t_max = max_range;
+        for(unsigned axis = 0; axis < 2; axis++)
+        {
+            if(direction[axis] == 0.f)
+            {
+                if(origin[axis] < 0.f || origin[axis] > grid_size[axis])
+                    t_max = -1.f;
+                continue;
+            }
+            float t0 = -origin[axis] / direction[axis];
+            float t1 = (grid_size[axis] - origin[axis]) / direction[axis];
+            if(t0 > t1)
+                std::swap(t0, t1);
+            t_min = std::max(t_min, t0);
+            t_max = std::min(t_max, t1);
+        }
+        if(t_min > t_max)
+            continue;
+
+        float t_hit, variance;
+        Eigen::Vector3f normal;
+        if(castRay(origin, direction, t_min, t_max, t_hit, normal, variance))
+        {
+            result.depth[i] = t_hit * rays.depth_factors[i];
+            result.normals[i] = grid2map * normal;
+            result.variance[i] = variance;
+        }
+    }
+}
+
+bool TSDFRaycaster::interpolate(const Eigen::Vector3f& pos_in_grid, float& distance, float& variance) const
+{
+    float distances[8], variances[8];
+    Eigen::Vector3f f;
+    if(!getVoxelValues(pos_in_grid, distances, variances, f))
+        return false;
+
+    float d[4], v[4];
+    for(unsigned i = 0; i < 4; i++)
+    {
+        d[i] = distances[2*i] + f.x() * (distances[2*i+1] - distances[2*i]);
+        v[i] = variances[2*i] + f.x() * (variances[2*i+1] - variances[2*i]);
+    }
+    distance = (1.f - f.z()) * (d[0] + f.y() * (d[1] - d[0])) + f.z() * (d[2] + f.y() * (d[3] - d[2]));
+    variance = (1.f - f.z()) * (v[0] + f.y() * (v[1] - v[0])) + f.z() * (v[2] + f.y() * (v[3] - v[2]));
+    return true;
+}
+
+bool TSDFRaycaster::getVoxelValues(const Eigen::Vector3f& pos_in_grid, float* distances, float* variances, Eigen::Vector3f& fraction) const
+{
+    // voxel values are located at the cell centers
+    const Eigen::Vector3f res = tsdf_map->getVoxelResolution().cast<float>();
+    const Eigen::Vector3f pos = pos_in_grid.cwiseQuotient(res) - Eigen::Vector3f(0.5f, 0.5f, 0.5f);
+    const Eigen::Vector3f lower = pos.array().floor();
+    fraction = pos - lower;
+
+    const int x = lower.x(), y = lower.y();
+    const int32_t z = lower.z();
+    const Vector2ui& num_cells = tsdf_map->getNumCells();
+    if(x < 0 || y < 0 || x + 1 >= (int)num_cells.x() || y + 1 >= (int)num_cells.y())
+        return false;
+
+    // corner i is located at (x + (i & 1), y + ((i >> 1) & 1), z + (i >> 2))
+    for(unsigned c = 0; c < 4; c++)
+    {
+        const TSDFVolumetricMap::GridMapBase::CellType& column = tsdf_map->at(x + (c & 0x1), y + (c >> 1));
+        TSDFVolumetricMap::GridMapBase::CellType::const_iterator it = column.find(z);
+        for(unsigned k = 0; k < 2; k++, it++)
+        {
+            if(it == column.end() || it->first != z + (int32_t)k)
+                return false;
+            const TSDFPatch& voxel = it->second;
+            if(!std::isfinite(voxel.getDistance()) || voxel.getStandardDeviation() >= std_threshold)
+                return false;
+            distances[c + 4*k] = voxel.getDistance();
+            variances[c + 4*k] = voxel.getVariance();
+        }
+    }
+    return true;
+}
+
+bool TSDFRaycaster::castRay(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction, float t_min, float t_max,
+                            float& t_hit, Eigen::Vector3f& normal, float& variance) const
+{
+    const float truncation = tsdf_map->getTruncation();
+    const float min_step = 0.5f * tsdf_map->getVoxelResolution().minCoeff();
+    // a sample in unknown space can be up to one voxel in front of the observed band
+    const float unknown_step = std::max(truncation - (float)tsdf_map->getVoxelResolution().maxCoeff(), min_step);
+
+    float t = t_min;
+    float t_prev = t_min;
+    float t_unknown = t_min;
+    float distance_prev = 0.f;
+    bool prev_valid = false;
+    bool prev_unknown = false;
+    bool seen_valid = false;
+    float distance;
+    while(t <= t_max)
+    {
+        if(!interpolate(origin + t * direction, distance, variance))
+        {
+            // unknown space, no surface is expected closer than the truncation distance.
+            // Behind observed space only small gaps are skipped, which are caused by voxels
+            // above the standard deviation threshold.
+            prev_valid = false;
+            prev_unknown = true;
+            t_unknown = t;
+            t += seen_valid ? min_step : unknown_step;
+            continue;
+        }
+
+        if(distance <= 0.f && !prev_valid)
+        {
+            // a surface seen from behind is not a hit
+            if(!prev_unknown)
+                return false;
+
+            // the step out of unknown space may have skipped the front side of the surface,
+            // search the first valid sample behind the unknown space
+            float t_valid = t;
+            float t_lower = t_unknown;
+            while(t_valid - t_lower > 0.1f * min_step)
+            {
+                const float t_mid = 0.5f * (t_lower + t_valid);
+                float distance_mid;
+                if(interpolate(origin + t_mid * direction, distance_mid, variance))
+                {
+                    t_valid = t_mid;
+                    distance = distance_mid;
+                }
+                else
+                    t_lower = t_mid;
+            }
+            if(distance <= 0.f)
+                return false;
+
+            // continue marching from the front side
+            prev_unknown = false;
+            t = t_valid;
+            continue;
+        }
+
+        if(distance <= 0.f)
+        {
+            // linear interpolation of the zero crossing between the last two samples
+            t_hit = t_prev + (t - t_prev) * distance_prev / (distance_prev - distance);
+            break;
+        }
+
+        prev_valid = true;
+        prev_unknown = false;
+        seen_valid = true;
+        t_prev = t;
+        distance_prev = distance;
+        t += std::max(std::min(distance, truncation), min_step);
+    }
+    if(t > t_max)
+        return false;
+
+    // the normal is given by the gradient of the trilinear interpolation at the hit point
+    Eigen::Vector3f hit = origin + t_hit * direction;
+    float distances[8], variances[8];
+    Eigen::Vector3f f;
+    if(!getVoxelValues(hit, distances, variances, f))
+    {
+        hit = origin + t * direction;
+        getVoxelValues(hit, distances, variances, f);
+    }
+    interpolate(hit, distance, variance);
+
+    // differences along the voxel edges, dx is indexed by (y,z), dy by (x,z) and dz by (x,y)
+    float dx[4], dy[4], dz[4];
+    for(unsigned i = 0; i < 4; i++)
+    {
+        dx[i] = distances[2*i+1] - distances[2*i];
+        dy[i] = distances[(i & 0x1) + 4*(i >> 1) + 2] - distances[(i & 0x1) + 4*(i >> 1)];
+        dz[i] = distances[i+4] - distances[i];
+    }
+    const Eigen::Vector3f res = tsdf_map->getVoxelResolution().cast<float>();
+    normal.x() = ((1.f - f.z()) * ((1.f - f.y()) * dx[0] + f.y() * dx[1]) + f.z() * ((1.f - f.y()) * dx[2] + f.y() * dx[3])) / res.x();
+    normal.y() = ((1.f - f.z()) * ((1.f - f.x()) * dy[0] + f.x() * dy[1]) + f.z() * ((1.f - f.x()) * dy[2] + f.x() * dy[3])) / res.y();
+    normal.z() = ((1.f - f.y()) * ((1.f - f.x()) * dz[0] + f.x() * dz[1]) + f.y() * ((1.f - f.x()) * dz[2] + f.x() * dz[3])) / res.z();
+    normal.normalize();
+    return true;
+}
@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+#include <base/Eigen.hpp>
+#include <maps/grid/TSDFVolumetricMap.hpp>
+
+#include <vector>
+
+namespace maps { namespace tools
+{
+
+/**
+ * Directions of the rays of a sensor, expressed in the sensor frame.
+ * The rays are stored row by row.
+ */
+struct RayPattern
+{
+    typedef std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > DirectionVector;
+
+    unsigned width;
+    unsigned height;
+    /** unit direction of each ray */
+    DirectionVector directions;
+    /** converts the distance along a ray into its depth value */
+    std::vector<float> depth_factors;
+
+    RayPattern() : width(0), height(0) {}
+
+    size_t size() const { return directions.size(); }
+
+    /**
+     * Creates the rays of a pinhole camera looking along the z axis, x pointing right and y down.
+     * The depth value of a ray is the z coordinate of the hit point.
+     */
+    static RayPattern createPinhole(unsigned width, unsigned height, float fx, float fy, float cx, float cy);
+
+    /**
+     * Creates the rays of a laser scanner looking along the x axis with z pointing up.
+     * Each row of the pattern corresponds to one elevation angle.
+     * The depth value of a ray is the range of the hit point.
+     */
+    static RayPattern createLidar(unsigned horizontal_beams, float min_azimuth, float max_azimuth, const std::vector<float>& elevations);
+};
+
+/**
+ * Depth, normal and variance images predicted by TSDFRaycaster.
+ * Rays without a surface hit are set to NaN.
+ */
+struct RaycastResult
+{
+    typedef std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > NormalVector;
+
+    unsigned width;
+    unsigned height;
+    std::vector<float> depth;
+    /** surface normals in the map frame, pointing towards the sensor */
+    NormalVector normals;
+    /** interpolated variance of the TSDF at the surface */
+    std::vector<float> variance;
+
+    RaycastResult() : width(0), height(0) {}
+
+    void resize(unsigned width, unsigned height);
+
+    bool isValid(size_t i) const { return depth[i] == depth[i]; }
+};
+
+/**
+ * Renders depth, normal and variance images of the zero crossing of a TSDF map.
+ *
+ * The rays are marched with steps of the interpolated distance, limited by the truncation of the map.
+ * Unknown space in front of the first observation is skipped with steps slightly below the truncation
+ * distance. If such a step lands behind a surface, the ray is refined to the first observed sample.
+ * The zero crossing is found by trilinear interpolation of the TSDF.
+ * The rays are processed in parallel, if OpenMP is available.
+ */
+class TSDFRaycaster
+{
+public:
+    TSDFRaycaster() : std_threshold(1.f), min_range(0.f), max_range(100.f) {}
+
+    void setTSDFMap(grid::TSDFVolumetricMap::Ptr map) { tsdf_map = map; }
+
+    /** voxels with a larger standard deviation are treated as unknown */
+    inline void setStdThreshold(float threshold) { this->std_threshold = threshold; }
+    inline float getStdThreshold() const { return this->std_threshold; }
+
+    inline void setRange(float min_range, float max_range) { this->min_range = min_range; this->max_range = max_range; }
+    inline float getMinRange() const { return this->min_range; }
+    inline float getMaxRange() const { return this->max_range; }
+
+    /**
+     * Casts the rays of the given pattern from the sensor pose.
+     * @param sensor2map transformation from the sensor frame to the map frame,
+     *                   same as the pose used in TSDFVolumetricMap::mergePointCloud
+     */
+    void raycast(const RayPattern& rays, const base::Transform3d& sensor2map, RaycastResult& result) const;
+
+    /**
+     * Returns the trilinear interpolated distance and variance at the given position in the grid frame.
+     * Returns false if one of the eight surrounding voxels is unknown.
+     */
+    bool interpolate(const Eigen::Vector3f& pos_in_grid, float& distance, float& variance) const;
+
+private:
+    bool getVoxelValues(const Eigen::Vector3f& pos_in_grid, float* distances, float* variances, Eigen::Vector3f& fraction) const;
+
+    bool castRay(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction, float t_min, float t_max,
+                 float& t_hit, Eigen::Vector3f& normal, float& variance) const;
+
+    grid::TSDFVolumetricMap::Ptr tsdf_map;
+    float std_threshold;
+    float min_range;
+    float max_range;
+};
+
+}}
@@ -27,17 +27,53 @@
 #pragma once
 
 #include <Eigen/Core>
+#include <Eigen/StdVector>
 #include <maps/grid/TSDFVolumetricMap.hpp>
 #include "MarchingCubes.hpp"
 
+#include <unordered_map>
+
 namespace maps { namespace tools
 {
 
+/**
+ * Triangle mesh with shared vertices.
+ * Every three consecutive entries in indices describe one triangle.
+ */
+struct IndexedSurfaceMesh
+{
+    typedef std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > VertexVector;
+
+    VertexVector vertices;
+    VertexVector normals;
+    std::vector<float> intensities;
+    std::vector<uint32_t> indices;
+
+    size_t getNumTriangles() const { return indices.size() / 3; }
+
+    void clear()
+    {
+        vertices.clear();
+        normals.clear();
+        intensities.clear();
+        indices.clear();
+    }
+};
+
+/**
+ * Base class of the TSDF surface reconstructions.
+ *
+ * The marching cubes results are kept per block of TSDFVolumetricMap::BLOCK_SIZE^2 columns.
+ * On each reconstruction only the blocks which have been modified since the last call
+ * (including a one column border) are recomputed.
+ * If the TSDF map is changed without the modification tracking of the map (e.g. by
+ * clear() or moveBy()) TSDFVolumetricMap::markAllModified() or invalidate() has to be called.
+ */
 template<class T>
 class TSDFSurfaceReconstruction
 {
 public:
-    TSDFSurfaceReconstruction() : std_threshold(1.f), iso_level(0.f) {}
+    TSDFSurfaceReconstruction() : std_threshold(1.f), iso_level(0.f), valid(false), last_stamp(0), revision(0) {}
     virtual ~TSDFSurfaceReconstruction() {}
 
     void setTSDFMap(grid::TSDFVolumetricMap::Ptr map, float z_min = -50.f, float z_max = 50.f)
@@ -46,124 +82,373 @@ public:
         voxel_res = tsdf_map->getVoxelResolution().cast<float>();
         z_idx_min = (int32_t)std::floor(z_min / voxel_res.z());
         z_idx_max = (int32_t)std::floor(z_max / voxel_res.z());
-
-        // create cell verticies
-        vertices.resize(8);
-        for(unsigned i = 0; i < 8; ++i)
-        {
-            vertices[i] = Eigen::Vector3f::Zero();
-            if(i & 0x4)
-                vertices[i][1] = voxel_res[1];
-
-            if(i & 0x2)
-                vertices[i][2] = voxel_res[2];
-
-            if((i & 0x1) ^ ((i >> 1) & 0x1))
-                vertices[i][0] = voxel_res[0];
-        }
+        invalidate();
     }
 
-    inline void setIsoLevel(float iso_level) { this->iso_level = iso_level; }
+    inline void setIsoLevel(float iso_level) { this->iso_level = iso_level; invalidate(); }
     inline float getIsoLevel() { return this->iso_level; }
 
-    inline void setStdThreshold(float threshold) { this->std_threshold = threshold; }
+    inline void setStdThreshold(float threshold) { this->std_threshold = threshold; invalidate(); }
     inline float getStdThreshold() { return this->std_threshold; }
 
+    /** Discards the cached blocks, the next reconstruction will process the whole map */
+    void invalidate() { valid = false; }
+
     virtual void reconstruct(T &output) = 0;
 
-protected:
-    void reconstructSurfaces(std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& surfaces, std::vector<float>& intensities, bool surfaces_in_global_frame = true)
+    /**
+     * Extracts the iso surface of the TSDF map as a mesh with shared vertices
+     * and area weighted per-vertex normals.
+     * Modified blocks are processed in parallel, if OpenMP is available.
+     */
+    void reconstructMesh(IndexedSurfaceMesh& mesh, bool mesh_in_global_frame = true)
     {
-        if(!tsdf_map)
-            throw std::runtime_error("TSDF map is not set!");
+        updateBlocks();
 
-        maps::grid::CellExtents extends = tsdf_map->calculateCellExtents();
-        for(unsigned y = extends.min().y(); y < extends.max().y(); y++)
+        // merge the blocks, vertices on the border between two blocks are shared
+        mesh.clear();
+        size_t num_vertices = 0, num_indices = 0;
+        for(const MeshBlock& block : blocks)
         {
-            for(unsigned x = extends.min().x(); x < extends.max().x(); x++)
+            num_vertices += block.vertices.size();
+            num_indices += block.indices.size();
+        }
+        mesh.vertices.reserve(num_vertices);
+        mesh.intensities.reserve(num_vertices);
+        mesh.indices.reserve(num_indices);
+
+        std::vector<uint32_t> weights;
+        weights.reserve(num_vertices);
+        std::vector<uint32_t> vertex_ids;
+        EdgeVertexMap shared_vertices;
+        for(const MeshBlock& block : blocks)
+        {
+            vertex_ids.resize(block.keys.size());
+            for(size_t i = 0; i < block.keys.size(); i++)
             {
-                const maps::grid::TSDFVolumetricMap::GridMapBase::CellType& tree = tsdf_map->at(x,y);
-                for(maps::grid::TSDFVolumetricMap::GridMapBase::CellType::const_iterator cell = tree.begin(); cell != tree.end(); cell++)
+                const EdgeKey& key = block.keys[i];
+                if(block.isBorderVertex(key))
                 {
-                    if(cell->first > z_idx_min && cell->first < z_idx_max)
+                    std::pair<typename EdgeVertexMap::iterator, bool> inserted = shared_vertices.insert(std::make_pair(key, (uint32_t)mesh.vertices.size()));
+                    if(!inserted.second)
                     {
-                        Eigen::Vector3i idx(x,y,cell->first);
-                        reconstructVoxel(cell->second, idx, surfaces, intensities);
+                        vertex_ids[i] = inserted.first->second;
+                        mesh.intensities[vertex_ids[i]] += block.intensities[i];
+                        weights[vertex_ids[i]] += block.weights[i];
+                        continue;
                     }
                 }
+
+                vertex_ids[i] = mesh.vertices.size();
+                mesh.vertices.push_back(block.vertices[i]);
+                mesh.intensities.push_back(block.intensities[i]);
+                weights.push_back(block.weights[i]);
             }
+
+            for(uint32_t idx : block.indices)
+                mesh.indices.push_back(vertex_ids[idx]);
         }
 
+        for(size_t i = 0; i < mesh.intensities.size(); i++)
+            mesh.intensities[i] /= weights[i];
+
+        computeVertexNormals(mesh);
+
         // transform points to global frame
-        if(surfaces_in_global_frame)
+        if(mesh_in_global_frame)
         {
             Eigen::Affine3f local_frame = tsdf_map->getLocalFrame().inverse().cast<float>();
-            for(Eigen::Vector3f& point : surfaces)
+            for(Eigen::Vector3f& point : mesh.vertices)
                 point = local_frame * point;
+            for(Eigen::Vector3f& normal : mesh.normals)
+                normal = local_frame.linear() * normal;
         }
     }
 
-    void reconstructVoxel(const grid::TSDFVolumetricMap::VoxelCellType& voxel, Eigen::Vector3i& idx,
-                          std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& surfaces, std::vector<float>& intensities)
+protected:
+    /**
+     * Extracts the iso surface of the TSDF map as a list of triangles,
+     * three consecutive points describe one triangle.
+     */
+    void reconstructSurfaces(std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& surfaces, std::vector<float>& intensities, bool surfaces_in_global_frame = true)
     {
-        if(std::abs(voxel.getDistance()) < tsdf_map->getTruncation() && voxel.getStandardDeviation() < std_threshold)
+        IndexedSurfaceMesh mesh;
+        reconstructMesh(mesh, surfaces_in_global_frame);
+
+        surfaces.resize(mesh.indices.size());
+        intensities.resize(mesh.indices.size());
+        for(size_t i = 0; i < mesh.indices.size(); i++)
         {
-            std::vector<float> leaf_node(8, 0.f);
-            leaf_node[0] = voxel.getDistance();
-            if(getValidNeighborList(leaf_node, idx))
+            surfaces[i] = mesh.vertices[mesh.indices[i]];
+            intensities[i] = mesh.intensities[mesh.indices[i]];
+        }
+    }
+
+    /** Identifies a cube edge by its lower voxel index and its axis */
+    struct EdgeKey
+    {
+        int32_t x, y, z;
+        int32_t axis;
+
+        bool operator==(const EdgeKey& other) const
+        {
+            return x == other.x && y == other.y && z == other.z && axis == other.axis;
+        }
+    };
+
+    struct EdgeKeyHash
+    {
+        size_t operator()(const EdgeKey& key) const
+        {
+            return ((size_t)(uint32_t)key.x * 73856093u) ^ ((size_t)(uint32_t)key.y * 19349663u) ^
+                   ((size_t)(uint32_t)key.z * 83492791u) ^ (size_t)key.axis;
+        }
+    };
+
+    typedef std::unordered_map<EdgeKey, uint32_t, EdgeKeyHash> EdgeVertexMap;
+
+    /**
+     * Partial mesh of the cubes in [min, max) of one block.
+     * The vertices are in the local frame of the TSDF map.
+     */
+    struct MeshBlock
+    {
+        Eigen::Vector2i min;
+        Eigen::Vector2i max;
+        /** is increased every time the block is recomputed */
+        uint64_t revision;
+
+        std::vector<EdgeKey> keys;
+        IndexedSurfaceMesh::VertexVector vertices;
+        /** sum of the intensities and number of cubes sharing the vertex */
+        std::vector<float> intensities;
+        std::vector<uint32_t> weights;
+        std::vector<uint32_t> indices;
+
+        MeshBlock() : min(Eigen::Vector2i::Zero()), max(Eigen::Vector2i::Zero()), revision(0) {}
+
+        /** Returns true if the vertex can be shared with a neighboring block */
+        bool isBorderVertex(const EdgeKey& key) const
+        {
+            return (key.axis != 0 && (key.x == min.x() || key.x == max.x())) ||
+                   (key.axis != 1 && (key.y == min.y() || key.y == max.y()));
+        }
+
+        void clear()
+        {
+            keys.clear();
+            vertices.clear();
+            intensities.clear();
+            weights.clear();
+            indices.clear();
+        }
+    };
+
+    /**
+     * Recomputes all blocks affected by modifications of the TSDF map since the last call.
+     * Blocks which have been recomputed get a new revision.
+     */
+    void updateBlocks()
+    {
+        if(!tsdf_map)
+            throw std::runtime_error("TSDF map is not set!");
+
+        const Eigen::Vector2i num_blocks = tsdf_map->getNumBlocks().cast<int>();
+        if(!valid || num_blocks != block_grid_size)
+        {
+            valid = false;
+            block_grid_size = num_blocks;
+            blocks.assign(num_blocks.prod(), MeshBlock());
+        }
+
+        // a cube depends on the columns of its block and of the blocks in positive x and y direction
+        std::vector<int> dirty_blocks;
+        for(int by = 0; by < num_blocks.y(); by++)
+        {
+            for(int bx = 0; bx < num_blocks.x(); bx++)
             {
-                size_t size = surfaces.size();
-                // create surface
-                MarchingCubes::computeSurfaces(vertices, leaf_node, surfaces, iso_level);
-
-                // move surfaces to the current cell
-                Eigen::Vector3f cell_center = (idx.cast<float>() + Eigen::Vector3f(0.5f, 0.5f, 0.5f)).cwiseProduct(voxel_res);
-                for(size_t i = size; i < surfaces.size(); i++)
-                    surfaces[i] = cell_center + surfaces[i];
-
-                // add intensity information
-                size_t new_points = surfaces.size() - size;
-                float intensity = std::max( 0.f, (std_threshold - voxel.getStandardDeviation() - std::sqrt(tsdf_map->getMinVariance())) / std_threshold);
-                for(size_t i = 0; i < new_points; i++)
+                bool dirty = !valid;
+                for(int i = 0; i < 4 && !dirty; i++)
                 {
-                    intensities.push_back(intensity);
+                    grid::Index neighbor(bx + (i & 0x1), by + (i >> 1));
+                    if(neighbor.x() < num_blocks.x() && neighbor.y() < num_blocks.y())
+                        dirty = tsdf_map->getBlockStamp(neighbor) > last_stamp;
                 }
+                if(dirty)
+                    dirty_blocks.push_back(bx + by * num_blocks.x());
             }
         }
+
+        const grid::Vector2ui num_cells = tsdf_map->getNumCells();
+        const float truncation = tsdf_map->getTruncation();
+        const float min_std = std::sqrt(tsdf_map->getMinVariance());
+        #pragma omp parallel for schedule(dynamic)
+        for(int i = 0; i < (int)dirty_blocks.size(); i++)
+        {
+            MeshBlock& block = blocks[dirty_blocks[i]];
+            const Eigen::Vector2i block_idx(dirty_blocks[i] % num_blocks.x(), dirty_blocks[i] / num_blocks.x());
+            // the cubes of the last row and column have no neighboring cells
+            block.min = block_idx * grid::TSDFVolumetricMap::BLOCK_SIZE;
+            block.max = (block.min.array() + grid::TSDFVolumetricMap::BLOCK_SIZE).min(num_cells.cast<int>().array() - 1);
+            block.clear();
+            reconstructBlock(truncation, min_std, block);
+        }
+
+        for(int block_id : dirty_blocks)
+            blocks[block_id].revision = ++revision;
+
+        valid = true;
+        last_stamp = tsdf_map->getModificationStamp();
     }
 
+    const std::vector<MeshBlock>& getMeshBlocks() const { return blocks; }
+
 private:
-    bool getGridValue(Eigen::Vector3i pos, float &distance)
-    {
-        if(!tsdf_map->hasVoxelCell(pos))
-            return false;
+    typedef grid::TSDFVolumetricMap::GridMapBase::CellType VoxelColumn;
+    typedef typename VoxelColumn::const_iterator VoxelIterator;
 
-        const maps::grid::TSDFPatch& cell = tsdf_map->getVoxelCell(pos);
+    /** Offset of the cube vertex to the voxel the cube belongs to */
+    static inline Eigen::Vector3i getCornerOffset(int corner)
+    {
+        return Eigen::Vector3i((corner & 0x1) ^ ((corner >> 1) & 0x1), (corner >> 2) & 0x1, (corner >> 1) & 0x1);
+    }
 
-        if(cell.getStandardDeviation() >= std_threshold)
+    bool getValidDistance(const VoxelIterator& it, const VoxelIterator& end, int32_t z, float& distance) const
+    {
+        if(it == end || it->first != z || it->second.getStandardDeviation() >= std_threshold)
             return false;
 
-        distance = cell.getDistance();
+        distance = it->second.getDistance();
         return true;
     }
 
-    bool getValidNeighborList(std::vector<float> &leaf, const Eigen::Vector3i &index3d)
+    void reconstructBlock(float truncation, float min_std, MeshBlock& block) const
     {
-        if(!getGridValue(index3d + Eigen::Vector3i (1, 0, 0), leaf[1]))
-            return false;
-        if(!getGridValue(index3d + Eigen::Vector3i (1, 0, 1), leaf[2]))
-            return false;
-        if(!getGridValue(index3d + Eigen::Vector3i (0, 0, 1), leaf[3]))
-            return false;
-        if(!getGridValue(index3d + Eigen::Vector3i (0, 1, 0), leaf[4]))
-            return false;
-        if(!getGridValue(index3d + Eigen::Vector3i (1, 1, 0), leaf[5]))
-            return false;
-        if(!getGridValue(index3d + Eigen::Vector3i (1, 1, 1), leaf[6]))
-            return false;
-        if(!getGridValue(index3d + Eigen::Vector3i (0, 1, 1), leaf[7]))
-            return false;
-        return true;
+        // cube vertices (1,2), (4,7) and (5,6) are located in the neighboring columns
+        static const int neighbor_corners[3][2] = {{1, 2}, {4, 7}, {5, 6}};
+
+        const grid::TSDFVolumetricMap& map = *tsdf_map;
+        EdgeVertexMap edge_vertices;
+        float distances[8];
+        uint32_t cube_vertices[12];
+        for(int y = block.min.y(); y < block.max.y(); y++)
+        {
+            for(int x = block.min.x(); x < block.max.x(); x++)
+            {
+                const VoxelColumn& column = map.at(x, y);
+                if(column.empty())
+                    continue;
+
+                // the neighboring columns are traversed along with the current column
+                const VoxelColumn* neighbors[3] = {&map.at(x + 1, y), &map.at(x, y + 1), &map.at(x + 1, y + 1)};
+                VoxelIterator cursors[3] = {neighbors[0]->begin(), neighbors[1]->begin(), neighbors[2]->begin()};
+
+                for(VoxelIterator cell = column.begin(); cell != column.end(); cell++)
+                {
+                    const int32_t z = cell->first;
+                    const grid::TSDFPatch& voxel = cell->second;
+                    if(z <= z_idx_min || z >= z_idx_max)
+                        continue;
+                    if(!(std::abs(voxel.getDistance()) < truncation && voxel.getStandardDeviation() < std_threshold))
+                        continue;
+
+                    distances[0] = voxel.getDistance();
+                    bool complete = getValidDistance(cell + 1, column.end(), z + 1, distances[3]);
+                    for(unsigned i = 0; i < 3 && complete; i++)
+                    {
+                        VoxelIterator& cursor = cursors[i];
+                        while(cursor != neighbors[i]->end() && cursor->first < z)
+                            cursor++;
+                        complete = getValidDistance(cursor, neighbors[i]->end(), z, distances[neighbor_corners[i][0]]) &&
+                                   getValidDistance(cursor + 1, neighbors[i]->end(), z + 1, distances[neighbor_corners[i][1]]);
+                    }
+                    if(!complete)
+                        continue;
+
+                    const int cube_index = MarchingCubes::computeCubeIndex(distances, iso_level);
+                    if(edgeTable[cube_index] == 0)
+                        continue;
+
+                    const float intensity = std::max(0.f, (std_threshold - voxel.getStandardDeviation() - min_std) / std_threshold);
+                    const Eigen::Vector3i idx(x, y, z);
+                    for(int edge = 0; edge < 12; edge++)
+                    {
+                        if(edgeTable[cube_index] & (1 << edge))
+                            cube_vertices[edge] = getEdgeVertex(idx, edge, distances, intensity, edge_vertices, block);
+                    }
+
+                    for(int i = 0; triTable[cube_index][i] != -1; i++)
+                        block.indices.push_back(cube_vertices[triTable[cube_index][i]]);
+                }
+            }
+        }
+    }
+
+    uint32_t getEdgeVertex(const Eigen::Vector3i& idx, int edge, const float* distances, float intensity,
+                           EdgeVertexMap& edge_vertices, MeshBlock& block) const
+    {
+        int corner_a = edgeCorners[edge][0];
+        int corner_b = edgeCorners[edge][1];
+        Eigen::Vector3i offset_a = getCornerOffset(corner_a);
+        Eigen::Vector3i offset_b = getCornerOffset(corner_b);
+        if(offset_b.sum() < offset_a.sum())
+        {
+            std::swap(corner_a, corner_b);
+            std::swap(offset_a, offset_b);
+        }
+
+        EdgeKey key;
+        key.x = idx.x() + offset_a.x();
+        key.y = idx.y() + offset_a.y();
+        key.z = idx.z() + offset_a.z();
+        key.axis = offset_b.x() != offset_a.x() ? 0 : (offset_b.y() != offset_a.y() ? 1 : 2);
+
+        std::pair<typename EdgeVertexMap::iterator, bool> inserted = edge_vertices.insert(std::make_pair(key, (uint32_t)block.vertices.size()));
+        const uint32_t id = inserted.first->second;
+        if(!inserted.second)
+        {
+            // vertex was already created by a neighboring cube
+            block.intensities[id] += intensity;
+            block.weights[id]++;
+            return id;
+        }
+
+        Eigen::Vector3f p_a = (Eigen::Vector3i(key.x, key.y, key.z).cast<float>() + Eigen::Vector3f(0.5f, 0.5f, 0.5f)).cwiseProduct(voxel_res);
+        Eigen::Vector3f p_b = p_a;
+        p_b[key.axis] += voxel_res[key.axis];
+        const float d_a = distances[corner_a];
+        const float d_b = distances[corner_b];
+
+        block.keys.push_back(key);
+        block.vertices.push_back(p_a + ((iso_level - d_a) / (d_b - d_a)) * (p_b - p_a));
+        block.intensities.push_back(intensity);
+        block.weights.push_back(1);
+        return id;
+    }
+
+    static void computeVertexNormals(IndexedSurfaceMesh& mesh)
+    {
+        mesh.normals.assign(mesh.vertices.size(), Eigen::Vector3f::Zero());
+        for(size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            const Eigen::Vector3f& p1 = mesh.vertices[mesh.indices[i]];
+            const Eigen::Vector3f& p2 = mesh.vertices[mesh.indices[i+1]];
+            const Eigen::Vector3f& p3 = mesh.vertices[mesh.indices[i+2]];
+
+            // the length of the cross product weights the normal by the triangle area
+            Eigen::Vector3f normal = (p2 - p1).cross(p3 - p1);
+            if(!normal.allFinite())
+                continue;
+            for(int j = 0; j < 3; j++)
+                mesh.normals[mesh.indices[i+j]] += normal;
+        }
+
+        for(Eigen::Vector3f& normal : mesh.normals)
+        {
+            float norm = normal.norm();
+            if(norm > 0.f)
+                normal /= norm;
+        }
     }
 
 protected:
@@ -175,7 +460,13 @@ private:
     int32_t z_idx_min;
     int32_t z_idx_max;
     Eigen::Vector3f voxel_res;
-    std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > vertices;
+
+    /** cached blocks and the map modification stamp they are based on */
+    std::vector<MeshBlock> blocks;
+    Eigen::Vector2i block_grid_size;
+    bool valid;
+    uint64_t last_stamp;
+    uint64_t revision;
 };
 
 }}
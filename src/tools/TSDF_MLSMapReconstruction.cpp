@@ -31,23 +31,109 @@ using namespace maps::grid;
 
 void TSDF_MLSMapReconstruction::reconstruct(MLSMapPrecalculated& output)
 {
-    std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > surfaces;
-    std::vector<float> intensities;
-    reconstructSurfaces(surfaces, intensities, false);
+    updateBlocks();
+    const std::vector<MeshBlock>& blocks = getMeshBlocks();
 
-    output = MLSMapPrecalculated(tsdf_map->getNumCells() + maps::grid::Vector2ui(1,1), tsdf_map->getResolution(), MLSConfig());
-    output.getLocalFrame().translation() << 0.5*tsdf_map->getResolution(), 0;
+    base::Transform3d frame = base::Transform3d::Identity();
+    frame.translation() << 0.5*tsdf_map->getResolution(), 0;
+    frame = frame * tsdf_map->getLocalFrame();
+    const Vector2ui num_cells = tsdf_map->getNumCells() + maps::grid::Vector2ui(1,1);
+
+    bool rebuild = output_data != output.getLocalMapData().get() || output.getNumCells() != num_cells ||
+                   !output.getLocalFrame().matrix().isApprox(output_frame.matrix()) || block_revisions.size() != blocks.size();
+    if(rebuild)
+    {
+        output = MLSMapPrecalculated(num_cells, tsdf_map->getResolution(), MLSConfig());
+        block_patches.assign(blocks.size(), PatchList());
+        block_revisions.assign(blocks.size(), 0);
+    }
+
+    std::vector<int> updated_blocks;
+    for(size_t i = 0; i < blocks.size(); i++)
+    {
+        if(block_revisions[i] != blocks[i].revision)
+            updated_blocks.push_back(i);
+    }
+
+    // collect the cells covered by the previous and the new patches of the updated blocks
+    std::unordered_set<size_t> cleared_cells;
+    for(int block_id : updated_blocks)
+    {
+        for(const std::pair<Index, Patch>& patch : block_patches[block_id])
+            cleared_cells.insert(patch.first.x() + patch.first.y() * num_cells.x());
+    }
+
+    for(int block_id : updated_blocks)
+    {
+        computePatches(blocks[block_id], output, block_patches[block_id]);
+        for(const std::pair<Index, Patch>& patch : block_patches[block_id])
+            cleared_cells.insert(patch.first.x() + patch.first.y() * num_cells.x());
+        block_revisions[block_id] = blocks[block_id].revision;
+    }
+
+    if(rebuild)
+    {
+        for(const PatchList& patches : block_patches)
+        {
+            for(const std::pair<Index, Patch>& patch : patches)
+                output.at(patch.first).insert(patch.second);
+        }
+    }
+    else if(!updated_blocks.empty())
+    {
+        for(size_t cell : cleared_cells)
+            output.at(cell % num_cells.x(), cell / num_cells.x()).clear();
+
+        // the cleared cells can also contain patches of the neighboring blocks
+        const Eigen::Vector2i num_blocks = tsdf_map->getNumBlocks().cast<int>();
+        std::vector<bool> affected_blocks(blocks.size(), false);
+        for(int block_id : updated_blocks)
+        {
+            const Eigen::Vector2i block_idx(block_id % num_blocks.x(), block_id / num_blocks.x());
+            for(int y = std::max(block_idx.y() - 1, 0); y <= std::min(block_idx.y() + 1, num_blocks.y() - 1); y++)
+            {
+                for(int x = std::max(block_idx.x() - 1, 0); x <= std::min(block_idx.x() + 1, num_blocks.x() - 1); x++)
+                    affected_blocks[x + y * num_blocks.x()] = true;
+            }
+        }
+
+        // insert in block order to get the same result as a full reconstruction
+        for(size_t i = 0; i < blocks.size(); i++)
+        {
+            if(!affected_blocks[i])
+                continue;
+            for(const std::pair<Index, Patch>& patch : block_patches[i])
+            {
+                if(cleared_cells.count(patch.first.x() + patch.first.y() * num_cells.x()))
+                    output.at(patch.first).insert(patch.second);
+            }
+        }
+    }
+
+    // set local frame
+    output.getLocalFrame() = frame;
+    output_frame = frame;
+    output_data = output.getLocalMapData().get();
+}
+
+void TSDF_MLSMapReconstruction::computePatches(const MeshBlock& block, const MLSMapPrecalculated& output, PatchList& patches) const
+{
+    patches.clear();
+
+    // patches are computed in the grid frame of the output map
+    Eigen::Vector3d offset;
+    offset << 0.5*tsdf_map->getResolution(), 0;
 
     Eigen::Vector3f p1, p2, p3;
     Index idx;
     Eigen::Vector3f center;
     Eigen::Vector3f normal;
     float min_z, max_z;
-    for(unsigned i = 0; i < surfaces.size(); i += 3)
+    for(unsigned i = 0; i < block.indices.size(); i += 3)
     {
-        p1 = surfaces[i];
-        p2 = surfaces[i+1];
-        p3 = surfaces[i+2];
+        p1 = block.vertices[block.indices[i]];
+        p2 = block.vertices[block.indices[i+1]];
+        p3 = block.vertices[block.indices[i+2]];
         normal = (p2 - p1).cross(p3 - p1);
         normal.normalize();
 
@@ -63,11 +149,9 @@ void TSDF_MLSMapReconstruction::reconstruct(MLSMapPrecalculated& output)
         max_z = std::max(p1.z(), std::max(p2.z(), p3.z()));
 
         Eigen::Vector3d pos_diff;
-        if(output.toGrid(center.cast<double>(), idx, pos_diff))
+        if(output.toGridLocal(center.cast<double>() + offset, idx, pos_diff))
         {
-            SurfacePatch< MLSConfig::PRECALCULATED > patch(pos_diff.cast<float>(), normal, min_z, max_z);
-            // insert as new patch
-            output.at(idx).insert(patch);
+            patches.push_back(std::make_pair(idx, Patch(pos_diff.cast<float>(), normal, min_z, max_z)));
         }
         else
         {
@@ -77,7 +161,4 @@ void TSDF_MLSMapReconstruction::reconstruct(MLSMapPrecalculated& output)
             throw std::runtime_error(stream.str());
         }
     }
-
-    // set local frame
-    output.getLocalFrame() = output.getLocalFrame() * tsdf_map->getLocalFrame();
 }
@@ -31,15 +31,35 @@
 
 #include "TSDFSurfaceReconstruction.hpp"
 
+#include <unordered_set>
+
 namespace maps { namespace tools
 {
 
 class TSDF_MLSMapReconstruction : public TSDFSurfaceReconstruction<maps::grid::MLSMapPrecalculated>
 {
 public:
-    TSDF_MLSMapReconstruction() : TSDFSurfaceReconstruction<maps::grid::MLSMapPrecalculated>() {}
+    TSDF_MLSMapReconstruction() : TSDFSurfaceReconstruction<maps::grid::MLSMapPrecalculated>(), output_data(NULL) {}
 
+    /**
+     * Updates the MLS map with the surfaces of the modified blocks of the TSDF map.
+     * If the given map is not the result of the previous call it is rebuilt completely.
+     */
     void reconstruct(maps::grid::MLSMapPrecalculated &output);
+
+private:
+    typedef maps::grid::SurfacePatch<maps::grid::MLSConfig::PRECALCULATED> Patch;
+    typedef std::vector< std::pair<maps::grid::Index, Patch> > PatchList;
+
+    void computePatches(const MeshBlock& block, const maps::grid::MLSMapPrecalculated& output, PatchList& patches) const;
+
+    /** surface patches of each mesh block and the block revision they are based on */
+    std::vector<PatchList> block_patches;
+    std::vector<uint64_t> block_revisions;
+
+    /** identifies the output map of the previous call */
+    const maps::LocalMapData* output_data;
+    base::Transform3d output_frame;
 };
 
 }}
@@ -0,0 +1,555 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+/**
+ * Microbenchmarks of the hot paths of the maps library.
+ *
+ * Every benchmark is run once to warm up and then repeatedly, the median
+ * time of the repetitions is reported as the rate of processed items
+ * (points, cells, queries) per second. The results are printed and
+ * optionally written as JSON; a JSON file of a previous run can be given as
+ * baseline, the run then fails if a benchmark got slower than the tolerance.
+ *
+ * Usage: maps_benchmarks [--output FILE] [--baseline FILE] [--tolerance FRACTION]
+ *                        [--repetitions N] [--filter SUBSTRING]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include <maps/geometric/ContourMap.hpp>
+#include <maps/grid/MLSMap.hpp>
+#include <maps/grid/MLSCompactCodec.hpp>
+#include <maps/grid/TiledSerialization.hpp>
+#include <maps/grid/OccupancyGridMap.hpp>
+#include <maps/grid/TSDFVolumetricMap.hpp>
+#include <maps/grid/TraversabilityGrid.hpp>
+#include <maps/tools/MLSToSlopes.hpp>
+#include <maps/tools/SimpleTraversability.hpp>
+#include <maps/tools/TSDFRaycaster.hpp>
+#include <maps/tools/TraversabilityGrassfire.hpp>
+
+#include "../tools/GeneratePointclouds.hpp"
+#include "../common/GenerateMLS.hpp"
+
+using namespace ::maps::grid;
+using namespace ::maps::tools;
+
+struct Benchmark
+{
+    std::string name;
+    /** Name of the items counted by the rate, e.g. points */
+    std::string unit;
+    /** Runs the benchmark once and returns the number of processed items */
+    std::function<size_t ()> run;
+};
+
+struct Result
+{
+    std::string name;
+    std::string unit;
+    size_t items;
+    int repetitions;
+    double median;
+    double min;
+    double rate;
+    double baseline_rate;
+};
+
+/** Scans of the simulated LIDAR from random poses inside a randomly rotated box */
+struct LidarScans
+{
+    std::vector<maps::PointCloud> clouds;
+    std::vector<base::Transform3d> poses;
+    size_t num_points;
+
+    LidarScans(int num_scans)
+        : num_points(0)
+    {
+        typedef Eigen::Hyperplane<double, 3> Plane;
+        const Eigen::VectorXd latitudes = Eigen::VectorXd::LinSpaced(32, -16*M_PI/180, +16*M_PI/180);
+        const Eigen::VectorXd longitudes = Eigen::VectorXd::LinSpaced(360, -M_PI, +M_PI);
+        maps::LIDARSimulator lidar(latitudes, longitudes);
+        std::vector<Plane> scene;
+        Eigen::Quaterniond q; q.coeffs().setRandom(); q.normalize();
+        for(int i = 0; i < 3; ++i)
+        {
+            scene.push_back(Plane(q * Eigen::Vector3d::Unit(i), -2.0));
+            scene.push_back(Plane(q * Eigen::Vector3d::Unit(i), 2.0));
+        }
+
+        Eigen::ArrayXXd ranges;
+        clouds.resize(num_scans);
+        for(int i = 0; i < num_scans; ++i)
+        {
+            base::Transform3d pose = base::Transform3d::Identity();
+            pose.translation().setRandom();
+            Eigen::Quaterniond r; r.coeffs().setRandom(); r.normalize();
+            pose.linear() = r.toRotationMatrix();
+            poses.push_back(pose);
+
+            // the points are computed from the ranges, since the organized point cloud
+            // of getRanges depends on the resize behaviour of the PCL version
+            lidar.getRanges(ranges, scene, pose);
+            for(int r = 0; r < ranges.rows(); ++r)
+            {
+                for(int c = 0; c < ranges.cols(); ++c)
+                {
+                    const Eigen::Vector3d dir(std::cos(latitudes(r)) * std::cos(longitudes(c)),
+                                              std::cos(latitudes(r)) * std::sin(longitudes(c)), std::sin(latitudes(r)));
+                    pcl::PointXYZ point;
+                    point.getVector3fMap() = (dir * ranges(r, c)).cast<float>();
+                    clouds[i].push_back(point);
+                }
+            }
+            clouds[i].sensor_origin_ = Eigen::Vector4f::Zero();
+            num_points += clouds[i].size();
+        }
+    }
+};
+
+/** Kalman MLS of a wave surface, as used by the traversability tools */
+static MLSMapKalman generateKalmanWaves()
+{
+    MLSConfig mls_config;
+    mls_config.updateModel = MLSConfig::KALMAN;
+    MLSMapKalman mls(Vector2ui(300, 300), Vector2d(0.05, 0.05), mls_config);
+
+    for (unsigned int y = 0; y < mls.getNumCells().y(); ++y)
+    {
+        for (unsigned int x = 0; x < mls.getNumCells().x(); ++x)
+        {
+            const float z = 0.2f * std::cos(x * 0.05 * M_PI / 2.5) * std::sin(y * 0.05 * M_PI / 2.5);
+            mls.mergePatch(Index(x, y), MLSMapKalman::Patch(z, 0.01f));
+        }
+    }
+    return mls;
+}
+
+/** TSDF of a horizontal plane at z = 0.03 */
+static TSDFVolumetricMap::Ptr generateTSDFPlane()
+{
+    TSDFVolumetricMap::Ptr tsdf(new TSDFVolumetricMap(Vector2ui(40, 40), Vector3d(0.1, 0.1, 0.1), 0.3f));
+    Eigen::Vector3i idx;
+    for(idx.y() = 0; idx.y() < 40; idx.y()++)
+        for(idx.x() = 0; idx.x() < 40; idx.x()++)
+            for(idx.z() = -10; idx.z() < 20; idx.z()++)
+                tsdf->getVoxelCell(idx) = TSDFPatch((idx.z() + 0.5) * 0.1 - 0.03, 0.0001f);
+    return tsdf;
+}
+
+/** Random segments of up to 1m length within a cube of 200m */
+static maps::geometric::ContourMap generateContour()
+{
+    maps::geometric::ContourMap contour;
+    std::srand(7);
+    for(int i = 0; i < 20000; ++i)
+    {
+        const Eigen::Vector3d start = Eigen::Vector3d::Random() * 100.;
+        contour.push_back(maps::geometric::LineSegment3d(start, start + Eigen::Vector3d::Random()));
+    }
+    return contour;
+}
+
+/** Nearest segment queries at random positions */
+static Benchmark contourFindNearest(const std::string& name, const maps::geometric::ContourMap& contour, size_t num_queries)
+{
+    return Benchmark{name, "queries", [&contour, num_queries]()
+    {
+        std::srand(7);
+        size_t found = 0;
+        for(size_t i = 0; i < num_queries; ++i)
+            found += contour.findNearest(Eigen::Vector3d::Random() * 100., 1).size();
+        return found == num_queries ? num_queries : 0;
+    }};
+}
+
+template<enum MLSConfig::update_model Model>
+static Benchmark mlsIngest(const std::string& name, const LidarScans& scans)
+{
+    return Benchmark{name, "points", [&scans]()
+    {
+        MLSConfig mls_config;
+        mls_config.updateModel = Model;
+        mls_config.gapSize = 0.125f;
+        MLSMap<Model> mls(Vector2ui(200, 200), Vector2d(0.125, 0.125), mls_config);
+        mls.getLocalFrame().translation() << 0.5 * mls.getSize(), 0;
+        for(size_t i = 0; i < scans.clouds.size(); ++i)
+            mls.mergePointCloud(scans.clouds[i], scans.poses[i]);
+        return scans.num_points;
+    }};
+}
+
+/** Input data of the benchmarks, generated once before running them */
+struct BenchmarkData
+{
+    LidarScans scans;
+    MLSMapKalman kalman_waves;
+    MLSMapSloped sloped_waves;
+    GridMapF slopes, max_steps;
+    std::vector<uint8_t> compact_waves;
+    TSDFVolumetricMap::Ptr tsdf_plane;
+    maps::geometric::ContourMap contour, indexed_contour;
+
+    BenchmarkData()
+        : scans(8)
+        , kalman_waves(generateKalmanWaves())
+        , sloped_waves(generateWaves())
+        , tsdf_plane(generateTSDFPlane())
+        , contour(generateContour())
+        , indexed_contour(contour)
+    {
+        MLSToSlopes::computeSlopes(kalman_waves, slopes);
+        MLSToSlopes::computeMaxSteps(kalman_waves, max_steps);
+        MLSCompactCodec().encode(kalman_waves, compact_waves);
+        indexed_contour.enableSpatialIndex(2.);
+    }
+};
+
+static std::vector<Benchmark> createBenchmarks(const BenchmarkData& data)
+{
+    std::vector<Benchmark> benchmarks;
+    const LidarScans& scans = data.scans;
+    const MLSMapKalman& kalman_waves = data.kalman_waves;
+    const MLSMapSloped& sloped_waves = data.sloped_waves;
+
+    // point cloud ingest, BASE and PRECALCULATED patches can not be created from points
+    benchmarks.push_back(mlsIngest<MLSConfig::SLOPE>("mls_slope_merge_pointcloud", scans));
+    benchmarks.push_back(mlsIngest<MLSConfig::KALMAN>("mls_kalman_merge_pointcloud", scans));
+
+    benchmarks.push_back(Benchmark{"mls_precalculated_from_slope", "cells", [&sloped_waves]()
+    {
+        const MLSMapPrecalculated mls(sloped_waves);
+        return size_t(mls.getNumCells().prod());
+    }});
+
+    benchmarks.push_back(Benchmark{"occupancy_merge_pointcloud", "points", [&scans]()
+    {
+        OccupancyGridMap grid(Vector2ui(200, 200), Vector3d(0.125, 0.125, 0.05), OccupancyConfiguration());
+        grid.getLocalFrame().translation() << 0.5 * grid.getSize(), 0;
+        for(size_t i = 0; i < scans.clouds.size(); ++i)
+            grid.mergePointCloud(scans.clouds[i], scans.poses[i]);
+        return scans.num_points;
+    }});
+
+    benchmarks.push_back(Benchmark{"tsdf_merge_pointcloud", "points", [&scans]()
+    {
+        TSDFVolumetricMap tsdf(Vector2ui(100, 100), Vector3d(0.1, 0.1, 0.1), 0.2f);
+        tsdf.getLocalFrame().translation() << 0.5 * tsdf.getSize(), 0;
+        for(size_t i = 0; i < scans.clouds.size(); ++i)
+            tsdf.mergePointCloud(scans.clouds[i], scans.poses[i]);
+        return scans.num_points;
+    }});
+
+    benchmarks.push_back(Benchmark{"tsdf_raycast", "rays", [&data]()
+    {
+        TSDFRaycaster raycaster;
+        raycaster.setTSDFMap(data.tsdf_plane);
+        const RayPattern rays = RayPattern::createPinhole(320, 240, 250.f, 250.f, 159.5f, 119.5f);
+        base::Transform3d pose(Eigen::AngleAxisd(M_PI, Eigen::Vector3d::UnitX()));
+        pose.translation() << 2.0, 2.0, 1.5;
+        RaycastResult result;
+        raycaster.raycast(rays, pose, result);
+        return rays.size();
+    }});
+
+    // traversability tools
+    benchmarks.push_back(Benchmark{"mls_to_slopes", "cells", [&kalman_waves]()
+    {
+        GridMapF slopes, max_steps;
+        if(!MLSToSlopes::computeSlopes(kalman_waves, slopes) || !MLSToSlopes::computeMaxSteps(kalman_waves, max_steps))
+            throw std::runtime_error("MLSToSlopes failed");
+        return size_t(kalman_waves.getNumCells().prod());
+    }});
+
+    benchmarks.push_back(Benchmark{"simple_traversability", "cells", [&data]()
+    {
+        SimpleTraversability traversability(SimpleTraversabilityConfig(0.5, 10, 0.3, 0.5, 0.2));
+        TraversabilityGrid result;
+        if(!traversability.calculateTraversability(result, data.slopes, data.max_steps))
+            throw std::runtime_error("SimpleTraversability failed");
+        return size_t(data.slopes.getNumCells().prod());
+    }});
+
+    benchmarks.push_back(Benchmark{"traversability_grassfire", "cells", [&kalman_waves]()
+    {
+        TraversabilityGrassfire grassfire(TraversabilityGrassfireConfig(0.15, 0.8, 1.2, 10, 0.1, 1.0));
+        TraversabilityGrid result;
+        if(!grassfire.calculateTraversability(result, kalman_waves, Eigen::Vector3d(7.5, 7.5, 0.0)))
+            throw std::runtime_error("TraversabilityGrassfire found no drive plane");
+        return size_t(kalman_waves.getNumCells().prod());
+    }});
+
+    // queries
+    benchmarks.push_back(Benchmark{"mls_intersects_aabb", "queries", [&sloped_waves]()
+    {
+        const size_t num_queries = 20000;
+        const Eigen::Vector2d size = sloped_waves.getSize();
+        std::srand(7);
+        size_t hits = 0;
+        for(size_t i = 0; i < num_queries; ++i)
+        {
+            const Eigen::Vector3d center((Eigen::Vector3d::Random() + Eigen::Vector3d::Ones()) * 0.5);
+            const Eigen::Vector3d min(center.x() * size.x(), center.y() * size.y(), center.z() * 2.0 - 1.0);
+            hits += sloped_waves.intersectsAABB(Eigen::AlignedBox3d(min, min + Eigen::Vector3d(0.5, 0.5, 0.2)));
+        }
+        return hits <= num_queries ? num_queries : 0;
+    }});
+
+    benchmarks.push_back(Benchmark{"mls_intersect_aabb", "queries", [&sloped_waves]()
+    {
+        const size_t num_queries = 2000;
+        const Eigen::Vector2d size = sloped_waves.getSize();
+        std::srand(7);
+        size_t patches = 0;
+        for(size_t i = 0; i < num_queries; ++i)
+        {
+            const Eigen::Vector3d center((Eigen::Vector3d::Random() + Eigen::Vector3d::Ones()) * 0.5);
+            const Eigen::Vector3d min(center.x() * size.x(), center.y() * size.y(), center.z() * 2.0 - 1.0);
+            patches += sloped_waves.intersectAABB(Eigen::AlignedBox3d(min, min + Eigen::Vector3d(0.5, 0.5, 0.2))).size();
+        }
+        return patches != size_t(-1) ? num_queries : 0;
+    }});
+
+    benchmarks.push_back(contourFindNearest("contour_find_nearest_linear", data.contour, 100));
+    benchmarks.push_back(contourFindNearest("contour_find_nearest_indexed", data.indexed_contour, 1000));
+
+    // serialization
+    benchmarks.push_back(Benchmark{"mls_serialization_roundtrip", "cells", [&sloped_waves]()
+    {
+        std::stringstream stream;
+        {
+            boost::archive::binary_oarchive oa(stream);
+            oa << sloped_waves;
+        }
+        MLSMapSloped loaded;
+        {
+            boost::archive::binary_iarchive ia(stream);
+            ia >> loaded;
+        }
+        return size_t(loaded.getNumCells().prod());
+    }});
+
+    benchmarks.push_back(Benchmark{"mls_tiled_serialization_roundtrip", "cells", [&kalman_waves]()
+    {
+        std::stringstream stream;
+        saveTiled(kalman_waves, stream);
+        MLSMapKalman loaded;
+        loadTiled(stream, loaded);
+        return size_t(loaded.getNumCells().prod());
+    }});
+
+    benchmarks.push_back(Benchmark{"mls_compact_encode", "cells", [&kalman_waves]()
+    {
+        std::vector<uint8_t> encoded;
+        MLSCompactCodec().encode(kalman_waves, encoded);
+        return size_t(kalman_waves.getNumCells().prod());
+    }});
+
+    benchmarks.push_back(Benchmark{"mls_compact_decode", "cells", [&data]()
+    {
+        MLSMapKalman decoded;
+        MLSCompactCodec::decode(data.compact_waves, decoded);
+        return size_t(decoded.getNumCells().prod());
+    }});
+
+    return benchmarks;
+}
+
+static Result runBenchmark(const Benchmark& benchmark, int repetitions)
+{
+    typedef std::chrono::steady_clock Clock;
+    Result result{benchmark.name, benchmark.unit, 0, repetitions, 0., 0., 0., 0.};
+
+    // warm up caches and allocators
+    result.items = benchmark.run();
+
+    std::vector<double> times;
+    for(int i = 0; i < repetitions; ++i)
+    {
+        const Clock::time_point start = Clock::now();
+        result.items = benchmark.run();
+        times.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    result.median = times[times.size() / 2];
+    result.min = times.front();
+    result.rate = result.median > 0. ? result.items / result.median : 0.;
+    return result;
+}
+
+/** Reads the rates of the benchmarks from a JSON file written by writeJSON */
+static std::map<std::string, double> readBaseline(const std::string& filename)
+{
+    std::ifstream file(filename.c_str());
+    if(!file)
+        throw std::runtime_error("Could not open baseline file " + filename);
+    std::stringstream content;
+    content << file.rdbuf();
+
+    std::map<std::string, double> rates;
+    const std::string json = content.str();
+    static const std::regex entry("\"name\"\\s*:\\s*\"([^\"]*)\"[^}]*?\"rate\"\\s*:\\s*([-+0-9.eE]+)");
+    for(std::sregex_iterator it(json.begin(), json.end(), entry), end; it != end; ++it)
+        rates[(*it)[1]] = std::strtod((*it)[2].str().c_str(), NULL);
+    return rates;
+}
+
+static void writeJSON(std::ostream& out, const std::vector<Result>& results, bool with_baseline)
+{
+    out << std::setprecision(9);
+    out << "{\n  \"benchmarks\": [\n";
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"unit\": \"" << r.unit << "\", \"items\": " << r.items
+            << ", \"repetitions\": " << r.repetitions << ", \"median_seconds\": " << r.median
+            << ", \"min_seconds\": " << r.min << ", \"rate\": " << r.rate;
+        if(with_baseline && r.baseline_rate > 0.)
+            out << ", \"baseline_rate\": " << r.baseline_rate << ", \"speedup\": " << r.rate / r.baseline_rate;
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static void usage()
+{
+    std::cerr << "Usage: maps_benchmarks [--output FILE] [--baseline FILE] [--tolerance FRACTION]\n"
+                 "                       [--repetitions N] [--filter SUBSTRING]\n";
+}
+
+static int run(int argc, char** argv)
+{
+    std::string output, baseline, filter;
+    double tolerance = 0.1;
+    int repetitions = 5;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if(arg == "--help" || arg == "-h")
+        {
+            usage();
+            return 0;
+        }
+        if(i + 1 >= argc)
+        {
+            usage();
+            return 2;
+        }
+        const std::string value = argv[++i];
+        if(arg == "--output")
+            output = value;
+        else if(arg == "--baseline")
+            baseline = value;
+        else if(arg == "--tolerance")
+            tolerance = std::atof(value.c_str());
+        else if(arg == "--repetitions")
+            repetitions = std::max(1, std::atoi(value.c_str()));
+        else if(arg == "--filter")
+            filter = value;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    std::map<std::string, double> baseline_rates;
+    if(!baseline.empty())
+        baseline_rates = readBaseline(baseline);
+
+    // the generated data is the same for every run
+    std::srand(42);
+    const BenchmarkData data;
+
+    bool regression = false;
+    std::vector<Result> results;
+    for(const Benchmark& benchmark : createBenchmarks(data))
+    {
+        if(benchmark.name.find(filter) == std::string::npos)
+            continue;
+
+        Result result = runBenchmark(benchmark, repetitions);
+        std::cout << std::left << std::setw(36) << result.name << std::right << std::setw(14) << std::fixed << std::setprecision(0)
+                  << result.rate << " " << result.unit << "/s" << std::setw(12) << std::setprecision(3) << result.median * 1e3 << " ms";
+
+        std::map<std::string, double>::const_iterator base = baseline_rates.find(result.name);
+        if(base != baseline_rates.end() && base->second > 0.)
+        {
+            result.baseline_rate = base->second;
+            const double speedup = result.rate / result.baseline_rate;
+            std::cout << std::setw(10) << std::setprecision(2) << speedup << "x";
+            if(speedup < 1. - tolerance)
+            {
+                std::cout << "  REGRESSION";
+                regression = true;
+            }
+        }
+        std::cout << std::endl;
+        results.push_back(result);
+    }
+
+    if(!output.empty())
+    {
+        std::ofstream file(output.c_str());
+        if(!file)
+        {
+            std::cerr << "Could not write " << output << std::endl;
+            return 2;
+        }
+        writeJSON(file, results, !baseline_rates.empty());
+    }
+
+    return regression ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        return run(argc, argv);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "maps_benchmarks: " << e.what() << std::endl;
+        return 2;
+    }
+}
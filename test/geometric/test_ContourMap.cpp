@@ -30,10 +30,10 @@
 /** Geometric Contour Map **/
 #include <maps/geometric/Point.hpp>
 #include <maps/geometric/ContourMap.hpp>
+#include <maps/operations/ContourRasterization.hpp>
 
 #include <boost/math/special_functions/fpclassify.hpp>
 
-#include <chrono>
 
 using namespace ::maps::geometric;
 
@@ -89,3 +89,124 @@ BOOST_AUTO_TEST_CASE(test_contour_map_copy)
     delete contour_copy;
 }
 
+
+static void checkSameQueries(const ContourMap& indexed, const ContourMap& linear, const Eigen::Vector3d& position)
+{
+    std::vector<size_t> nearest = indexed.findNearest(position, 5);
+    std::vector<size_t> expected = linear.findNearest(position, 5);
+    BOOST_REQUIRE_EQUAL(nearest.size(), expected.size());
+    for (size_t i = 0; i < nearest.size(); ++i)
+        BOOST_CHECK_CLOSE(indexed[nearest[i]].squaredSegmentDistance(position), linear[expected[i]].squaredSegmentDistance(position), 1e-6);
+
+    BOOST_CHECK(indexed.findInRadius(position, 2.5) == linear.findInRadius(position, 2.5));
+
+    Eigen::AlignedBox3d box(position, position + Eigen::Vector3d(3., 1., 0.5));
+    BOOST_CHECK(indexed.findInBox(box) == linear.findInBox(box));
+}
+
+BOOST_AUTO_TEST_CASE(test_contour_map_spatial_queries)
+{
+    ContourMap contour;
+    srand(7);
+    for (unsigned int i = 0; i < 20000; ++i)
+    {
+        Eigen::Vector3d start = Eigen::Vector3d::Random() * 100.;
+        contour.push_back(LineSegment3d(start, start + Eigen::Vector3d::Random()));
+    }
+
+    ContourMap indexed(contour);
+    indexed.enableSpatialIndex(2.);
+    BOOST_CHECK(indexed.hasSpatialIndex());
+
+    for (int i = 0; i < 50; ++i)
+        checkSameQueries(indexed, contour, Eigen::Vector3d::Random() * 120.);
+
+    // a position far outside of the elements
+    checkSameQueries(indexed, contour, Eigen::Vector3d(1000., -500., 0.));
+
+    // the index follows modifications
+    LineSegment3d added(Eigen::Vector3d(200., 200., 0.), Eigen::Vector3d(201., 200., 0.));
+    indexed.push_back(added);
+    contour.push_back(added);
+    BOOST_CHECK_EQUAL(indexed.findNearest(Eigen::Vector3d(200.5, 200.1, 0.), 1).front(), 20000);
+    indexed.erase(indexed.begin(), indexed.begin() + 100);
+    contour.erase(contour.begin(), contour.begin() + 100);
+    indexed.insert(indexed.begin() + 10, added);
+    contour.insert(contour.begin() + 10, added);
+    for (int i = 0; i < 20; ++i)
+        checkSameQueries(indexed, contour, Eigen::Vector3d::Random() * 120.);
+    BOOST_CHECK(indexed.findInRadius(Eigen::Vector3d(200.5, 200.1, 0.), 0.5) == std::vector<size_t>({10, 19901}));
+
+    // nearest queries with and without index give the same segments
+    for (int i = 0; i < 1000; ++i)
+    {
+        const Eigen::Vector3d position = Eigen::Vector3d::Random() * 100.;
+        BOOST_CHECK(indexed.findNearest(position, 1) == contour.findNearest(position, 1));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_linesegment_segment_distance)
+{
+    LineSegment3d segment(Eigen::Vector3d(0., 0., 0.), Eigen::Vector3d(2., 0., 0.));
+    BOOST_CHECK_CLOSE(segment.squaredSegmentDistance(Eigen::Vector3d(1., 1., 0.)), 1., 1e-9);
+    BOOST_CHECK_CLOSE(segment.squaredSegmentDistance(Eigen::Vector3d(3., 1., 0.)), 2., 1e-9);
+    BOOST_CHECK_CLOSE(segment.squaredSegmentDistance(Eigen::Vector3d(-1., 0., 0.)), 1., 1e-9);
+    BOOST_CHECK(intersects(segment, Eigen::AlignedBox3d(Eigen::Vector3d(1.5, -1., -1.), Eigen::Vector3d(3., 1., 1.))));
+    BOOST_CHECK(!intersects(segment, Eigen::AlignedBox3d(Eigen::Vector3d(2.5, -1., -1.), Eigen::Vector3d(3., 1., 1.))));
+}
+
+BOOST_AUTO_TEST_CASE(test_contour_map_rasterization)
+{
+    using namespace ::maps::grid;
+    using ::maps::operations::ContourRasterization;
+
+    ContourMap contour;
+    contour.push_back(LineSegment3d(Eigen::Vector3d(1.05, 1.05, 0.), Eigen::Vector3d(8.95, 1.05, 0.)));
+    contour.push_back(LineSegment3d(Eigen::Vector3d(1.05, 1.05, 2.), Eigen::Vector3d(8.95, 6.05, 2.)));
+    contour.push_back(LineSegment3d(Eigen::Vector3d(-5., -5., 0.), Eigen::Vector3d(-4., -4., 0.)));
+
+    GridMap<float> occupancy(Vector2ui(100, 70), Vector2d(0.1, 0.1), 0.f);
+    ContourRasterization::rasterize(contour, occupancy, ContourRasterization::SUPERCOVER, 1.f, 16);
+
+    // the cells of a diagonal segment are connected by edges
+    for (int y = 0; y < 70; ++y)
+    {
+        for (int x = 0; x < 100; ++x)
+        {
+            const Eigen::Vector2d center((x + 0.5) * 0.1, (y + 0.5) * 0.1);
+            const double distance = std::sqrt(std::min(contour[0].squaredSegmentDistance(Eigen::Vector3d(center.x(), center.y(), 0.)),
+                                                       contour[1].squaredSegmentDistance(Eigen::Vector3d(center.x(), center.y(), 2.))));
+            // touched cells are within half a cell diagonal, cells further than that are free
+            if (occupancy.at(x, y) == 1.f)
+                BOOST_CHECK_LE(distance, 0.0708);
+            else
+                BOOST_CHECK_GT(distance, 0.0353);
+        }
+    }
+    BOOST_CHECK_EQUAL(occupancy.at(10, 10), 1.f);
+    BOOST_CHECK_EQUAL(occupancy.at(89, 10), 1.f);
+    BOOST_CHECK_EQUAL(occupancy.at(90, 10), 0.f);
+
+    GridMap<float> antialiased(Vector2ui(100, 70), Vector2d(0.1, 0.1), 0.f);
+    ContourRasterization::rasterize(contour, antialiased, ContourRasterization::ANTI_ALIASED, 1.f, 16);
+    BOOST_CHECK_CLOSE(antialiased.at(50, 10), 1.f, 1e-3);
+    BOOST_CHECK_EQUAL(antialiased.at(50, 11), 0.f);
+    // the diagonal segment passes a third of a cell above the center of this cell
+    BOOST_CHECK_GT(antialiased.at(50, 35), 0.6f);
+    BOOST_CHECK_LT(antialiased.at(50, 35), 0.8f);
+
+    GridMap<float> distance(Vector2ui(100, 70), Vector2d(0.1, 0.1), 0.f);
+    distance.translate(Eigen::Vector3d(0.2, 0., 0.));
+    ContourRasterization::computeDistance(contour, distance, 1.0, 16);
+    for (int y = 0; y < 70; ++y)
+    {
+        for (int x = 0; x < 100; ++x)
+        {
+            Eigen::Vector3d center;
+            distance.fromGrid(Index(x, y), center);
+            const double expected = std::min(1.0, std::sqrt(std::min(contour[0].squaredSegmentDistance(center),
+                                                                     contour[1].squaredSegmentDistance(Eigen::Vector3d(center.x(), center.y(), 2.)))));
+            BOOST_REQUIRE_SMALL(distance.at(x, y) - expected, 1e-5);
+        }
+    }
+}
@@ -63,3 +63,47 @@ BOOST_AUTO_TEST_CASE(test_mls_serialization)
 
 
 }
+
+BOOST_AUTO_TEST_CASE(test_mls_batch_queries)
+{
+    MLSMapSloped mls = generateWaves();
+    mls.getLocalFrame().translate(Eigen::Vector3d(0.3, -0.2, 0.1));
+
+    const int num_points = 2000;
+    Eigen::Matrix3Xd points = Eigen::Matrix3Xd::Random(3, num_points);
+    points.topRows<2>() *= 0.6 * mls.getSize().maxCoeff();
+
+    Eigen::VectorXd surface_pos;
+    std::vector<uint8_t> surface_valid;
+    mls.getClosestSurfacePos(points, surface_pos, surface_valid);
+
+    Eigen::Matrix3Xd contact_points;
+    std::vector<uint8_t> contact_valid;
+    mls.getClosestContactPoints(points, contact_points, contact_valid);
+
+    BOOST_REQUIRE_EQUAL(surface_pos.size(), num_points);
+    BOOST_REQUIRE_EQUAL(contact_points.cols(), num_points);
+    int num_valid = 0;
+    for(int i = 0; i < num_points; i++)
+    {
+        double z;
+        bool valid = mls.getClosestSurfacePos(points.col(i), z);
+        BOOST_REQUIRE_EQUAL((bool)surface_valid[i], valid);
+        if(valid)
+        {
+            BOOST_CHECK_SMALL(surface_pos[i] - z, 1e-6);
+            num_valid++;
+        }
+        else
+            BOOST_CHECK(std::isnan(surface_pos[i]));
+
+        Eigen::Vector3d contact_point;
+        valid = mls.getClosestContactPoint(points.col(i), contact_point);
+        BOOST_REQUIRE_EQUAL((bool)contact_valid[i], valid);
+        if(valid)
+            BOOST_CHECK(contact_points.col(i).isApprox(contact_point, 1e-6));
+    }
+    // some of the points are outside of the grid
+    BOOST_CHECK(num_valid > 0);
+    BOOST_CHECK(num_valid < num_points);
+}
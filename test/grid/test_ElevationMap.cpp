@@ -0,0 +1,75 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE GridTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/ElevationMap.hpp>
+
+using namespace ::maps::grid;
+
+BOOST_AUTO_TEST_CASE(test_elevation_surface_properties)
+{
+    ElevationMap elevation(Vector2ui(60, 40), Vector2d(0.1, 0.2));
+    for (size_t y = 0; y < 40; ++y)
+        for (size_t x = 0; x < 60; ++x)
+            elevation.at(x, y) = 0.02f * x * x - 0.3f * y;
+    elevation.at(30, 20) = ElevationMap::ELEVATION_DEFAULT;
+
+    SurfaceProperties properties;
+    elevation.computeSurfaceProperties(properties);
+
+    for (size_t y = 0; y < 40; ++y)
+    {
+        for (size_t x = 0; x < 60; ++x)
+        {
+            const Index idx(x, y);
+            const bool border = x == 0 || y == 0 || x == 59 || y == 39;
+            const bool missing_neighbour = (idx - Index(30, 20)).cwiseAbs().sum() == 1;
+            BOOST_REQUIRE_EQUAL(properties.valid.at(idx), !border && !missing_neighbour);
+            if (!properties.valid.at(idx))
+            {
+                BOOST_CHECK(std::isnan(properties.normal_z.at(idx)));
+                continue;
+            }
+
+            const Vector3d normal = elevation.getNormal(idx);
+            BOOST_CHECK_SMALL(normal.x() - properties.normal_x.at(idx), 1e-5);
+            BOOST_CHECK_SMALL(normal.y() - properties.normal_y.at(idx), 1e-5);
+            BOOST_CHECK_SMALL(normal.z() - properties.normal_z.at(idx), 1e-5);
+            BOOST_CHECK_SMALL(std::acos(normal.z()) - properties.slope.at(idx), 1e-3);
+            if (idx == Index(30, 20))
+                BOOST_CHECK(std::isnan(properties.curvature.at(idx)));
+            else
+                BOOST_CHECK_CLOSE(properties.curvature.at(idx), 4., 0.1);
+        }
+    }
+
+    ElevationMap small(Vector2ui(2, 5), Vector2d(0.1, 0.1));
+    small.computeSurfaceProperties(properties);
+    BOOST_CHECK_EQUAL(properties.valid.getNumCells(), Vector2ui(2, 5));
+    BOOST_CHECK_EQUAL(properties.valid.at(1, 1), 0);
+}
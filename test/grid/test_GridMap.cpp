@@ -341,6 +341,39 @@ BOOST_AUTO_TEST_CASE(test_grid_clear)
     delete grid;
 }
 
+BOOST_AUTO_TEST_CASE(test_grid_differs_from)
+{
+    GridMap<double> grid(Vector2ui(64, 64), Vector2d(0.1, 0.1), 0.);
+    grid.enableChangeTracking(16);
+
+    // copies continue the tracking, only the stamps of the modified tiles are compared
+    GridMap<double> copy = grid;
+    copy.at(20, 20) = 1.;
+    copy.markModified(Index(20, 20));
+    BOOST_CHECK(copy.differsFrom(grid, Index(16, 16), Index(32, 32)));
+    BOOST_CHECK(grid.differsFrom(copy, Index(16, 16), Index(32, 32)));
+    BOOST_CHECK(!copy.differsFrom(grid, Index(0, 0), Index(16, 64)));
+
+    // a different map of the same size is compared cell by cell, even if its tracker is further ahead
+    GridMap<double> other(Vector2ui(64, 64), Vector2d(0.1, 0.1), 0.);
+    other.enableChangeTracking(16);
+    for(int i = 0; i < 100; ++i)
+        other.markModified(Index(60, 60));
+    other.at(5, 5) = 2.;
+    BOOST_CHECK(other.getChangeTracker().getVersion() > copy.getChangeTracker().getVersion());
+    BOOST_CHECK(other.differsFrom(copy, Index(0, 0), Index(16, 16)));
+    BOOST_CHECK(other.differsFrom(copy, Index(16, 16), Index(32, 32)));
+    BOOST_CHECK(!other.differsFrom(copy, Index(32, 32), Index(64, 64)));
+
+    // restarting the tracking starts a new history
+    copy.enableChangeTracking(16);
+    BOOST_CHECK(!copy.differsFrom(grid, Index(0, 0), Index(16, 16)));
+    BOOST_CHECK(copy.differsFrom(grid, Index(16, 16), Index(32, 32)));
+
+    GridMap<double> smaller(Vector2ui(32, 32), Vector2d(0.1, 0.1), 0.);
+    BOOST_CHECK(smaller.differsFrom(grid, Index(0, 0), Index(16, 16)));
+}
+
 BOOST_AUTO_TEST_CASE(test_grid_move_complete)
 {
     Vector2ui num_cells(7, 5);
@@ -1502,3 +1535,56 @@ BOOST_AUTO_TEST_CASE(test_to_from_grid)
         }
     }
 }
+
+template<typename Scalar>
+void checkToGridBulk(const GridMap<char>& map, const Eigen::Affine3d& trafo)
+{
+    Eigen::Matrix<Scalar, 3, Eigen::Dynamic> points = (Eigen::Matrix3Xd::Random(3, 1000) * map.getSize().maxCoeff()).cast<Scalar>();
+    Eigen::Matrix2Xi indices;
+    Eigen::Matrix<Scalar, 3, Eigen::Dynamic> pos_in_cell, points_in_map;
+    std::vector<uint8_t> in_grid;
+    map.toGridBulk(points, trafo, indices, pos_in_cell, in_grid);
+    map.fromGridBulk(indices, pos_in_cell, points_in_map);
+
+    BOOST_REQUIRE_EQUAL(indices.cols(), points.cols());
+    BOOST_REQUIRE_EQUAL(in_grid.size(), (size_t)points.cols());
+    const double eps = std::is_same<Scalar, float>::value ? 1e-3 : 1e-9;
+    for(int i = 0; i < points.cols(); ++i)
+    {
+        Eigen::Vector3d trafo_p = trafo * points.col(i).template cast<double>();
+        Index idx;
+        Eigen::Vector3d pos_diff;
+        bool inside = map.toGrid(trafo_p, idx, pos_diff);
+
+        // points close to a cell border may end up in the neighboring cell due to rounding
+        if(((pos_diff.head<2>().cwiseAbs() - 0.5 * map.getResolution()).array().abs() < eps).any())
+            continue;
+        BOOST_CHECK_EQUAL(inside, in_grid[i] != 0);
+        if(!inside)
+            continue;
+        BOOST_CHECK_EQUAL(idx, Index(indices.col(i)));
+        BOOST_CHECK_SMALL((pos_diff - pos_in_cell.col(i).template cast<double>()).norm(), eps);
+        BOOST_CHECK_SMALL((trafo_p - points_in_map.col(i).template cast<double>()).norm(), eps);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_to_grid_bulk)
+{
+    for(int i=0; i<10; ++i)
+    {
+        GridMap<char> map(Vector2ui(100, 80), Eigen::Vector2d::Random().cwiseAbs() + Eigen::Vector2d(0.01, 0.01), 0);
+        map.getLocalFrame().linear() = Eigen::Quaterniond(Eigen::Vector4d::Random().normalized()).toRotationMatrix();
+        map.getLocalFrame().translation() = Eigen::Vector3d::Random();
+
+        Eigen::Affine3d trafo(Eigen::Quaterniond(Eigen::Vector4d::Random().normalized()));
+        trafo.translation() = Eigen::Vector3d::Random();
+
+        checkToGridBulk<double>(map, trafo);
+        checkToGridBulk<float>(map, trafo);
+    }
+
+    // float points on a large grid are converted in double precision
+    GridMap<char> large_map(Vector2ui(10000, 4), Vector2d(0.05, 0.05), 0);
+    large_map.translate(Eigen::Vector3d(-250., 0., 0.));
+    checkToGridBulk<float>(large_map, Eigen::Affine3d::Identity());
+}
@@ -207,3 +207,71 @@ BOOST_AUTO_TEST_CASE(test_gridmap_keys)
 
     delete grid_map;
 }
+
+BOOST_AUTO_TEST_CASE(test_gridmap_layer_handle)
+{
+    LayeredGridMap grid_map(num_cells, resolution);
+    GridMap<double> &grid = grid_map.addLayer<double>("double_grid", 1.);
+    grid.at(Index(3, 4)) = 5.;
+
+    LayerHandle<double> handle = grid_map.getLayerHandle<double>("double_grid");
+    BOOST_CHECK_EQUAL(handle.at(Index(3, 4)), 5.);
+    BOOST_CHECK_EQUAL(handle.at(0, 0), 1.);
+    handle.at(7, 8) = 2.;
+    BOOST_CHECK_EQUAL(grid.at(Index(7, 8)), 2.);
+
+    const LayeredGridMap &const_map = grid_map;
+    LayerHandle<const double> const_handle = const_map.getLayerHandle<double>("double_grid");
+    BOOST_CHECK_EQUAL(const_handle.at(7, 8), 2.);
+
+    BOOST_CHECK_THROW(grid_map.getLayerHandle<int>("double_grid"), std::runtime_error);
+    BOOST_CHECK_THROW(grid_map.getLayerHandle<double>("no_grid"), std::out_of_range);
+    BOOST_CHECK_THROW(handle.at(100, 0), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_gridmap_interleaved_layers)
+{
+    LayeredGridMap grid_map(num_cells, resolution);
+    grid_map.addLayer<float>("height", 0.f, INTERLEAVED);
+    grid_map.addLayer<uint8_t>("class", 3, INTERLEAVED);
+    grid_map.addLayer<double>("separate", 0., SEPARATE);
+
+    BOOST_CHECK(grid_map.isInterleaved("height"));
+    BOOST_CHECK(!grid_map.isInterleaved("separate"));
+    BOOST_CHECK_EQUAL(grid_map.getAllLayerKeys().size(), 3);
+    BOOST_CHECK_THROW(grid_map.addInterleavedLayer<float>("height", 0.f), std::out_of_range);
+    BOOST_CHECK_THROW(grid_map.getLayer<float>("height"), std::runtime_error);
+
+    LayerHandle<float> height = grid_map.getLayerHandle<float>("height");
+    LayerHandle<uint8_t> cls = grid_map.getLayerHandle<uint8_t>("class");
+    for (size_t y = 0; y < num_cells.y(); ++y)
+    {
+        for (size_t x = 0; x < num_cells.x(); ++x)
+        {
+            BOOST_REQUIRE_EQUAL(height.at(x, y), 0.f);
+            BOOST_REQUIRE_EQUAL(cls.at(x, y), 3);
+            height.at(x, y) = x + y * 0.5f;
+            cls.at(x, y) = x % 5;
+        }
+    }
+    // the members of a cell are adjacent
+    BOOST_CHECK_LT(std::abs(reinterpret_cast<char*>(&cls.at(10, 10)) - reinterpret_cast<char*>(&height.at(10, 10))), 8);
+
+    // adding and removing layers keeps the values of the other layers
+    grid_map.addInterleavedLayer<double>("cost", -1.);
+    BOOST_CHECK(grid_map.removeLayer("class"));
+    height = grid_map.getLayerHandle<float>("height");
+    LayerHandle<double> cost = grid_map.getLayerHandle<double>("cost");
+    for (size_t y = 0; y < num_cells.y(); ++y)
+    {
+        for (size_t x = 0; x < num_cells.x(); ++x)
+        {
+            BOOST_REQUIRE_EQUAL(height.at(x, y), x + y * 0.5f);
+            BOOST_REQUIRE_EQUAL(cost.at(x, y), -1.);
+        }
+    }
+    BOOST_CHECK(!grid_map.hasLayer("class"));
+
+    grid_map.removeAllLayers();
+    BOOST_CHECK(!grid_map.hasLayer("height"));
+}
@@ -33,6 +33,7 @@
 #include <maps/grid/VectorGridAccess.hpp>
 #include <maps/grid/GridFacade.hpp>
 #include <maps/grid/LevelList.hpp>
+#include <maps/grid/MLSPyramid.hpp>
 
 #include <iostream>
 
@@ -343,3 +344,245 @@ BOOST_AUTO_TEST_CASE(test_mapAccess2)
 }*/
 
 
+
+/** Fills the grid with up to three patches per cell */
+void fillRandomPatches(MultiLevelGridMap<PatchBase>& grid, unsigned seed)
+{
+    srand(seed);
+    for(unsigned y = 0; y < grid.getNumCells().y(); y++)
+    {
+        for(unsigned x = 0; x < grid.getNumCells().x(); x++)
+        {
+            int num_patches = rand() % 4;
+            for(int i = 0; i < num_patches; i++)
+            {
+                double min = (rand() % 1000) / 100.0;
+                grid.at(x, y).insert(PatchBase(min, min + (rand() % 100) / 100.0));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_height_pyramid_queries)
+{
+    MultiLevelGridMap<PatchBase> grid(Vector2ui(53, 37), Eigen::Vector2d(0.5, 0.5));
+    fillRandomPatches(grid, 42);
+
+    MultiLevelGridMap<PatchBase> grid_pyramid(grid);
+    grid_pyramid.buildHeightPyramid();
+    BOOST_REQUIRE(grid_pyramid.hasHeightPyramid());
+    BOOST_CHECK_EQUAL(grid_pyramid.getHeightPyramid().getNumLevels(), 7);
+
+    for(int i = 0; i < 1000; i++)
+    {
+        Eigen::Vector3d min((rand() % 300) / 10.0, (rand() % 200) / 10.0, (rand() % 1200) / 100.0 - 1.0);
+        Eigen::Vector3d size((rand() % 100) / 10.0, (rand() % 100) / 10.0, (rand() % 200) / 100.0);
+        Eigen::AlignedBox3d box(min, min + size);
+
+        MultiLevelGridMap<PatchBase>::PatchVector expected = grid.intersectAABB(box);
+        MultiLevelGridMap<PatchBase>::PatchVector result = grid_pyramid.intersectAABB(box);
+        BOOST_REQUIRE_EQUAL(result.size(), expected.size());
+        for(size_t j = 0; j < result.size(); j++)
+        {
+            BOOST_CHECK_EQUAL(result[j].first, expected[j].first);
+            BOOST_CHECK_EQUAL(result[j].second->getMin(), expected[j].second->getMin());
+        }
+
+        BOOST_CHECK_EQUAL(grid.intersectsAABB(box), !expected.empty());
+        BOOST_CHECK_EQUAL(grid_pyramid.intersectsAABB(box), !expected.empty());
+    }
+
+    // boxes above all patches are rejected
+    BOOST_CHECK(!grid_pyramid.intersectsAABB(Eigen::AlignedBox3d(Eigen::Vector3d(0, 0, 20), Eigen::Vector3d(20, 15, 30))));
+    BOOST_CHECK(grid_pyramid.intersectAABB(Eigen::AlignedBox3d(Eigen::Vector3d(0, 0, 20), Eigen::Vector3d(20, 15, 30))).empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_height_pyramid_update)
+{
+    MultiLevelGridMap<PatchBase> grid(Vector2ui(20, 20), Eigen::Vector2d(1, 1));
+    grid.at(3, 4).insert(PatchBase(1.0, 2.0));
+    grid.buildHeightPyramid();
+
+    const HeightPyramid& pyramid = grid.getHeightPyramid();
+    const unsigned top = pyramid.getNumLevels() - 1;
+    BOOST_CHECK_EQUAL(pyramid.getMin(top, 0, 0), 1.f);
+    BOOST_CHECK_EQUAL(pyramid.getMax(top, 0, 0), 2.f);
+
+    Eigen::AlignedBox3d box(Eigen::Vector3d(10.0, 10.0, 4.5), Eigen::Vector3d(12.0, 12.0, 5.5));
+    BOOST_CHECK(!grid.intersectsAABB(box));
+
+    grid.at(11, 11).insert(PatchBase(5.0, 6.0));
+    grid.updateHeightPyramid(Index(11, 11));
+    BOOST_CHECK_EQUAL(pyramid.getMax(top, 0, 0), 6.f);
+    BOOST_CHECK(grid.intersectsAABB(box));
+    BOOST_CHECK_EQUAL(grid.intersectAABB(box).size(), 1);
+
+    grid.at(11, 11).clear();
+    grid.updateHeightPyramid(Index(11, 11));
+    BOOST_CHECK_EQUAL(pyramid.getMax(top, 0, 0), 2.f);
+    BOOST_CHECK(!grid.intersectsAABB(box));
+}
+
+BOOST_AUTO_TEST_CASE(test_height_pyramid_resize_move)
+{
+    MultiLevelGridMap<PatchBase> grid(Vector2ui(20, 20), Eigen::Vector2d(1, 1));
+    grid.at(3, 4).insert(PatchBase(1.0, 2.0));
+    grid.buildHeightPyramid();
+
+    // cells of the grown area are part of the rebuilt pyramid
+    grid.extend(Vector2ui(40, 30));
+    BOOST_CHECK_EQUAL(grid.getHeightPyramid().getLevelSize(0), Vector2ui(40, 30));
+    grid.at(35, 25).insert(PatchBase(5.0, 6.0));
+    grid.markModified(Index(35, 25));
+    BOOST_CHECK(grid.intersectsAABB(Eigen::AlignedBox3d(Eigen::Vector3d(35.2, 25.2, 5.2), Eigen::Vector3d(35.8, 25.8, 5.8))));
+
+    // moved patches are found at their new position
+    grid.moveBy(Index(2, 3));
+    BOOST_CHECK(grid.intersectsAABB(Eigen::AlignedBox3d(Eigen::Vector3d(37.2, 28.2, 5.2), Eigen::Vector3d(37.8, 28.8, 5.8))));
+    BOOST_CHECK(!grid.intersectsAABB(Eigen::AlignedBox3d(Eigen::Vector3d(35.2, 25.2, 5.2), Eigen::Vector3d(35.8, 25.8, 5.8))));
+
+    // updates outside of the pyramid are ignored
+    HeightPyramid pyramid = grid.getHeightPyramid();
+    pyramid.update(Index(100, 100), grid.at(0, 0));
+    BOOST_CHECK_EQUAL(pyramid.getRejectLevel(100, 100, 0., 1.), -1);
+}
+
+BOOST_AUTO_TEST_CASE(test_footprint_rasterization)
+{
+    // square rotated by 45 degrees around the center of cell (5,5)
+    maps::tools::Footprint::Polygon polygon;
+    polygon.push_back(Eigen::Vector2d(5.5, 4.0));
+    polygon.push_back(Eigen::Vector2d(7.0, 5.5));
+    polygon.push_back(Eigen::Vector2d(5.5, 7.0));
+    polygon.push_back(Eigen::Vector2d(4.0, 5.5));
+
+    std::vector<Index> cells;
+    maps::tools::Footprint::rasterize(polygon, Eigen::Vector2d(1, 1), Vector2ui(20, 20),
+        [&cells](int y, int x_begin, int x_end)
+        {
+            for(int x = x_begin; x < x_end; x++)
+                cells.push_back(Index(x, y));
+            return false;
+        });
+
+    // like intersectAABB, cells touching the upper bounds are included, the corner cells are not
+    BOOST_CHECK_EQUAL(cells.size(), 3 + 4 + 3 + 1);
+    BOOST_CHECK(std::find(cells.begin(), cells.end(), Index(4, 4)) != cells.end());
+    BOOST_CHECK(std::find(cells.begin(), cells.end(), Index(7, 5)) != cells.end());
+    BOOST_CHECK(std::find(cells.begin(), cells.end(), Index(7, 4)) == cells.end());
+    BOOST_CHECK(std::find(cells.begin(), cells.end(), Index(4, 7)) == cells.end());
+    BOOST_CHECK(std::find(cells.begin(), cells.end(), Index(6, 7)) == cells.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_batch_collisions)
+{
+    MultiLevelGridMap<PatchBase> grid(Vector2ui(53, 37), Eigen::Vector2d(0.5, 0.5));
+    fillRandomPatches(grid, 7);
+    MultiLevelGridMap<PatchBase> grid_pyramid(grid);
+    grid_pyramid.buildHeightPyramid();
+
+    // axis aligned boxes have to give the same results as intersectsAABB
+    Eigen::AlignedBox3d shape(Eigen::Vector3d(-0.6, -0.4, -0.2), Eigen::Vector3d(0.6, 0.4, 0.3));
+    MultiLevelGridMap<PatchBase>::PoseVector poses;
+    for(int i = 0; i < 500; i++)
+    {
+        Eigen::Affine3d pose = Eigen::Affine3d::Identity();
+        pose.translation() << (rand() % 250) / 10.0 + 0.6, (rand() % 170) / 10.0 + 0.4, (rand() % 1100) / 100.0;
+        poses.push_back(pose);
+    }
+
+    std::vector<uint8_t> collisions, collisions_pyramid;
+    grid.checkCollisions(maps::tools::Footprint::fromBox(shape), poses, collisions);
+    grid_pyramid.checkCollisions(maps::tools::Footprint::fromBox(shape), poses, collisions_pyramid);
+    std::vector<float> clearance;
+    grid_pyramid.computeClearance(maps::tools::Footprint::fromBox(shape), poses, clearance);
+    BOOST_REQUIRE_EQUAL(collisions.size(), poses.size());
+    BOOST_REQUIRE_EQUAL(clearance.size(), poses.size());
+    for(size_t i = 0; i < poses.size(); i++)
+    {
+        Eigen::AlignedBox3d box(poses[i] * shape.min(), poses[i] * shape.max());
+        bool expected = grid.intersectsAABB(box);
+        BOOST_CHECK_EQUAL((bool)collisions[i], expected);
+        BOOST_CHECK_EQUAL((bool)collisions_pyramid[i], expected);
+        BOOST_CHECK_EQUAL(clearance[i] == 0.f, expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_oriented_footprint)
+{
+    MultiLevelGridMap<PatchBase> grid(Vector2ui(20, 20), Eigen::Vector2d(1, 1));
+    grid.at(4, 4).insert(PatchBase(0.0, 0.5));
+
+    // a long thin box rotated by 45 degrees passes the obstacle, its bounding box doesn't
+    Eigen::Affine3d pose(Eigen::AngleAxisd(-M_PI / 4., Eigen::Vector3d::UnitZ()));
+    pose.translation() << 6.5, 6.5, 0.;
+    MultiLevelGridMap<PatchBase>::PoseVector poses(1, pose);
+    maps::tools::Footprint footprint = maps::tools::Footprint::fromBox(Eigen::AlignedBox3d(Eigen::Vector3d(-2.5, -0.2, 0.2), Eigen::Vector3d(2.5, 0.2, 1.0)));
+
+    std::vector<uint8_t> collisions;
+    grid.checkCollisions(footprint, poses, collisions);
+    BOOST_CHECK(!collisions[0]);
+
+    poses[0].translation() << 4.8, 4.8, 0.;
+    grid.checkCollisions(footprint, poses, collisions);
+    BOOST_CHECK(collisions[0]);
+
+    // raising the box above the patch results in a clearance of 0.5
+    poses[0].translation().z() = 0.8;
+    std::vector<float> clearance;
+    grid.computeClearance(footprint, poses, clearance);
+    BOOST_CHECK_CLOSE(clearance[0], 0.5f, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_pyramid)
+{
+    MLSConfig config;
+    config.updateModel = MLSConfig::KALMAN;
+    MLSMapKalman mls(Vector2ui(41, 30), Eigen::Vector2d(0.05, 0.05), config);
+    for(unsigned y = 0; y < 30; ++y)
+        for(unsigned x = 0; x < 41; ++x)
+            mls.mergePatch(Index(x, y), MLSMapKalman::Patch(0.01f * (x % 2), 0.01f));
+    // a bridge above a single cell
+    mls.mergePatch(Index(10, 10), MLSMapKalman::Patch(3.f, 0.01f));
+
+    MLSPyramid<MLSConfig::KALMAN> pyramid(2);
+    pyramid.build(mls, 3);
+    BOOST_REQUIRE_EQUAL(pyramid.getNumLevels(), 3);
+
+    const MLSMapKalman& coarse = pyramid.getLevel(0);
+    BOOST_CHECK_EQUAL(coarse.getNumCells(), Vector2ui(21, 15));
+    BOOST_CHECK(coarse.getResolution().isApprox(Eigen::Vector2d(0.1, 0.1)));
+    BOOST_CHECK_EQUAL(pyramid.getLevel(2).getNumCells(), Vector2ui(6, 4));
+    BOOST_CHECK(coarse.hasHeightPyramid());
+
+    // the ground patches of a block are fused, the bridge is kept
+    BOOST_REQUIRE_EQUAL(coarse.at(5, 5).size(), 2);
+    const MLSMapKalman::Patch& ground = *coarse.at(5, 5).begin();
+    BOOST_CHECK_CLOSE(ground.getMean(), 0.005f, 1.);
+    BOOST_CHECK_CLOSE(ground.getVariance(), 0.0025f, 1.);
+    BOOST_CHECK_EQUAL(coarse.at(5, 5).rbegin()->getMean(), 3.f);
+    BOOST_CHECK_EQUAL(coarse.at(4, 5).size(), 1);
+    // the last column only covers one column of cells
+    BOOST_CHECK_CLOSE(coarse.at(20, 0).begin()->getVariance(), 0.005f, 1.);
+
+    // incremental update equals a rebuild
+    mls.enableChangeTracking(8);
+    pyramid.build(mls, 3);
+    mls.mergePatch(Index(33, 21), MLSMapKalman::Patch(1.5f, 0.01f));
+    mls.mergePatch(Index(0, 29), MLSMapKalman::Patch(-2.f, 0.01f));
+    pyramid.update(mls);
+
+    MLSPyramid<MLSConfig::KALMAN> reference(2);
+    reference.build(mls, 3);
+    for(size_t level = 0; level < 3; ++level)
+    {
+        const MLSMapKalman& updated = pyramid.getLevel(level);
+        for(unsigned y = 0; y < updated.getNumCells().y(); ++y)
+            for(unsigned x = 0; x < updated.getNumCells().x(); ++x)
+                BOOST_REQUIRE(updated.at(x, y) == reference.getLevel(level).at(x, y));
+    }
+    BOOST_CHECK_EQUAL(pyramid.getLevel(0).at(16, 10).size(), 2);
+
+    MLSPyramid<MLSConfig::KALMAN> not_built;
+    BOOST_CHECK_THROW(not_built.update(mls), std::runtime_error);
+}
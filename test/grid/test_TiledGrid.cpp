@@ -0,0 +1,140 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE GridTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/GridMap.hpp>
+#include <maps/grid/LevelList.hpp>
+#include <maps/grid/TiledGrid.hpp>
+
+#include <boost/filesystem.hpp>
+
+using namespace ::maps::grid;
+
+struct TemporaryDirectory
+{
+    boost::filesystem::path path;
+
+    TemporaryDirectory()
+        : path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("tiled_grid_%%%%%%%%"))
+    {}
+
+    ~TemporaryDirectory()
+    {
+        boost::filesystem::remove_all(path);
+    }
+};
+
+static float pattern(size_t x, size_t y, int iteration)
+{
+    return x * 1000.f + y + iteration * 0.5f;
+}
+
+BOOST_AUTO_TEST_CASE(test_tiled_gridmap)
+{
+    TemporaryDirectory directory;
+    const Vector2ui num_cells(200, 150);
+
+    // keep at most 4 tiles of 16x16 cells in memory
+    TiledGridConfig config;
+    config.tile_size = 16;
+    config.memory_budget = 4 * 16 * 16 * sizeof(float);
+    {
+        GridMap<float, TiledGrid<float> > map(TiledGrid<float>(directory.path.string(), num_cells, -1.f, config), Vector2d(0.1, 0.1));
+        BOOST_CHECK_EQUAL(map.getNumCells(), num_cells);
+        BOOST_CHECK_EQUAL(map.at(5, 7), -1.f);
+
+        for(int iteration = 0; iteration < 2; ++iteration)
+            for(size_t y = 0; y < num_cells.y(); y += 3)
+                for(size_t x = 0; x < num_cells.x(); x += 2)
+                    map.at(x, y) = pattern(x, y, iteration);
+        BOOST_CHECK_LE(map.getNumCachedTiles(), 4);
+
+        for(size_t y = 0; y < num_cells.y(); ++y)
+            for(size_t x = 0; x < num_cells.x(); ++x)
+                BOOST_REQUIRE_EQUAL(map.at(x, y), (x % 2 == 0 && y % 3 == 0) ? pattern(x, y, 1) : -1.f);
+
+        Vector3d pos;
+        BOOST_CHECK(map.fromGrid(Index(10, 20), pos));
+        BOOST_CHECK_THROW(map.at(200, 0), std::runtime_error);
+        BOOST_CHECK_THROW(map.resize(Vector2ui(10, 10)), std::runtime_error);
+    }
+
+    // the tiles are written back when the map is destroyed
+    TiledGrid<float> reopened(directory.path.string(), config);
+    BOOST_CHECK_EQUAL(reopened.getNumCells(), num_cells);
+    BOOST_CHECK_EQUAL(reopened.getTileSize(), 16);
+    BOOST_CHECK_EQUAL(reopened.getDefaultValue(), -1.f);
+    for(size_t y = 0; y < num_cells.y(); ++y)
+        for(size_t x = 0; x < num_cells.x(); ++x)
+            BOOST_REQUIRE_EQUAL(reopened.at(x, y), (x % 2 == 0 && y % 3 == 0) ? pattern(x, y, 1) : -1.f);
+
+    reopened.clear();
+    BOOST_CHECK_EQUAL(reopened.at(0, 0), -1.f);
+}
+
+BOOST_AUTO_TEST_CASE(test_tiled_grid_window)
+{
+    TemporaryDirectory directory;
+    const Vector2ui num_cells(320, 320);
+    TiledGridConfig config;
+    config.tile_size = 32;
+    TiledGrid<LevelList<int> > grid(directory.path.string(), num_cells, LevelList<int>(), config);
+
+    // a robot driving diagonally through the map, modifying the cells around it
+    for(int step = 0; step < 300; step += 5)
+    {
+        const Index center(step, step);
+        grid.setWindow(center, 40, Index(20, 20));
+        // only the tiles within the window are kept
+        BOOST_CHECK_LE(grid.getNumCachedTiles(), 25);
+        for(int dy = -10; dy <= 10; ++dy)
+            for(int dx = -10; dx <= 10; ++dx)
+            {
+                const Index idx = center + Index(dx, dy);
+                if(idx.x() >= 0 && idx.y() >= 0)
+                    grid.at(idx).insert(step);
+            }
+    }
+
+    grid.setWindow(Index(0, 0), 0);
+    grid.flush();
+
+    // every cell holds all steps whose window covered it
+    for(int y = 0; y < 310; y += 7)
+    {
+        for(int x = 0; x < 310; x += 7)
+        {
+            const LevelList<int>& cell = grid.at(x, y);
+            size_t expected = 0;
+            for(int step = 0; step < 300; step += 5)
+                if(std::abs(x - step) <= 10 && std::abs(y - step) <= 10)
+                    expected++;
+            BOOST_REQUIRE_EQUAL(cell.size(), expected);
+        }
+    }
+}
@@ -35,6 +35,9 @@
 #include <maps/grid/LevelList.hpp>
 #include <maps/grid/MultiLevelGridMap.hpp>
 #include <maps/grid/TraversabilityGrid.hpp>
+#include <maps/grid/RawGridMap.hpp>
+#include <maps/grid/ElevationMap.hpp>
+#include <maps/grid/MapDelta.hpp>
 
 using namespace ::maps::grid;
 
@@ -169,6 +172,152 @@ BOOST_AUTO_TEST_CASE(test_gridmap_serialization)
     }
 }
 
+BOOST_AUTO_TEST_CASE(test_raw_gridmap)
+{
+    ElevationMap map_o(Vector2ui(301, 77), Vector2d(0.1, 0.25), -1.f);
+    map_o.getId() = "elevation";
+    map_o.getEPSGCode() = "EPSG::5243";
+    map_o.translate(Eigen::Vector3d(1., -2., 0.5));
+    map_o.rotate(Eigen::Quaterniond(Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ())));
+    for(unsigned y = 0; y < map_o.getNumCells().y(); ++y)
+        for(unsigned x = 0; x < map_o.getNumCells().x(); x += 3)
+            map_o.at(x, y) = x * 0.5f - y;
+
+    const std::string filename = "test_raw_gridmap.bin";
+    saveRawGridMap(map_o, filename);
+
+    ElevationMap map_loaded;
+    loadRawGridMap(filename, map_loaded);
+    GridMap<float, MappedGrid<float> > map_mapped = mapRawGridMap<float>(filename);
+
+    BOOST_CHECK_EQUAL(map_loaded.getNumCells(), map_o.getNumCells());
+    BOOST_CHECK_EQUAL(map_mapped.getNumCells(), map_o.getNumCells());
+    BOOST_CHECK(map_loaded.getResolution() == map_o.getResolution());
+    BOOST_CHECK(map_mapped.getResolution() == map_o.getResolution());
+    BOOST_CHECK_EQUAL(map_loaded.getDefaultValue(), -1.f);
+    BOOST_CHECK_EQUAL(map_mapped.getDefaultValue(), -1.f);
+    BOOST_CHECK_EQUAL(map_mapped.getId(), "elevation");
+    BOOST_CHECK_EQUAL(map_loaded.getEPSGCode(), "EPSG::5243");
+    BOOST_CHECK_EQUAL(map_mapped.getMapType(), map_o.getMapType());
+    BOOST_CHECK(map_loaded.getLocalFrame().isApprox(map_o.getLocalFrame()));
+    BOOST_CHECK(map_mapped.getLocalFrame().isApprox(map_o.getLocalFrame()));
+    BOOST_CHECK(std::equal(map_o.begin(), map_o.end(), map_loaded.begin()));
+    BOOST_CHECK(std::equal(map_o.begin(), map_o.end(), map_mapped.begin()));
+    BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(&*map_mapped.begin()) % RAW_GRID_ALIGNMENT, 0);
+
+    // modifications of the mapped map are private
+    map_mapped.at(0, 0) = 42.f;
+    map_mapped.moveBy(Index(2, 1));
+    BOOST_CHECK_EQUAL(map_mapped.at(2, 1), 42.f);
+    BOOST_CHECK_EQUAL(mapRawGridMap<float>(filename).at(0, 0), map_o.at(0, 0));
+    BOOST_CHECK_THROW(map_mapped.resize(Vector2ui(10, 10)), std::runtime_error);
+
+    // the cell type is checked
+    GridMap<double> map_double;
+    BOOST_CHECK_THROW(loadRawGridMap(filename, map_double), std::runtime_error);
+    BOOST_CHECK_THROW(mapRawGridMap<uint8_t>(filename), std::runtime_error);
+
+    // traversability cells are trivially copyable as well
+    TraversabilityGrid trav_o(Vector2ui(10, 20), Vector2d(0.5, 0.5), TraversabilityCell(1, 0));
+    trav_o.at(3, 4) = TraversabilityCell(2, 200);
+    saveRawGridMap(trav_o, filename);
+    GridMap<TraversabilityCell> trav_i;
+    loadRawGridMap(filename, trav_i);
+    BOOST_CHECK(trav_i.at(3, 4) == TraversabilityCell(2, 200));
+    BOOST_CHECK(trav_i.at(0, 0) == TraversabilityCell(1, 0));
+
+    std::remove(filename.c_str());
+
+    // headers whose sizes overflow 64 bit are rejected
+    const RawGridHeader header = createRawGridHeader(map_o, map_o.getResolution(), map_o.getNumCells(), sizeof(float), alignof(float));
+    const size_t file_size = header.data_offset + header.data_size;
+    BOOST_CHECK_NO_THROW(checkRawGridHeader(header, file_size, sizeof(float), alignof(float)));
+    RawGridHeader corrupted = header;
+    corrupted.data_offset = uint64_t(0) - RAW_GRID_ALIGNMENT;
+    BOOST_CHECK_THROW(checkRawGridHeader(corrupted, file_size, sizeof(float), alignof(float)), std::runtime_error);
+    corrupted = header;
+    corrupted.num_cells[0] = corrupted.num_cells[1] = 1u << 31;
+    corrupted.data_size = 0;
+    BOOST_CHECK_THROW(checkRawGridHeader(corrupted, file_size, sizeof(float), alignof(float)), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_gridmap_delta)
+{
+    GridMap<float> map(Vector2ui(500, 300), Vector2d(0.1, 0.1), 0.f);
+    GridMap<float> replica(map.getNumCells(), map.getResolution(), 0.f);
+    map.enableChangeTracking(32);
+    map.translate(Eigen::Vector3d(1., 2., 3.));
+
+    // initial synchronization sends all tiles
+    std::stringstream full;
+    uint64_t version = saveDelta(map, 0, full);
+    BOOST_CHECK_EQUAL(applyDelta(full, replica), version);
+    BOOST_CHECK(replica.getLocalFrame().isApprox(map.getLocalFrame()));
+
+    for(int round = 0; round < 3; ++round)
+    {
+        // modify a small area
+        for(unsigned y = 100 + round * 10; y < 140; ++y)
+        {
+            for(unsigned x = 200; x < 230 + round; ++x)
+            {
+                map.at(x, y) = x + y * 0.5f + round;
+                map.markModified(Index(x, y));
+            }
+        }
+
+        std::stringstream delta;
+        const uint64_t new_version = saveDelta(map, version, delta);
+        BOOST_CHECK_GT(new_version, version);
+        BOOST_CHECK_LT(delta.str().size(), full.str().size() / 20);
+        BOOST_CHECK_EQUAL(applyDelta(delta, replica), new_version);
+        version = new_version;
+        BOOST_CHECK(std::equal(map.begin(), map.end(), replica.begin()));
+    }
+
+    // nothing changed
+    std::stringstream empty;
+    BOOST_CHECK_EQUAL(saveDelta(map, version, empty), version);
+    BOOST_CHECK_LT(empty.str().size(), 256);
+
+    GridMap<float> other_size(Vector2ui(10, 10), map.getResolution(), 0.f);
+    BOOST_CHECK_THROW(applyDelta(empty, other_size), std::runtime_error);
+    GridMap<float> untracked(Vector2ui(10, 10), map.getResolution(), 0.f);
+    BOOST_CHECK_THROW(saveDelta(untracked, 0, empty), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_gridmap_delta_resize_move)
+{
+    GridMap<float> map(Vector2ui(100, 80), Vector2d(0.1, 0.1), 0.f);
+    map.enableChangeTracking(16);
+
+    // resizing restarts the tracking, modifications of the new area are recorded
+    map.extend(Vector2ui(150, 120));
+    BOOST_CHECK_EQUAL(map.getChangeTracker().getNumCells(), map.getNumCells());
+    for(unsigned x = 120; x < 150; ++x)
+    {
+        map.at(x, 110) = x;
+        map.markModified(Index(x, 110));
+    }
+    // cells outside of the grid are ignored
+    map.markModified(Index(1000, 1000));
+
+    GridMap<float> replica(map.getNumCells(), map.getResolution(), 0.f);
+    std::stringstream full;
+    uint64_t version = saveDelta(map, 0, full);
+    BOOST_CHECK_EQUAL(applyDelta(full, replica), version);
+    BOOST_CHECK(std::equal(map.begin(), map.end(), replica.begin()));
+
+    // moving changes all tiles
+    map.moveBy(Index(5, -3));
+    std::stringstream delta;
+    const uint64_t moved_version = saveDelta(map, version, delta);
+    BOOST_CHECK_GT(moved_version, version);
+    BOOST_CHECK_EQUAL(applyDelta(delta, replica), moved_version);
+    BOOST_CHECK(std::equal(map.begin(), map.end(), replica.begin()));
+    BOOST_CHECK_EQUAL(replica.at(125 + 5, 110 - 3), 125.f);
+}
+
 BOOST_AUTO_TEST_CASE(test_levellist_serialization)
 {
     LevelList<int> list;
@@ -32,6 +32,11 @@
 
 /** Based local map **/
 #include <maps/grid/MLSMap.hpp>
+#include <maps/grid/MLSCompactCodec.hpp>
+#include <maps/grid/MapDelta.hpp>
+#include <maps/grid/TiledSerialization.hpp>
+
+#include <limits>
 
 using namespace ::maps::grid;
 
@@ -176,3 +181,232 @@ BOOST_AUTO_TEST_CASE(test_mls_serialization)
     }
 
 }
+
+static MLSMapKalman createLayeredMLS(const Vector2ui& num_cells)
+{
+    MLSConfig mls_config;
+    mls_config.updateModel = MLSConfig::KALMAN;
+    mls_config.gapSize = 0.5;
+    MLSMapKalman mls(num_cells, Vector2d(0.05, 0.05), mls_config);
+    mls.getId() = "compact";
+    mls.translate(Eigen::Vector3d(-2., 3., 100.));
+
+    // ground with a bridge and some walls
+    for(size_t y = 0; y < num_cells.y(); ++y)
+    {
+        for(size_t x = 0; x < num_cells.x(); ++x)
+        {
+            const Index idx(x, y);
+            const float ground = 0.3f * std::sin(x * 0.05f) * std::cos(y * 0.07f) - 100.f;
+            mls.mergePatch(idx, MLSMapKalman::Patch(ground, 0.0004f + x * 1e-5f));
+            if(x % 7 == 0)
+                mls.mergePatch(idx, MLSMapKalman::Patch(ground + 2.f, 0.01f, 1.f));
+            if(y % 11 == 0)
+                mls.mergePatch(idx, MLSMapKalman::Patch(ground + 4.f, 0.f));
+        }
+    }
+    return mls;
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_compact_codec)
+{
+    const Vector2ui num_cells(77, 50);
+    MLSMapKalman mls_o = createLayeredMLS(num_cells);
+    // leave some cells empty
+    for(size_t x = 20; x < 60; ++x)
+        mls_o.at(x, 3).clear();
+
+    for(float max_error : {0.001f, 0.01f})
+    {
+        MLSCompactCodec::Config config;
+        config.max_height_error = max_error;
+        config.tile_size = 8;
+        MLSCompactCodec codec(config);
+
+        std::vector<uint8_t> data;
+        codec.encode(mls_o, data);
+        MLSMapKalman mls_i;
+        MLSCompactCodec::decode(data, mls_i);
+
+        BOOST_CHECK_EQUAL(mls_i.getNumCells(), num_cells);
+        BOOST_CHECK(mls_i.getResolution() == mls_o.getResolution());
+        BOOST_CHECK(mls_i.getLocalFrame().isApprox(mls_o.getLocalFrame()));
+        BOOST_CHECK_EQUAL(mls_i.getId(), "compact");
+        BOOST_CHECK_EQUAL(mls_i.getConfig().gapSize, mls_o.getConfig().gapSize);
+
+        for(size_t y = 0; y < num_cells.y(); ++y)
+        {
+            for(size_t x = 0; x < num_cells.x(); ++x)
+            {
+                const MLSMapKalman::CellType& cell_o = mls_o.at(x, y);
+                const MLSMapKalman::CellType& cell_i = mls_i.at(x, y);
+                BOOST_REQUIRE_EQUAL(cell_o.size(), cell_i.size());
+                for(MLSMapKalman::CellType::const_iterator it_o = cell_o.begin(), it_i = cell_i.begin(); it_o != cell_o.end(); ++it_o, ++it_i)
+                {
+                    // allow for the float precision at a height of 100m
+                    BOOST_CHECK_LE(std::abs(it_o->getMean() - it_i->getMean()), max_error + 1e-4f);
+                    BOOST_CHECK_LE(std::abs(it_o->getTop() - it_i->getTop()), max_error + 1e-4f);
+                    BOOST_CHECK_LE(std::abs(it_o->getBottom() - it_i->getBottom()), max_error + 1e-4f);
+                    if(it_o->getVariance() == 0.f)
+                        BOOST_CHECK_EQUAL(it_i->getVariance(), 0.f);
+                    else
+                        BOOST_CHECK_CLOSE(it_o->getVariance(), it_i->getVariance(), 4.);
+                }
+            }
+        }
+    }
+
+    // the default configuration is smaller than the binary archive
+    std::vector<uint8_t> data;
+    MLSCompactCodec().encode(mls_o, data);
+    std::stringstream archive;
+    {
+        boost::archive::binary_oarchive oa(archive);
+        oa << mls_o;
+    }
+    BOOST_CHECK_LT(data.size(), archive.str().size());
+
+    data.pop_back();
+    MLSMapKalman mls_i;
+    BOOST_CHECK_THROW(MLSCompactCodec::decode(data, mls_i), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_compact_codec_malformed)
+{
+    MLSMapKalman mls_o = createLayeredMLS(Vector2ui(20, 10));
+    std::vector<uint8_t> data;
+    MLSCompactCodec().encode(mls_o, data);
+
+    // the tile size follows the fixed size header, both strings and the MLS config
+    const size_t tile_size_offset = 126 + 1 + mls_o.getId().size() + 1 + mls_o.getEPSGCode().size() + 9;
+    BOOST_REQUIRE_EQUAL(data[tile_size_offset], 16);
+    MLSMapKalman mls_i;
+    for(uint32_t tile_size : {21u, 4097u, 0x10000u, 0xFFFFFFFFu})
+    {
+        std::vector<uint8_t> corrupted = data;
+        for(int i = 0; i < 4; ++i)
+            corrupted[tile_size_offset + i] = uint8_t(tile_size >> (8 * i));
+        BOOST_CHECK_THROW(MLSCompactCodec::decode(corrupted, mls_i), std::runtime_error);
+    }
+
+    // a huge grid with only a few tile bytes
+    std::vector<uint8_t> corrupted = data;
+    for(int i = 0; i < 8; ++i)
+        corrupted[5 + i] = 0xFF;
+    BOOST_CHECK_THROW(MLSCompactCodec::decode(corrupted, mls_i), std::runtime_error);
+
+    MLSCompactCodec::Config config;
+    config.tile_size = 4097;
+    BOOST_CHECK_THROW(MLSCompactCodec codec(config), std::runtime_error);
+
+    mls_o.at(3, 4).clear();
+    mls_o.at(3, 4).insert(MLSMapKalman::Patch(std::numeric_limits<float>::quiet_NaN(), 0.01f));
+    BOOST_CHECK_THROW(MLSCompactCodec().encode(mls_o, data), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_delta)
+{
+    MLSConfig mls_config;
+    mls_config.updateModel = MLSConfig::KALMAN;
+    MLSMapKalman mls(Vector2ui(200, 200), Vector2d(0.05, 0.05), mls_config);
+    MLSMapKalman replica(mls.getNumCells(), mls.getResolution(), mls_config);
+    replica.buildHeightPyramid();
+    mls.enableChangeTracking(16);
+
+    std::stringstream full;
+    uint64_t version = saveDelta(mls, 0, full);
+    applyDelta(full, replica);
+
+    for(int step = 0; step < 5; ++step)
+    {
+        // a robot observing a small area around itself
+        const double cx = 1. + step * 1.5;
+        for(double x = cx - 0.5; x < cx + 0.5; x += 0.01)
+            for(double y = 4.5; y < 5.5; y += 0.01)
+                mls.mergePoint(Eigen::Vector3d(x, y, std::sin(x) + step * 0.01));
+
+        std::stringstream delta;
+        version = saveDelta(mls, version, delta);
+        applyDelta(delta, replica);
+    }
+
+    for(size_t y = 0; y < 200; ++y)
+        for(size_t x = 0; x < 200; ++x)
+            BOOST_REQUIRE(mls.at(x, y) == replica.at(x, y));
+
+    // the height pyramid of the replica is updated
+    MLSMapKalman reference = replica;
+    reference.buildHeightPyramid();
+    BOOST_CHECK_EQUAL(replica.getHeightPyramid().getMax(replica.getHeightPyramid().getNumLevels() - 1, 0, 0),
+                      reference.getHeightPyramid().getMax(reference.getHeightPyramid().getNumLevels() - 1, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_tiled_serialization)
+{
+    const Vector2ui num_cells(300, 250);
+    MLSMapKalman mls_o = createLayeredMLS(num_cells);
+    for(size_t x = 0; x < 300; ++x)
+        mls_o.at(x, 100).clear();
+
+    // the map is not modified while saving
+    const MLSMapKalman& mls_const = mls_o;
+    for(unsigned tile_size : {1u, 64u, 128u, 1000u})
+    {
+        std::stringstream stream;
+        saveTiled(mls_const, stream, tile_size);
+        BOOST_CHECK_EQUAL(mls_o.getNumCells(), num_cells);
+
+        MLSMapKalman mls_i;
+        loadTiled(stream, mls_i);
+        BOOST_CHECK_EQUAL(mls_i.getNumCells(), num_cells);
+        BOOST_CHECK(mls_i.getResolution() == mls_o.getResolution());
+        BOOST_CHECK(mls_i.getLocalFrame().isApprox(mls_o.getLocalFrame()));
+        BOOST_CHECK_EQUAL(mls_i.getId(), "compact");
+        BOOST_CHECK_EQUAL(mls_i.getConfig().gapSize, mls_o.getConfig().gapSize);
+        for(size_t y = 0; y < num_cells.y(); ++y)
+            for(size_t x = 0; x < num_cells.x(); ++x)
+                BOOST_REQUIRE(mls_o.at(x, y) == mls_i.at(x, y));
+    }
+
+    // the change tracking and the height pyramid of the target map are set up for the loaded cells
+    {
+        std::stringstream stream;
+        saveTiled(mls_o, stream);
+
+        MLSMapKalman mls_i;
+        mls_i.enableChangeTracking(16);
+        mls_i.buildHeightPyramid();
+        loadTiled(stream, mls_i);
+        BOOST_REQUIRE(mls_i.hasChangeTracking());
+        BOOST_CHECK_EQUAL(mls_i.getChangeTracker().getTileSize(), 16u);
+        BOOST_CHECK_EQUAL(mls_i.getChangeTracker().getNumCells(), num_cells);
+        const uint64_t version = mls_i.getChangeTracker().getVersion();
+        mls_i.mergePatch(Index(250, 200), MLSMapKalman::Patch(5.f, 0.1f));
+        BOOST_CHECK(mls_i.getChangeTracker().isModified(Index(250 / 16, 200 / 16), version));
+        BOOST_CHECK(!mls_i.getChangeTracker().isModified(Index(0, 0), version));
+
+        BOOST_REQUIRE(mls_i.hasHeightPyramid());
+        MLSMapKalman reference = mls_i;
+        reference.buildHeightPyramid();
+        const HeightPyramid& pyramid = mls_i.getHeightPyramid();
+        BOOST_REQUIRE_EQUAL(pyramid.getNumLevels(), reference.getHeightPyramid().getNumLevels());
+        BOOST_CHECK_EQUAL(pyramid.getMax(pyramid.getNumLevels() - 1, 0, 0),
+                          reference.getHeightPyramid().getMax(pyramid.getNumLevels() - 1, 0, 0));
+        MLSMapKalman no_pyramid = mls_i;
+        no_pyramid.clearHeightPyramid();
+        for(double z : {-100.5, -50., 4.95, 20.})
+        {
+            const Eigen::AlignedBox3d box(Eigen::Vector3d(12.4, 9.9, z), Eigen::Vector3d(12.6, 10.1, z + 0.5));
+            BOOST_CHECK_EQUAL(mls_i.intersectsAABB(box), no_pyramid.intersectsAABB(box));
+        }
+        BOOST_CHECK(mls_i.intersectsAABB(Eigen::AlignedBox3d(Eigen::Vector3d(12.4, 9.9, 4.95), Eigen::Vector3d(12.6, 10.1, 5.45))));
+    }
+
+    std::stringstream stream;
+    saveTiled(mls_o, stream);
+    std::string data = stream.str();
+    data.resize(data.size() - 10);
+    std::stringstream truncated(data);
+    MLSMapKalman mls_i;
+    BOOST_CHECK_THROW(loadTiled(truncated, mls_i), std::runtime_error);
+}
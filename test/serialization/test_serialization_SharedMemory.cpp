@@ -0,0 +1,268 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE SerializationTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/SharedMemoryMap.hpp>
+#include <maps/grid/ElevationMap.hpp>
+#include <maps/grid/MLSMap.hpp>
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace ::maps::grid;
+
+BOOST_AUTO_TEST_CASE(test_shared_grid_map)
+{
+    const std::string name = "maps_test_shared_grid_map_" + std::to_string(::getpid());
+    ElevationMap map(Vector2ui(200, 100), Vector2d(0.1, 0.1), 0.f);
+    map.getId() = "elevation";
+    map.translate(Eigen::Vector3d(-10., -5., 0.));
+
+    SharedMapPublisher publisher(name, 200 * 100 * sizeof(float) + 4096);
+    SharedMapSubscriber subscriber(name);
+    BOOST_CHECK(!subscriber.getGridMap<float>());
+
+    map.at(1, 2) = 1.f;
+    publisher.publish(map);
+    BOOST_CHECK_EQUAL(subscriber.getRevision(), 1);
+
+    uint64_t revision;
+    boost::shared_ptr<const GridMap<float, MappedGrid<float> > > view1 = subscriber.getGridMap<float>(&revision);
+    BOOST_REQUIRE(view1);
+    BOOST_CHECK_EQUAL(revision, 1);
+    BOOST_CHECK_EQUAL(view1->getId(), "elevation");
+    BOOST_CHECK_EQUAL(view1->getNumCells(), map.getNumCells());
+    BOOST_CHECK(view1->getLocalFrame().isApprox(map.getLocalFrame()));
+    BOOST_CHECK(std::equal(map.begin(), map.end(), view1->begin()));
+
+    // held maps are not overwritten by the publisher
+    map.at(1, 2) = 2.f;
+    publisher.publish(map);
+    boost::shared_ptr<const GridMap<float, MappedGrid<float> > > view2 = subscriber.getGridMap<float>();
+    map.at(1, 2) = 3.f;
+    publisher.publish(map);
+    BOOST_CHECK_EQUAL(view1->at(1, 2), 1.f);
+    BOOST_CHECK_EQUAL(view2->at(1, 2), 2.f);
+    BOOST_CHECK_EQUAL(subscriber.getGridMap<float>()->at(1, 2), 3.f);
+
+    // all buffers besides the latest one are held
+    BOOST_CHECK_THROW(publisher.publish(map), std::runtime_error);
+    view1.reset();
+    map.at(1, 2) = 4.f;
+    publisher.publish(map);
+    BOOST_CHECK_EQUAL(subscriber.getGridMap<float>()->at(1, 2), 4.f);
+    BOOST_CHECK_EQUAL(view2->at(1, 2), 2.f);
+
+    ElevationMap too_large(Vector2ui(400, 400), Vector2d(0.1, 0.1), 0.f);
+    BOOST_CHECK_THROW(publisher.publish(too_large), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_shared_mls_map)
+{
+    const std::string name = "maps_test_shared_mls_map_" + std::to_string(::getpid());
+    MLSMapKalman mls_o(Vector2ui(100, 100), Vector2d(0.1, 0.1), MLSConfig());
+    for(int i = 0; i < 1000; ++i)
+        mls_o.mergePoint(Eigen::Vector3d(i % 100 * 0.1, i / 10 * 0.1, std::sin(i * 0.1)));
+
+    SharedMapPublisher publisher(name, 1 << 20);
+    SharedMapSubscriber subscriber(name);
+    publisher.publishSerialized(mls_o);
+
+    MLSMapKalman mls_i;
+    BOOST_REQUIRE(subscriber.readSerialized(mls_i));
+    BOOST_CHECK_EQUAL(mls_i.getNumCells(), mls_o.getNumCells());
+    for(size_t i = 0; i < mls_o.getNumElements(); ++i)
+    {
+        const Index idx(i % 100, i / 100);
+        BOOST_REQUIRE_EQUAL(mls_i.at(idx).size(), mls_o.at(idx).size());
+        for(MLSMapKalman::CellType::const_iterator it_o = mls_o.at(idx).begin(), it_i = mls_i.at(idx).begin(); it_o != mls_o.at(idx).end(); ++it_o, ++it_i)
+            BOOST_CHECK_EQUAL(it_o->getMean(), it_i->getMean());
+    }
+
+    // a raw grid map can not be read from an archive
+    BOOST_CHECK_THROW(subscriber.getGridMap<float>(), std::runtime_error);
+}
+
+/** Map type whose serialization always fails */
+struct FailingMap
+{
+    template<class Archive>
+    void serialize(Archive&, const unsigned int)
+    {
+        throw std::logic_error("serialization failed");
+    }
+};
+
+BOOST_AUTO_TEST_CASE(test_shared_map_publish_errors)
+{
+    const std::string name = "maps_test_shared_map_errors_" + std::to_string(::getpid());
+    SharedMapPublisher publisher(name, 4096, 2);
+    SharedMapSubscriber subscriber(name);
+
+    // the buffers are released after failures, other errors are passed on unchanged
+    MLSMapKalman too_large(Vector2ui(100, 100), Vector2d(0.1, 0.1), MLSConfig());
+    for(int i = 0; i < 10000; ++i)
+        too_large.mergePoint(Eigen::Vector3d(i % 100 * 0.1, i / 100 * 0.1, 0.));
+    for(int i = 0; i < 3; ++i)
+    {
+        BOOST_CHECK_THROW(publisher.publishSerialized(FailingMap()), std::logic_error);
+        BOOST_CHECK_THROW(publisher.publishSerialized(too_large), std::runtime_error);
+    }
+    BOOST_CHECK_EQUAL(publisher.getRevision(), 0);
+
+    MLSMapKalman small(Vector2ui(2, 2), Vector2d(0.1, 0.1), MLSConfig());
+    publisher.publishSerialized(small);
+    MLSMapKalman small_i;
+    BOOST_REQUIRE(subscriber.readSerialized(small_i));
+    BOOST_CHECK_EQUAL(small_i.getNumCells(), Vector2ui(2, 2));
+}
+
+/** Map type which overwrites the buffer with invalid cells before its serialization fails */
+struct PartlyWrittenMap
+{
+    GridMap<float> map;
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int)
+    {
+        ar & map;
+        throw std::logic_error("serialization failed");
+    }
+};
+// without class information the written bytes are the archive of the wrapped map
+BOOST_CLASS_IMPLEMENTATION(PartlyWrittenMap, boost::serialization::object_serializable)
+
+BOOST_AUTO_TEST_CASE(test_shared_map_failed_publish_while_reading)
+{
+    const std::string name = "maps_test_shared_map_failed_publish_" + std::to_string(::getpid());
+    SharedMapPublisher publisher(name, 4096, 2);
+    SharedMapSubscriber subscriber(name);
+
+    // With two buffers a failed publish overwrites the buffer which was the latest one
+    // before the last publish. A reader which looked up that buffer just before must not get it.
+    PartlyWrittenMap invalid;
+    invalid.map = GridMap<float>(Vector2ui(4, 4), Vector2d(0.1, 0.1), -1.f);
+
+    // the serialization registry is set up on first use, which is not thread-safe
+    GridMap<float> first(Vector2ui(4, 4), Vector2d(0.1, 0.1), 0.f);
+    publisher.publishSerialized(first);
+    BOOST_REQUIRE(subscriber.readSerialized(first));
+
+    std::atomic<bool> done(false);
+    std::thread writer([&]()
+    {
+        GridMap<float> map(Vector2ui(4, 4), Vector2d(0.1, 0.1), 0.f);
+        for(int i = 1; i <= 5000; ++i)
+        {
+            std::fill(map.begin(), map.end(), float(i));
+            try
+            {
+                publisher.publishSerialized(map);
+                publisher.publishSerialized(invalid);
+            }
+            catch(const std::exception&)
+            {
+                // the buffer is held by the reader or the invalid map failed as intended
+            }
+            // lets the reader continue where it was interrupted
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+        done = true;
+    });
+
+    unsigned num_reads = 0, num_invalid = 0;
+    while(!done)
+    {
+        GridMap<float> map;
+        if(!subscriber.readSerialized(map))
+            continue;
+        ++num_reads;
+        if(map.getNumCells() != Vector2ui(4, 4) || *map.begin() < 0.f
+            || std::count(map.begin(), map.end(), *map.begin()) != int(map.getNumElements()))
+            ++num_invalid;
+    }
+    writer.join();
+
+    BOOST_CHECK_GT(num_reads, 0u);
+    BOOST_CHECK_EQUAL(num_invalid, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_shared_grid_map_two_processes)
+{
+    const std::string name = "maps_test_shared_two_processes_" + std::to_string(::getpid());
+    const unsigned num_maps = 200;
+    SharedMapPublisher publisher(name, 64 * 64 * sizeof(float) + 4096);
+
+    pid_t pid = ::fork();
+    BOOST_REQUIRE(pid >= 0);
+    if(pid == 0)
+    {
+        // subscriber process, every map must be consistent, i.e. all cells hold its revision
+        int result = 0;
+        try
+        {
+            SharedMapSubscriber subscriber(name);
+            uint64_t revision = 0;
+            const std::chrono::steady_clock::time_point timeout = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+            while(revision < num_maps && std::chrono::steady_clock::now() < timeout)
+            {
+                boost::shared_ptr<const GridMap<float, MappedGrid<float> > > view = subscriber.getGridMap<float>(&revision);
+                if(!view)
+                    continue;
+                for(const float& cell : *view)
+                {
+                    if(cell != float(revision))
+                        result = 1;
+                }
+            }
+            if(revision < num_maps)
+                result = 2;
+        }
+        catch(const std::exception& e)
+        {
+            result = 3;
+        }
+        ::_exit(result);
+    }
+
+    GridMap<float> map(Vector2ui(64, 64), Vector2d(0.1, 0.1), 0.f);
+    for(unsigned i = 1; i <= num_maps; ++i)
+    {
+        std::fill(map.begin(), map.end(), float(i));
+        publisher.publish(map);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+
+    int status = 0;
+    BOOST_REQUIRE_EQUAL(::waitpid(pid, &status, 0), pid);
+    BOOST_CHECK(WIFEXITED(status));
+    BOOST_CHECK_EQUAL(WEXITSTATUS(status), 0);
+}
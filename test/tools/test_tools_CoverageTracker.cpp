@@ -0,0 +1,173 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE ToolsTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/MLSMap.hpp>
+#include <maps/operations/CoverageMapGeneration.hpp>
+
+using namespace maps;
+using namespace grid;
+
+/** Flat ground at z = 0 with a 2m high wall at x in [3.0, 3.2) along the whole map */
+static MLSMapKalman createWallMap()
+{
+    MLSConfig config;
+    config.updateModel = MLSConfig::KALMAN;
+    MLSMapKalman mls(Vector2ui(200, 200), Vector2d(0.1, 0.1), config);
+    mls.getLocalFrame().translation() << 10, 10, 0;
+
+    for(int x = 0; x < 200; ++x)
+    {
+        for(int y = 0; y < 200; ++y)
+        {
+            const double px = (x + 0.5) * 0.1 - 10;
+            const float height = (px >= 3.0 && px < 3.2) ? 2.0f : 0.0f;
+            mls.mergePatch(Index(x, y), MLSMapKalman::Patch(height, 0.01f, height));
+        }
+    }
+    return mls;
+}
+
+/** Lowest covered height of the cell at @p pos, infinity if the cell is not covered */
+static float coveredBottom(const CoverageMap3d& coverage, const Eigen::Vector3d& pos)
+{
+    Index idx;
+    BOOST_REQUIRE(coverage.toGrid(pos, idx));
+    float bottom = std::numeric_limits<float>::infinity();
+    for(const CoverageMap3d::Patch& p : coverage.at(idx))
+        bottom = std::min(bottom, p.getBottom());
+    return bottom;
+}
+
+BOOST_AUTO_TEST_CASE(test_coverage_occlusion)
+{
+    MLSMapKalman mls = createWallMap();
+    operations::CoverageTracker tracker;
+    tracker.setFrame(mls);
+    tracker.updateMLS(mls);
+
+    base::Pose pose;
+    pose.position << 0, 0, 1;
+    tracker.addCoverage(8.0, base::AngleSegment(), pose);
+    const CoverageMap3d& coverage = tracker.getCoverage();
+
+    // visible ground in front of the wall and to the side
+    BOOST_CHECK_SMALL(coveredBottom(coverage, Eigen::Vector3d(2.0, 0.05, 0)), 0.01f);
+    BOOST_CHECK_SMALL(coveredBottom(coverage, Eigen::Vector3d(-5.0, 0.05, 0)), 0.01f);
+    BOOST_CHECK_SMALL(coveredBottom(coverage, Eigen::Vector3d(0.05, 6.0, 0)), 0.01f);
+    // top of the wall is seen
+    BOOST_CHECK_CLOSE(coveredBottom(coverage, Eigen::Vector3d(3.05, 0.05, 0)), 2.0f, 1.0f);
+    // behind the wall only space above the line of sight over the wall edge is covered
+    BOOST_CHECK_GT(coveredBottom(coverage, Eigen::Vector3d(5.0, 0.05, 0)), 2.5f);
+    // outside of the range nothing is covered
+    BOOST_CHECK(std::isinf(coveredBottom(coverage, Eigen::Vector3d(-9.0, 0.05, 0))));
+}
+
+BOOST_AUTO_TEST_CASE(test_coverage_angle_range)
+{
+    MLSMapKalman mls = createWallMap();
+    operations::CoverageTracker tracker;
+    tracker.setFrame(mls);
+    tracker.updateMLS(mls);
+
+    // sensor looking along -x with a 90 degree field of view
+    base::Pose pose;
+    pose.position << 0, 0, 1;
+    pose.orientation = Eigen::AngleAxisd(M_PI, Eigen::Vector3d::UnitZ());
+    tracker.addCoverage(8.0, base::AngleSegment(base::Angle::fromDeg(-45), M_PI / 2), pose);
+    const CoverageMap3d& coverage = tracker.getCoverage();
+
+    BOOST_CHECK_SMALL(coveredBottom(coverage, Eigen::Vector3d(-5.0, 0.05, 0)), 0.01f);
+    BOOST_CHECK(std::isinf(coveredBottom(coverage, Eigen::Vector3d(2.0, 0.05, 0))));
+    BOOST_CHECK(std::isinf(coveredBottom(coverage, Eigen::Vector3d(0.05, 5.0, 0))));
+}
+
+BOOST_AUTO_TEST_CASE(test_coverage_sensor_outside)
+{
+    MLSMapKalman mls = createWallMap();
+    operations::CoverageTracker tracker;
+    tracker.setFrame(mls);
+    tracker.updateMLS(mls);
+
+    // the sensor is 2m left of the grid, its rays are clipped to the grid
+    base::Pose pose;
+    pose.position << -12, 0, 1;
+    tracker.addCoverage(5.0, base::AngleSegment(), pose);
+    const CoverageMap3d& coverage = tracker.getCoverage();
+
+    BOOST_CHECK_SMALL(coveredBottom(coverage, Eigen::Vector3d(-9.95, 0.05, 0)), 0.01f);
+    BOOST_CHECK_SMALL(coveredBottom(coverage, Eigen::Vector3d(-8.0, 2.0, 0)), 0.01f);
+    BOOST_CHECK(std::isinf(coveredBottom(coverage, Eigen::Vector3d(-6.5, 0.05, 0))));
+
+    // a sensor whose range does not reach the grid covers nothing
+    operations::CoverageTracker far_tracker;
+    far_tracker.setFrame(mls);
+    far_tracker.updateMLS(mls);
+    pose.position << -12, 15, 1;
+    far_tracker.addCoverage(5.0, base::AngleSegment(), pose);
+    size_t covered = 0;
+    for(size_t y = 0; y < 200; ++y)
+        for(size_t x = 0; x < 200; ++x)
+            covered += far_tracker.getCoverage().at(x, y).size();
+    BOOST_CHECK_EQUAL(covered, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_coverage_frame_shift)
+{
+    MLSMapKalman mls = createWallMap();
+    operations::CoverageTracker tracker;
+    tracker.setFrame(mls);
+    tracker.updateMLS(mls);
+
+    base::Pose pose;
+    pose.position << 0, 0, 1;
+    tracker.addCoverage(4.0, base::AngleSegment(), pose);
+
+    const Eigen::Vector3d ground(-2.0, 1.05, 0), shadow(3.55, 0.05, 0), outside(-5.0, 0.05, 0);
+    const float ground_bottom = coveredBottom(tracker.getCoverage(), ground);
+    const float shadow_bottom = coveredBottom(tracker.getCoverage(), shadow);
+    BOOST_REQUIRE_SMALL(ground_bottom, 0.01f);
+    BOOST_REQUIRE_GT(shadow_bottom, 1.0f);
+
+    // scroll the MLS by whole cells, coverage has to stay at the same place in the map
+    mls.getLocalFrame().translation() += Eigen::Vector3d(-1.0, 0.5, 0);
+    tracker.updateMLS(mls);
+    BOOST_CHECK(tracker.getCoverage().getLocalFrame().isApprox(mls.getLocalFrame()));
+    BOOST_CHECK_EQUAL(coveredBottom(tracker.getCoverage(), ground), ground_bottom);
+    BOOST_CHECK_EQUAL(coveredBottom(tracker.getCoverage(), shadow), shadow_bottom);
+    BOOST_CHECK(std::isinf(coveredBottom(tracker.getCoverage(), outside)));
+    // cells scrolled in from outside are empty
+    BOOST_CHECK(tracker.getCoverage().at(Index(199, 0)).empty());
+
+    // rotating the MLS requires resampling
+    mls.getLocalFrame().rotate(Eigen::AngleAxisd(M_PI / 2, Eigen::Vector3d::UnitZ()));
+    tracker.updateMLS(mls);
+    BOOST_CHECK(tracker.getCoverage().getLocalFrame().isApprox(mls.getLocalFrame()));
+    BOOST_CHECK_SMALL(coveredBottom(tracker.getCoverage(), ground), 0.01f);
+    BOOST_CHECK_CLOSE(coveredBottom(tracker.getCoverage(), shadow), shadow_bottom, 0.01f);
+}
@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE ToolsTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/operations/GridHoleFilling.hpp>
+
+using namespace maps;
+using namespace grid;
+using operations::GridHoleFilling;
+
+BOOST_AUTO_TEST_CASE(test_fill_holes_empty)
+{
+    // grids without cells or without known cells are not changed
+    GridMap<double> empty(Vector2ui(0, 0), Vector2d(1, 1), 0.);
+    GridHoleFilling::fillHoles(empty);
+    BOOST_CHECK_EQUAL(empty.getNumCells(), Vector2ui(0, 0));
+
+    GridMap<double> unknown(Vector2ui(7, 5), Vector2d(1, 1), 0.);
+    GridHoleFilling::fillHoles(unknown);
+    for(size_t y = 0; y < 5; ++y)
+        for(size_t x = 0; x < 7; ++x)
+            BOOST_CHECK_EQUAL(unknown.at(x, y), 0.);
+}
+
+BOOST_AUTO_TEST_CASE(test_fill_holes_constant)
+{
+    // a single known cell fills the whole grid
+    GridMap<float> grid(Vector2ui(13, 6), Vector2d(0.1, 0.1), 0.f);
+    grid.at(11, 2) = 3.f;
+    GridHoleFilling::fillHoles(grid);
+    for(size_t y = 0; y < 6; ++y)
+        for(size_t x = 0; x < 13; ++x)
+            BOOST_CHECK_CLOSE(grid.at(x, y), 3.f, 1e-4);
+
+    GridMap<int> grid_int(Vector2ui(1, 9), Vector2d(1, 1), -1);
+    grid_int.at(0, 8) = 42;
+    GridHoleFilling::fillHoles(grid_int);
+    for(size_t y = 0; y < 9; ++y)
+        BOOST_CHECK_EQUAL(grid_int.at(0, y), 42);
+}
+
+BOOST_AUTO_TEST_CASE(test_fill_holes_ramp)
+{
+    // a ramp along x with a gap of several columns
+    const Vector2ui num_cells(33, 17);
+    GridMap<double> grid(num_cells, Vector2d(1, 1), 0.);
+    for(size_t y = 0; y < num_cells.y(); ++y)
+        for(size_t x = 0; x < num_cells.x(); ++x)
+            if(x < 10 || x > 20)
+                grid.at(x, y) = 1. + x;
+    GridHoleFilling::fillHoles(grid);
+
+    for(size_t y = 0; y < num_cells.y(); ++y)
+    {
+        for(size_t x = 0; x < num_cells.x(); ++x)
+        {
+            if(x < 10 || x > 20)
+            {
+                // known cells are kept
+                BOOST_CHECK_EQUAL(grid.at(x, y), 1. + x);
+                continue;
+            }
+            // the filled values are between the borders of the gap and increase along x
+            BOOST_CHECK_GT(grid.at(x, y), 10.);
+            BOOST_CHECK_LT(grid.at(x, y), 22.);
+            if(x > 10)
+                BOOST_CHECK_GE(grid.at(x, y), grid.at(x - 1, y));
+        }
+    }
+}
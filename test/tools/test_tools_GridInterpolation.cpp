@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE ToolsTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/operations/GridInterpolation.hpp>
+
+using namespace maps;
+using namespace grid;
+using operations::GridInterpolation;
+
+static double plane(double x, double y)
+{
+    return 1. + 0.5 * x - 0.25 * y;
+}
+
+BOOST_AUTO_TEST_CASE(test_interpolate_plane)
+{
+    // samples of a plane are interpolated exactly inside of their convex hull
+    const Vector2ui num_cells(31, 21);
+    GridMap<double> grid(num_cells, Vector2d(0.1, 0.1), 0.);
+    const int samples[][2] = {{0, 0}, {30, 0}, {0, 20}, {30, 20}, {7, 3}, {19, 11}, {4, 17}, {25, 6}, {15, 15}};
+    for(const int* s : samples)
+        grid.at(s[0], s[1]) = plane(s[0], s[1]);
+    GridInterpolation::interpolate(grid);
+
+    for(size_t y = 0; y < num_cells.y(); ++y)
+        for(size_t x = 0; x < num_cells.x(); ++x)
+            BOOST_CHECK_SMALL(grid.at(x, y) - plane(x, y), 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(test_interpolate_outside_hull)
+{
+    // cells outside of the convex hull keep the default value
+    GridMap<double> grid(Vector2ui(20, 20), Vector2d(1, 1), 0.);
+    grid.at(5, 5) = 1.;
+    grid.at(15, 5) = 2.;
+    grid.at(5, 15) = 3.;
+    GridInterpolation::interpolate(grid);
+
+    BOOST_CHECK_CLOSE(grid.at(10, 5), 1.5, 1e-9);
+    BOOST_CHECK_CLOSE(grid.at(5, 10), 2., 1e-9);
+    BOOST_CHECK_CLOSE(grid.at(10, 10), 2.5, 1e-9);
+    BOOST_CHECK_EQUAL(grid.at(11, 11), 0.);
+    BOOST_CHECK_EQUAL(grid.at(4, 5), 0.);
+    BOOST_CHECK_EQUAL(grid.at(19, 19), 0.);
+}
+
+BOOST_AUTO_TEST_CASE(test_rasterize_shared_edges)
+{
+    // four triangles around an inner corner, the cells on the shared edges
+    // belong to exactly one triangle and the cells on the hull edges are included
+    const Vector2ui num_cells(13, 10);
+    const Eigen::Vector3d outer[4] = {Eigen::Vector3d(0, 0, 0), Eigen::Vector3d(12, 0, 0),
+                                      Eigen::Vector3d(12, 9, 0), Eigen::Vector3d(0, 9, 0)};
+    const Eigen::Vector3d center(5, 4, 0);
+
+    std::vector<int> count(num_cells.prod(), 0);
+    for(int i = 0; i < 4; i++)
+    {
+        // the edge opposite of the center is on the hull
+        Eigen::Vector3d corners[3] = {center, outer[i], outer[(i + 1) % 4]};
+        bool hull_edges[3] = {true, false, false};
+        GridInterpolation::rasterizeTriangle(num_cells, corners, hull_edges,
+                                             [&count, &num_cells](int64_t x, int64_t y, double)
+                                             {
+                                                 count[y * num_cells.x() + x]++;
+                                             });
+    }
+
+    for(size_t y = 0; y < num_cells.y(); ++y)
+        for(size_t x = 0; x < num_cells.x(); ++x)
+            BOOST_CHECK_EQUAL(count[y * num_cells.x() + x], 1);
+}
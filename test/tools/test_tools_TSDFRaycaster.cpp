@@ -0,0 +1,159 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE ToolsTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/TSDFVolumetricMap.hpp>
+#include <maps/tools/TSDFRaycaster.hpp>
+
+using namespace maps::grid;
+using namespace maps::tools;
+
+/** Creates a map containing the signed distances to a horizontal plane at height @p z_plane */
+TSDFVolumetricMap::Ptr createPlaneMap(float z_plane)
+{
+    TSDFVolumetricMap::Ptr map(new TSDFVolumetricMap(Vector2ui(40, 40), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f));
+    Eigen::Vector3d res = map->getVoxelResolution();
+    Eigen::Vector3i idx;
+    for(idx.y() = 0; idx.y() < 40; idx.y()++)
+    {
+        for(idx.x() = 0; idx.x() < 40; idx.x()++)
+        {
+            for(idx.z() = -10; idx.z() < 20; idx.z()++)
+            {
+                float distance = (idx.z() + 0.5) * res.z() - z_plane;
+                map->getVoxelCell(idx) = TSDFPatch(distance, 0.0001f);
+            }
+        }
+    }
+    return map;
+}
+
+/** Creates a map which only contains the voxels between @p z_min and @p z_max (in voxel indices) of a plane at height @p z_plane */
+TSDFVolumetricMap::Ptr createPlaneBandMap(float z_plane, int z_min, int z_max)
+{
+    TSDFVolumetricMap::Ptr map = createPlaneMap(z_plane);
+    TSDFVolumetricMap::Ptr band(new TSDFVolumetricMap(map->getNumCells(), map->getVoxelResolution(), map->getTruncation()));
+    Eigen::Vector3i idx;
+    for(idx.y() = 0; idx.y() < 40; idx.y()++)
+        for(idx.x() = 0; idx.x() < 40; idx.x()++)
+            for(idx.z() = z_min; idx.z() <= z_max; idx.z()++)
+                band->getVoxelCell(idx) = map->getVoxelCell(idx);
+    return band;
+}
+
+/** Camera above the map center looking downwards */
+base::Transform3d createDownwardPose(double height)
+{
+    base::Transform3d pose(Eigen::AngleAxisd(M_PI, Eigen::Vector3d::UnitX()));
+    pose.translation() << 2.0, 2.0, height;
+    return pose;
+}
+
+BOOST_AUTO_TEST_CASE(test_pinhole_raycast)
+{
+    TSDFRaycaster raycaster;
+    raycaster.setTSDFMap(createPlaneMap(0.03f));
+
+    RayPattern rays = RayPattern::createPinhole(64, 48, 50.f, 50.f, 31.5f, 23.5f);
+    RaycastResult result;
+    raycaster.raycast(rays, createDownwardPose(1.5), result);
+
+    BOOST_REQUIRE_EQUAL(result.width, 64);
+    BOOST_REQUIRE_EQUAL(result.height, 48);
+    for(size_t i = 0; i < rays.size(); i++)
+    {
+        BOOST_REQUIRE(result.isValid(i));
+        BOOST_CHECK_CLOSE(result.depth[i], 1.47f, 0.1);
+        BOOST_CHECK(result.normals[i].isApprox(Eigen::Vector3f::UnitZ(), 1e-3));
+        BOOST_CHECK_CLOSE(result.variance[i], 0.0001f, 1e-3);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_lidar_raycast)
+{
+    TSDFRaycaster raycaster;
+    raycaster.setTSDFMap(createPlaneMap(0.03f));
+
+    std::vector<float> elevations;
+    elevations.push_back(-0.8f);
+    elevations.push_back(-0.6f);
+    elevations.push_back(0.1f);
+    RayPattern rays = RayPattern::createLidar(90, -M_PI, M_PI, elevations);
+    RaycastResult result;
+    base::Transform3d pose = base::Transform3d::Identity();
+    pose.translation() << 2.0, 2.0, 1.0;
+    raycaster.raycast(rays, pose, result);
+
+    for(unsigned row = 0; row < 2; row++)
+    {
+        for(unsigned i = 0; i < rays.width; i++)
+        {
+            BOOST_REQUIRE(result.isValid(row * rays.width + i));
+            BOOST_CHECK_CLOSE(result.depth[row * rays.width + i], 0.97f / std::sin(-elevations[row]), 0.1);
+        }
+    }
+
+    // rays pointing upwards leave the volume without a hit
+    for(unsigned i = 0; i < rays.width; i++)
+        BOOST_CHECK(!result.isValid(2 * rays.width + i));
+}
+
+BOOST_AUTO_TEST_CASE(test_raycast_behind_surface)
+{
+    TSDFRaycaster raycaster;
+    raycaster.setTSDFMap(createPlaneMap(0.03f));
+
+    // the sensor is located below the surface
+    RayPattern rays = RayPattern::createPinhole(16, 12, 20.f, 20.f, 7.5f, 5.5f);
+    RaycastResult result;
+    base::Transform3d pose = base::Transform3d::Identity();
+    pose.translation() << 2.0, 2.0, -0.5;
+    raycaster.raycast(rays, pose, result);
+
+    for(size_t i = 0; i < rays.size(); i++)
+        BOOST_CHECK(!result.isValid(i));
+}
+
+BOOST_AUTO_TEST_CASE(test_raycast_from_unknown_space)
+{
+    // only 2cm in front of the surface are observed, the sensor is located in unknown space
+    // less than the truncation distance above the surface
+    TSDFRaycaster raycaster;
+    raycaster.setTSDFMap(createPlaneBandMap(0.03f, -3, 0));
+
+    RayPattern rays = RayPattern::createPinhole(16, 12, 200.f, 200.f, 7.5f, 5.5f);
+    RaycastResult result;
+    raycaster.raycast(rays, createDownwardPose(0.37), result);
+
+    for(size_t i = 0; i < rays.size(); i++)
+    {
+        BOOST_REQUIRE(result.isValid(i));
+        BOOST_CHECK_CLOSE(result.depth[i], 0.34f, 0.5);
+        BOOST_CHECK(result.normals[i].isApprox(Eigen::Vector3f::UnitZ(), 1e-3));
+    }
+}
@@ -0,0 +1,230 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE ToolsTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/TSDFVolumetricMap.hpp>
+#include <maps/tools/TSDFPolygonMeshReconstruction.hpp>
+#include <maps/tools/TSDF_MLSMapReconstruction.hpp>
+
+using namespace maps::grid;
+using namespace maps::tools;
+
+/** Fills the map with the signed distances to a horizontal plane at height @p z_plane */
+void fillPlane(TSDFVolumetricMap& map, float z_plane)
+{
+    Eigen::Vector3d res = map.getVoxelResolution();
+    Eigen::Vector3i idx;
+    for(idx.y() = 0; idx.y() < (int)map.getNumCells().y(); idx.y()++)
+    {
+        for(idx.x() = 0; idx.x() < (int)map.getNumCells().x(); idx.x()++)
+        {
+            for(idx.z() = -5; idx.z() < 5; idx.z()++)
+            {
+                float distance = (idx.z() + 0.5) * res.z() - z_plane;
+                map.getVoxelCell(idx) = TSDFPatch(distance, 0.0001f);
+            }
+        }
+    }
+}
+
+/** Raises the surface within the given columns and marks them as modified */
+void addStep(TSDFVolumetricMap& map, const Index& min, const Index& max, float z_plane)
+{
+    Eigen::Vector3d res = map.getVoxelResolution();
+    Eigen::Vector3i idx;
+    for(idx.y() = min.y(); idx.y() < max.y(); idx.y()++)
+    {
+        for(idx.x() = min.x(); idx.x() < max.x(); idx.x()++)
+        {
+            for(idx.z() = -5; idx.z() < 5; idx.z()++)
+            {
+                float distance = (idx.z() + 0.5) * res.z() - z_plane;
+                map.getVoxelCell(idx) = TSDFPatch(distance, 0.0001f);
+            }
+            map.markModified(idx.head<2>());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_indexed_mesh_plane)
+{
+    TSDFVolumetricMap::Ptr map(new TSDFVolumetricMap(Vector2ui(40, 30), Eigen::Vector3d(0.1, 0.1, 0.1)));
+    fillPlane(*map, 0.03f);
+
+    TSDFPolygonMeshReconstruction reconstruction;
+    reconstruction.setTSDFMap(map);
+
+    IndexedSurfaceMesh mesh;
+    reconstruction.reconstructMesh(mesh);
+
+    // one vertex per column, shared by all neighboring cubes
+    BOOST_CHECK_EQUAL(mesh.vertices.size(), 40 * 30);
+    BOOST_CHECK_EQUAL(mesh.normals.size(), mesh.vertices.size());
+    BOOST_CHECK_EQUAL(mesh.intensities.size(), mesh.vertices.size());
+    BOOST_CHECK_EQUAL(mesh.getNumTriangles(), 39 * 29 * 2);
+
+    for(uint32_t idx : mesh.indices)
+        BOOST_REQUIRE(idx < mesh.vertices.size());
+
+    for(size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        BOOST_CHECK_CLOSE(mesh.vertices[i].z(), 0.03f, 0.1);
+        BOOST_CHECK_CLOSE(std::abs(mesh.normals[i].z()), 1.f, 1e-3);
+        BOOST_CHECK_EQUAL(mesh.normals[i].z() > 0.f, mesh.normals[0].z() > 0.f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_indexed_mesh_frame)
+{
+    TSDFVolumetricMap::Ptr map(new TSDFVolumetricMap(Vector2ui(10, 10), Eigen::Vector3d(0.1, 0.1, 0.1)));
+    fillPlane(*map, 0.03f);
+    map->translate(Eigen::Vector3d(1., 2., 3.));
+
+    TSDFPolygonMeshReconstruction reconstruction;
+    reconstruction.setTSDFMap(map);
+
+    IndexedSurfaceMesh mesh_local, mesh_global;
+    reconstruction.reconstructMesh(mesh_local, false);
+    reconstruction.reconstructMesh(mesh_global, true);
+
+    BOOST_REQUIRE_EQUAL(mesh_local.vertices.size(), mesh_global.vertices.size());
+    BOOST_CHECK(mesh_local.indices == mesh_global.indices);
+    for(size_t i = 0; i < mesh_local.vertices.size(); i++)
+        BOOST_CHECK(mesh_global.vertices[i].isApprox(mesh_local.vertices[i] + Eigen::Vector3f(1.f, 2.f, 3.f)));
+}
+
+BOOST_AUTO_TEST_CASE(test_polygon_mesh)
+{
+    TSDFVolumetricMap::Ptr map(new TSDFVolumetricMap(Vector2ui(20, 20), Eigen::Vector3d(0.1, 0.1, 0.1)));
+    fillPlane(*map, -0.12f);
+
+    TSDFPolygonMeshReconstruction reconstruction;
+    reconstruction.setTSDFMap(map);
+
+    pcl::PolygonMesh polygon_mesh;
+    reconstruction.reconstruct(polygon_mesh);
+
+    BOOST_CHECK_EQUAL(polygon_mesh.cloud.width, 20 * 20);
+    BOOST_REQUIRE_EQUAL(polygon_mesh.polygons.size(), 19 * 19 * 2);
+    for(const pcl::Vertices& polygon : polygon_mesh.polygons)
+        BOOST_CHECK_EQUAL(polygon.vertices.size(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_modification_tracking)
+{
+    TSDFVolumetricMap map(Vector2ui(40, 20), Eigen::Vector3d(0.1, 0.1, 0.1));
+    BOOST_CHECK_EQUAL(map.getNumBlocks(), Vector2ui(3, 2));
+
+    uint64_t stamp = map.getModificationStamp();
+    map.mergePoint(Eigen::Vector3d(0.25, 0.25, 1.0), Eigen::Vector3d(0.25, 0.25, 0.0));
+    BOOST_CHECK(map.getModificationStamp() > stamp);
+    BOOST_CHECK(map.getBlockStamp(Index(0, 0)) > stamp);
+    for(int y = 0; y < 2; y++)
+    {
+        for(int x = (y == 0 ? 1 : 0); x < 3; x++)
+            BOOST_CHECK(map.getBlockStamp(Index(x, y)) <= stamp);
+    }
+    // the blocks are the tiles of the change tracking of the grid, e.g. used by saveDelta
+    BOOST_CHECK(map.hasChangeTracking());
+    BOOST_CHECK(map.getChangeTracker().isModified(Index(0, 0), stamp));
+    BOOST_CHECK(!map.getChangeTracker().isModified(Index(1, 0), stamp));
+
+    stamp = map.getModificationStamp();
+    map.markAllModified();
+    for(int y = 0; y < 2; y++)
+    {
+        for(int x = 0; x < 3; x++)
+            BOOST_CHECK(map.getBlockStamp(Index(x, y)) > stamp);
+    }
+
+    // without change tracking all blocks count as modified
+    stamp = map.getModificationStamp();
+    map.disableChangeTracking();
+    BOOST_CHECK_EQUAL(map.getNumBlocks(), Vector2ui(3, 2));
+    BOOST_CHECK(map.getBlockStamp(Index(2, 1)) > stamp);
+}
+
+BOOST_AUTO_TEST_CASE(test_incremental_mesh)
+{
+    TSDFVolumetricMap::Ptr map(new TSDFVolumetricMap(Vector2ui(50, 40), Eigen::Vector3d(0.1, 0.1, 0.1)));
+    fillPlane(*map, 0.03f);
+
+    TSDFPolygonMeshReconstruction incremental;
+    incremental.setTSDFMap(map);
+    IndexedSurfaceMesh mesh;
+    incremental.reconstructMesh(mesh);
+
+    // the step crosses the border between blocks
+    addStep(*map, Index(12, 14), Index(20, 22), 0.23f);
+    incremental.reconstructMesh(mesh);
+
+    TSDFPolygonMeshReconstruction full;
+    full.setTSDFMap(map);
+    IndexedSurfaceMesh expected;
+    full.reconstructMesh(expected);
+
+    BOOST_CHECK(expected.vertices.size() > 50 * 40);
+    BOOST_REQUIRE_EQUAL(mesh.vertices.size(), expected.vertices.size());
+    BOOST_CHECK(mesh.indices == expected.indices);
+    for(size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        BOOST_CHECK(mesh.vertices[i].isApprox(expected.vertices[i]));
+        BOOST_CHECK(mesh.normals[i].isApprox(expected.normals[i]));
+        BOOST_CHECK_CLOSE(mesh.intensities[i], expected.intensities[i], 1e-3);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_incremental_mls)
+{
+    TSDFVolumetricMap::Ptr map(new TSDFVolumetricMap(Vector2ui(50, 40), Eigen::Vector3d(0.1, 0.1, 0.1)));
+    fillPlane(*map, 0.03f);
+
+    TSDF_MLSMapReconstruction incremental;
+    incremental.setTSDFMap(map);
+    MLSMapPrecalculated mls;
+    incremental.reconstruct(mls);
+
+    addStep(*map, Index(12, 14), Index(20, 22), 0.23f);
+    incremental.reconstruct(mls);
+
+    TSDF_MLSMapReconstruction full;
+    full.setTSDFMap(map);
+    MLSMapPrecalculated expected;
+    full.reconstruct(expected);
+
+    BOOST_REQUIRE_EQUAL(mls.getNumCells(), expected.getNumCells());
+    BOOST_CHECK(mls.getLocalFrame().isApprox(expected.getLocalFrame()));
+    for(unsigned y = 0; y < mls.getNumCells().y(); y++)
+    {
+        for(unsigned x = 0; x < mls.getNumCells().x(); x++)
+        {
+            BOOST_REQUIRE_EQUAL(mls.at(x, y).size(), expected.at(x, y).size());
+            BOOST_CHECK(std::equal(mls.at(x, y).begin(), mls.at(x, y).end(), expected.at(x, y).begin()));
+        }
+    }
+}
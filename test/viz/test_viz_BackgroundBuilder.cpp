@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE VizTest
+#include <boost/test/included/unit_test.hpp>
+
+#include <vector>
+#include <chrono>
+
+#include "BackgroundBuilder.hpp"
+
+using namespace vizkit3d;
+
+BOOST_AUTO_TEST_CASE(test_background_builder_result)
+{
+    std::atomic<int> notified(0);
+    BackgroundBuilder<std::vector<float> > builder([&notified]{ ++notified; });
+
+    std::vector<float> result;
+    BOOST_CHECK(!builder.takeResult(result));
+
+    builder.submit([](const BuildCancellation& cancellation)
+    {
+        std::vector<float> values(10000);
+        BackgroundBuilder<std::vector<float> >::parallelFor(values.size(), 128, cancellation, [&values](int begin, int end)
+        {
+            for(int i = begin; i < end; ++i)
+                values[i] = i;
+        });
+        return values;
+    });
+    builder.wait();
+
+    BOOST_CHECK_EQUAL(notified, 1);
+    BOOST_REQUIRE(builder.takeResult(result));
+    BOOST_REQUIRE_EQUAL(result.size(), 10000u);
+    BOOST_CHECK_EQUAL(result[9999], 9999.f);
+    // a result is only taken once
+    BOOST_CHECK(!builder.takeResult(result));
+}
+
+BOOST_AUTO_TEST_CASE(test_background_builder_cancel)
+{
+    BackgroundBuilder<int> builder;
+
+    std::atomic<bool> started(false), cancelled(false);
+    builder.submit([&](const BuildCancellation& cancellation)
+    {
+        started = true;
+        while(!cancellation.isCancelled())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        cancelled = true;
+        return 1;
+    });
+    while(!started)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // the newer job supersedes the running one
+    builder.submit([](const BuildCancellation&) { return 2; });
+    builder.wait();
+
+    BOOST_CHECK(cancelled);
+    int result = 0;
+    BOOST_REQUIRE(builder.takeResult(result));
+    BOOST_CHECK_EQUAL(result, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_background_builder_error)
+{
+    BackgroundBuilder<int> builder;
+    builder.submit([](const BuildCancellation&) -> int { throw std::runtime_error("failed"); });
+    builder.wait();
+
+    int result = 0;
+    BOOST_CHECK_THROW(builder.takeResult(result), std::runtime_error);
+    BOOST_CHECK(!builder.takeResult(result));
+}
+
+BOOST_AUTO_TEST_CASE(test_background_builder_parallel_error)
+{
+    BackgroundBuilder<int> builder;
+    builder.submit([](const BuildCancellation& cancellation) -> int
+    {
+        // an exception of a chunk is passed on to takeResult
+        BackgroundBuilder<int>::parallelFor(1000, 10, cancellation, [](int begin, int end)
+        {
+            if(begin <= 500 && 500 < end)
+                throw std::runtime_error("chunk failed");
+        });
+        return 1;
+    });
+    builder.wait();
+
+    int result = 0;
+    BOOST_CHECK_THROW(builder.takeResult(result), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_background_builder_cancel_pending)
+{
+    BackgroundBuilder<int> builder;
+
+    std::atomic<bool> started(false), release(false);
+    builder.submit([&](const BuildCancellation&)
+    {
+        started = true;
+        while(!release)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return 1;
+    });
+    while(!started)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    builder.submit([](const BuildCancellation&) { return 2; });
+
+    // a waiting thread is woken up when the pending job is cancelled
+    std::thread waiter([&builder]{ builder.wait(); });
+    builder.cancel();
+    release = true;
+    waiter.join();
+
+    int result = 0;
+    BOOST_CHECK(!builder.isBusy());
+    BOOST_CHECK(!builder.takeResult(result));
+}
@@ -33,6 +33,10 @@
 #include <vizkit3d/Vizkit3DWidget.hpp>
 #include <vizkit3d/QtThreadedWidget.hpp>
 #include <vizkit3d/GridMapVisualization.hpp>
+#include <vizkit3d/ColorGradient.hpp>
+
+#include <osg/Texture2D>
+#include <osg/ShapeDrawable>
 
 using namespace ::maps::grid;
 
@@ -58,6 +62,29 @@ static void showGridMap(const GridMap<CellT> &grid_map)
     }
 }
 
+BOOST_AUTO_TEST_CASE(gridviz_color_lookup_table)
+{
+    vizkit3d::ColorGradient gradient;
+    gradient.createDefaultHeatMapGradient();
+
+    std::vector<uint8_t> table;
+    gradient.createLookupTable(table, 256);
+    BOOST_REQUIRE_EQUAL(table.size(), 4 * 256u);
+
+    // the table samples the gradient, including both of its ends
+    for (unsigned int i = 0; i < 256; i += 15)
+    {
+        float r, g, b;
+        gradient.getColorAtValue(i / 255.f, r, g, b);
+        BOOST_CHECK_EQUAL(table[4 * i + 0], (uint8_t)(r * 255.0));
+        BOOST_CHECK_EQUAL(table[4 * i + 1], (uint8_t)(g * 255.0));
+        BOOST_CHECK_EQUAL(table[4 * i + 2], (uint8_t)(b * 255.0));
+        BOOST_CHECK_EQUAL(table[4 * i + 3], 255);
+    }
+    BOOST_CHECK_EQUAL(table[0], 0);
+    BOOST_CHECK_EQUAL(table[4 * 255], 255);
+}
+
 BOOST_AUTO_TEST_CASE(gridviz_test_min)
 {
     Vector2ui numCells(4, 4);
@@ -198,6 +225,144 @@ BOOST_AUTO_TEST_CASE(gridviz_char_test)
     showGridMap(grid_map);
 }
 
+/** Gives access to the scene graph updates without a viewer */
+struct TestGridMapVisualization : public vizkit3d::GridMapVisualization
+{
+    void render()
+    {
+        if(!node)
+            node = createMainNode();
+        updateMainNode(node.get());
+    }
+
+    /** The first update starts the background build, the next one swaps in the tiles */
+    void renderBuild()
+    {
+        render();
+        waitForBuild();
+        render();
+    }
+
+    std::vector<osg::Geode*> getTiles()
+    {
+        std::vector<osg::Geode*> tiles;
+        osg::Group* main = node->asGroup();
+        for(unsigned i = 0; i < main->getNumChildren(); ++i)
+        {
+            osg::Group* group = main->getChild(i)->asGroup();
+            if(!group || group->asGeode())
+                continue;
+            for(unsigned j = 0; j < group->getNumChildren(); ++j)
+                if(osg::Geode* geode = group->getChild(j)->asGeode())
+                    tiles.push_back(geode);
+        }
+        return tiles;
+    }
 
+    static osg::Image* getImage(osg::Geode* tile)
+    {
+        osg::StateAttribute* attribute = tile->getStateSet()->getTextureAttribute(0, osg::StateAttribute::TEXTURE);
+        return static_cast<osg::Texture2D*>(attribute)->getImage();
+    }
 
+    osg::ref_ptr<osg::Node> node;
+};
 
+static bool equalColumns(const osg::Image* a, int column_a, const osg::Image* b, int column_b)
+{
+    for(int row = 0; row < a->t(); ++row)
+        if(!std::equal(a->data() + 4 * (column_a + row * a->s()), a->data() + 4 * (column_a + row * a->s() + 1),
+                       b->data() + 4 * (column_b + row * b->s())))
+            return false;
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(gridviz_tile_seams)
+{
+    GridMap<double> grid_map(Vector2ui(600, 10), Vector2d(0.1, 0.1), -10.);
+    for (unsigned int x = 0; x < grid_map.getNumCells().x(); ++x)
+        for (unsigned int y = 0; y < grid_map.getNumCells().y(); ++y)
+            grid_map.at(x, y) = 0.01 * x;
+
+    TestGridMapVisualization viz;
+    viz.updateData(grid_map);
+    viz.renderBuild();
+
+    // tiles of 254 cells, the textures include the adjacent column of the neighbouring tiles
+    std::vector<osg::Geode*> tiles = viz.getTiles();
+    BOOST_REQUIRE_EQUAL(tiles.size(), 3u);
+    std::vector<osg::Image*> images;
+    for(osg::Geode* tile : tiles)
+        images.push_back(TestGridMapVisualization::getImage(tile));
+    BOOST_CHECK_EQUAL(images[0]->s(), 255);
+    BOOST_CHECK_EQUAL(images[1]->s(), 256);
+    BOOST_CHECK_EQUAL(images[2]->s(), 93);
+    BOOST_CHECK(equalColumns(images[0], 253, images[1], 0));
+    BOOST_CHECK(equalColumns(images[0], 254, images[1], 1));
+    BOOST_CHECK(equalColumns(images[1], 254, images[2], 0));
+    BOOST_CHECK(equalColumns(images[1], 255, images[2], 1));
+    BOOST_CHECK(!equalColumns(images[0], 0, images[0], 254));
+
+    // only the tiles whose textures contain a changed cell are updated
+    std::vector<unsigned> counts;
+    for(osg::Image* image : images)
+        counts.push_back(image->getModifiedCount());
+    grid_map.at(100, 5) = 0.5;
+    viz.updateData(grid_map);
+    viz.renderBuild();
+    BOOST_CHECK_GT(images[0]->getModifiedCount(), counts[0]);
+    BOOST_CHECK_EQUAL(images[1]->getModifiedCount(), counts[1]);
+    BOOST_CHECK_EQUAL(images[2]->getModifiedCount(), counts[2]);
+
+    for(size_t i = 0; i < images.size(); ++i)
+        counts[i] = images[i]->getModifiedCount();
+    grid_map.at(254, 5) = 0.5;
+    viz.updateData(grid_map);
+    viz.renderBuild();
+    BOOST_CHECK_GT(images[0]->getModifiedCount(), counts[0]);
+    BOOST_CHECK_GT(images[1]->getModifiedCount(), counts[1]);
+    BOOST_CHECK_EQUAL(images[2]->getModifiedCount(), counts[2]);
+    BOOST_CHECK(equalColumns(images[0], 254, images[1], 1));
+
+    // the change tracking of a different map is not used, its cells are compared
+    grid_map.enableChangeTracking(32);
+    viz.updateData(grid_map);
+    viz.renderBuild();
+    GridMap<double> other(grid_map.getNumCells(), grid_map.getResolution(), -10.);
+    for (unsigned int x = 0; x < other.getNumCells().x(); ++x)
+        for (unsigned int y = 0; y < other.getNumCells().y(); ++y)
+            other.at(x, y) = grid_map.at(x, y);
+    other.at(400, 5) = 0.5;
+    other.enableChangeTracking(32);
+    for(int i = 0; i < 100; ++i)
+        other.markModified(Index(0, 0));
+    for(size_t i = 0; i < images.size(); ++i)
+        counts[i] = images[i]->getModifiedCount();
+    viz.updateData(other);
+    viz.renderBuild();
+    BOOST_CHECK_EQUAL(images[0]->getModifiedCount(), counts[0]);
+    BOOST_CHECK_GT(images[1]->getModifiedCount(), counts[1]);
+    BOOST_CHECK_EQUAL(images[2]->getModifiedCount(), counts[2]);
+
+    // neighbouring height fields share the cell at the tile border
+    viz.setShowHeightField(true);
+    viz.renderBuild();
+    tiles = viz.getTiles();
+    BOOST_REQUIRE_EQUAL(tiles.size(), 3u);
+    std::vector<osg::HeightField*> height_fields;
+    for(osg::Geode* tile : tiles)
+    {
+        osg::ShapeDrawable* drawable = dynamic_cast<osg::ShapeDrawable*>(tile->getDrawable(0));
+        BOOST_REQUIRE(drawable);
+        height_fields.push_back(static_cast<osg::HeightField*>(drawable->getShape()));
+    }
+    BOOST_CHECK_EQUAL(height_fields[0]->getNumColumns(), 255u);
+    BOOST_CHECK_EQUAL(height_fields[1]->getNumColumns(), 255u);
+    BOOST_CHECK_EQUAL(height_fields[2]->getNumColumns(), 92u);
+    for(unsigned r = 0; r < 10; ++r)
+    {
+        BOOST_CHECK_CLOSE(height_fields[0]->getHeight(254, r), height_fields[1]->getHeight(0, r), 1e-4);
+        BOOST_CHECK_CLOSE(height_fields[1]->getHeight(254, r), height_fields[2]->getHeight(0, r), 1e-4);
+        BOOST_CHECK_CLOSE(height_fields[2]->getHeight(91, r), 5.99, 1e-4);
+    }
+}
@@ -31,6 +31,7 @@
 #include <Eigen/Geometry>
 
 #include "StandaloneVisualizer.hpp"
+#include "MLSMapVisualization.hpp"
 #include <maps/grid/MLSMap.hpp>
 
 using namespace ::maps::grid;
@@ -135,3 +136,75 @@ BOOST_AUTO_TEST_CASE(mls_loop)
     show_MLS(mls);
 }
 
+
+/** Gives access to the scene graph updates without a viewer */
+struct TestMLSMapVisualization : public vizkit3d::MLSMapVisualization
+{
+    void render()
+    {
+        if(!node)
+            node = createMainNode();
+        updateMainNode(node.get());
+    }
+    osg::ref_ptr<osg::Node> node;
+};
+
+BOOST_AUTO_TEST_CASE(mlsviz_changed_tiles)
+{
+    MLSConfig mls_config;
+    mls_config.updateModel = MLSConfig::KALMAN;
+    MLSMapKalman mls(Vector2ui(100, 100), Vector2d(0.1, 0.1), mls_config);
+    for (int x = 0; x < 100; ++x)
+        for (int y = 0; y < 100; ++y)
+            mls.mergePatch(Index(x, y), MLSMapKalman::Patch(0.f, 0.01f));
+
+    TestMLSMapVisualization viz;
+    viz.setTileSize(32);
+    viz.updateData(mls);
+    BOOST_CHECK_EQUAL(viz.getChangedTiles().size(), 16u);
+
+    osg::ref_ptr<osg::Group> tile = viz.buildTile(Index(3, 3));
+    BOOST_REQUIRE_EQUAL(tile->getNumChildren(), 1u);
+    BOOST_CHECK(tile->getChild(0)->asGeode()->getNumDrawables() > 0);
+
+    // the first update starts the background build, the next one swaps in the tiles
+    viz.render();
+    viz.waitForBuild();
+    viz.render();
+    BOOST_CHECK(viz.getChangedTiles().empty());
+
+    // only the tile of the modified cell has to be rebuilt
+    mls.mergePatch(Index(40, 70), MLSMapKalman::Patch(1.f, 0.01f));
+    viz.updateData(mls);
+    std::vector<Index> changed = viz.getChangedTiles();
+    BOOST_REQUIRE_EQUAL(changed.size(), 1u);
+    BOOST_CHECK(changed[0] == Index(1, 2));
+
+    // the connected surface of a tile includes the first column of the next tile
+    mls.mergePatch(Index(64, 40), MLSMapKalman::Patch(1.f, 0.01f));
+    viz.updateData(mls);
+    BOOST_CHECK_EQUAL(viz.getChangedTiles().size(), 2u);
+    viz.setConnectedSurface(true);
+    BOOST_CHECK_EQUAL(viz.getChangedTiles().size(), 3u);
+
+    // the change tracking of a different map of the same size is not used, even if it is further ahead
+    mls.enableChangeTracking(32);
+    viz.updateData(mls);
+    viz.render();
+    viz.waitForBuild();
+    viz.render();
+    BOOST_CHECK(viz.getChangedTiles().empty());
+
+    MLSMapKalman other(Vector2ui(100, 100), Vector2d(0.1, 0.1), mls_config);
+    for (int x = 0; x < 100; ++x)
+        for (int y = 0; y < 100; ++y)
+            other.mergePatch(Index(x, y), MLSMapKalman::Patch(0.f, 0.01f));
+    other.enableChangeTracking(32);
+    for (int i = 0; i < 100; ++i)
+        other.markModified(Index(99, 99));
+    viz.updateData(other);
+    changed = viz.getChangedTiles();
+    BOOST_CHECK(std::find(changed.begin(), changed.end(), Index(1, 2)) != changed.end());
+    BOOST_CHECK(std::find(changed.begin(), changed.end(), Index(2, 1)) != changed.end());
+    BOOST_CHECK(std::find(changed.begin(), changed.end(), Index(0, 0)) == changed.end());
+}
@@ -0,0 +1,258 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <stdint.h>
+
+namespace vizkit3d
+{
+    /** Lets a running build job find out whether a newer job superseded it */
+    class BuildCancellation
+    {
+    public:
+        BuildCancellation(const std::atomic<uint64_t>& generation, uint64_t id)
+            : generation(generation), id(id)
+        {}
+
+        bool isCancelled() const
+        {
+            return generation.load() != id;
+        }
+
+    private:
+        const std::atomic<uint64_t>& generation;
+        uint64_t id;
+    };
+
+    /**
+     * @brief Builds the geometry of a plugin in a worker thread.
+     * @details
+     * The plugin hands a job, which captures a copy of the map data and builds
+     * the osg objects from it, to submit(). The worker runs the latest submitted
+     * job and calls the notify callback when it finished, so that updateMainNode()
+     * only has to swap the finished objects into the scene graph with takeResult().
+     * Submitting a new job cancels the previous one: it should check
+     * BuildCancellation::isCancelled() regularly, its result is discarded in any case.
+     *
+     * The callback runs in the worker thread. Plugins call setDirty() in it while
+     * holding their updateMutex, like updateData() does, so the flag is not
+     * reset by an update callback which is running at the same time.
+     */
+    template <class Result>
+    class BackgroundBuilder
+    {
+    public:
+        typedef std::function<Result (const BuildCancellation&)> Job;
+
+        explicit BackgroundBuilder(const std::function<void ()>& notify = std::function<void ()>())
+            : notify(notify),
+              generation(0),
+              has_result(false),
+              running(false),
+              stop(false),
+              worker(&BackgroundBuilder::run, this)
+        {}
+
+        ~BackgroundBuilder()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+                ++generation;
+            }
+            condition.notify_all();
+            worker.join();
+        }
+
+        BackgroundBuilder(const BackgroundBuilder&) = delete;
+        BackgroundBuilder& operator=(const BackgroundBuilder&) = delete;
+
+        /** Schedules @p job, a pending or running job is cancelled and an untaken result dropped */
+        void submit(const Job& job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending = job;
+                ++generation;
+                // only the result of the latest job is handed out
+                result = Result();
+                has_result = false;
+            }
+            condition.notify_all();
+        }
+
+        /** Cancels the pending or running job */
+        void cancel()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending = Job();
+                ++generation;
+            }
+            idle.notify_all();
+        }
+
+        /**
+         * Moves the result of the latest finished job to @p result.
+         * Returns false if there is no new result. An exception thrown by the job is rethrown here.
+         */
+        bool takeResult(Result& result)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(error)
+            {
+                std::exception_ptr e;
+                std::swap(e, error);
+                std::rethrow_exception(e);
+            }
+            if(!has_result)
+                return false;
+            result = std::move(this->result);
+            this->result = Result();
+            has_result = false;
+            return true;
+        }
+
+        /** Returns true while a job is pending or running */
+        bool isBusy() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return pending || running;
+        }
+
+        /** Blocks until no job is pending or running */
+        void wait() const
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            idle.wait(lock, [this]{ return !pending && !running; });
+        }
+
+        /**
+         * Calls @p f(begin, end) for chunks of [0, @p n) in parallel, unless
+         * @p cancellation is set. Helper for jobs filling large vertex or pixel arrays.
+         * The first exception thrown by @p f is rethrown after all chunks finished.
+         */
+        template <class F>
+        static void parallelFor(int n, int chunk_size, const BuildCancellation& cancellation, const F& f)
+        {
+            const int num_chunks = (n + chunk_size - 1) / chunk_size;
+            std::exception_ptr chunk_error;
+#pragma omp parallel for schedule(dynamic)
+            for(int chunk = 0; chunk < num_chunks; ++chunk)
+            {
+                if(cancellation.isCancelled())
+                    continue;
+                // exceptions must not leave the parallel region
+                try
+                {
+                    f(chunk * chunk_size, std::min(n, (chunk + 1) * chunk_size));
+                }
+                catch(...)
+                {
+#pragma omp critical(background_builder_error)
+                    if(!chunk_error)
+                        chunk_error = std::current_exception();
+                }
+            }
+            if(chunk_error)
+                std::rethrow_exception(chunk_error);
+        }
+
+    private:
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true)
+            {
+                condition.wait(lock, [this]{ return stop || pending; });
+                if(stop)
+                    return;
+
+                Job job;
+                job.swap(pending);
+                const uint64_t id = generation;
+                running = true;
+                lock.unlock();
+
+                Result job_result;
+                std::exception_ptr job_error;
+                try
+                {
+                    job_result = job(BuildCancellation(generation, id));
+                }
+                catch(...)
+                {
+                    job_error = std::current_exception();
+                }
+
+                lock.lock();
+                const bool finished = id == generation;
+                if(finished)
+                {
+                    if(job_error)
+                        error = job_error;
+                    else
+                    {
+                        result = std::move(job_result);
+                        has_result = true;
+                    }
+                }
+
+                if(finished && notify)
+                {
+                    lock.unlock();
+                    notify();
+                    lock.lock();
+                }
+                running = false;
+                idle.notify_all();
+            }
+        }
+
+        std::function<void ()> notify;
+        mutable std::mutex mutex;
+        std::condition_variable condition;
+        mutable std::condition_variable idle;
+        std::atomic<uint64_t> generation;
+        Job pending;
+        Result result;
+        std::exception_ptr error;
+        bool has_result;
+        bool running;
+        bool stop;
+        // has to be initialized last
+        std::thread worker;
+    };
+}
@@ -33,6 +33,8 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
+#include <stdint.h>
 
 namespace vizkit3d
 {
@@ -122,5 +124,22 @@ namespace vizkit3d
 
             return;
         }
+
+        //-- Samples the gradient at (size) equidistant values between 0 and 1 into
+        //-- (table) as RGBA bytes, so colors can be looked up instead of interpolated.
+        void createLookupTable(std::vector<uint8_t> &table, unsigned size = 1024) const
+        {
+            size = std::max(size, 2u);
+            table.resize(4 * size);
+            for(unsigned i = 0; i < size; i++)
+            {
+                float red = 1.f, green = 1.f, blue = 0.6f;
+                getColorAtValue(i / float(size - 1), red, green, blue);
+                table[4 * i + 0] = static_cast<uint8_t>(red * 255.0);
+                table[4 * i + 1] = static_cast<uint8_t>(green * 255.0);
+                table[4 * i + 2] = static_cast<uint8_t>(blue * 255.0);
+                table[4 * i + 3] = 255;
+            }
+        }
     };
 }
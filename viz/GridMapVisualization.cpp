@@ -25,6 +25,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 #include <iostream>
+#include <cmath>
 
 #include "GridMapVisualization.hpp"
 
@@ -45,7 +46,13 @@ struct GridMapVisualization::Data {
     //
     // Making a copy is required because of how OSG works
     virtual ~Data() { }
-    virtual void visualize(osg::Geode& geode, bool showHeightField, bool interpolateCellColors, bool useNPOTTextures) const = 0;
+    /** Returns the range of the values which are not the default value */
+    virtual void getRange(double& min, double& max) const = 0;
+    /** Writes the colors (and the heights, if requested) of the rows [rowBegin, rowEnd) of the cells [begin, end) */
+    virtual void fillRows(const Index& begin, const Index& end, int rowBegin, int rowEnd, double min, double max,
+                          const std::vector<uint8_t>& colorTable, unsigned char* pixels, float* heights) const = 0;
+    virtual bool hasChanges(const Data& other, const Index& begin, const Index& end) const = 0;
+    virtual maps::grid::Vector2ui getNumCells() const = 0;
     virtual maps::grid::CellExtents getCellExtents() const = 0;
     virtual maps::grid::Vector2d getResolution() const = 0;
     virtual base::Affine3d getLocalFrame() const = 0;
@@ -56,95 +63,73 @@ struct DataHold : public GridMapVisualization::Data
 {
     GridMap<GridT> grid;
 
-    ColorGradient heatMapGradient;
-
     DataHold(const GridMap<GridT> grid) 
         : grid(grid) 
     {
-        this->heatMapGradient.createDefaultHeatMapGradient();
     }
 
-    void visualize(osg::Geode& geode, bool showHeightField ,bool interpolateCellColors, bool useNPOTTextures) const
+    void getRange(double& min, double& max) const
     {
-        while(geode.removeDrawables(0));
-
-        // Create height field.
-        if (showHeightField)
-        {
-            osg::ref_ptr<osg::HeightField> heightField = createHeighField();
-
-            // Add height field to geode.
-            osg::ShapeDrawable *drawable = new osg::ShapeDrawable(heightField);
-            geode.addDrawable(drawable);
-        }
-        else
+        if(grid.getNumCells().prod() == 0)
         {
-            osg::ref_ptr<osg::Geometry> plane = createPlane();
-            geode.addDrawable(plane.get());
+            min = max = 0.;
+            return;
         }
+        min = grid.getMin(false);
+        max = grid.getMax(false);
+    }
 
-        // Set material properties.
-        osg::StateSet* state = geode.getOrCreateStateSet();
-        osg::ref_ptr<osg::Material> mat = new osg::Material;
-        mat->setColorMode( osg::Material::AMBIENT_AND_DIFFUSE );
-
-        mat->setAmbient( osg::Material::FRONT_AND_BACK,
-                osg::Vec4( .5f, .5f, .3f, 1.0f ) );
-        mat->setDiffuse( osg::Material::FRONT_AND_BACK,
-                osg::Vec4( .5f, .5f, .3f, 1.0f ) );
-        //mat->setSpecular( osg::Material::FRONT,
-        //          osg::Vec4( 1.f, 1.f, 1.f, 1.0f ) );
+    void fillRows(const Index& begin, const Index& end, int rowBegin, int rowEnd, double min, double max,
+                  const std::vector<uint8_t>& colorTable, unsigned char* pixels, float* heights) const
+    {
+        const int width = end.x() - begin.x();
+        const int num_colors = colorTable.size() / 4;
+        const GridT default_value = grid.getDefaultValue();
 
-        state->setAttribute( mat.get() );
+        //scaling between the min and max value of the map
+        double scaling = std::abs(max - min);
 
-        osg::ref_ptr<osg::Image> image = createTextureImage();   
-        osg::Texture2D* tex = new osg::Texture2D(image);
+        if(scaling == 0)
+            scaling = 1.0;
 
-        if (interpolateCellColors)
+        for (int y = rowBegin; y < rowEnd; ++y)
         {
-            tex->setFilter(osg::Texture2D::MIN_FILTER,osg::Texture2D::LINEAR_MIPMAP_LINEAR);
-            tex->setFilter(osg::Texture2D::MAG_FILTER,osg::Texture2D::LINEAR);
-        }
-        else
-        {
-            tex->setFilter(osg::Texture::MIN_FILTER, osg::Texture::NEAREST_MIPMAP_NEAREST);
-            tex->setFilter(osg::Texture::MAG_FILTER, osg::Texture::NEAREST);
-        }
+            unsigned char* pos = pixels + 4 * y * width;
+            for (int x = 0; x < width; ++x)
+            {
+                /** Get the cell value **/
+                const GridT cell_value = grid.at(begin.x() + x, begin.y() + y);
 
-        tex->setResizeNonPowerOfTwoHint(!useNPOTTextures);
-        state->setTextureAttributeAndModes(0, tex);          
+                // values outside of the range get the colors of the ends of the gradient,
+                // NaN the color of the end like in ColorGradient::getColorAtValue
+                const double normalize_value = (cell_value - min) / scaling;
+                int color = num_colors - 1;
+                if(!std::isnan(normalize_value))
+                    color = std::min(std::max(normalize_value, 0.), 1.) * (num_colors - 1) + 0.5;
 
-        if (showHeightField)
-        {
-            // Use osg::TexMat to set the scale and positioning of the texture.
-            // NOTE: Necissary since the HeightField is drawn from cell center to cell center,
-            //       thus being smaller than the texture is supposed to be.
-            osg::Matrixd scaleMatrix, translationMatrix, scaleTranslationMatrix;
-            float xScale = (grid.getNumCells().x() - 1) / static_cast<float>(grid.getNumCells().x());
-            float yScale = (grid.getNumCells().y() - 1) / static_cast<float>(grid.getNumCells().y());
-            float xTranslation = (1. - xScale) / 2;
-            float yTranslation = (1. - yScale) / 2;
-
-            scaleMatrix.makeScale(osg::Vec3(xScale, yScale, 0.));
-            translationMatrix.makeTranslate(osg::Vec3(xTranslation, yTranslation, 0.));
-            scaleTranslationMatrix = scaleMatrix * translationMatrix;
-
-            osg::ref_ptr<osg::TexMat> textureMatrix = new osg::TexMat(scaleTranslationMatrix);
-
-            state->setTextureAttributeAndModes(0, textureMatrix.get(), osg::StateAttribute::ON);
-        }
-        else
-        {
-            // Set texture without scaling when using the plane.
-            osg::ref_ptr<osg::TexMat> textureMatrix = static_cast<osg::TexMat*>(state->getTextureAttribute(0, osg::StateAttribute::TEXMAT));
-            if (textureMatrix)
-            {
-                textureMatrix->setMatrix(osg::Matrixd());
-            }
+                std::copy(&colorTable[4 * color], &colorTable[4 * color] + 4, pos);
+                pos += 4;
 
+                if(heights)
+                    heights[x + y * width] = cell_value != default_value ? cell_value : min;    // min elevation
+            }
         }
-    };
-    
+    }
+
+    bool hasChanges(const Data& other_data, const Index& begin, const Index& end) const
+    {
+        const DataHold* other = dynamic_cast<const DataHold*>(&other_data);
+        if(!other || other->grid.getNumCells() != grid.getNumCells() || other->grid.getDefaultValue() != grid.getDefaultValue())
+            return true;
+
+        return grid.differsFrom(other->grid, begin, end);
+    }
+
+    maps::grid::Vector2ui getNumCells() const
+    {
+        return grid.getNumCells();
+    }
+
     maps::grid::CellExtents getCellExtents() const
     {
         return grid.calculateCellExtents();
@@ -159,161 +144,348 @@ struct DataHold : public GridMapVisualization::Data
     {
         return grid.getLocalFrame();
     }
+};
 
-    osg::ref_ptr<osg::Geometry> createPlane() const
-    {
-        maps::grid::Vector2d mapSize = grid.getSize();
+struct GridMapVisualization::BuildResult
+{
+    boost::shared_ptr<Data> data;
+    unsigned settingsVersion;
+    bool rebuildAll;
+    maps::grid::Vector2ui numTiles;
+    double min, max;
+    std::vector<maps::grid::Index> tiles;
+    /** RGBA pixels and heights of the changed tiles */
+    std::vector< std::vector<unsigned char> > pixels;
+    std::vector< std::vector<float> > heights;
+
+    BuildResult()
+        : settingsVersion(0)
+        , rebuildAll(false)
+        , min(0.)
+        , max(0.)
+    {}
+};
 
-        osg::ref_ptr<osg::Geometry> plane = new osg::Geometry();
+/** Cells [begin, end) of a tile and the cells [image_begin, image_end) of its texture,
+ *  which adds the adjacent row and column of the neighbouring tiles on each side */
+static void getTileCells(const Index& tile, const maps::grid::Vector2ui& num_cells, int texture_size,
+                         Index& begin, Index& end, Index& image_begin, Index& image_end)
+{
+    begin = tile * (texture_size - 2);
+    end = (begin.array() + texture_size - 2).matrix().cwiseMin(num_cells.cast<int>());
+    image_begin = (begin.array() - 1).matrix().cwiseMax(Index(0, 0));
+    image_end = (end.array() + 1).matrix().cwiseMin(num_cells.cast<int>());
+}
 
-        // Assign white as a color to the plane.
-        osg::ref_ptr<osg::Vec4Array> c = new osg::Vec4Array;
-        plane->setColorArray(c.get());
-        plane->setColorBinding(osg::Geometry::BIND_OVERALL);
-        c->push_back( osg::Vec4(1.0f, 1.0f, 1.0f, 1.0f));
+GridMapVisualization::GridMapVisualization()
+    : MapVisualization<maps::grid::GridMap<double>>()
+    , rebuild(false)
+    , tilesOutdated(true)
+    , settingsVersion(0)
+    , builder(new BackgroundBuilder<BuildResult>([this]{ boost::mutex::scoped_lock lock(updateMutex); setDirty(); }))
+    , numTiles(0, 0)
+    , shownMin(0.)
+    , shownMax(0.)
+    , showHeightField(false)
+    , interpolateCellColors(true)
+    , useNPOTTextures(false)
+{
+    ColorGradient heatMapGradient;
+    heatMapGradient.createDefaultHeatMapGradient();
+    heatMapGradient.createLookupTable(colorTable);
+}
 
-        // Set texture coordinates.
-        osg::ref_ptr<osg::Vec2dArray>  texture_coordinates = new osg::Vec2dArray;
-        texture_coordinates->push_back(osg::Vec2d(0,0));
-        texture_coordinates->push_back(osg::Vec2d(1,0));
-        texture_coordinates->push_back(osg::Vec2d(1,1));
-        texture_coordinates->push_back(osg::Vec2d(0,1));
-        plane->setTexCoordArray(0, texture_coordinates.get());
+GridMapVisualization::~GridMapVisualization()
+{
+    // stop the worker before the members it uses are destroyed
+    builder.reset();
+}
 
-        // Specify the vertices.
-        osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
-        vertices->push_back(osg::Vec3(0, 0, 0));
-        vertices->push_back(osg::Vec3(mapSize.x(), 0, 0));
-        vertices->push_back(osg::Vec3(mapSize.x(), mapSize.y(), 0));
-        vertices->push_back(osg::Vec3(0, mapSize.y(), 0));
-        plane->setVertexArray(vertices.get());
+osg::ref_ptr<osg::Node> GridMapVisualization::createMainNode()
+{
+    osg::ref_ptr<osg::Group> mainNode = MapVisualization::createMainNode()->asGroup();
+    tileGroup = new osg::Group();
 
-        osg::ref_ptr<osg::DrawArrays> drawArrays = new osg::DrawArrays(osg::PrimitiveSet::POLYGON, 0, vertices->size());
-        plane->addPrimitiveSet(drawArrays.get());
+    // Set material properties.
+    osg::StateSet* state = tileGroup->getOrCreateStateSet();
+    osg::ref_ptr<osg::Material> mat = new osg::Material;
+    mat->setColorMode( osg::Material::AMBIENT_AND_DIFFUSE );
 
-        return plane;
-    }
+    mat->setAmbient( osg::Material::FRONT_AND_BACK,
+            osg::Vec4( .5f, .5f, .3f, 1.0f ) );
+    mat->setDiffuse( osg::Material::FRONT_AND_BACK,
+            osg::Vec4( .5f, .5f, .3f, 1.0f ) );
 
-    osg::HeightField* createHeighField() const
-    {
-        // create height field
-        osg::HeightField* heightField = new osg::HeightField();
-        heightField->allocate(grid.getNumCells().x(), grid.getNumCells().y());
-        heightField->setXInterval(grid.getResolution().x());
-        heightField->setYInterval(grid.getResolution().y());
-        heightField->setSkirtHeight(0.0f); 
+    state->setAttribute( mat.get() );
 
-        heightField->setOrigin(osg::Vec3(grid.getResolution().x() / 2.0, grid.getResolution().y() / 2, 0.0));
+    mainNode->addChild(tileGroup.get());
+    tiles.clear();
+    tilesOutdated = true;
+    ++settingsVersion;
+    rebuild = true;
 
-        double min = grid.getMin(false);
-        double default_value = grid.getDefaultValue();
+    return mainNode;
+}
 
-        for (unsigned int r = 0; r < heightField->getNumRows(); r++) 
+void GridMapVisualization::updateMainNode ( osg::Node* node )
+{
+    // Copy the tiles finished by the builder into the shown images and height fields.
+    // Results of older settings are dropped, the tiles are recreated below.
+    BuildResult result;
+    if(builder->takeResult(result) && result.settingsVersion == settingsVersion)
+    {
+        if(result.rebuildAll)
         {
-            for (unsigned int c = 0; c < heightField->getNumColumns(); c++) 
+            tileGroup->removeChildren(0, tileGroup->getNumChildren());
+            tiles.clear();
+            numTiles = result.numTiles;
+            const maps::grid::Vector2ui num_cells = result.data->getNumCells();
+            for(unsigned ty = 0; ty < numTiles.y(); ++ty)
             {
-                GridT cell_value = grid.at(maps::grid::Index(c, r));
-
-                if( cell_value !=  default_value)
-                    heightField->setHeight(c, r, cell_value);
-                else
-                    heightField->setHeight(c, r, min);    // min elevation
+                for(unsigned tx = 0; tx < numTiles.x(); ++tx)
+                {
+                    Index begin, end, image_begin, image_end;
+                    getTileCells(Index(tx, ty), num_cells, TextureSize, begin, end, image_begin, image_end);
+                    tiles.push_back(createTile(begin, end, image_begin, image_end, result.data->getResolution()));
+                    tileGroup->addChild(tiles.back().geode.get());
+                }
             }
-        }     
-
-        return heightField;  
-    }    
+            tilesOutdated = false;
+        }
+        for(size_t i = 0; i < result.tiles.size(); ++i)
+            updateTile(tiles[result.tiles[i].x() + result.tiles[i].y() * numTiles.x()], result.pixels[i], result.heights[i]);
+        shown = result.data;
+        shownMin = result.min;
+        shownMax = result.max;
+    }
 
-    osg::Image* createTextureImage() const
+    // Color the changed tiles of new data in the background.
+    if(p && rebuild)
     {
-        osg::Image* image = new osg::Image(); 
-
-        //convert double to uint16 
-        int size = grid.getNumCells().x() * grid.getNumCells().y() * 4;
-        unsigned char* image_raw_data = new unsigned char[size];
-        unsigned char* pos = image_raw_data;
-
-        GridT min = grid.getMin(false);
-        GridT max = grid.getMax(false);
-
-        //scaling between SCALING_MIN_VALUE and SCALING_MAX_VALUE meters 
-        double scaling = std::abs(max - min);
-
-        if(scaling == 0)
-            scaling = 1.0;
-
-        // fill image with color
-        for (unsigned int y = 0; y < grid.getNumCells().y(); ++y)
+        const maps::grid::Vector2ui num_cells = p->getNumCells();
+        const maps::grid::Vector2ui num_tiles((num_cells.x() + TextureSize - 3) / (TextureSize - 2),
+                                              (num_cells.y() + TextureSize - 3) / (TextureSize - 2));
+        const bool rebuild_all = tilesOutdated || !shown || num_tiles != numTiles || num_cells != shown->getNumCells()
+                                 || !p->getResolution().isApprox(shown->getResolution());
+
+        const boost::shared_ptr<Data> data = p;
+        const boost::shared_ptr<Data> base = rebuild_all ? boost::shared_ptr<Data>() : shown;
+        const double base_min = shownMin, base_max = shownMax;
+        const bool height_field = showHeightField;
+        const unsigned settings_version = settingsVersion;
+        const std::vector<uint8_t> color_table = colorTable;
+        builder->submit([=](const BuildCancellation& cancellation)
         {
-            for (unsigned int x = 0; x < grid.getNumCells().x(); ++x)
+            BuildResult result;
+            result.data = data;
+            result.settingsVersion = settings_version;
+            result.numTiles = num_tiles;
+            data->getRange(result.min, result.max);
+            // the colors and the height of empty cells depend on the range of the whole map
+            result.rebuildAll = rebuild_all || result.min != base_min || result.max != base_max;
+            result.tiles = findChangedTiles(*data, result.rebuildAll ? NULL : base.get());
+
+            result.pixels.resize(result.tiles.size());
+            result.heights.resize(result.tiles.size());
+            for(size_t i = 0; i < result.tiles.size(); ++i)
             {
-                /** Get the cell value **/
-                GridT cell_value = grid.at(maps::grid::Index(x, y));
+                Index begin, end, image_begin, image_end;
+                getTileCells(result.tiles[i], num_cells, TextureSize, begin, end, image_begin, image_end);
+                const Index size = image_end - image_begin;
+                result.pixels[i].resize(4 * size.prod());
+                if(height_field)
+                    result.heights[i].resize(size.prod());
+            }
 
-                double normalize_value = (double)(cell_value - min)/scaling;
-                osg::Vec4f col(1.0,1.0,0.6,1.0);
-                this->heatMapGradient.getColorAtValue(normalize_value, col.r(),col.g(),col.b());
+            // color the rows of all changed tiles in parallel
+            BackgroundBuilder<BuildResult>::parallelFor(result.tiles.size() * TextureSize, 32, cancellation, [&](int begin_row, int end_row)
+            {
+                for(int row = begin_row; row < end_row;)
+                {
+                    const size_t i = row / TextureSize;
+                    Index begin, end, image_begin, image_end;
+                    getTileCells(result.tiles[i], num_cells, TextureSize, begin, end, image_begin, image_end);
+                    const int first = row % TextureSize;
+                    const int last = std::min<int>(first + end_row - row, image_end.y() - image_begin.y());
+                    if(first < last)
+                        data->fillRows(image_begin, image_end, first, last, result.min, result.max, color_table,
+                                       &result.pixels[i][0], height_field ? &result.heights[i][0] : NULL);
+                    row += std::min(end_row - row, TextureSize - first);
+                }
+            });
+            return result;
+        });
+        rebuild = false;
+    }
 
-                *pos++ = (unsigned char)(col.r() * 255.0);
-                *pos++ = (unsigned char)(col.g() * 255.0);
-                *pos++ = (unsigned char)(col.b() * 255.0);
-                *pos++ = (unsigned char)(col.a() * 255.0);
-            }
-        }
+    if(!shown) return;
 
-        image->setImage(
-                grid.getNumCells().x(),
-                grid.getNumCells().y(),
-                1, // datadepth per channel
-                GL_RGBA, 
-                GL_RGBA, 
-                GL_UNSIGNED_BYTE, // GLenum type, (GL_UNSIGNED_BYTE, 0x1401)
-                (unsigned char*)(image_raw_data), // unsigned char* data
-                osg::Image::USE_NEW_DELETE, // USE_NEW_DELETE, //osg::Image::NO_DELETE,// AllocationMode mode (shallow copy)
-                1);      
-
-        return image;
-    }    
-};
+    // Draw map extents.
+    visualizeMapExtents(shown->getCellExtents(), shown->getResolution());
 
-GridMapVisualization::GridMapVisualization()
-    : MapVisualization<maps::grid::GridMap<double>>()
-    , p(0)
-    , showHeightField(false)
-    , interpolateCellColors(true)
-{}
+    // Set local frame.
+    setLocalFrame(shown->getLocalFrame());
+}
 
-GridMapVisualization::~GridMapVisualization()
+void GridMapVisualization::waitForBuild() const
 {
+    builder->wait();
 }
 
-osg::ref_ptr<osg::Node> GridMapVisualization::createMainNode()
+std::vector<maps::grid::Index> GridMapVisualization::findChangedTiles(const Data& data, const Data* base)
 {
-    osg::ref_ptr<osg::Group> mainNode = MapVisualization::createMainNode()->asGroup();
-    geode = new osg::Geode();
-    mainNode->addChild(geode.get());
-
-    return mainNode;
+    std::vector<Index> changed;
+    const maps::grid::Vector2ui num_cells = data.getNumCells();
+    for(unsigned ty = 0; ty * (TextureSize - 2) < num_cells.y(); ++ty)
+    {
+        for(unsigned tx = 0; tx * (TextureSize - 2) < num_cells.x(); ++tx)
+        {
+            Index begin, end, image_begin, image_end;
+            getTileCells(Index(tx, ty), num_cells, TextureSize, begin, end, image_begin, image_end);
+            if(!base || data.hasChanges(*base, image_begin, image_end))
+                changed.push_back(Index(tx, ty));
+        }
+    }
+    return changed;
 }
 
-void GridMapVisualization::updateMainNode ( osg::Node* node )
+GridMapVisualization::Tile GridMapVisualization::createTile(const Index& begin, const Index& end,
+                                                            const Index& imageBegin, const Index& imageEnd,
+                                                            const maps::grid::Vector2d& resolution) const
 {
-    if(!p) return;
+    Tile tile;
+    tile.geode = new osg::Geode();
+    tile.heightFieldOffset = begin - imageBegin;
+    const Index size = imageEnd - imageBegin;
 
-    // Draw map.
-    p->visualize(*geode, showHeightField, interpolateCellColors, useNPOTTextures);
+    tile.image = new osg::Image();
+    tile.image->allocateImage(size.x(), size.y(), 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    tile.image->setInternalTextureFormat(GL_RGBA);
+    tile.image->setDataVariance(osg::Object::DYNAMIC);
 
-    // Draw map extents.
-    visualizeMapExtents(p->getCellExtents(), p->getResolution());
+    osg::StateSet* state = tile.geode->getOrCreateStateSet();
+    osg::Texture2D* tex = new osg::Texture2D(tile.image.get());
 
-    // Set local frame.
-    setLocalFrame(p->getLocalFrame());
+    if (interpolateCellColors)
+    {
+        tex->setFilter(osg::Texture2D::MIN_FILTER,osg::Texture2D::LINEAR_MIPMAP_LINEAR);
+        tex->setFilter(osg::Texture2D::MAG_FILTER,osg::Texture2D::LINEAR);
+    }
+    else
+    {
+        tex->setFilter(osg::Texture::MIN_FILTER, osg::Texture::NEAREST_MIPMAP_NEAREST);
+        tex->setFilter(osg::Texture::MAG_FILTER, osg::Texture::NEAREST);
+    }
+    tex->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+    tex->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+
+    tex->setResizeNonPowerOfTwoHint(!useNPOTTextures);
+    state->setTextureAttributeAndModes(0, tex);
+
+    if (showHeightField)
+    {
+        // The height field is drawn from cell center to cell center, up to the first
+        // cells of the next tiles, and needs two cells in each direction.
+        const Index cells = imageEnd - begin;
+        if((cells.array() < 2).any())
+            return tile;
+
+        tile.heightField = new osg::HeightField();
+        tile.heightField->allocate(cells.x(), cells.y());
+        tile.heightField->setXInterval(resolution.x());
+        tile.heightField->setYInterval(resolution.y());
+        tile.heightField->setSkirtHeight(0.0f);
+        tile.heightField->setOrigin(osg::Vec3((begin.x() + 0.5) * resolution.x(), (begin.y() + 0.5) * resolution.y(), 0.0));
+        tile.geode->addDrawable(new osg::ShapeDrawable(tile.heightField.get()));
+
+        // Use osg::TexMat to set the scale and positioning of the texture.
+        // NOTE: Necissary since the HeightField is drawn from cell center to cell center,
+        //       thus being smaller than the texture is supposed to be.
+        osg::Matrixd scaleMatrix, translationMatrix, scaleTranslationMatrix;
+        float xScale = (cells.x() - 1) / static_cast<float>(size.x());
+        float yScale = (cells.y() - 1) / static_cast<float>(size.y());
+        float xTranslation = (tile.heightFieldOffset.x() + 0.5) / size.x();
+        float yTranslation = (tile.heightFieldOffset.y() + 0.5) / size.y();
+
+        scaleMatrix.makeScale(osg::Vec3(xScale, yScale, 0.));
+        translationMatrix.makeTranslate(osg::Vec3(xTranslation, yTranslation, 0.));
+        scaleTranslationMatrix = scaleMatrix * translationMatrix;
+
+        osg::ref_ptr<osg::TexMat> textureMatrix = new osg::TexMat(scaleTranslationMatrix);
+
+        state->setTextureAttributeAndModes(0, textureMatrix.get(), osg::StateAttribute::ON);
+    }
+    else
+    {
+        // The plane covers the cells of the tile, the outer rows and columns of the
+        // texture belong to the neighbouring tiles and are only used for interpolation.
+        osg::ref_ptr<osg::Geometry> plane = new osg::Geometry();
+
+        // Assign white as a color to the plane.
+        osg::ref_ptr<osg::Vec4Array> c = new osg::Vec4Array;
+        plane->setColorArray(c.get());
+        plane->setColorBinding(osg::Geometry::BIND_OVERALL);
+        c->push_back( osg::Vec4(1.0f, 1.0f, 1.0f, 1.0f));
+
+        // Set texture coordinates.
+        const osg::Vec2 uv_min(tile.heightFieldOffset.x() / static_cast<float>(size.x()),
+                               tile.heightFieldOffset.y() / static_cast<float>(size.y()));
+        const osg::Vec2 uv_max((end.x() - imageBegin.x()) / static_cast<float>(size.x()),
+                               (end.y() - imageBegin.y()) / static_cast<float>(size.y()));
+        osg::ref_ptr<osg::Vec2Array>  texture_coordinates = new osg::Vec2Array;
+        texture_coordinates->push_back(osg::Vec2(uv_min.x(), uv_min.y()));
+        texture_coordinates->push_back(osg::Vec2(uv_max.x(), uv_min.y()));
+        texture_coordinates->push_back(osg::Vec2(uv_max.x(), uv_max.y()));
+        texture_coordinates->push_back(osg::Vec2(uv_min.x(), uv_max.y()));
+        plane->setTexCoordArray(0, texture_coordinates.get());
+
+        // Specify the vertices.
+        const osg::Vec2 min(begin.x() * resolution.x(), begin.y() * resolution.y());
+        const osg::Vec2 max(end.x() * resolution.x(), end.y() * resolution.y());
+        osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+        vertices->push_back(osg::Vec3(min.x(), min.y(), 0));
+        vertices->push_back(osg::Vec3(max.x(), min.y(), 0));
+        vertices->push_back(osg::Vec3(max.x(), max.y(), 0));
+        vertices->push_back(osg::Vec3(min.x(), max.y(), 0));
+        plane->setVertexArray(vertices.get());
+
+        osg::ref_ptr<osg::DrawArrays> drawArrays = new osg::DrawArrays(osg::PrimitiveSet::POLYGON, 0, vertices->size());
+        plane->addPrimitiveSet(drawArrays.get());
+        tile.geode->addDrawable(plane.get());
+    }
+
+    return tile;
+}
+
+void GridMapVisualization::updateTile(Tile& tile, const std::vector<unsigned char>& pixels, const std::vector<float>& heights) const
+{
+    if(pixels.size() == tile.image->getTotalSizeInBytes())
+    {
+        std::copy(pixels.begin(), pixels.end(), tile.image->data());
+        // only the texture of this tile is uploaded again
+        tile.image->dirty();
+    }
+
+    if(tile.heightField && heights.size() == pixels.size() / 4)
+    {
+        // the heights cover the image, the height field starts at the first cell of the tile
+        const unsigned width = tile.image->s();
+        const Index& offset = tile.heightFieldOffset;
+        for (unsigned int r = 0; r < tile.heightField->getNumRows(); r++)
+            for (unsigned int c = 0; c < tile.heightField->getNumColumns(); c++)
+                tile.heightField->setHeight(c, r, heights[(c + offset.x()) + (r + offset.y()) * width]);
+        // the drawable tessellates the height field when it is created
+        tile.geode->setDrawable(0, new osg::ShapeDrawable(tile.heightField.get()));
+    }
 }
 
 void GridMapVisualization::setShowHeightField(bool enabled)
 {
     showHeightField = enabled;
     emit propertyChanged("showHeightField");
+    tilesOutdated = true;
+    ++settingsVersion;
+    rebuild = true;
     setDirty();
 }
 
@@ -326,6 +498,9 @@ void GridMapVisualization::setInterpolateCellColors(bool enabled)
 {
     interpolateCellColors = enabled;
     emit propertyChanged("interpolateCellColors");
+    tilesOutdated = true;
+    ++settingsVersion;
+    rebuild = true;
     setDirty();
 }
 
@@ -338,6 +513,9 @@ void GridMapVisualization::setUseNPOTTextures(bool enabled)
 {
     useNPOTTextures = enabled;
     emit propertyChanged("useNPOTTextures");
+    tilesOutdated = true;
+    ++settingsVersion;
+    rebuild = true;
     setDirty();
 }
 
@@ -349,21 +527,25 @@ bool GridMapVisualization::areNPOTTexturesUsed() const
 void GridMapVisualization::updateDataIntern(::maps::grid::GridMap<double> const& value)
 {
     p.reset(new DataHold<double>( value ));
+    rebuild = true;
 }
 
 void GridMapVisualization::updateDataIntern(::maps::grid::GridMap<float> const& value)
 {
     p.reset(new DataHold<float>( value ));
+    rebuild = true;
 }
 
 void GridMapVisualization::updateDataIntern(::maps::grid::GridMap<int> const& value)
 {
     p.reset(new DataHold<int>( value ));
+    rebuild = true;
 }
 
 void GridMapVisualization::updateDataIntern(::maps::grid::GridMap<char> const& value)
 {
     p.reset(new DataHold<char>( value ));
+    rebuild = true;
 }
 
 //Macro that makes this plugin loadable in ruby, this is optional.
@@ -29,13 +29,18 @@
 
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
 
 #include <vizkit3d/MapVisualization.hpp>
 
 #include <osg/Geode>
+#include <osg/Image>
 #include <osg/Shape>
 #include <osg/Texture2D>
 
+#include "BackgroundBuilder.hpp"
+
 #if QT_VERSION >= 0x050000 || !defined(Q_MOC_RUN)
     #include <maps/grid/GridMap.hpp>
 #endif
@@ -68,6 +73,12 @@ namespace vizkit3d
             Q_INVOKABLE void updateGridMapC(::maps::grid::GridMapC const &sample)
             {vizkit3d::Vizkit3DPlugin<::maps::grid::GridMap<double>>::updateData(sample);}
 
+            /** Blocks until the background build of the latest data finished */
+            void waitForBuild() const;
+
+            /** Copy of the map data, implemented by a template for each map type */
+            struct Data;
+
         protected:
             virtual osg::ref_ptr<osg::Node> createMainNode();
             virtual void updateMainNode(osg::Node* node);
@@ -77,10 +88,46 @@ namespace vizkit3d
             virtual void updateDataIntern(::maps::grid::GridMap<char> const& plan);            
 
         private:
-            struct Data;
-            boost::scoped_ptr<Data> p;            
+            struct BuildResult;
+
+            /** Persistent geometry and texture of one tile of the map, which
+             *  is updated in place when cells of the tile change */
+            struct Tile
+            {
+                osg::ref_ptr<osg::Geode> geode;
+                osg::ref_ptr<osg::Image> image;
+                osg::ref_ptr<osg::HeightField> heightField;
+                /** Position of the first height field cell in the image */
+                ::maps::grid::Index heightFieldOffset;
+            };
+
+            /** Number of cells of a tile texture. The texture also contains the
+             *  adjacent row and column of the neighbouring tiles, so interpolated
+             *  colors and height fields connect without seams */
+            static const int TextureSize = 256;
+
+            Tile createTile(const ::maps::grid::Index& begin, const ::maps::grid::Index& end,
+                            const ::maps::grid::Index& imageBegin, const ::maps::grid::Index& imageEnd,
+                            const ::maps::grid::Vector2d& resolution) const;
+            void updateTile(Tile& tile, const std::vector<unsigned char>& pixels, const std::vector<float>& heights) const;
+            static std::vector< ::maps::grid::Index > findChangedTiles(const Data& data, const Data* base);
+
+            /** The latest data and the data the shown geometry was built from */
+            boost::shared_ptr<Data> p, shown;
+            bool rebuild;
+            /** The tiles have to be recreated because a setting changed */
+            bool tilesOutdated;
+            /** Counts the setting changes, results of older settings are dropped */
+            unsigned settingsVersion;
+            boost::scoped_ptr< BackgroundBuilder<BuildResult> > builder;
 
-            osg::ref_ptr<osg::Geode> geode;
+            osg::ref_ptr<osg::Group> tileGroup;
+            std::vector<Tile> tiles;
+            ::maps::grid::Vector2ui numTiles;
+            /** Value range the shown tiles were colored with */
+            double shownMin, shownMax;
+            /** Colors of the heat map gradient as RGBA bytes */
+            std::vector<uint8_t> colorTable;
 
             bool showHeightField;
             bool interpolateCellColors;
@@ -25,6 +25,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 #include <iostream>
+#include <algorithm>
 
 #include <osg/Geode>
 #include <osg/ShapeDrawable>
@@ -67,14 +68,30 @@ struct MLSMapVisualization::Data {
     Data(MLSMapVisualization& vis):visualization(vis) {}
     virtual ~Data() { }
     virtual Eigen::Vector2d getResolution() const = 0;
-    virtual void visualize(vizkit3d::PatchesGeode& geode, int levelOffset) const = 0;
-    virtual void visualize(vizkit3d::SurfaceGeode& geode) const = 0;
-    virtual void visualizeNegativeInformation(vizkit3d::PatchesGeode& geode) const = 0;
+    virtual Vector2ui getNumCells() const = 0;
+    // The visualize methods draw the cells in [begin, end)
+    virtual void visualize(vizkit3d::PatchesGeode& geode, int levelOffset, int minMeasurements, const Index& begin, const Index& end) const = 0;
+    virtual void visualize(vizkit3d::SurfaceGeode& geode, const Index& begin, const Index& end) const = 0;
+    virtual void visualizeNegativeInformation(vizkit3d::PatchesGeode& geode, const Index& begin, const Index& end) const = 0;
+    // Returns true if any cell in [begin, end) differs from the cell in other
+    virtual bool hasChanges(const Data& other, const Index& begin, const Index& end) const = 0;
     virtual maps::grid::CellExtents getCellExtents() const = 0;
     virtual base::Transform3d getLocalFrame() const = 0;
     MLSMapVisualization& visualization;
 };
 
+/** Only sloped patches count their measurements */
+static bool hasMeasurements(const SurfacePatch<MLSConfig::SLOPE>& p, int min_measurements)
+{
+    return p.getNumberOfMeasurements() >= min_measurements;
+}
+
+template<class Patch>
+static bool hasMeasurements(const Patch&, int)
+{
+    return true;
+}
+
 template<enum MLSConfig::update_model Type>
 struct DataHold : public MLSMapVisualization::Data
 {
@@ -86,14 +103,18 @@ public:
     }
 
     Eigen::Vector2d getResolution() const { return mls.getResolution(); }
-    
 
-void visualize(vizkit3d::SurfaceGeode& geode) const
+    Vector2ui getNumCells() const { return mls.getNumCells(); }
+
+    void visualize(vizkit3d::SurfaceGeode& geode, const Index& begin, const Index& end) const
     {
         Vector2ui num_cell = mls.getNumCells();
 
-            for (size_t y = 0; y < num_cell.y()-1; y++) {
-                for (size_t x = 0; x < num_cell.x(); x++) {
+            // include the first row and column of the next tile to close the gaps between tiles
+            const size_t y_end = std::min<size_t>(end.y(), num_cell.y()-1);
+            const size_t x_end = std::min<size_t>(end.x()+1, num_cell.x());
+            for (size_t y = begin.y(); y < y_end; y++) {
+                for (size_t x = begin.x(); x < x_end; x++) {
 
                     typedef typename MLSMap<Type>::CellType Cell;
                     const Cell &list = mls.at(x, y);
@@ -138,15 +159,11 @@ void visualize(vizkit3d::SurfaceGeode& geode) const
 
 
 
-    void visualize(vizkit3d::PatchesGeode& geode, int levelOffset) const
+    void visualize(vizkit3d::PatchesGeode& geode, int levelOffset, int minMeasurements, const Index& begin, const Index& end) const
     {
-        Vector2ui num_cell = mls.getNumCells();
-
-            //const GridMap<SPListST> &mls = *this;
-            
-            for (size_t x = 0; x < num_cell.x(); x++)
+            for (int x = begin.x(); x < end.x(); x++)
             {
-                for (size_t y = 0; y < num_cell.y(); y++)
+                for (int y = begin.y(); y < end.y(); y++)
                 {
                     typedef typename MLSMap<Type>::CellType Cell;
                     const Cell &list = mls.at(x, y);
@@ -158,7 +175,8 @@ void visualize(vizkit3d::SurfaceGeode& geode) const
                     if (list.size()){
                         for (typename Cell::const_iterator it = list.begin()+levelOffset; it != list.end(); it++)
                         {
-                            visualization.visualize(geode, *it);
+                            if(hasMeasurements(*it, minMeasurements))
+                                visualization.visualize(geode, *it);
                         } // for(SPList ...)
                     }
                 } // for(y ...)
@@ -168,22 +186,21 @@ void visualize(vizkit3d::SurfaceGeode& geode) const
 
     };
 
-    void visualizeNegativeInformation(vizkit3d::PatchesGeode& geode) const
+    void visualizeNegativeInformation(vizkit3d::PatchesGeode& geode, const Index& begin, const Index& end) const
     {
         boost::shared_ptr<maps::grid::OccupancyGridMap> grid;
         if(mls.hasFreeSpaceMap() && (grid = boost::dynamic_pointer_cast<maps::grid::OccupancyGridMap>(mls.getFreeSpaceMap())))
         {
             Eigen::Vector3d res = grid->getVoxelResolution();
-            maps::grid::Vector2ui num_cell = grid->getNumCells();
             const maps::grid::OccupancyConfiguration& config = grid->getConfig();
-            for (size_t x = 0; x < num_cell.x(); x++)
+            for (int x = begin.x(); x < end.x(); x++)
             {
-                for (size_t y = 0; y < num_cell.y(); y++)
+                for (int y = begin.y(); y < end.y(); y++)
                 {
-                    const maps::grid::OccupancyGridMap::GridMapBase::CellType &tree = grid->at(x, y);
                     maps::grid::Index idx(x, y);
                     if(grid->inGrid(idx))
                     {
+                        const maps::grid::OccupancyGridMap::GridMapBase::CellType &tree = grid->at(x, y);
                         // Calculate the position of the cell center.
                         maps::grid::Vector2d pos = (maps::grid::Index(x, y).cast<double>() + maps::grid::Vector2d(0.5, 0.5)).array() * mls.getResolution().array();
                         geode.setPosition(pos.x(), pos.y());
@@ -207,6 +224,15 @@ void visualize(vizkit3d::SurfaceGeode& geode) const
         }
     }
 
+    bool hasChanges(const Data& other_data, const Index& begin, const Index& end) const
+    {
+        const DataHold* other = dynamic_cast<const DataHold*>(&other_data);
+        if(!other || other->mls.getNumCells() != mls.getNumCells() || !other->mls.getResolution().isApprox(mls.getResolution()))
+            return true;
+
+        return mls.differsFrom(other->mls, begin, end);
+    }
+
     base::Transform3d getLocalFrame() const
     {
         return mls.getLocalFrame();
@@ -218,9 +244,38 @@ void visualize(vizkit3d::SurfaceGeode& geode) const
     }
 };
 
+struct MLSMapVisualization::TileSettings
+{
+    osg::Vec4 horizontalCellColor;
+    osg::Vec4 negativeCellColor;
+    bool showUncertainty;
+    bool showNegative;
+    bool showNormals;
+    bool cycleHeightColor;
+    double cycleColorInterval;
+    bool showPatchExtents;
+    double uncertaintyScale;
+    int minMeasurements;
+    bool connectedSurface;
+    bool simplifySurface;
+    bool connectedSurfaceLOD;
+};
+
+struct MLSMapVisualization::BuildResult
+{
+    BuildResult() : rebuildAll(false), settingsVersion(0) {}
+    boost::shared_ptr<Data> data;
+    bool rebuildAll;
+    unsigned settingsVersion;
+    Vector2ui numTiles;
+    std::vector<Index> tiles;
+    std::vector< osg::ref_ptr<osg::Group> > nodes;
+};
+
 MLSMapVisualization::MLSMapVisualization()
     : MapVisualization< maps::grid::MLSMapKalman >(),
-    p(0),
+    needsBuild(false),
+    builder(new BackgroundBuilder<BuildResult>([this]{ boost::mutex::scoped_lock lock(updateMutex); setDirty(); })),
     horizontalCellColor(osg::Vec4(0.1,0.5,0.9,1.0)),
     verticalCellColor(osg::Vec4(0.8,0.9,0.5,1.0)), 
     negativeCellColor(osg::Vec4(0.1,0.5,0.9,0.2)), 
@@ -236,12 +291,18 @@ MLSMapVisualization::MLSMapVisualization()
     minMeasurements(1),
     connectedSurface(false),
     simplifySurface(true),
-    connected_surface_lod(false)
+    connected_surface_lod(false),
+    tileSize(64),
+    numTiles(0, 0),
+    tilesOutdated(true),
+    settingsVersion(0)
 {
 }
 
 MLSMapVisualization::~MLSMapVisualization()
 {
+    // stop the worker before the members it uses are destroyed
+    builder.reset();
 }
 
 osg::ref_ptr<osg::Node> MLSMapVisualization::createMainNode()
@@ -255,63 +316,175 @@ osg::ref_ptr<osg::Node> MLSMapVisualization::createMainNode()
 
 void MLSMapVisualization::updateMainNode ( osg::Node* node )
 {
-    if(!p) return;
-    setLocalFrame(p->getLocalFrame());
-
-    localNode->removeChildren(0, localNode->getNumChildren());
+    // Swap in the tiles finished by the builder. Results of older settings
+    // are dropped, all tiles are rebuilt below.
+    BuildResult result;
+    if(builder->takeResult(result) && result.settingsVersion == settingsVersion)
+    {
+        if(result.rebuildAll)
+        {
+            localNode->removeChildren(0, localNode->getNumChildren());
+            tileNodes.assign(result.numTiles.prod(), osg::ref_ptr<osg::Group>());
+            numTiles = result.numTiles;
+            tilesOutdated = false;
+        }
+        for(size_t i = 0; i < result.tiles.size(); ++i)
+        {
+            osg::ref_ptr<osg::Group>& tileNode = tileNodes[result.tiles[i].x() + result.tiles[i].y() * numTiles.x()];
+            if(tileNode)
+                localNode->replaceChild(tileNode, result.nodes[i]);
+            else
+                localNode->addChild(result.nodes[i]);
+            tileNode = result.nodes[i];
+        }
+        shown = result.data;
+    }
 
-    Eigen::Vector2d res = p->getResolution();
+    // build the tiles of new data or settings in the background
+    if(p && needsBuild)
+    {
+        const Vector2ui num_cells = p->getNumCells();
+        const Vector2ui num_tiles((num_cells.x() + tileSize - 1) / tileSize, (num_cells.y() + tileSize - 1) / tileSize);
+        // changes of the free space map are not tracked, so negative information is always redrawn
+        const bool rebuild_all = tilesOutdated || !shown || num_tiles != numTiles || showNegative;
+
+        const boost::shared_ptr<Data> data = p;
+        const boost::shared_ptr<Data> base = rebuild_all ? boost::shared_ptr<Data>() : shown;
+        const unsigned tile_size = tileSize;
+        const unsigned settings_version = settingsVersion;
+        const TileSettings settings = getTileSettings();
+        builder->submit([=](const BuildCancellation& cancellation)
+        {
+            BuildResult result;
+            result.data = data;
+            result.rebuildAll = rebuild_all;
+            result.settingsVersion = settings_version;
+            result.numTiles = num_tiles;
+            result.tiles = findChangedTiles(*data, base.get(), tile_size, settings.connectedSurface);
+            result.nodes.resize(result.tiles.size());
+            BackgroundBuilder<BuildResult>::parallelFor(result.tiles.size(), 1, cancellation, [&](int begin, int end)
+            {
+                for(int i = begin; i < end; ++i)
+                {
+                    const Index tile_begin = result.tiles[i] * int(tile_size);
+                    const Index tile_end = (tile_begin.array() + int(tile_size)).matrix().cwiseMin(num_cells.cast<int>());
+                    result.nodes[i] = buildTile(*data, settings, tile_begin, tile_end);
+                }
+            });
+            return result;
+        });
+        needsBuild = false;
+    }
 
-    osg::ref_ptr<PatchesGeode> geode = new PatchesGeode(res.x(), res.y());
-    localNode->addChild( geode );
+    if(!shown) return;
+    setLocalFrame(shown->getLocalFrame());
 
     // draw the extents of the mls
-    visualizeMapExtents(p->getCellExtents(), p->getResolution());
+    visualizeMapExtents(shown->getCellExtents(), shown->getResolution());
+}
+
+std::vector<maps::grid::Index> MLSMapVisualization::findChangedTiles(const Data& data, const Data* base, unsigned tile_size, bool connected_surface)
+{
+    std::vector<Index> changed;
+    const Vector2ui num_cells = data.getNumCells();
+    // the connected surface of a tile also depends on the first row and column of the next tiles
+    const int border = connected_surface ? 1 : 0;
+    for(unsigned ty = 0; ty * tile_size < num_cells.y(); ++ty)
+    {
+        for(unsigned tx = 0; tx * tile_size < num_cells.x(); ++tx)
+        {
+            const Index begin = Index(tx, ty) * int(tile_size);
+            const Index end = (begin.array() + int(tile_size) + border).matrix().cwiseMin(num_cells.cast<int>());
+            if(!base || data.hasChanges(*base, begin, end))
+                changed.push_back(Index(tx, ty));
+        }
+    }
+    return changed;
+}
+
+osg::ref_ptr<osg::Group> MLSMapVisualization::buildTile(const maps::grid::Index& tile)
+{
+    if(!p) return new osg::Group();
+    const Index begin = tile * int(tileSize);
+    const Index end = (begin.array() + int(tileSize)).matrix().cwiseMin(p->getNumCells().cast<int>());
+    return buildTile(*p, getTileSettings(), begin, end);
+}
+
+MLSMapVisualization::TileSettings MLSMapVisualization::getTileSettings() const
+{
+    TileSettings settings;
+    settings.horizontalCellColor = horizontalCellColor;
+    settings.negativeCellColor = negativeCellColor;
+    settings.showUncertainty = showUncertainty;
+    settings.showNegative = showNegative;
+    settings.showNormals = showNormals;
+    settings.cycleHeightColor = cycleHeightColor;
+    settings.cycleColorInterval = cycleColorInterval;
+    settings.showPatchExtents = showPatchExtents;
+    settings.uncertaintyScale = uncertaintyScale;
+    settings.minMeasurements = minMeasurements;
+    settings.connectedSurface = connectedSurface;
+    settings.simplifySurface = simplifySurface;
+    settings.connectedSurfaceLOD = connected_surface_lod;
+    return settings;
+}
+
+osg::ref_ptr<osg::Group> MLSMapVisualization::buildTile(const Data& data, const TileSettings& settings,
+                                                        const maps::grid::Index& begin, const maps::grid::Index& end)
+{
+    osg::ref_ptr<osg::Group> tileNode = new osg::Group();
+    if((begin.array() >= end.array()).any())
+        return tileNode;
+
+    Eigen::Vector2d res = data.getResolution();
 
-    if(cycleHeightColor)
+    osg::ref_ptr<PatchesGeode> geode = new PatchesGeode(res.x(), res.y());
+    tileNode->addChild( geode );
+
+    if(settings.cycleHeightColor)
     {
         geode->showCycleColor(true);
-        geode->setCycleColorInterval(cycleColorInterval);
+        geode->setCycleColorInterval(settings.cycleColorInterval);
         geode->setColorHSVA(0, 1.0, 0.6, 1.0);
     }
     else
-        geode->setColor(horizontalCellColor);
-    geode->setShowPatchExtents(showPatchExtents);
-    geode->setShowNormals(showNormals);
-    geode->setUncertaintyScale(uncertaintyScale);
+        geode->setColor(settings.horizontalCellColor);
+    geode->setShowPatchExtents(settings.showPatchExtents);
+    geode->setShowNormals(settings.showNormals);
+    geode->setUncertaintyScale(settings.uncertaintyScale);
 
-    if (!connectedSurface) {
-        p->visualize(*geode, 0);
+    if (!settings.connectedSurface) {
+        data.visualize(*geode, 0, settings.minMeasurements, begin, end);
     } else {
-        p->visualize(*geode, 1);
+        data.visualize(*geode, 1, settings.minMeasurements, begin, end);
 
         osg::ref_ptr<SurfaceGeode> sgeode = new SurfaceGeode(res.x(), res.y());
-        if(cycleHeightColor)
+        if(settings.cycleHeightColor)
         {
             sgeode->showCycleColor(true);
-            sgeode->setCycleColorInterval(cycleColorInterval);
+            sgeode->setCycleColorInterval(settings.cycleColorInterval);
             sgeode->setColorHSVA(0, 1.0, 0.6, 1.0);
         } else {
-            sgeode->setColor(horizontalCellColor);
+            sgeode->setColor(settings.horizontalCellColor);
         }
-        sgeode->setShowPatchExtents(showPatchExtents);
-        sgeode->setShowNormals(showNormals);
-        sgeode->setUncertaintyScale(uncertaintyScale);
+        sgeode->setShowPatchExtents(settings.showPatchExtents);
+        sgeode->setShowNormals(settings.showNormals);
+        sgeode->setUncertaintyScale(settings.uncertaintyScale);
 
         // init LOD:
         // high level
-        p->visualize(*sgeode);
+        data.visualize(*sgeode, begin, end);
 
-        if (simplifySurface) {
+        if (settings.simplifySurface) {
             osgUtil::Simplifier simplifer;
             simplifer.setSampleRatio(1.0f);
             sgeode->accept(simplifer);
         }
 
         osg::ref_ptr<osg::LOD> lodnode = new osg::LOD();
-        localNode->addChild(lodnode);
+        tileNode->addChild(lodnode);
 
-        if (!connected_surface_lod) {
+        if (!settings.connectedSurfaceLOD) {
             // only use one LOD level
             lodnode->addChild(sgeode, 0, FLT_MAX);
         } else {
@@ -325,36 +498,75 @@ void MLSMapVisualization::updateMainNode ( osg::Node* node )
         }
     }
 
-    if( showUncertainty || showNormals || showPatchExtents)
+    if( settings.showUncertainty || settings.showNormals || settings.showPatchExtents)
     {
         geode->drawLines();
     }
 
-    if( showNegative )
+    if( settings.showNegative )
     {
         osg::ref_ptr<PatchesGeode> neg_geode = new PatchesGeode(res.x(), res.y());
-        neg_geode->setColor(negativeCellColor);
-        localNode->addChild( neg_geode );
-        p->visualizeNegativeInformation(*neg_geode);
+        neg_geode->setColor(settings.negativeCellColor);
+        tileNode->addChild( neg_geode );
+        data.visualizeNegativeInformation(*neg_geode, begin, end);
     }
+
+    return tileNode;
+}
+
+std::vector<maps::grid::Index> MLSMapVisualization::getChangedTiles() const
+{
+    if(!p) return std::vector<Index>();
+    return findChangedTiles(*p, shown.get(), tileSize, connectedSurface);
+}
+
+void MLSMapVisualization::waitForBuild() const
+{
+    builder->wait();
+}
+
+void MLSMapVisualization::invalidateTiles()
+{
+    tilesOutdated = true;
+    ++settingsVersion;
+    needsBuild = true;
+    setDirty();
+}
+
+int MLSMapVisualization::getTileSize() const
+{
+    return tileSize;
+}
+
+void MLSMapVisualization::setTileSize(int cells)
+{
+    tileSize = std::max(1, cells);
+    emit propertyChanged("tile_size");
+    invalidateTiles();
+}
+
+void MLSMapVisualization::setData(Data* data)
+{
+    p.reset(data);
+    needsBuild = true;
 }
 
 void MLSMapVisualization::updateDataIntern(::maps::grid::MLSMapKalman const& value)
 {
-    p.reset(new DataHold<MLSConfig::KALMAN>( value, *this ));
+    setData(new DataHold<MLSConfig::KALMAN>( value, *this ));
 }
 void MLSMapVisualization::updateDataIntern(::maps::grid::MLSMap<::maps::grid::MLSConfig::SLOPE> const& value)
 {
-    p.reset(new DataHold<MLSConfig::SLOPE>( value, *this ));
+    setData(new DataHold<MLSConfig::SLOPE>( value, *this ));
 }
 void MLSMapVisualization::updateDataIntern(::maps::grid::MLSMap<::maps::grid::MLSConfig::PRECALCULATED> const& value)
 {
-    p.reset(new DataHold<MLSConfig::PRECALCULATED>( value, *this ));
+    setData(new DataHold<MLSConfig::PRECALCULATED>( value, *this ));
 }
 
 void MLSMapVisualization::updateDataIntern(::maps::grid::MLSMap<::maps::grid::MLSConfig::BASE> const& value)
 {
-    p.reset(new DataHold<MLSConfig::BASE>( value, *this ));
+    setData(new DataHold<MLSConfig::BASE>( value, *this ));
 }
 
 bool MLSMapVisualization::isUncertaintyShown() const
@@ -371,7 +583,7 @@ void MLSMapVisualization::setShowUncertainty(bool enabled)
         setShowNormals(false);
     }
     emit propertyChanged("show_uncertainty");
-    setDirty();
+    invalidateTiles();
 }
 
 bool MLSMapVisualization::isNegativeShown() const
@@ -383,7 +595,7 @@ void MLSMapVisualization::setShowNegative(bool enabled)
 {
     showNegative = enabled;
     emit propertyChanged("show_negative");
-    setDirty();
+    invalidateTiles();
 }
 
 bool MLSMapVisualization::areNormalsEstimated() const
@@ -395,7 +607,7 @@ void MLSMapVisualization::setEstimateNormals(bool enabled)
 {
     estimateNormals = enabled;
     emit propertyChanged("estimate_normals");
-    setDirty();
+    invalidateTiles();
 }
 
 bool MLSMapVisualization::areNormalsShown() const
@@ -412,7 +624,7 @@ void MLSMapVisualization::setShowNormals(bool enabled)
         setShowUncertainty(false);
     }
     emit propertyChanged("show_normals");
-    setDirty();
+    invalidateTiles();
 }
 
 bool MLSMapVisualization::isHeightColorCycled() const
@@ -424,7 +636,7 @@ void MLSMapVisualization::setCycleHeightColor(bool enabled)
 {
     cycleHeightColor = enabled;
     emit propertyChanged("cycle_height_color");
-    setDirty();
+    invalidateTiles();
 }
 
 double MLSMapVisualization::getCycleColorInterval() const
@@ -439,7 +651,7 @@ void MLSMapVisualization::setCycleColorInterval(double interval)
     else
         cycleColorInterval = interval;
     emit propertyChanged("cycle_color_interval");
-    setDirty();
+    invalidateTiles();
 }
 
 QColor MLSMapVisualization::getHorizontalCellColor() const
@@ -456,7 +668,7 @@ void MLSMapVisualization::setHorizontalCellColor(QColor color)
     horizontalCellColor.z() = color.blueF();
     horizontalCellColor.w() = color.alphaF();
     emit propertyChanged("horizontal_cell_color");
-    setDirty();
+    invalidateTiles();
 }
 
 QColor MLSMapVisualization::getVerticalCellColor() const
@@ -473,7 +685,7 @@ void MLSMapVisualization::setVerticalCellColor(QColor color)
     verticalCellColor.z() = color.blueF();
     verticalCellColor.w() = color.alphaF();
     emit propertyChanged("vertical_cell_color");
-    setDirty();
+    invalidateTiles();
 }
 
 QColor MLSMapVisualization::getNegativeCellColor() const
@@ -490,7 +702,7 @@ void MLSMapVisualization::setNegativeCellColor(QColor color)
     negativeCellColor.z() = color.blueF();
     negativeCellColor.w() = color.alphaF();
     emit propertyChanged("negative_cell_color");
-    setDirty();
+    invalidateTiles();
 }
 
 QColor MLSMapVisualization::getUncertaintyColor() const
@@ -507,7 +719,7 @@ void MLSMapVisualization::setUncertaintyColor(QColor color)
     uncertaintyColor.z() = color.blueF();
     uncertaintyColor.w() = color.alphaF();
     emit propertyChanged("uncertainty_color");
-    setDirty();
+    invalidateTiles();
 }
 
 void MLSMapVisualization::setShowPatchExtents( bool value ) 
@@ -519,7 +731,7 @@ void MLSMapVisualization::setShowPatchExtents( bool value )
         setShowUncertainty(false);
     }
     emit propertyChanged("show_patch_extents");
-    setDirty();
+    invalidateTiles();
 }
 
 bool MLSMapVisualization::arePatchExtentsShown() const
@@ -537,7 +749,7 @@ void MLSMapVisualization::setUncertaintyScale(double scaling)
     uncertaintyScale = std::abs(scaling);
 
     emit propertyChanged("uncertainty_scale");
-    setDirty();
+    invalidateTiles();
 }
 
 bool MLSMapVisualization::isConnectedSurface() const
@@ -550,7 +762,7 @@ void MLSMapVisualization::setConnectedSurface(bool enabled)
     connectedSurface = enabled;
 
     emit propertyChanged("connected_surface");
-    setDirty();
+    invalidateTiles();
 }
 
 bool MLSMapVisualization::getConnectedSurfaceLOD() const
@@ -562,7 +774,7 @@ void MLSMapVisualization::setConnectedSurfaceLOD(bool enabled)
     connected_surface_lod = enabled;
 
     emit propertyChanged("connected_surface_lod");
-    setDirty();
+    invalidateTiles();
 }
 
 bool MLSMapVisualization::getSimplifySurface() const
@@ -573,7 +785,7 @@ void MLSMapVisualization::setSimplifySurface(bool enabled)
 {
     simplifySurface = enabled;
     emit propertyChanged("simplify_surface");
-    setDirty();
+    invalidateTiles();
 }
 
 int MLSMapVisualization::getMinMeasurements() const
@@ -584,14 +796,11 @@ void MLSMapVisualization::setMinMeasurements(int measurements)
 {
     minMeasurements = measurements;
     emit propertyChanged("min_measurements");
-    setDirty();
+    invalidateTiles();
 }
 
 void MLSMapVisualization::visualize(vizkit3d::PatchesGeode& geode, const SurfacePatch<MLSConfig::SLOPE>& p)
 {
-    if(p.getNumberOfMeasurements() < minMeasurements)
-    	return;
-
     float minZ, maxZ;
     p.getRange(minZ, maxZ);
     minZ -= 5e-4f;
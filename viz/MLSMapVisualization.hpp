@@ -33,6 +33,13 @@
 #include <osg/Shape>
 #include <osg/Texture2D>
 
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "BackgroundBuilder.hpp"
+
 #if QT_VERSION >= 0x050000 || !defined(Q_MOC_RUN)
     #include <maps/grid/MLSMap.hpp>
 #endif
@@ -66,6 +73,7 @@ namespace vizkit3d
         Q_PROPERTY(QColor negative_cell_color READ getNegativeCellColor WRITE setNegativeCellColor)
         Q_PROPERTY(QColor uncertainty_color READ getUncertaintyColor WRITE setUncertaintyColor)
         Q_PROPERTY(int min_measurements READ getMinMeasurements WRITE setMinMeasurements)
+        Q_PROPERTY(int tile_size READ getTileSize WRITE setTileSize)
 
         public:
             MLSMapVisualization();
@@ -76,6 +84,21 @@ namespace vizkit3d
             void visualize(vizkit3d::PatchesGeode& geode, const maps::grid::SurfacePatch<maps::grid::MLSConfig::KALMAN>& p);
             void visualize(vizkit3d::PatchesGeode& geode, const maps::grid::SurfacePatch<maps::grid::MLSConfig::BASE>& p);
 
+            /**
+             * Builds the geometry of the cells of tile @p tile of the current data,
+             * i.e. of the cells [tile * tile_size, (tile + 1) * tile_size).
+             * The map is displayed as one such node per tile, so only the tiles
+             * whose cells changed are rebuilt on an update. The tiles are built
+             * in a background thread and swapped in by updateMainNode.
+             */
+            osg::ref_ptr<osg::Group> buildTile(const maps::grid::Index& tile);
+
+            /** Returns the tiles which differ between the shown and the latest data */
+            std::vector<maps::grid::Index> getChangedTiles() const;
+
+            /** Blocks until the background build of the latest data finished */
+            void waitForBuild() const;
+
             Q_INVOKABLE void updateMLSPrecalculated(maps::grid::MLSMapPrecalculated const &sample)
             {vizkit3d::Vizkit3DPlugin<::maps::grid::MLSMapKalman>::updateData(sample);}
 
@@ -112,6 +135,9 @@ namespace vizkit3d
             //Hack ends here
 
 
+            /** Copy of the map data, implemented by a template for each map type */
+            struct Data;
+
         protected:
             virtual osg::ref_ptr<osg::Node> createMainNode();
             virtual void updateMainNode(osg::Node* node);
@@ -121,10 +147,24 @@ namespace vizkit3d
             virtual void updateDataIntern(::maps::grid::MLSMap<::maps::grid::MLSConfig::BASE> const& mls);
 
         private:
-            struct Data;
-            boost::scoped_ptr<Data> p;
+            struct BuildResult;
+            struct TileSettings;
+            /** The latest data and the data the shown tiles were built from */
+            boost::shared_ptr<Data> p, shown;
+            bool needsBuild;
+            boost::scoped_ptr< BackgroundBuilder<BuildResult> > builder;
 
             osg::ref_ptr<osg::Group> localNode;
+            std::vector< osg::ref_ptr<osg::Group> > tileNodes;
+
+            void setData(Data* data);
+            /** Rebuilds all tiles on the next update, e.g. after changing how the patches are drawn */
+            void invalidateTiles();
+            /** Copy of the settings the tiles are drawn with, which the background build uses */
+            TileSettings getTileSettings() const;
+            static std::vector<maps::grid::Index> findChangedTiles(const Data& data, const Data* base, unsigned tile_size, bool connected_surface);
+            static osg::ref_ptr<osg::Group> buildTile(const Data& data, const TileSettings& settings,
+                                                      const maps::grid::Index& begin, const maps::grid::Index& end);
         
         public slots:
 
@@ -176,6 +216,9 @@ namespace vizkit3d
             int getMinMeasurements() const;
             void setMinMeasurements(int measurements);
 
+            int getTileSize() const;
+            void setTileSize(int cells);
+
         protected:
             osg::Vec4 horizontalCellColor;
             osg::Vec4 verticalCellColor;
@@ -194,6 +237,11 @@ namespace vizkit3d
             bool connectedSurface;
             bool simplifySurface;
             bool connected_surface_lod;
+            unsigned tileSize;
+            maps::grid::Vector2ui numTiles;
+            bool tilesOutdated;
+            /** Counts the setting changes, results of older settings are dropped */
+            unsigned settingsVersion;
 
 #if 0
             osg::Vec3 estimateNormal(
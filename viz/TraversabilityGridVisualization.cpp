@@ -33,7 +33,9 @@
 using namespace vizkit3d;
 
 TraversabilityGridVisualization::TraversabilityGridVisualization()
-    : interpolateCellColors(true),
+    : rebuild(false),
+      builder(new BackgroundBuilder<BuildResult>([this]{ boost::mutex::scoped_lock lock(updateMutex); setDirty(); })),
+      interpolateCellColors(true),
       useNPOTTextures(false),
       unknownColor(osg::Vec4(0, 0, 1, 1)),
       obstacleColor(osg::Vec4(0.8, 0, 0, 1)),
@@ -44,6 +46,8 @@ TraversabilityGridVisualization::TraversabilityGridVisualization()
 
 TraversabilityGridVisualization::~TraversabilityGridVisualization()
 {
+    // stop the worker before the members it uses are destroyed
+    builder.reset();
 }
 
 osg::ref_ptr<osg::Node> TraversabilityGridVisualization::createMainNode()
@@ -68,26 +72,55 @@ osg::ref_ptr<osg::Node> TraversabilityGridVisualization::createMainNode()
 
 void TraversabilityGridVisualization::updateMainNode(osg::Node* node)
 {
+    // Swap in the texture finished by the builder.
+    BuildResult result;
+    if (builder->takeResult(result))
+    {
+        shownGrid = result.grid;
+        image = result.image;
+        texture->setImage(image.get());
+        updatePlane(*shownGrid);
+    }
+
+    // Color new data in the background.
+    if (traversabilityGrid && rebuild)
+    {
+        const boost::shared_ptr<const maps::grid::TraversabilityGrid> grid = traversabilityGrid;
+        CellColors colors;
+        colors.unknown = unknownColor;
+        colors.obstacle = obstacleColor;
+        colors.minTraversable = minTraversableColor;
+        colors.maxTraversable = maxTraversableColor;
+        builder->submit([grid, colors](const BuildCancellation& cancellation)
+        {
+            BuildResult result;
+            result.image = createTextureImage(*grid, colors, cancellation);
+            result.grid = grid;
+            return result;
+        });
+        rebuild = false;
+    }
+
+    if (!shownGrid)
+        return;
+
     // Draw map extents.
-    visualizeMapExtents(traversabilityGrid.calculateCellExtents(), traversabilityGrid.getResolution());
+    visualizeMapExtents(shownGrid->calculateCellExtents(), shownGrid->getResolution());
 
     // Apply localFrame.
-    setLocalFrame(traversabilityGrid.getLocalFrame());
+    setLocalFrame(shownGrid->getLocalFrame());
 
     visualize(*planeGeode);
 }
 
 void TraversabilityGridVisualization::updateDataIntern(const maps::grid::TraversabilityGrid& plan)
 {
-    traversabilityGrid = plan;
+    traversabilityGrid.reset(new maps::grid::TraversabilityGrid(plan));
+    rebuild = true;
 }
 
 void vizkit3d::TraversabilityGridVisualization::visualize(osg::Geode& geode) const
 {
-        updatePlane();
-
-        updateTextureImage();
-
         texture->setResizeNonPowerOfTwoHint(!useNPOTTextures);
 
         if (!interpolateCellColors)
@@ -126,9 +159,9 @@ osg::ref_ptr<osg::Geometry> TraversabilityGridVisualization::createPlane()
         return plane;
 }
 
-void TraversabilityGridVisualization::updatePlane() const
+void TraversabilityGridVisualization::updatePlane(const maps::grid::TraversabilityGrid& grid) const
 {
-    maps::grid::Vector2d mapSize = traversabilityGrid.getSize();
+    maps::grid::Vector2d mapSize = grid.getSize();
 
     osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array();
 
@@ -141,63 +174,61 @@ void TraversabilityGridVisualization::updatePlane() const
 }
 
 
-void TraversabilityGridVisualization::updateTextureImage() const
+osg::ref_ptr<osg::Image> TraversabilityGridVisualization::createTextureImage(const maps::grid::TraversabilityGrid& grid, const CellColors& colors,
+                                                                             const BuildCancellation& cancellation)
 {
-        maps::grid::Vector2ui numCells = traversabilityGrid.getNumCells();
+        maps::grid::Vector2ui numCells = grid.getNumCells();
 
-        unsigned char* imageData = new unsigned char[numCells.x() * numCells.y() * 4];
-        unsigned char* pos = imageData;
+        osg::ref_ptr<osg::Image> textureImage = new osg::Image();
+        textureImage->allocateImage(numCells.x(), numCells.y(), 1, GL_RGBA, GL_UNSIGNED_BYTE);
 
-        for (size_t y = 0; y < numCells.y(); ++y)
+        BackgroundBuilder<BuildResult>::parallelFor(numCells.y(), 16, cancellation, [&](int begin, int end)
         {
-            for (size_t x = 0; x < numCells.x(); ++x)
+            for (int y = begin; y < end; ++y)
             {
-                osg::Vec4 color = colorForCoordinate(x, y);
-
-                *pos++ = static_cast<unsigned char>(color.r() * 255.0);
-                *pos++ = static_cast<unsigned char>(color.g() * 255.0);
-                *pos++ = static_cast<unsigned char>(color.b() * 255.0);
-                *pos++ = static_cast<unsigned char>(color.a() * 255.0);
+                unsigned char* pos = textureImage->data(0, y);
+                for (size_t x = 0; x < numCells.x(); ++x)
+                {
+                    osg::Vec4 color = colorForCoordinate(grid, colors, x, y);
+
+                    *pos++ = static_cast<unsigned char>(color.r() * 255.0);
+                    *pos++ = static_cast<unsigned char>(color.g() * 255.0);
+                    *pos++ = static_cast<unsigned char>(color.b() * 255.0);
+                    *pos++ = static_cast<unsigned char>(color.a() * 255.0);
+                }
             }
-        }
+        });
 
-        image->setImage(numCells.x(),
-                        numCells.y(),
-                        1,  // datadepth per channel
-                        GL_RGBA,
-                        GL_RGBA,
-                        GL_UNSIGNED_BYTE,  // GLenum type, (GL_UNSIGNED_BYTE, 0x1401)
-                        imageData,  // unsigned char* data
-                        osg::Image::USE_NEW_DELETE,  // USE_NEW_DELETE, //osg::Image::NO_DELETE,// AllocationMode mode (shallow copy)
-                        1);
+        return textureImage;
 }
 
-osg::Vec4 TraversabilityGridVisualization::colorForCoordinate(std::size_t x, std::size_t y) const
+osg::Vec4 TraversabilityGridVisualization::colorForCoordinate(const maps::grid::TraversabilityGrid& grid, const CellColors& colors,
+                                                              std::size_t x, std::size_t y)
 {
-    float probability = traversabilityGrid.getProbability(x, y);
+    float probability = grid.getProbability(x, y);
     if (probability < 0.001)
     {
         // unknown
-        return unknownColor;
+        return colors.unknown;
     }
 
-    uint8_t traversabilityClassId = traversabilityGrid.getTraversabilityClassId(x, y);
+    uint8_t traversabilityClassId = grid.getTraversabilityClassId(x, y);
     switch(traversabilityClassId)
     {
         case 0:
             // unknown
-            return unknownColor;
+            return colors.unknown;
         case 1:
             // obstacle
-            return obstacleColor;
+            return colors.obstacle;
         default:
             // Interpolate between minTraversableColor and maxTraversableColor depending on drivability.
-            float drivability = traversabilityGrid.getTraversability(x, y).getDrivability();
+            float drivability = grid.getTraversability(x, y).getDrivability();
 
-            float r = (1 - drivability) * minTraversableColor.r() + drivability * maxTraversableColor.r();
-            float g = (1 - drivability) * minTraversableColor.g() + drivability * maxTraversableColor.g();
-            float b = (1 - drivability) * minTraversableColor.b() + drivability * maxTraversableColor.b();
-            float alpha = (1 - drivability) * minTraversableColor.a() + drivability * maxTraversableColor.a();
+            float r = (1 - drivability) * colors.minTraversable.r() + drivability * colors.maxTraversable.r();
+            float g = (1 - drivability) * colors.minTraversable.g() + drivability * colors.maxTraversable.g();
+            float b = (1 - drivability) * colors.minTraversable.b() + drivability * colors.maxTraversable.b();
+            float alpha = (1 - drivability) * colors.minTraversable.a() + drivability * colors.maxTraversable.a();
             return osg::Vec4(r, g, b, alpha);
     }
 }
@@ -237,6 +268,7 @@ void TraversabilityGridVisualization::setUnknownColor(QColor& color)
 {
     unknownColor.set(color.redF(), color.greenF(), color.blueF(), color.alphaF());
     emit propertyChanged("unknownColor");
+    rebuild = true;
     setDirty();
 }
 
@@ -251,6 +283,7 @@ void TraversabilityGridVisualization::setObstacleColor(QColor& color)
 {
     obstacleColor.set(color.redF(), color.greenF(), color.blueF(), color.alphaF());
     emit propertyChanged("obstacleColor");
+    rebuild = true;
     setDirty();
 }
 
@@ -265,6 +298,7 @@ void TraversabilityGridVisualization::setMinTraversableColor(QColor& color)
 {
     minTraversableColor.set(color.redF(), color.greenF(), color.blueF(), color.alphaF());
     emit propertyChanged("minTraversableColor");
+    rebuild = true;
     setDirty();
 }
 
@@ -279,5 +313,6 @@ void TraversabilityGridVisualization::setMaxTraversableColor(QColor& color)
 {
     maxTraversableColor.set(color.redF(), color.greenF(), color.blueF(), color.alphaF());
     emit propertyChanged("maxTraversableColor");
+    rebuild = true;
     setDirty();
 }
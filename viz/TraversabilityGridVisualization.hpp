@@ -33,6 +33,11 @@
 #include <osg/Image>
 # include <osg/Texture2D>
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "BackgroundBuilder.hpp"
+
 #if QT_VERSION >= 0x050000 || !defined(Q_MOC_RUN)
     #include <maps/grid/TraversabilityGrid.hpp>
 #endif
@@ -80,15 +85,25 @@ namespace vizkit3d
         virtual void updateMainNode(osg::Node* node);
         virtual void updateDataIntern(::maps::grid::TraversabilityGrid const& plan);
 
+        /** Colors of the traversability classes, the background build uses a copy of them */
+        struct CellColors
+        {
+            osg::Vec4 unknown;
+            osg::Vec4 obstacle;
+            osg::Vec4 minTraversable;
+            osg::Vec4 maxTraversable;
+        };
+
         void visualize(osg::Geode& geode) const;
         // Creates a plane geometry as a basis for the visualization.
         osg::ref_ptr<osg::Geometry> createPlane();
-        // Updates the plane to represent the current internal data.
-        void updatePlane() const;
-        // Creates an Image from the internal data to be applied to the
-        // plane as a texture.
-        void updateTextureImage() const;
-        osg::Vec4 colorForCoordinate(std::size_t x, std::size_t y) const;
+        // Updates the plane to represent the given grid.
+        void updatePlane(const maps::grid::TraversabilityGrid& grid) const;
+        // Creates an Image from the grid to be applied to the plane as a texture.
+        // Called by the background builder, the rows are colored in parallel.
+        static osg::ref_ptr<osg::Image> createTextureImage(const maps::grid::TraversabilityGrid& grid, const CellColors& colors,
+                                                           const BuildCancellation& cancellation);
+        static osg::Vec4 colorForCoordinate(const maps::grid::TraversabilityGrid& grid, const CellColors& colors, std::size_t x, std::size_t y);
 
         // Node holding the plane.
         osg::ref_ptr<osg::Geode> planeGeode;
@@ -97,7 +112,16 @@ namespace vizkit3d
         osg::ref_ptr<osg::Texture2D> texture;
 
     private:
-        maps::grid::TraversabilityGrid traversabilityGrid;
+        struct BuildResult
+        {
+            osg::ref_ptr<osg::Image> image;
+            boost::shared_ptr<const maps::grid::TraversabilityGrid> grid;
+        };
+
+        // The latest grid and the grid the shown texture was built from.
+        boost::shared_ptr<const maps::grid::TraversabilityGrid> traversabilityGrid, shownGrid;
+        bool rebuild;
+        boost::scoped_ptr< BackgroundBuilder<BuildResult> > builder;
 
         bool interpolateCellColors;
         bool useNPOTTextures;
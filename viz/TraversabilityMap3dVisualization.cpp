@@ -38,13 +38,16 @@ vizkit3d::TraversabilityMap3dVisualization::TraversabilityMap3dVisualization()
     : MapVisualization< maps::grid::TraversabilityMap3d< maps::grid::TraversabilityNodeBase* > >()
     , isoline_interval(16.0)
     , show_connections(false)
+    , rebuild(false)
+    , builder(new BackgroundBuilder<BuildResult>([this]{ boost::mutex::scoped_lock lock(updateMutex); setDirty(); }))
 {
 
 }
 
 vizkit3d::TraversabilityMap3dVisualization::~TraversabilityMap3dVisualization()
 {
-
+    // stop the worker before the members it uses are destroyed
+    builder.reset();
 }
 
 osg::ref_ptr< osg::Node > vizkit3d::TraversabilityMap3dVisualization::createMainNode()
@@ -61,6 +64,30 @@ osg::ref_ptr< osg::Node > vizkit3d::TraversabilityMap3dVisualization::createMain
 void vizkit3d::TraversabilityMap3dVisualization::updateDataIntern(const maps::grid::TraversabilityMap3d< TraversabilityNodeBase* >& data)
 {
     map = data;
+
+    // the nodes may change or be deleted after this call, so the builder gets a copy of their values
+    boost::shared_ptr<MapData> copy(new MapData());
+    copy->resolution = map.getResolution();
+    copy->localFrame = map.getLocalFrame();
+    copy->cellExtents = map.calculateCellExtents();
+    for(size_t y = 0; y < map.getNumCells().y(); y++)
+    {
+        for(size_t x = 0; x < map.getNumCells().x(); x++)
+        {
+            for(const TraversabilityNodeBase *node : map.at(x, y))
+            {
+                const NodeData from = {node->getIndex(), node->getHeight(), node->getType()};
+                copy->nodes.push_back(from);
+                for(const TraversabilityNodeBase *conNode : node->getConnections())
+                {
+                    const NodeData to = {conNode->getIndex(), conNode->getHeight(), conNode->getType()};
+                    copy->connections.push_back(std::make_pair(from, to));
+                }
+            }
+        }
+    }
+    mapData = copy;
+    rebuild = true;
 }
 
 void setColor(const osg::Vec4d& color, osg::Geode* geode)
@@ -107,39 +134,38 @@ void addSphere(const Eigen::Vector3f &position, osg::ref_ptr<osg::Geode> geode)
 };
 
 
-void TraversabilityMap3dVisualization::visualizeNode(const TraversabilityNodeBase* node)
+void TraversabilityMap3dVisualization::visualizeNode(const NodeData& node, const Vector2d& resolution, PatchesGeode& geode)
 {
-    Eigen::Vector2f curNodePos = (node->getIndex().cast<float>() + Eigen::Vector2f(0.5, 0.5)).array() * map.getResolution().cast<float>().array();
+    Eigen::Vector2f curNodePos = (node.index.cast<float>() + Eigen::Vector2f(0.5, 0.5)).array() * resolution.cast<float>().array();
 
-    PatchesGeode *geode = dynamic_cast<PatchesGeode *>(nodeGeode.get());
-    geode->setPosition(curNodePos.x(), curNodePos.y());
+    geode.setPosition(curNodePos.x(), curNodePos.y());
     
-    switch(node->getType())
+    switch(node.type)
     {
         case TraversabilityNodeBase::OBSTACLE:
-            geode->setColor(osg::Vec4d(1,0,0,1));
+            geode.setColor(osg::Vec4d(1,0,0,1));
             break;
         case TraversabilityNodeBase::UNKNOWN:
-            geode->setColor(osg::Vec4d(1,0,1,1));
+            geode.setColor(osg::Vec4d(1,0,1,1));
             break;
         case TraversabilityNodeBase::TRAVERSABLE:
-            geode->setColor(osg::Vec4d(0, 1, 0, 1));
+            geode.setColor(osg::Vec4d(0, 1, 0, 1));
             break;
         case TraversabilityNodeBase::FRONTIER:
-            geode->setColor(osg::Vec4d(0, 0, 1, 1));
+            geode.setColor(osg::Vec4d(0, 0, 1, 1));
             break;
         case TraversabilityNodeBase::HOLE:
-            geode->setColor(osg::Vec4d(0, 1, 1, 1));
+            geode.setColor(osg::Vec4d(0, 1, 1, 1));
             break;
         case TraversabilityNodeBase::UNSET:
-            geode->setColor(osg::Vec4d(1, 1, 0, 1));
+            geode.setColor(osg::Vec4d(1, 1, 0, 1));
             break;            
         default:
             LOG_WARN_S << "Unknown node type!";
-            geode->setColor(osg::Vec4d(0,0,1,1));
+            geode.setColor(osg::Vec4d(0,0,1,1));
     }
     
-    if(fabs(node->getHeight()) > 30000)
+    if(fabs(node.height) > 30000)
     {
         //FIXME if nodes are too far aways, the culling mechanism of osg breaks.
         // I.e. verticves disappear when zooming in on them.
@@ -147,67 +173,90 @@ void TraversabilityMap3dVisualization::visualizeNode(const TraversabilityNodeBas
         return;
     }
     
-    if(std::isnan(node->getHeight()))
+    if(std::isnan(node.height))
         throw std::runtime_error("FOOOOOOOO");
     
-    geode->drawHorizontalPlane(node->getHeight());
-    
-    if(show_connections)
-    {
-        for(const TraversabilityNodeBase *conNode: node->getConnections())
-        {
-            visualizeConnection(node, conNode);
-        }
-    }
+    geode.drawHorizontalPlane(node.height);
 }
 
-void TraversabilityMap3dVisualization::visualizeConnection(const TraversabilityNodeBase* from, const TraversabilityNodeBase* to)
+void TraversabilityMap3dVisualization::visualizeConnection(const NodeData& from, const NodeData& to,
+                                                           const Vector2d& resolution, osgviz::LinesNode& lines)
 {
-    Eigen::Vector2f toPos = (to->getIndex().cast<float>() + Eigen::Vector2f(0.5, 0.5)).array() * map.getResolution().cast<float>().array();
-    Eigen::Vector2f fromPos = (from->getIndex().cast<float>() + Eigen::Vector2f(0.5, 0.5)).array() * map.getResolution().cast<float>().array();
-    osg::Vec3 fromOsg(fromPos.x(), fromPos.y(), from->getHeight());
-    osg::Vec3 toOsg(toPos.x(), toPos.y(), to->getHeight());
+    Eigen::Vector2f toPos = (to.index.cast<float>() + Eigen::Vector2f(0.5, 0.5)).array() * resolution.cast<float>().array();
+    Eigen::Vector2f fromPos = (from.index.cast<float>() + Eigen::Vector2f(0.5, 0.5)).array() * resolution.cast<float>().array();
+    osg::Vec3 fromOsg(fromPos.x(), fromPos.y(), from.height);
+    osg::Vec3 toOsg(toPos.x(), toPos.y(), to.height);
     
-    linesNode->addLine(fromOsg, toOsg);
+    lines.addLine(fromOsg, toOsg);
 }
 
-void vizkit3d::TraversabilityMap3dVisualization::addNodeList(const maps::grid::LevelList< TraversabilityNodeBase* >& l, osg::Group* group)
+osg::ref_ptr<osg::Group> vizkit3d::TraversabilityMap3dVisualization::createNodes(const MapData& map, bool show_connections,
+                                                                                  const BuildCancellation& cancellation)
 {
-    for(const auto &entry: l)
+    osg::ref_ptr<osg::Group> nodes = new osg::Group();
+
+    osg::ref_ptr<PatchesGeode> geode = new PatchesGeode(map.resolution.x(), map.resolution.y());
+    osg::ref_ptr<osgviz::LinesNode> lines = new osgviz::LinesNode(osg::Vec4(1, 1, 1, 1));
+    nodes->addChild(geode);
+    nodes->addChild(lines);
+
+    geode->setColor(osg::Vec4d(1,0,0,1));
+    geode->setShowPatchExtents(true);
+    geode->setShowNormals(true);
+    
+    for(size_t i = 0; i < map.nodes.size(); i++)
     {
-        visualizeNode(entry);
+        // the result of a cancelled build is dropped anyway
+        if(i % 4096 == 0 && cancellation.isCancelled())
+            return nodes;
+        visualizeNode(map.nodes[i], map.resolution, *geode);
     }
+
+    if(show_connections)
+    {
+        for(const std::pair<NodeData, NodeData>& connection : map.connections)
+            visualizeConnection(connection.first, connection.second, map.resolution, *lines);
+    }
+
+    return nodes;
 }
 
 void vizkit3d::TraversabilityMap3dVisualization::updateMainNode(osg::Node* node)
 {
-    // Apply local frame.
-    setLocalFrame(map.getLocalFrame());
-
-    // Draw map extents.
-    visualizeMapExtents(map.calculateCellExtents(), map.getResolution());
-
-    //clear old data
-    localNode->removeChildren(0, localNode->getNumChildren());
+    // Swap in the nodes finished by the builder.
+    BuildResult result;
+    if(builder->takeResult(result))
+    {
+        localNode->removeChildren(0, localNode->getNumChildren());
+        localNode->addChild(result.nodes);
+        nodeGeode = dynamic_cast<osg::Geode*>(result.nodes->getChild(0));
+        linesNode = dynamic_cast<osgviz::LinesNode*>(result.nodes->getChild(1));
+        shownMap = result.map;
+    }
 
-    nodeGeode = new PatchesGeode(map.getResolution().x(), map.getResolution().y());
-    linesNode = new osgviz::LinesNode(osg::Vec4(1, 1, 1, 1));
-    localNode->addChild(nodeGeode);
-    localNode->addChild(linesNode);
-    
-    PatchesGeode *geode = dynamic_cast<PatchesGeode *>(nodeGeode.get());
-    geode->setColor(osg::Vec4d(1,0,0,1));
-    geode->setShowPatchExtents(true);
-    geode->setShowNormals(true);
-    
-    for(size_t y = 0; y < map.getNumCells().y(); y++)
+    // Build the nodes of new data or settings in the background.
+    if(mapData && rebuild)
     {
-        for(size_t x = 0; x < map.getNumCells().x(); x++)
+        const boost::shared_ptr<const MapData> data = mapData;
+        const bool connections = show_connections;
+        builder->submit([data, connections](const BuildCancellation& cancellation)
         {
-            const LevelList<TraversabilityNodeBase *> &l(map.at(x, y));
-            addNodeList(l, localNode);
-        }
+            BuildResult result;
+            result.nodes = createNodes(*data, connections, cancellation);
+            result.map = data;
+            return result;
+        });
+        rebuild = false;
     }
+
+    if(!shownMap)
+        return;
+
+    // Apply local frame.
+    setLocalFrame(shownMap->localFrame);
+
+    // Draw map extents.
+    visualizeMapExtents(shownMap->cellExtents, shownMap->resolution);
 }
 
 void vizkit3d::TraversabilityMap3dVisualization::setIsolineInterval(const double& val)
@@ -226,6 +275,7 @@ void TraversabilityMap3dVisualization::setShowConnections(bool val)
 {
     show_connections = val;
     emit propertyChanged("show_connections");
+    rebuild = true;
     setDirty();
 }
 
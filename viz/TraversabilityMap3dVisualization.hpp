@@ -32,6 +32,11 @@
 #include <osg/Texture2D>
 #include <osgViz/modules/viz/Primitives/Primitives/LinesNode.h>
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "BackgroundBuilder.hpp"
+
 #if QT_VERSION >= 0x050000 || !defined(Q_MOC_RUN)
     #include "maps/grid/TraversabilityMap3d.hpp"
 #endif
@@ -39,6 +44,8 @@
 namespace vizkit3d
 {
 
+class PatchesGeode;
+
 class TraversabilityMap3dVisualization
     : public vizkit3d::MapVisualization<::maps::grid::TraversabilityMap3d<maps::grid::TraversabilityNodeBase *>>
 {
@@ -56,10 +63,30 @@ protected:
 
     ::maps::grid::TraversabilityMap3d<maps::grid::TraversabilityNodeBase *> map;
 
-    void addNodeList(const ::maps::grid::LevelList<::maps::grid::TraversabilityNodeBase *> &l, osg::Group* group);
+    /** Values of a node, the nodes of the map belong to the sender of the data */
+    struct NodeData
+    {
+        maps::grid::Index index;
+        float height;
+        maps::grid::TraversabilityNodeBase::TYPE type;
+    };
 
-    void visualizeNode(const ::maps::grid::TraversabilityNodeBase *node);
-    void visualizeConnection(const ::maps::grid::TraversabilityNodeBase *from, const ::maps::grid::TraversabilityNodeBase *to);
+    /** Copy of the drawn values of a map, which the background builder works on */
+    struct MapData
+    {
+        maps::grid::Vector2d resolution;
+        base::Transform3d localFrame;
+        maps::grid::CellExtents cellExtents;
+        std::vector<NodeData> nodes;
+        std::vector< std::pair<NodeData, NodeData> > connections;
+    };
+
+    /** Builds the nodes and connections of @p map, called by the background builder */
+    static osg::ref_ptr<osg::Group> createNodes(const MapData& map, bool show_connections, const BuildCancellation& cancellation);
+
+    static void visualizeNode(const NodeData& node, const maps::grid::Vector2d& resolution, PatchesGeode& geode);
+    static void visualizeConnection(const NodeData& from, const NodeData& to,
+                                    const maps::grid::Vector2d& resolution, osgviz::LinesNode& lines);
 
     osg::ref_ptr<osg::Geode> nodeGeode;
     osg::ref_ptr<osgviz::LinesNode> linesNode;
@@ -90,7 +117,17 @@ public:
     void setShowConnections(bool val);
 
 private:
+    struct BuildResult
+    {
+        osg::ref_ptr<osg::Group> nodes;
+        boost::shared_ptr<const MapData> map;
+    };
+
     osg::ref_ptr<osg::Group> localNode;
+    // The latest map and the map the shown nodes were built from.
+    boost::shared_ptr<const MapData> mapData, shownMap;
+    bool rebuild;
+    boost::scoped_ptr< BackgroundBuilder<BuildResult> > builder;
 };
 
 }